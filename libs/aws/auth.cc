@@ -37,9 +37,9 @@ void Authenticator::add_aws_headers(const RequestInfo& req)
 Misc::PropertyList Authenticator::get_canonical_headers(const RequestInfo& req)
 {
   Misc::PropertyList canon_headers;
-  for(const auto& p: req.headers.xml.children)
-    canon_headers.add(Text::tolower(p->name),
-                      Text::canonicalise_space(**p));
+  for(const auto& f: req.headers)
+    canon_headers.add(Text::tolower(string(f.name)),
+                      Text::canonicalise_space(string(f.value)));
   return canon_headers;
 }
 
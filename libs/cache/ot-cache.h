@@ -14,6 +14,14 @@
 #include "ot-mt.h"
 
 #include <map>
+#include <memory>
+#include <unordered_map>
+#include <list>
+#include <vector>
+#include <atomic>
+#include <limits>
+#include <functional>
+#include <algorithm>
 #include <iostream>
 #include <time.h>
 
@@ -29,9 +37,10 @@ struct PolicyData
   time_t add_time;          // Time added
   time_t use_time;          // Time last used
   unsigned long use_count;  // Number of times used
+  size_t cost;              // Cost (e.g. bytes) from cost function, or 0
 
   // Constructor - set times to now
-  PolicyData(): use_count(0)
+  PolicyData(): use_count(0), cost(0)
   {
     time(&add_time);
     use_time = add_time;
@@ -53,6 +62,143 @@ template<class CONTENT> struct MapContent
   MapContent(const CONTENT& _content): content(_content) {}
 };
 
+//==========================================================================
+// Cache statistics - snapshot of counters
+struct Statistics
+{
+  uint64_t lookups{0};      // Calls to lookup()
+  uint64_t hits{0};         // ... which found the entry
+  uint64_t misses{0};       // ... which didn't
+  uint64_t inserts{0};      // Entries added or replaced
+  uint64_t evictions{0};    // Entries evicted to make room
+  uint64_t tidied{0};       // Entries removed by tidy()
+  uint64_t rejected{0};     // Adds refused by admission filter
+  uint64_t entries{0};      // Entries now resident
+  uint64_t cost{0};         // Total cost of resident entries
+
+  double hit_ratio() const { return lookups ? double(hits)/lookups : 0; }
+};
+
+inline ostream& operator<<(ostream& s, const Statistics& st)
+{
+  s << "lookups " << st.lookups << ", hits " << st.hits
+    << ", misses " << st.misses << " (hit ratio " << st.hit_ratio()
+    << "), inserts " << st.inserts << ", evictions " << st.evictions
+    << ", tidied " << st.tidied << ", rejected " << st.rejected
+    << ", entries " << st.entries << ", cost " << st.cost;
+  return s;
+}
+
+//==========================================================================
+// Live statistics counters
+// Relaxed atomics, so cheap enough to leave on in production
+struct Counters
+{
+  atomic<uint64_t> lookups{0};
+  atomic<uint64_t> hits{0};
+  atomic<uint64_t> inserts{0};
+  atomic<uint64_t> evictions{0};
+  atomic<uint64_t> tidied{0};
+  atomic<uint64_t> rejected{0};
+  atomic<uint64_t> cost{0};
+
+  static void inc(atomic<uint64_t>& c, uint64_t n=1)
+  { c.fetch_add(n, memory_order_relaxed); }
+  static void dec(atomic<uint64_t>& c, uint64_t n=1)
+  { c.fetch_sub(n, memory_order_relaxed); }
+
+  // Get a snapshot, with the given number of entries
+  Statistics snapshot(uint64_t entries) const
+  {
+    Statistics st;
+    st.lookups = lookups.load(memory_order_relaxed);
+    st.hits = hits.load(memory_order_relaxed);
+    st.misses = st.lookups > st.hits ? st.lookups - st.hits : 0;
+    st.inserts = inserts.load(memory_order_relaxed);
+    st.evictions = evictions.load(memory_order_relaxed);
+    st.tidied = tidied.load(memory_order_relaxed);
+    st.rejected = rejected.load(memory_order_relaxed);
+    st.entries = entries;
+    st.cost = cost.load(memory_order_relaxed);
+    return st;
+  }
+};
+
+//==========================================================================
+// Frequency sketch for TinyLFU admission
+// Count-min sketch of small saturating counters, all halved after a sample
+// of increments so that old popularity fades
+// Thread-safe, but only approximately consistent - which is all it needs
+class FrequencySketch
+{
+  static const int depth = 4;
+  static const uint8_t max_count = 15;
+
+  size_t width_mask;
+  unique_ptr<atomic<uint8_t>[]> counters;  // depth rows of width
+  size_t sample_size;
+  atomic<size_t> additions{0};
+
+  size_t index(uint64_t hash, int row) const
+  {
+    uint64_t h = (hash + row) * 0x9E3779B97F4A7C15ULL;
+    h ^= h >> 29;
+    return row * (width_mask+1) + (h & width_mask);
+  }
+
+  // Halve all counters
+  void age()
+  {
+    const auto n = depth * (width_mask+1);
+    for(auto i=0u; i<n; i++)
+      counters[i].store(counters[i].load(memory_order_relaxed) >> 1,
+                        memory_order_relaxed);
+  }
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor - capacity is expected number of entries in the cache
+  FrequencySketch(size_t capacity)
+  {
+    size_t width = 16;
+    while (width < capacity) width <<= 1;
+    width_mask = width-1;
+    counters.reset(new atomic<uint8_t>[depth * width]());
+    sample_size = 10 * width;
+  }
+
+  //------------------------------------------------------------------------
+  // Record an occurrence of the given hash
+  void increment(uint64_t hash)
+  {
+    for(auto row=0; row<depth; row++)
+    {
+      auto& c = counters[index(hash, row)];
+      auto v = c.load(memory_order_relaxed);
+      while (v < max_count
+             && !c.compare_exchange_weak(v, v+1, memory_order_relaxed))
+        ;
+    }
+
+    if (additions.fetch_add(1, memory_order_relaxed) + 1 == sample_size)
+    {
+      additions.store(0, memory_order_relaxed);
+      age();
+    }
+  }
+
+  //------------------------------------------------------------------------
+  // Estimate the frequency of the given hash
+  unsigned int estimate(uint64_t hash) const
+  {
+    unsigned int f = max_count;
+    for(auto row=0; row<depth; row++)
+      f = min(f, static_cast<unsigned int>(
+                   counters[index(hash, row)].load(memory_order_relaxed)));
+    return f;
+  }
+};
+
 //==========================================================================
 // Background tidy policy template (abstract interface)
 // Called in background to cull 'dead' items
@@ -206,6 +352,9 @@ protected:
   // Limit on entries, 0 if unlimited
   unsigned int limit;
 
+  // Limit on total cost, 0 if unlimited
+  uint64_t cost_limit{0};
+
   // Core map
   MapType cachemap;
 
@@ -213,6 +362,103 @@ protected:
   TIDY_POLICY tidy_policy;
   EVICTOR_POLICY evictor_policy;
 
+  // Statistics
+  mutable Counters counters;
+
+  // Optional cost function and admission filter
+  function<size_t(const CONTENT&)> cost_function;
+  unique_ptr<FrequencySketch> sketch;
+  function<size_t(const ID&)> id_hash;
+
+  //------------------------------------------------------------------------
+  // Find the worst entry according to the evictor policy, other than the
+  // one given
+  // Mutex must be held
+  MapIterator find_worst(MapIterator except)
+  {
+    PolicyData worst_data;
+    MapIterator worst = cachemap.end();
+
+    // Show the policy all the entries, let them choose the worst
+    for(MapIterator p = cachemap.begin(); p!=cachemap.end(); ++p)
+    {
+      if (p == except) continue;
+      MCType &mc = p->second;
+      if (evictor_policy.check_worst(mc.policy_data, worst_data))
+      {
+        // Keep this as the worst
+        worst = p;
+        worst_data = mc.policy_data;
+      }
+    }
+
+    return worst;
+  }
+
+  //------------------------------------------------------------------------
+  // Erase an entry, keeping count of cost
+  // Mutex must be held
+  void erase_entry(MapIterator p)
+  {
+    Counters::dec(counters.cost, p->second.policy_data.cost);
+    cachemap.erase(p);
+  }
+
+  //------------------------------------------------------------------------
+  // Evict until there is room for an entry of the given cost, optionally
+  // for the given ID, which may already exist and is then not counted
+  // If an admission filter is enabled, a new ID is refused if it is no more
+  // popular than the entries it would displace - replacing is always allowed
+  // Victims are added to the list, for dispose() outside the lock
+  // Mutex must be held
+  // Returns whether there is now room
+  bool make_room(const ID *id, size_t cost, list<CONTENT>& victims)
+  {
+    auto existing = id ? cachemap.find(*id) : cachemap.end();
+    auto count = cachemap.size();
+    auto total = counters.cost.load(memory_order_relaxed);
+    if (existing != cachemap.end())
+    {
+      count--;
+      total -= existing->second.policy_data.cost;
+    }
+
+    // Don't flush everything for something which can never fit
+    if (cost_limit && cost > cost_limit) return false;
+
+    while ((limit && count >= limit)
+           || (cost_limit && total + cost > cost_limit))
+    {
+      auto worst = find_worst(existing);
+      if (worst == cachemap.end()) return false;  // Can't do it
+
+      if (id && existing == cachemap.end() && sketch
+          && sketch->estimate(id_hash(*id))
+             <= sketch->estimate(id_hash(worst->first)))
+      {
+        Counters::inc(counters.rejected);
+        return false;
+      }
+
+      if (!prepare_to_die(worst->first, worst->second.content))
+        return false;
+
+      count--;
+      total -= worst->second.policy_data.cost;
+      victims.push_back(worst->second.content);
+      erase_entry(worst);
+      Counters::inc(counters.evictions);
+    }
+
+    return true;
+  }
+
+  //------------------------------------------------------------------------
+  // Dispose of content which has left the cache by eviction or tidying
+  // Called outside the lock - does nothing here, but PointerCache uses it
+  // to free pointers
+  virtual void dispose(CONTENT&) {}
+
 public:
   // Overall readers/writer mutex
   mutable MT::RWMutex mutex;
@@ -236,18 +482,64 @@ public:
   // Get the limit
   int get_limit() const { return limit; }
 
+  //------------------------------------------------------------------------
+  // Set a cost function, giving the cost (e.g. size in bytes) of content
+  // Must be set before content is added
+  void set_cost_function(const function<size_t(const CONTENT&)>& f)
+  { cost_function = f; }
+
+  //------------------------------------------------------------------------
+  // Set a limit on total cost - may evict if more than limit in cache
+  void set_cost_limit(uint64_t _cost_limit)
+  {
+    cost_limit = _cost_limit;
+    evict();
+  }
+
+  //------------------------------------------------------------------------
+  // Enable a TinyLFU admission filter, which refuses to add an entry when
+  // the cache is full unless it has been added or looked up more often
+  // recently than the entry it would evict
+  // Capacity is the expected number of entries
+  void enable_admission_filter(size_t capacity,
+                               const function<size_t(const ID&)>& hasher
+                                 = hash<ID>())
+  {
+    MT::RWWriteLock lock(mutex);
+    sketch.reset(new FrequencySketch(capacity));
+    id_hash = hasher;
+  }
+
   //------------------------------------------------------------------------
   // Add an item of content to the cache
   // item is COPIED
   // Any existing content under this ID is deleted
-  // Whether successful - can fail if limit reached and no eviction possible
+  // Whether successful - can fail if limit reached and no eviction possible,
+  // or if refused by the admission filter
   bool add(const ID& id, const CONTENT& content)
   {
-    if (limit && cachemap.size() >= limit && !evict()) return false;
+    MCType mc(content);
+    if (cost_function) mc.policy_data.cost = cost_function(content);
 
-    MT::RWWriteLock lock(mutex);  // NB Don't lock around evict
-    cachemap[id] = MCType(content);
-    return true;
+    list<CONTENT> victims;
+    bool ok;
+    {
+      MT::RWWriteLock lock(mutex);
+      if (sketch) sketch->increment(id_hash(id));
+      ok = make_room(&id, mc.policy_data.cost, victims);
+      if (ok)
+      {
+        auto p = cachemap.find(id);
+        if (p != cachemap.end())
+          Counters::dec(counters.cost, p->second.policy_data.cost);
+        cachemap[id] = mc;
+        Counters::inc(counters.cost, mc.policy_data.cost);
+        Counters::inc(counters.inserts);
+      }
+    }
+
+    for(auto& v: victims) dispose(v);
+    return ok;
   }
 
   //------------------------------------------------------------------------
@@ -265,15 +557,26 @@ public:
     return cachemap.size();
   }
 
+  //------------------------------------------------------------------------
+  // Get statistics
+  Statistics get_statistics() const
+  {
+    MT::RWReadLock lock(mutex);
+    return counters.snapshot(cachemap.size());
+  }
+
   //------------------------------------------------------------------------
   // Returns copy of content of a given ID in the map
   // Whether found - if not, result is not changed
   bool lookup(const ID& id, CONTENT& result) const
   {
     MT::RWReadLock lock(mutex);
+    if (sketch) sketch->increment(id_hash(id));
+    Counters::inc(counters.lookups);
     const auto p = cachemap.find(id);
     if (p != cachemap.end())
     {
+      Counters::inc(counters.hits);
       result = p->second.content;
       return true;
     }
@@ -306,7 +609,7 @@ public:
   {
     MT::RWWriteLock lock(mutex);
     MapIterator p = cachemap.find(id);
-    if (p != cachemap.end()) cachemap.erase(p);
+    if (p != cachemap.end()) erase_entry(p);
   }
 
   //------------------------------------------------------------------------
@@ -322,61 +625,46 @@ public:
   virtual void tidy()
   {
     time_t now = time(0);
-    MT::RWWriteLock lock(mutex);
+    list<CONTENT> victims;
 
-    for(MapIterator p = cachemap.begin();
-        p!=cachemap.end();)
     {
-      MapIterator q=p++;
-      MCType &mc = q->second;
-      if (!tidy_policy.keep_entry(mc.policy_data, now)
-          && prepare_to_die(q->first, mc.content))
-        cachemap.erase(q);
+      MT::RWWriteLock lock(mutex);
+      for(MapIterator p = cachemap.begin();
+          p!=cachemap.end();)
+      {
+        MapIterator q=p++;
+        MCType &mc = q->second;
+        if (!tidy_policy.keep_entry(mc.policy_data, now)
+            && prepare_to_die(q->first, mc.content))
+        {
+          victims.push_back(mc.content);
+          erase_entry(q);
+          Counters::inc(counters.tidied);
+        }
+      }
     }
+
+    // Dispose outside the lock
+    for(auto& v: victims) dispose(v);
   }
 
   //------------------------------------------------------------------------
   // Run emergency evictor policy
-  // Evicts until map size is less than limit (room to add one)
+  // Evicts until map size is less than limit (room to add one), and
+  // total cost is within the cost limit
   // Returns whether there is now room
   virtual bool evict()
   {
-    MT::RWWriteLock lock(mutex);
-
-    // Number we need to evict
-    unsigned int needed = cachemap.size() - limit + 1;
-    if (needed <= 0) return true;
-
-    while (needed)
+    list<CONTENT> victims;
+    bool ok;
     {
-      PolicyData worst_data;
-      MapIterator worst = cachemap.end();
-
-      // Show the policy all the entries, let them choose the worst
-      for(MapIterator p = cachemap.begin();
-          p!=cachemap.end();
-          ++p)
-      {
-        MCType &mc = p->second;
-        if (evictor_policy.check_worst(mc.policy_data, worst_data))
-        {
-          // Keep this as the worst
-          worst = p;
-          worst_data = mc.policy_data;
-        }
-      }
-
-      // Did we find one?
-      if (worst!=cachemap.end()
-          && prepare_to_die(worst->first, worst->second.content))
-      {
-        cachemap.erase(worst);
-        needed--;
-      }
-      else return false;  // Can't do it
+      MT::RWWriteLock lock(mutex);
+      ok = make_room(nullptr, 0, victims);
     }
 
-    return true; // Got enough
+    // Dispose outside the lock
+    for(auto& v: victims) dispose(v);
+    return ok;
   }
 
   //------------------------------------------------------------------------
@@ -420,6 +708,7 @@ public:
   {
     MT::RWWriteLock lock(mutex);
     cachemap.clear();
+    counters.cost = 0;
   }
 
   //------------------------------------------------------------------------
@@ -546,9 +835,13 @@ protected:
   typedef typename MapType::iterator MapIterator;
 
   //------------------------------------------------------------------------
-  // Unused base prepare_to_die()
-  using Cache<ID, PointerContent<CONTENT>, TIDY_POLICY, EVICTOR_POLICY>
-    ::prepare_to_die;
+  // Base prepare_to_die(), forwarded to pointer version
+  bool prepare_to_die(const ID& id, PointerContent<CONTENT>& pc) override
+  { return prepare_to_die(id, pc.ptr); }
+
+  //------------------------------------------------------------------------
+  // Delete content leaving the cache
+  void dispose(PointerContent<CONTENT>& pc) override { delete pc.ptr; }
 
 public:
   //------------------------------------------------------------------------
@@ -563,15 +856,20 @@ public:
   // Add an item of content to the cache by pointer
   // item is TAKEN, and will be deleted on exit from the cache
   // Any existing content under this ID is deleted
-  // Whether successful - can fail if limit reached and no eviction possible
+  // Whether successful - can fail if limit reached and no eviction possible,
+  // or if refused by the admission filter, in which case item is deleted
   bool add(const ID& id, CONTENT *content)
   {
     // Try removing first to ensure deletion of old one
     remove(id);
 
     // Add PointerContent
-    return Cache<ID, PointerContent<CONTENT>, TIDY_POLICY, EVICTOR_POLICY>::
-      add(id, PointerContent<CONTENT>(content));
+    if (Cache<ID, PointerContent<CONTENT>, TIDY_POLICY, EVICTOR_POLICY>::
+        add(id, PointerContent<CONTENT>(content)))
+      return true;
+
+    delete content;
+    return false;
   }
 
   //------------------------------------------------------------------------
@@ -581,13 +879,27 @@ public:
   CONTENT *lookup(const ID& id) const
   {
     MT::RWReadLock lock(this->mutex);
+    if (this->sketch) this->sketch->increment(this->id_hash(id));
+    Counters::inc(this->counters.lookups);
     const auto p = this->cachemap.find(id);
     if (p != this->cachemap.end())
+    {
+      Counters::inc(this->counters.hits);
       return p->second.content.ptr;
+    }
     else
       return 0;
   }
 
+  //------------------------------------------------------------------------
+  // Set a cost function, giving the cost (e.g. size in bytes) of content
+  // Must be set before content is added
+  void set_cost_function(const function<size_t(const CONTENT&)>& f)
+  {
+    this->cost_function = [f](const PointerContent<CONTENT>& pc)
+      { return pc.ptr ? f(*pc.ptr) : 0; };
+  }
+
   //------------------------------------------------------------------------
   // Detaches pointer to content of a given ID in the map
   // Pointer found, or 0 if not in cache
@@ -599,7 +911,7 @@ public:
     if (p != this->cachemap.end())
     {
       CONTENT *r = p->second.content.ptr;
-      this->cachemap.erase(p);
+      this->erase_entry(p);
       return r;
     }
     else return 0;
@@ -619,7 +931,7 @@ public:
       if (p != this->cachemap.end())
       {
         to_delete = p->second.content.ptr;
-        this->cachemap.erase(p);
+        this->erase_entry(p);
       }
     }
 
@@ -635,116 +947,510 @@ public:
   virtual bool prepare_to_die(const ID&, CONTENT *) { return true; }
 
   //------------------------------------------------------------------------
-  // Run background evictor policy
-  virtual void tidy()
+  // Iterators
+  typedef PointerCacheIterator<ID, CONTENT> iterator;
+  iterator begin() { return iterator(this->cachemap.begin()); }
+  iterator end() { return iterator(this->cachemap.end()); }
+  typedef ConstPointerCacheIterator<ID, CONTENT> const_iterator;
+  const_iterator begin() const
+  { return const_iterator(this->cachemap.begin()); }
+  const_iterator end() const { return const_iterator(this->cachemap.end()); }
+
+
+  //------------------------------------------------------------------------
+  // Clear all content
+  virtual void clear()
   {
-    list<CONTENT *> to_delete;
-    time_t now = time(0);
+    MT::RWWriteLock lock(this->mutex);
+    for(MapIterator p = this->cachemap.begin(); p!=this->cachemap.end(); ++p)
+      delete(p->second.content.ptr);
+    this->cachemap.clear();
+    this->counters.cost = 0;
+  }
+
+  //------------------------------------------------------------------------
+  // Destructor to clear all entries
+  // Has to be here to ensure the right clear() gets called
+  ~PointerCache() { clear(); }
+};
+
+//==========================================================================
+// ShardedCache template
+// Like Cache, but split into a number of separately locked shards by hash
+// of ID, each of which keeps its entries in order of use, so lookup, touch
+// and eviction are O(1) and threads using different IDs rarely contend
+
+// Template arguments as Cache, plus:
+//   HASH:            Hash function for ID (default std::hash<ID>)
+
+// The limit is divided evenly between the shards, so eviction may start a
+// little before the total reaches it
+// Eviction only shows the EVICTOR_POLICY the few least recently used
+// entries in the shard, rather than every entry - with LRUEvictorPolicy
+// the least recently used is always chosen, or the next least if
+// prepare_to_die() refuses it
+// Policies are shared between shards, so may be called concurrently
+
+template<class ID, class CONTENT, class TIDY_POLICY, class EVICTOR_POLICY,
+         class HASH = hash<ID> >
+  class ShardedCache
+{
+protected:
+  //------------------------------------------------------------------------
+  // Useful internal types
+  struct Entry
+  {
+    ID id;
+    CONTENT content;
+    PolicyData policy_data;
+
+    Entry(const ID& _id, const CONTENT& _content):
+      id(_id), content(_content) {}
+  };
+
+  typedef list<Entry> ListType;   // Most recently used first
+  typedef typename ListType::iterator ListIterator;
+
+  // Padded to avoid false sharing of locks
+  // Statistics are kept per shard under its lock, so cost nothing extra
+  struct alignas(64) Shard
+  {
+    mutable MT::Mutex mutex;
+    ListType entries;
+    unordered_map<ID, ListIterator, HASH> index;
+    mutable Statistics stats;
+  };
+
+  //------------------------------------------------------------------------
+  // Internal state
+  static const unsigned int eviction_sample = 5;
+
+  // Limits on entries and total cost, 0 if unlimited - each shard gets
+  // an equal share, with the remainder spread over the first shards
+  atomic<unsigned int> limit{0};
+  atomic<uint64_t> cost_limit{0};
+
+  vector<Shard> shards;
+  size_t shard_mask;
+  HASH hasher;
+  atomic<size_t> count{0};
+
+  // Policies
+  TIDY_POLICY tidy_policy;
+  EVICTOR_POLICY evictor_policy;
+
+  // Optional cost function and admission filter
+  function<size_t(const CONTENT&)> cost_function;
+  unique_ptr<FrequencySketch> sketch;
+
+  //------------------------------------------------------------------------
+  // Get the shard for an ID - mixes the hash first, since std::hash is
+  // often the identity
+  Shard& shard_for(const ID& id)
+  {
+    const uint64_t h = hasher(id);
+    return shards[((h * 0x9E3779B97F4A7C15ULL) >> 40) & shard_mask];
+  }
+
+  const Shard& shard_for(const ID& id) const
+  { return const_cast<ShardedCache *>(this)->shard_for(id); }
+
+  //------------------------------------------------------------------------
+  // Get a shard's share of a total limit, so the shares add up to exactly
+  // the total
+  uint64_t share_of(uint64_t total, const Shard& shard) const
+  {
+    const uint64_t n = shard_mask+1;
+    const uint64_t index = &shard - shards.data();
+    return total/n + (index < total%n ? 1 : 0);
+  }
+
+  //------------------------------------------------------------------------
+  // Check whether a shard would be over its limits with the given number
+  // of extra entries and extra cost, after releasing the given cost (of an
+  // entry being replaced)
+  // Shard must be locked
+  bool over_limits(const Shard& shard, size_t extra, uint64_t extra_cost,
+                   uint64_t released_cost = 0)
+  {
+    const auto slimit = limit.load(memory_order_relaxed);
+    const auto sclimit = cost_limit.load(memory_order_relaxed);
+    return (slimit && shard.index.size() + extra > share_of(slimit, shard))
+      || (sclimit && shard.stats.cost - released_cost + extra_cost
+                     > share_of(sclimit, shard));
+  }
+
+  //------------------------------------------------------------------------
+  // Erase an entry from a shard, keeping count
+  // Shard must be locked
+  void erase_entry(Shard& shard, ListIterator p)
+  {
+    shard.stats.cost -= p->policy_data.cost;
+    shard.index.erase(p->id);
+    shard.entries.erase(p);
+    count--;
+  }
+
+  //------------------------------------------------------------------------
+  // Evict the worst of the least recently used entries in a shard, trying
+  // the next worst if prepare_to_die() refuses
+  // If an admission filter is enabled and a candidate ID is given, refuses
+  // if the candidate is no more popular than the victim
+  // The except entry, if given, is never chosen
+  // Shard must be locked
+  // Returns whether one was evicted
+  bool evict_one(Shard& shard, const ID *candidate = nullptr,
+                 const Entry *except = nullptr)
+  {
+    ListIterator refused[eviction_sample];
+    auto num_refused = 0u;
 
-    // Avoid locking around delete
+    while (num_refused < eviction_sample)
     {
-      MT::RWWriteLock lock(this->mutex);
+      // Start with worst being 'never', so even entries added this second
+      // can be chosen
+      PolicyData worst_data;
+      worst_data.add_time = worst_data.use_time =
+        numeric_limits<time_t>::max();
+      worst_data.use_count = numeric_limits<unsigned long>::max();
 
-      for(MapIterator p = this->cachemap.begin();
-          p!=this->cachemap.end();)
+      auto worst = shard.entries.end();
+      auto p = shard.entries.end();
+      for(auto i=0u; i<eviction_sample && p!=shard.entries.begin(); i++)
       {
-        MapIterator q=p++;
-        MCType &mc = q->second;
-        if (!this->tidy_policy.keep_entry(mc.policy_data, now)
-            && prepare_to_die(q->first, q->second.content.ptr))
+        --p;
+        if (&*p == except
+            || find(refused, refused+num_refused, p) != refused+num_refused)
+          continue;
+        if (evictor_policy.check_worst(p->policy_data, worst_data))
         {
-          to_delete.push_back(q->second.content.ptr);
-          this->cachemap.erase(q);
+          worst = p;
+          worst_data = p->policy_data;
         }
       }
+
+      if (worst == shard.entries.end()) return false;
+
+      if (candidate && sketch && sketch->estimate(hasher(*candidate))
+                                 <= sketch->estimate(hasher(worst->id)))
+      {
+        shard.stats.rejected++;
+        return false;
+      }
+
+      if (prepare_to_die(worst->id, worst->content))
+      {
+        erase_entry(shard, worst);
+        shard.stats.evictions++;
+        return true;
+      }
+
+      refused[num_refused++] = worst;
     }
 
-    // Now do the delete outside the lock
-    for(typename list<CONTENT *>::iterator p = to_delete.begin();
-        p!=to_delete.end(); ++p)
-      delete(*p);
+    return false;
   }
 
+public:
   //------------------------------------------------------------------------
-  // Run emergency evictor policy
-  // Evicts until map size is less than limit (room to add one)
-  // Returns whether there is now room
-  virtual bool evict()
+  // Constructor
+  // Number of shards is rounded up to a power of 2
+  ShardedCache(const TIDY_POLICY& _tpol,
+               const EVICTOR_POLICY& _epol,
+               unsigned int _limit=0, unsigned int _shards=16):
+    tidy_policy(_tpol), evictor_policy(_epol)
+  {
+    size_t n = 1;
+    while (n < _shards) n <<= 1;
+    shards = vector<Shard>(n);
+    shard_mask = n-1;
+    set_limit(_limit);
+  }
+
+  //------------------------------------------------------------------------
+  // Set the limit - may evict if more than limit in cache
+  // Each shard holds at most its share of the limit, so eviction may start
+  // before the whole cache is full, but the limit is never exceeded - with
+  // a limit below the number of shards, some shards can hold nothing
+  void set_limit(unsigned int _limit)
+  {
+    limit = _limit;
+    evict();
+  }
+
+  //------------------------------------------------------------------------
+  // Get the limit
+  int get_limit() const { return limit; }
+
+  //------------------------------------------------------------------------
+  // Set a cost function, giving the cost (e.g. size in bytes) of content
+  // Must be set before content is added
+  void set_cost_function(const function<size_t(const CONTENT&)>& f)
+  { cost_function = f; }
+
+  //------------------------------------------------------------------------
+  // Set a limit on total cost, shared between shards like the entry limit
+  // - may evict if more than limit in cache
+  void set_cost_limit(uint64_t _cost_limit)
+  {
+    cost_limit = _cost_limit;
+    evict();
+  }
+
+  //------------------------------------------------------------------------
+  // Enable a TinyLFU admission filter - see Cache
+  // Must be called before the cache is in use
+  void enable_admission_filter(size_t capacity)
+  { sketch.reset(new FrequencySketch(capacity)); }
+
+  //------------------------------------------------------------------------
+  // Get the number of shards
+  unsigned int get_shards() const { return shards.size(); }
+
+  //------------------------------------------------------------------------
+  // Add an item of content to the cache
+  // item is COPIED
+  // Any existing content under this ID is replaced
+  // Whether successful - can fail if limit reached and no eviction possible,
+  // or if refused by the admission filter
+  bool add(const ID& id, const CONTENT& content)
   {
-    // Number we need to evict
-    unsigned int needed = this->cachemap.size() - this->limit + 1;
-    if (needed <= 0) return true;
+    const size_t cost = cost_function ? cost_function(content) : 0;
+    if (sketch) sketch->increment(hasher(id));
 
-    while (needed)
+    auto& shard = shard_for(id);
+
+    // Don't flush a shard for something which can never fit
+    const auto sclimit = cost_limit.load(memory_order_relaxed);
+    if (sclimit && cost > share_of(sclimit, shard)) return false;
+
+    MT::Lock lock(shard.mutex);
+
+    const auto p = shard.index.find(id);
+    if (p != shard.index.end())
     {
-      CONTENT *to_delete = 0;
-      PolicyData worst_data;
+      // Make room for any extra cost from the others - no admission filter,
+      // since it is already here
+      const auto e = p->second;
+      const auto old_cost = e->policy_data.cost;
+      while (over_limits(shard, 0, cost, old_cost))
+        if (!evict_one(shard, nullptr, &*e)) return false;
+
+      e->content = content;
+      e->policy_data = PolicyData();
+      e->policy_data.cost = cost;
+      shard.stats.cost = shard.stats.cost - old_cost + cost;
+      shard.stats.inserts++;
+      shard.entries.splice(shard.entries.begin(), shard.entries, e);
+      return true;
+    }
 
-      {
-        MT::RWWriteLock lock(this->mutex);
-        MapIterator worst = this->cachemap.end();
+    while (over_limits(shard, 1, cost))
+      if (!evict_one(shard, &id)) return false;
 
-        // Show the policy all the entries, let them choose the worst
-        for(MapIterator p = this->cachemap.begin();
-            p!=this->cachemap.end();
-            ++p)
-        {
-          MCType &mc = p->second;
-          if (this->evictor_policy.check_worst(mc.policy_data, worst_data))
-          {
-            // Keep this as the worst
-            worst = p;
-            worst_data = mc.policy_data;
-          }
-        }
+    shard.entries.emplace_front(id, content);
+    shard.entries.front().policy_data.cost = cost;
+    shard.index.emplace(id, shard.entries.begin());
+    shard.stats.cost += cost;
+    shard.stats.inserts++;
+    count++;
+    return true;
+  }
 
-        // Did we find one?
-        if (worst!=this->cachemap.end())
-        {
-          // Fail if blocked by subclass
-          if (!prepare_to_die(worst->first, worst->second.content.ptr))
-            return false;
+  //------------------------------------------------------------------------
+  // Check (without copying) whether a given ID exists in the cache
+  bool contains(const ID& id) const
+  {
+    const auto& shard = shard_for(id);
+    MT::Lock lock(shard.mutex);
+    return shard.index.find(id) != shard.index.end();
+  }
 
-          to_delete = worst->second.content.ptr;
-          this->cachemap.erase(worst);
-          needed--;
+  //------------------------------------------------------------------------
+  // Get current size of cache
+  unsigned int size() const
+  {
+    return count.load(memory_order_relaxed);
+  }
+
+  //------------------------------------------------------------------------
+  // Get statistics, summed over all shards
+  Statistics get_statistics() const
+  {
+    Statistics total;
+    for(const auto& shard: shards)
+    {
+      MT::Lock lock(shard.mutex);
+      const auto& st = shard.stats;
+      total.lookups += st.lookups;
+      total.hits += st.hits;
+      total.inserts += st.inserts;
+      total.evictions += st.evictions;
+      total.tidied += st.tidied;
+      total.rejected += st.rejected;
+      total.entries += shard.index.size();
+      total.cost += st.cost;
+    }
+    total.misses = total.lookups - total.hits;
+    return total;
+  }
+
+  //------------------------------------------------------------------------
+  // Returns copy of content of a given ID in the cache
+  // Whether found - if not, result is not changed
+  bool lookup(const ID& id, CONTENT& result) const
+  {
+    if (sketch) sketch->increment(hasher(id));
+    const auto& shard = shard_for(id);
+    MT::Lock lock(shard.mutex);
+    shard.stats.lookups++;
+    const auto p = shard.index.find(id);
+    if (p == shard.index.end()) return false;
+    shard.stats.hits++;
+    result = p->second->content;
+    return true;
+  }
+
+  //------------------------------------------------------------------------
+  // Touches an entry, renewing its use-time and incrementing use-count,
+  // and moves it to most recently used
+  // Returns whether ID exists - ignored if not
+  bool touch(const ID& id)
+  {
+    auto& shard = shard_for(id);
+    MT::Lock lock(shard.mutex);
+    const auto p = shard.index.find(id);
+    if (p == shard.index.end()) return false;
+    p->second->policy_data.touch();
+    shard.entries.splice(shard.entries.begin(), shard.entries, p->second);
+    return true;
+  }
+
+  //------------------------------------------------------------------------
+  // Combined lookup and touch, taking the lock only once
+  // Whether found - if not, result is not changed
+  bool lookup_and_touch(const ID& id, CONTENT& result)
+  {
+    if (sketch) sketch->increment(hasher(id));
+    auto& shard = shard_for(id);
+    MT::Lock lock(shard.mutex);
+    shard.stats.lookups++;
+    const auto p = shard.index.find(id);
+    if (p == shard.index.end()) return false;
+    shard.stats.hits++;
+    p->second->policy_data.touch();
+    shard.entries.splice(shard.entries.begin(), shard.entries, p->second);
+    result = p->second->content;
+    return true;
+  }
+
+  //------------------------------------------------------------------------
+  // Remove content of given ID
+  virtual void remove(const ID& id)
+  {
+    auto& shard = shard_for(id);
+    MT::Lock lock(shard.mutex);
+    const auto p = shard.index.find(id);
+    if (p == shard.index.end()) return;
+    erase_entry(shard, p->second);
+  }
+
+  //------------------------------------------------------------------------
+  // Warning and decision whether to allow deletion from tidy or eviction
+  // Always OK here - override to prevent deletion of active objects
+  // Called with the shard locked, so must not call back into the cache
+  virtual bool prepare_to_die(const ID&, CONTENT&) { return true; }
+
+  //------------------------------------------------------------------------
+  // Run background tidy policy, one shard at a time
+  virtual void tidy()
+  {
+    const time_t now = time(0);
+    for(auto& shard: shards)
+    {
+      MT::Lock lock(shard.mutex);
+      for(auto p = shard.entries.begin(); p!=shard.entries.end();)
+      {
+        const auto q = p++;
+        if (!tidy_policy.keep_entry(q->policy_data, now)
+            && prepare_to_die(q->id, q->content))
+        {
+          erase_entry(shard, q);
+          shard.stats.tidied++;
         }
-        else return false;  // Can't do it
       }
-
-      // Do delete outside lock
-      if (to_delete) delete(to_delete);
     }
+  }
 
-    return true; // Got enough
+  //------------------------------------------------------------------------
+  // Run emergency evictor policy
+  // Evicts until every shard is within its share of the limits
+  // Returns whether successful
+  virtual bool evict()
+  {
+    auto ok = true;
+    for(auto& shard: shards)
+    {
+      MT::Lock lock(shard.mutex);
+      while (over_limits(shard, 0, 0))
+        if (!evict_one(shard)) { ok = false; break; }
+    }
+    return ok;
   }
 
+  //------------------------------------------------------------------------
+  // Call a function for every entry, most recently used first within each
+  // shard - the function is called with the shard locked
+  void for_each(const function<void(const ID&, CONTENT&)>& f)
+  {
+    for(auto& shard: shards)
+    {
+      MT::Lock lock(shard.mutex);
+      for(auto& e: shard.entries)
+        f(e.id, e.content);
+    }
+  }
 
   //------------------------------------------------------------------------
-  // Iterators
-  typedef PointerCacheIterator<ID, CONTENT> iterator;
-  iterator begin() { return iterator(this->cachemap.begin()); }
-  iterator end() { return iterator(this->cachemap.end()); }
-  typedef ConstPointerCacheIterator<ID, CONTENT> const_iterator;
-  const_iterator begin() const
-  { return const_iterator(this->cachemap.begin()); }
-  const_iterator end() const { return const_iterator(this->cachemap.end()); }
+  // Dump contents to given stream
+  void dump(ostream& s, bool show_content=false) const
+  {
+    time_t now = time(0);
 
+    s << "Cache size " << size() << ", limit " << limit
+      << ", shards " << shards.size() << ":\n";
+    for(const auto& shard: shards)
+    {
+      MT::Lock lock(shard.mutex);
+      for(const auto& e: shard.entries)
+      {
+        const auto& pd = e.policy_data;
+        s << e.id;
+        if (show_content) s << " -> " << e.content << endl;
+        s << " (at=" << pd.add_time-now <<
+          ", ut=" << pd.use_time-now <<
+          ", use=" << pd.use_count << ")\n";
+      }
+    }
+  }
 
   //------------------------------------------------------------------------
   // Clear all content
   virtual void clear()
   {
-    MT::RWWriteLock lock(this->mutex);
-    for(MapIterator p = this->cachemap.begin(); p!=this->cachemap.end(); ++p)
-      delete(p->second.content.ptr);
-    this->cachemap.clear();
+    for(auto& shard: shards)
+    {
+      MT::Lock lock(shard.mutex);
+      count -= shard.index.size();
+      shard.index.clear();
+      shard.entries.clear();
+      shard.stats.cost = 0;
+    }
   }
 
   //------------------------------------------------------------------------
-  // Destructor to clear all entries
-  // Has to be here to ensure the right clear() gets called
-  ~PointerCache() { clear(); }
+  // Virtual destructor
+  virtual ~ShardedCache() {}
 };
 
 ////////////////////////////////////////////////////////////////////////////
@@ -848,6 +1554,48 @@ public:
   { return current.add_time < worst.add_time; }
 };
 
+//==========================================================================
+// Cost eviction policy
+// Removes the entry with the highest cost per use, so large, rarely reused
+// entries go before small, hot ones - least recently used on a tie
+// Needs a cost function to be set on the cache
+template<class ID, class CONTENT> class CostEvictorPolicy:
+  public EvictorPolicy<ID, CONTENT>
+{
+  static double density(const PolicyData& pd)
+  { return pd.cost / (pd.use_count + 1.0); }
+
+public:
+  CostEvictorPolicy() {}
+
+  //------------------------------------------------------------------------
+  // Eviction policy - find the most expensive entry per use
+  bool check_worst(const PolicyData& current, const PolicyData& worst)
+  {
+    const auto c = density(current), w = density(worst);
+    return c > w || (c == w && current.use_time < worst.use_time);
+  }
+};
+
+//==========================================================================
+// Size eviction policy
+// Removes the largest entry, least recently used on a tie
+// Needs a cost function to be set on the cache
+template<class ID, class CONTENT> class SizeEvictorPolicy:
+  public EvictorPolicy<ID, CONTENT>
+{
+public:
+  SizeEvictorPolicy() {}
+
+  //------------------------------------------------------------------------
+  // Eviction policy - find the largest entry
+  bool check_worst(const PolicyData& current, const PolicyData& worst)
+  {
+    return current.cost > worst.cost
+      || (current.cost == worst.cost && current.use_time < worst.use_time);
+  }
+};
+
 ////////////////////////////////////////////////////////////////////////////
 // Standard combinations
 ////////////////////////////////////////////////////////////////////////////
@@ -990,6 +1738,57 @@ public:
     (NoTidyPolicy<ID, CONTENT>(), AgeEvictorPolicy<ID, CONTENT>(), _limit) {}
 };
 
+//==========================================================================
+// Cost eviction cache, no tidying, limited by total cost
+template<class ID, class CONTENT> class CostEvictionCache:
+  public Cache<ID, CONTENT, NoTidyPolicy<ID, CONTENT>,
+               CostEvictorPolicy<ID, CONTENT> >
+{
+public:
+  CostEvictionCache(const function<size_t(const CONTENT&)>& _cost_function,
+                    uint64_t _cost_limit, unsigned int _limit = 0):
+    Cache<ID, CONTENT, NoTidyPolicy<ID, CONTENT>,
+          CostEvictorPolicy<ID,CONTENT> >
+    (NoTidyPolicy<ID, CONTENT>(), CostEvictorPolicy<ID, CONTENT>(), _limit)
+  {
+    this->set_cost_function(_cost_function);
+    this->set_cost_limit(_cost_limit);
+  }
+};
+
+//==========================================================================
+// Cost eviction pointer cache, no tidying, limited by total cost
+template<class ID, class CONTENT> class CostEvictionPointerCache:
+  public PointerCache<ID, CONTENT, NoTidyPolicy<ID, CONTENT>,
+                      CostEvictorPolicy<ID, CONTENT> >
+{
+public:
+  CostEvictionPointerCache(
+      const function<size_t(const CONTENT&)>& _cost_function,
+      uint64_t _cost_limit, unsigned int _limit = 0):
+    PointerCache<ID, CONTENT, NoTidyPolicy<ID, CONTENT>,
+                 CostEvictorPolicy<ID,CONTENT> >
+    (NoTidyPolicy<ID, CONTENT>(), CostEvictorPolicy<ID, CONTENT>(), _limit)
+  {
+    this->set_cost_function(_cost_function);
+    this->set_cost_limit(_cost_limit);
+  }
+};
+
+//==========================================================================
+// LRU eviction sharded cache, no tidying
+template<class ID, class CONTENT> class LRUShardedCache:
+  public ShardedCache<ID, CONTENT, NoTidyPolicy<ID, CONTENT>,
+                      LRUEvictorPolicy<ID, CONTENT> >
+{
+public:
+  LRUShardedCache(unsigned int _limit = 0, unsigned int _shards = 16):
+    ShardedCache<ID, CONTENT, NoTidyPolicy<ID, CONTENT>,
+                 LRUEvictorPolicy<ID,CONTENT> >
+    (NoTidyPolicy<ID, CONTENT>(), LRUEvictorPolicy<ID, CONTENT>(),
+     _limit, _shards) {}
+};
+
 //==========================================================================
 }} //namespaces
 #endif // !__OBTOOLS_CACHE_H
@@ -0,0 +1,271 @@
+//==========================================================================
+// ObTools::Cache: test-cache-stats.cc
+//
+// GTest harness for cache statistics, cost limits, cost eviction and
+// admission filtering
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include <gtest/gtest.h>
+#include "ot-cache.h"
+#include <sstream>
+
+using namespace std;
+using namespace ObTools;
+
+TEST(CacheStatsTest, TestStatisticsAreCounted)
+{
+  Cache::LRUEvictionCache<int, string> cache(2);
+  cache.add(1, "one");
+  cache.add(2, "two");
+  string value;
+  EXPECT_TRUE(cache.lookup(1, value));
+  EXPECT_TRUE(cache.lookup(2, value));
+  EXPECT_TRUE(cache.lookup(1, value));
+  EXPECT_FALSE(cache.lookup(3, value));
+
+  auto st = cache.get_statistics();
+  EXPECT_EQ(4u, st.lookups);
+  EXPECT_EQ(3u, st.hits);
+  EXPECT_EQ(1u, st.misses);
+  EXPECT_DOUBLE_EQ(0.75, st.hit_ratio());
+  EXPECT_EQ(2u, st.inserts);
+  EXPECT_EQ(0u, st.evictions);
+  EXPECT_EQ(2u, st.entries);
+
+  ostringstream oss;
+  oss << st;
+  EXPECT_NE(string::npos, oss.str().find("hits 3"));
+}
+
+TEST(CacheStatsTest, TestCostLimitEvicts)
+{
+  Cache::CostEvictionCache<int, string> cache(
+    [](const string& s) { return s.size(); }, 10);
+  ASSERT_TRUE(cache.add(1, "aaaa"));
+  ASSERT_TRUE(cache.add(2, "bbbb"));
+  EXPECT_EQ(8u, cache.get_statistics().cost);
+
+  // Another 4 takes it over, so one goes
+  ASSERT_TRUE(cache.add(3, "cccc"));
+  auto st = cache.get_statistics();
+  EXPECT_EQ(2u, st.entries);
+  EXPECT_EQ(8u, st.cost);
+  EXPECT_EQ(1u, st.evictions);
+
+  // Replacing counts the new cost only
+  ASSERT_TRUE(cache.add(3, "cc"));
+  EXPECT_EQ(6u, cache.get_statistics().cost);
+
+  cache.remove(3);
+  EXPECT_EQ(4u, cache.get_statistics().cost);
+  cache.clear();
+  EXPECT_EQ(0u, cache.get_statistics().cost);
+}
+
+TEST(CacheStatsTest, TestTidyIsCounted)
+{
+  Cache::AgeTimeoutCache<int, int> cache(-1);
+  cache.add(1, 1);
+  cache.add(2, 2);
+  cache.tidy();
+  auto st = cache.get_statistics();
+  EXPECT_EQ(2u, st.tidied);
+  EXPECT_EQ(0u, st.entries);
+}
+
+// Content which counts its deletions
+struct Blob
+{
+  static int deleted;
+  size_t size;
+  Blob(size_t _size): size(_size) {}
+  ~Blob() { deleted++; }
+};
+int Blob::deleted = 0;
+
+TEST(CacheStatsTest, TestLargeColdObjectDoesNotFlushSmallHotOnes)
+{
+  Blob::deleted = 0;
+  {
+    Cache::CostEvictionPointerCache<int, Blob> cache(
+      [](const Blob& b) { return b.size; }, 1000);
+
+    // Small, hot entries
+    for (auto i=0; i<10; i++)
+    {
+      ASSERT_TRUE(cache.add(i, new Blob(50)));
+      for (auto j=0; j<5; j++)
+      {
+        ASSERT_NE(nullptr, cache.lookup(i));
+        cache.touch(i);
+      }
+    }
+
+    // Large one fits, but is then first to go when more arrive
+    ASSERT_TRUE(cache.add(100, new Blob(400)));
+    ASSERT_TRUE(cache.add(101, new Blob(200)));
+    EXPECT_FALSE(cache.contains(100));
+    for (auto i=0; i<10; i++) EXPECT_TRUE(cache.contains(i)) << i;
+    EXPECT_EQ(1, Blob::deleted);
+
+    // Too big to fit at all - deleted
+    EXPECT_FALSE(cache.add(102, new Blob(2000)));
+    EXPECT_EQ(2, Blob::deleted);
+    EXPECT_EQ(700u, cache.get_statistics().cost);
+    EXPECT_EQ(11u, cache.size());
+  }
+  EXPECT_EQ(13, Blob::deleted);
+}
+
+TEST(CacheStatsTest, TestSizeEvictorTakesLargestFirst)
+{
+  Cache::Cache<int, string, Cache::NoTidyPolicy<int, string>,
+               Cache::SizeEvictorPolicy<int, string> >
+    cache{Cache::NoTidyPolicy<int, string>(),
+          Cache::SizeEvictorPolicy<int, string>()};
+  cache.set_cost_function([](const string& s) { return s.size(); });
+  cache.add(1, "a");
+  cache.add(2, "bbbbbb");
+  cache.add(3, "ccc");
+  cache.set_cost_limit(5);
+  EXPECT_TRUE(cache.contains(1));
+  EXPECT_FALSE(cache.contains(2));
+  EXPECT_TRUE(cache.contains(3));
+}
+
+TEST(CacheStatsTest, TestAdmissionFilterRejectsOneHitWonders)
+{
+  Cache::CostEvictionCache<int, int> cache([](const int&) { return 1; }, 10);
+  cache.enable_admission_filter(100);
+
+  // Popular working set
+  int value;
+  for (auto i=0; i<10; i++)
+  {
+    ASSERT_TRUE(cache.add(i, i));
+    for (auto j=0; j<3; j++) cache.lookup(i, value);
+  }
+
+  // Scan of one-off keys gets nowhere
+  for (auto i=1000; i<1100; i++) EXPECT_FALSE(cache.add(i, i));
+  for (auto i=0; i<10; i++) EXPECT_TRUE(cache.contains(i));
+  EXPECT_EQ(100u, cache.get_statistics().rejected);
+
+  // But a key which keeps being asked for gets in
+  auto admitted = false;
+  for (auto i=0; i<10 && !admitted; i++)
+  {
+    cache.lookup(2000, value);
+    admitted = cache.add(2000, 2000);
+  }
+  EXPECT_TRUE(admitted);
+}
+
+TEST(CacheStatsTest, TestShardedStatisticsCostAndAdmission)
+{
+  Cache::ShardedCache<int, string, Cache::NoTidyPolicy<int, string>,
+                      Cache::CostEvictorPolicy<int, string> >
+    cache(Cache::NoTidyPolicy<int, string>(),
+          Cache::CostEvictorPolicy<int, string>(), 0, 1);
+  cache.set_cost_function([](const string& s) { return s.size(); });
+  cache.set_cost_limit(10);
+
+  ASSERT_TRUE(cache.add(1, "aaa"));
+  ASSERT_TRUE(cache.add(2, "bbbbbb"));
+  string value;
+  EXPECT_TRUE(cache.lookup_and_touch(1, value));
+  EXPECT_FALSE(cache.lookup(3, value));
+
+  // Big one goes first
+  ASSERT_TRUE(cache.add(3, "ccc"));
+  EXPECT_FALSE(cache.contains(2));
+
+  // Replace with something bigger evicts others, not itself
+  ASSERT_TRUE(cache.add(3, "cccccccc"));
+  EXPECT_TRUE(cache.contains(3));
+  EXPECT_FALSE(cache.contains(1));
+
+  auto st = cache.get_statistics();
+  EXPECT_EQ(2u, st.lookups);
+  EXPECT_EQ(1u, st.hits);
+  EXPECT_EQ(4u, st.inserts);
+  EXPECT_EQ(2u, st.evictions);
+  EXPECT_EQ(1u, st.entries);
+  EXPECT_EQ(8u, st.cost);
+
+  // Too big to fit at all
+  EXPECT_FALSE(cache.add(4, "ddddddddddd"));
+  EXPECT_TRUE(cache.contains(3));
+
+  // Admission filter on a new cache
+  Cache::LRUShardedCache<int, int> lru(4, 1);
+  lru.enable_admission_filter(4);
+  int v;
+  for (auto i=0; i<4; i++)
+  {
+    ASSERT_TRUE(lru.add(i, i));
+    lru.lookup(i, v);
+  }
+  EXPECT_FALSE(lru.add(99, 99));
+  EXPECT_EQ(1u, lru.get_statistics().rejected);
+}
+
+TEST(CacheStatsTest, TestAdmissionFilterAllowsReplacement)
+{
+  Cache::CostEvictionCache<int, string> cache(
+    [](const string& s) { return s.size(); }, 10);
+  cache.enable_admission_filter(100);
+  string value;
+  ASSERT_TRUE(cache.add(1, "aaaa"));
+  ASSERT_TRUE(cache.add(2, "bbbb"));
+  for (auto i=0; i<5; i++) cache.lookup(2, value);
+
+  // Less popular than what it displaces, but already here
+  ASSERT_TRUE(cache.add(1, "aaaaaaaa"));
+  EXPECT_FALSE(cache.contains(2));
+  EXPECT_EQ(8u, cache.get_statistics().cost);
+}
+
+// Cache which never lets anything be evicted
+class StubbornShardedCache:
+  public Cache::ShardedCache<int, string, Cache::NoTidyPolicy<int, string>,
+                             Cache::CostEvictorPolicy<int, string> >
+{
+public:
+  StubbornShardedCache():
+    ShardedCache(Cache::NoTidyPolicy<int, string>(),
+                 Cache::CostEvictorPolicy<int, string>(), 0, 1) {}
+  bool prepare_to_die(const int&, string&) override { return false; }
+};
+
+TEST(CacheStatsTest, TestShardedFailedReplaceKeepsCost)
+{
+  StubbornShardedCache cache;
+  cache.set_cost_function([](const string& s) { return s.size(); });
+  cache.set_cost_limit(10);
+  ASSERT_TRUE(cache.add(1, "aaaa"));
+  ASSERT_TRUE(cache.add(2, "bbb"));
+  EXPECT_EQ(7u, cache.get_statistics().cost);
+
+  // Needs 1 evicted, which is refused - so nothing changes
+  EXPECT_FALSE(cache.add(2, "bbbbbbb"));
+  string value;
+  ASSERT_TRUE(cache.lookup(2, value));
+  EXPECT_EQ("bbb", value);
+  EXPECT_EQ(7u, cache.get_statistics().cost);
+
+  // And the old cost is still released when it goes
+  cache.remove(2);
+  EXPECT_EQ(4u, cache.get_statistics().cost);
+}
+
+//--------------------------------------------------------------------------
+// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
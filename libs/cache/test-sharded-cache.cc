@@ -0,0 +1,220 @@
+//==========================================================================
+// ObTools::Cache: test-sharded-cache.cc
+//
+// GTest harness for sharded cache, including a multithreaded benchmark
+// against LRUEvictionCache
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include <gtest/gtest.h>
+#include "ot-cache.h"
+#include <thread>
+#include <sstream>
+
+using namespace std;
+using namespace ObTools;
+
+TEST(ShardedCacheTest, TestAddLookupReplaceRemove)
+{
+  Cache::LRUShardedCache<string, string> cache;
+  EXPECT_EQ(16u, cache.get_shards());
+  ASSERT_TRUE(cache.add("foo", "FOO"));
+  ASSERT_TRUE(cache.add("bar", "BAR"));
+  EXPECT_EQ(2u, cache.size());
+  EXPECT_TRUE(cache.contains("foo"));
+
+  string value;
+  ASSERT_TRUE(cache.lookup("foo", value));
+  EXPECT_EQ("FOO", value);
+  EXPECT_FALSE(cache.lookup("baz", value));
+  EXPECT_EQ("FOO", value);
+
+  ASSERT_TRUE(cache.add("foo", "FOO2"));
+  EXPECT_EQ(2u, cache.size());
+  ASSERT_TRUE(cache.lookup_and_touch("foo", value));
+  EXPECT_EQ("FOO2", value);
+
+  cache.remove("foo");
+  EXPECT_FALSE(cache.contains("foo"));
+  EXPECT_EQ(1u, cache.size());
+  cache.clear();
+  EXPECT_EQ(0u, cache.size());
+  EXPECT_FALSE(cache.contains("bar"));
+}
+
+TEST(ShardedCacheTest, TestLRUEvictionInOneShard)
+{
+  Cache::LRUShardedCache<int, int> cache(3, 1);
+  for (auto i=0; i<3; i++) ASSERT_TRUE(cache.add(i, i*10));
+
+  // Touch 0 so 1 is now least recently used
+  EXPECT_TRUE(cache.touch(0));
+  ASSERT_TRUE(cache.add(3, 30));
+  EXPECT_EQ(3u, cache.size());
+  EXPECT_TRUE(cache.contains(0));
+  EXPECT_FALSE(cache.contains(1));
+  EXPECT_TRUE(cache.contains(2));
+  EXPECT_TRUE(cache.contains(3));
+
+  // Reducing the limit evicts least recently used first
+  cache.set_limit(1);
+  EXPECT_EQ(1u, cache.size());
+  EXPECT_TRUE(cache.contains(3));
+}
+
+TEST(ShardedCacheTest, TestLimitIsSpreadOverShards)
+{
+  Cache::LRUShardedCache<int, int> cache(1000, 8);
+  for (auto i=0; i<100000; i++) ASSERT_TRUE(cache.add(i, i));
+  EXPECT_LE(cache.size(), 1000u);
+  EXPECT_GT(cache.size(), 900u);
+
+  // Most recent are still there
+  EXPECT_TRUE(cache.contains(99999));
+  EXPECT_FALSE(cache.contains(0));
+}
+
+TEST(ShardedCacheTest, TestLimitIsNeverExceeded)
+{
+  Cache::LRUShardedCache<int, int> cache(10, 16);
+  for (auto i=0; i<10000; i++) cache.add(i, i);
+  EXPECT_LE(cache.size(), 10u);
+  EXPECT_GT(cache.size(), 0u);
+
+  cache.set_limit(21);
+  for (auto i=0; i<10000; i++) cache.add(i, i);
+  EXPECT_LE(cache.size(), 21u);
+  EXPECT_GT(cache.size(), 16u);
+}
+
+// Cache which refuses to let odd numbers die
+class ProtectiveCache: public Cache::LRUShardedCache<int, int>
+{
+public:
+  ProtectiveCache(unsigned int limit): LRUShardedCache(limit, 1) {}
+  bool prepare_to_die(const int& id, int&) override { return !(id & 1); }
+};
+
+TEST(ShardedCacheTest, TestPrepareToDieCanPreventEviction)
+{
+  ProtectiveCache cache(2);
+  ASSERT_TRUE(cache.add(1, 1));
+  ASSERT_TRUE(cache.add(2, 2));
+  ASSERT_TRUE(cache.add(4, 4));   // Evicts 2, not 1
+  EXPECT_TRUE(cache.contains(1));
+  EXPECT_FALSE(cache.contains(2));
+  ASSERT_TRUE(cache.add(3, 3));   // Evicts 4
+  EXPECT_FALSE(cache.add(5, 5));  // Only odd ones left
+  EXPECT_EQ(2u, cache.size());
+}
+
+TEST(ShardedCacheTest, TestNoEvictorPolicyNeverEvicts)
+{
+  Cache::ShardedCache<int, int, Cache::NoTidyPolicy<int, int>,
+                      Cache::NoEvictorPolicy<int, int> >
+    cache(Cache::NoTidyPolicy<int, int>(), Cache::NoEvictorPolicy<int, int>(),
+          2, 1);
+  ASSERT_TRUE(cache.add(1, 1));
+  ASSERT_TRUE(cache.add(2, 2));
+  EXPECT_FALSE(cache.add(3, 3));
+}
+
+TEST(ShardedCacheTest, TestTidyPolicyAndDump)
+{
+  Cache::ShardedCache<int, int, Cache::AgeTimeoutTidyPolicy<int, int>,
+                      Cache::NoEvictorPolicy<int, int> >
+    cache(Cache::AgeTimeoutTidyPolicy<int, int>(-1),
+          Cache::NoEvictorPolicy<int, int>());
+  for (auto i=0; i<10; i++) cache.add(i, i);
+
+  auto sum = 0;
+  cache.for_each([&sum](const int&, int& v) { sum += v; });
+  EXPECT_EQ(45, sum);
+
+  ostringstream oss;
+  cache.dump(oss);
+  EXPECT_NE(string::npos, oss.str().find("Cache size 10"));
+
+  // Negative timeout means everything is too old
+  cache.tidy();
+  EXPECT_EQ(0u, cache.size());
+}
+
+//--------------------------------------------------------------------------
+// Run a mixed lookup/add load, return operations/sec
+template<class CACHE, class LOOKUP>
+double run_load(CACHE& cache, int threads, int ops, int keys,
+                LOOKUP lookup)
+{
+  auto start = chrono::steady_clock::now();
+  vector<thread> workers;
+  for (auto t=0; t<threads; t++)
+  {
+    workers.emplace_back([&cache, &lookup, t, ops, keys]()
+    {
+      uint32_t seed = 12345 + t;
+      for (auto i=0; i<ops; i++)
+      {
+        seed = seed * 1103515245 + 12345;
+        auto key = static_cast<int>((seed >> 8) % keys);
+        if (i % 10)
+          lookup(cache, key);
+        else
+          cache.add(key, key);
+      }
+    });
+  }
+  for (auto& w: workers) w.join();
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  return threads * ops / elapsed.count();
+}
+
+TEST(ShardedCacheTest, BenchmarkMultithreadedAgainstLRUEvictionCache)
+{
+  if (!getenv("OBTOOLS_BENCHMARK"))
+    GTEST_SKIP() << "OBTOOLS_BENCHMARK not set";
+
+  const auto threads = 8;
+  const auto keys = 20000;
+  const auto limit = 10000;
+
+  // Old cache can only evict entries used before this second, so fill it
+  // and wait - both caches start full
+  Cache::LRUEvictionCache<int, int> old_cache(limit);
+  Cache::LRUShardedCache<int, int> new_cache(limit);
+  for (auto i=0; i<limit; i++)
+  {
+    old_cache.add(i, i);
+    new_cache.add(i, i);
+  }
+  this_thread::sleep_for(chrono::milliseconds{1100});
+
+  auto old_rate = run_load(old_cache, threads, 20000, keys,
+                           [](Cache::LRUEvictionCache<int, int>& c, int key)
+                           {
+                             int value;
+                             if (c.lookup(key, value)) c.touch(key);
+                           });
+
+  auto new_rate = run_load(new_cache, threads, 200000, keys,
+                           [](Cache::LRUShardedCache<int, int>& c, int key)
+                           {
+                             int value;
+                             c.lookup_and_touch(key, value);
+                           });
+  EXPECT_LE(new_cache.size(), static_cast<unsigned>(limit));
+
+  cout << threads << " threads, ops/sec: LRUEvictionCache "
+       << static_cast<int>(old_rate) << ", LRUShardedCache "
+       << static_cast<int>(new_rate) << " (x" << new_rate / old_rate << ")\n";
+}
+
+//--------------------------------------------------------------------------
+// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -172,6 +172,7 @@ int Shell::start(int argc, char **argv)
   auto time_format = config.get_value("log/@timestamp", DEFAULT_TIMESTAMP);
   auto hold_time = config.get_value("log/@hold-time", DEFAULT_HOLD_TIME);
   Log::logger.connect_full(chan_out, level_out, time_format, hold_time);
+  Log::set_max_level(level_out);  // Don't format what will be filtered
   Log::Streams log;
   log.summary << name << " version " << version << " starting\n";
 
@@ -9,9 +9,422 @@
 
 #include "ot-db-mysql.h"
 #include "ot-log.h"
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 
 namespace ObTools { namespace DB { namespace MySQL {
 
+namespace
+{
+  // Initial buffer for text columns - grown if a value is truncated
+  const unsigned long initial_text_size = 256;
+
+  // Shortest text which reads back the same
+  string format_real(double value, bool single)
+  {
+    if (std::isnan(value)) return "nan";
+    if (std::isinf(value)) return value < 0 ? "-inf" : "inf";
+
+    char buf[32];
+    if (single)
+    {
+      const auto f = static_cast<float>(value);
+      for(auto digits = 6; digits <= 9; digits++)
+      {
+        snprintf(buf, sizeof(buf), "%.*g", digits, f);
+        if (strtof(buf, nullptr) == f) break;
+      }
+    }
+    else
+    {
+      for(auto digits = 15; digits <= 17; digits++)
+      {
+        snprintf(buf, sizeof(buf), "%.*g", digits, value);
+        if (strtod(buf, nullptr) == value) break;
+      }
+    }
+    return buf;
+  }
+}
+
+//==========================================================================
+// MySQL prepared statement
+
+//--------------------------------------------------------------------------
+// Constructor
+PreparedStatement::PreparedStatement(MYSQL_STMT *_stmt): stmt{_stmt}
+{
+  if (!stmt) return;
+
+  // Parameters start null
+  const auto np = mysql_stmt_param_count(stmt);
+  param_binds.resize(np);
+  params.resize(np);
+  for(auto& b: param_binds) b.buffer_type = MYSQL_TYPE_NULL;
+
+  // Bind result columns to native buffers where we can
+  auto meta = mysql_stmt_result_metadata(stmt);
+  if (!meta) return;
+
+  const auto nf = mysql_num_fields(meta);
+  const auto fields = mysql_fetch_fields(meta);
+  column_binds.resize(nf);
+  columns.resize(nf);
+  for(auto i=0u; i<nf; i++)
+  {
+    field_names.push_back(fields[i].name);
+    auto& b = column_binds[i];
+    auto& c = columns[i];
+    b.is_null = &c.is_null;
+    b.error = &c.error;
+    b.length = &c.length;
+
+    switch (fields[i].type)
+    {
+      case MYSQL_TYPE_TINY:
+      case MYSQL_TYPE_SHORT:
+      case MYSQL_TYPE_INT24:
+      case MYSQL_TYPE_LONG:
+      case MYSQL_TYPE_LONGLONG:
+      case MYSQL_TYPE_YEAR:
+        b.buffer_type = MYSQL_TYPE_LONGLONG;
+        b.buffer = &c.integer;
+        b.is_unsigned = (fields[i].flags & UNSIGNED_FLAG) ? 1 : 0;
+        break;
+
+      case MYSQL_TYPE_FLOAT:
+      case MYSQL_TYPE_DOUBLE:
+        b.buffer_type = MYSQL_TYPE_DOUBLE;
+        b.buffer = &c.real;
+        c.single = fields[i].type == MYSQL_TYPE_FLOAT;
+        break;
+
+      default:
+        // Text, decimals, dates and blobs - converted to text by the client
+        c.text.resize(initial_text_size);
+        b.buffer_type = MYSQL_TYPE_STRING;
+        b.buffer = c.text.data();
+        b.buffer_length = c.text.size();
+        break;
+    }
+  }
+
+  mysql_free_result(meta);
+}
+
+//--------------------------------------------------------------------------
+// Log an error from the statement
+void PreparedStatement::log_error(const string& what)
+{
+  Log::Error log;
+  log << "MySQL prepared statement " << what << " failed: "
+      << mysql_stmt_error(stmt) << endl;
+}
+
+//--------------------------------------------------------------------------
+// Clear a parameter binding and set its type
+// Returns the binding, or nullptr if the index is out of range
+MYSQL_BIND *PreparedStatement::start_param(int index, enum_field_types type)
+{
+  if (index < 1 || index > static_cast<int>(param_binds.size()))
+    return nullptr;
+  auto b = &param_binds[index-1];
+  *b = MYSQL_BIND{};
+  b->buffer_type = type;
+  return b;
+}
+
+//--------------------------------------------------------------------------
+// Bind a parameter (integer)
+bool PreparedStatement::bind(int index, int64_t value)
+{
+  auto b = start_param(index, MYSQL_TYPE_LONGLONG);
+  if (!b) return false;
+  auto& p = params[index-1];
+  p.integer = value;
+  b->buffer = &p.integer;
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Bind a parameter (unsigned integer)
+bool PreparedStatement::bind(int index, uint64_t value)
+{
+  auto b = start_param(index, MYSQL_TYPE_LONGLONG);
+  if (!b) return false;
+  auto& p = params[index-1];
+  p.integer = static_cast<long long>(value);
+  b->buffer = &p.integer;
+  b->is_unsigned = 1;
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Bind a parameter (real)
+bool PreparedStatement::bind(int index, double value)
+{
+  auto b = start_param(index, MYSQL_TYPE_DOUBLE);
+  if (!b) return false;
+  auto& p = params[index-1];
+  p.real = value;
+  b->buffer = &p.real;
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Bind a parameter (text)
+bool PreparedStatement::bind(int index, const string& value)
+{
+  auto b = start_param(index, MYSQL_TYPE_STRING);
+  if (!b) return false;
+  auto& p = params[index-1];
+  p.text = value;
+  p.length = p.text.size();
+  b->buffer = &p.text[0];
+  b->buffer_length = p.length;
+  b->length = &p.length;
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Bind a parameter (null)
+bool PreparedStatement::bind(int index)
+{
+  return start_param(index, MYSQL_TYPE_NULL);
+}
+
+//--------------------------------------------------------------------------
+// Reset statement
+void PreparedStatement::reset()
+{
+  if (stmt && executed) mysql_stmt_free_result(stmt);
+  executed = have_row = false;
+}
+
+//--------------------------------------------------------------------------
+// Run the statement with the current parameters, and store any result
+bool PreparedStatement::run()
+{
+  if (!stmt) return false;
+  reset();
+
+  if (!param_binds.empty() && mysql_stmt_bind_param(stmt, param_binds.data()))
+  {
+    log_error("bind");
+    return false;
+  }
+
+  if (mysql_stmt_execute(stmt))
+  {
+    log_error("execute");
+    return false;
+  }
+
+  if (!column_binds.empty())
+  {
+    if (mysql_stmt_bind_result(stmt, column_binds.data())
+        || mysql_stmt_store_result(stmt))
+    {
+      log_error("result");
+      mysql_stmt_free_result(stmt);
+      return false;
+    }
+  }
+
+  executed = true;
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Execute statement
+bool PreparedStatement::execute()
+{
+  return run();
+}
+
+//--------------------------------------------------------------------------
+// Get number of rows in result set
+int PreparedStatement::count()
+{
+  if (!executed && !run()) return 0;
+  return mysql_stmt_num_rows(stmt);
+}
+
+//--------------------------------------------------------------------------
+// Refetch text columns which didn't fit, into bigger buffers
+bool PreparedStatement::fetch_truncated()
+{
+  auto rebind = false;
+  for(auto i=0u; i<columns.size(); i++)
+  {
+    auto& c = columns[i];
+    auto& b = column_binds[i];
+    if (b.buffer_type != MYSQL_TYPE_STRING || c.length <= c.text.size())
+      continue;
+
+    c.text.resize(c.length);
+    b.buffer = c.text.data();
+    b.buffer_length = c.text.size();
+    if (mysql_stmt_fetch_column(stmt, &b, i, 0))
+    {
+      log_error("fetch");
+      return false;
+    }
+    rebind = true;
+  }
+
+  // Keep the bigger buffers for later rows
+  if (rebind && mysql_stmt_bind_result(stmt, column_binds.data()))
+  {
+    log_error("result");
+    return false;
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Move to next row
+bool PreparedStatement::next()
+{
+  if (!executed && !run()) return false;
+
+  have_row = false;
+  if (column_binds.empty()) return false;
+
+  const auto rc = mysql_stmt_fetch(stmt);
+  if (rc == MYSQL_NO_DATA) return false;
+  if (rc == MYSQL_DATA_TRUNCATED)
+  {
+    if (!fetch_truncated()) return false;
+  }
+  else if (rc)
+  {
+    log_error("fetch");
+    return false;
+  }
+
+  have_row = true;
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Get next row from result set
+// Whether another was found - if so, clears and writes into row
+// Null fields are left out, as in ResultSet
+bool PreparedStatement::fetch(Row& row)
+{
+  if (!next()) return false;
+
+  row.clear();
+  for(auto i=0u; i<columns.size(); i++)
+    if (!columns[i].is_null) row.add(field_names[i], get_string(i));
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Get first value of next row from result set
+// Whether another was found - if so, writes into value
+bool PreparedStatement::fetch(string& value)
+{
+  if (columns.empty() || !next()) return false;
+  value = get_string(0);
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Fetch field as string
+string PreparedStatement::get_string(int col)
+{
+  if (!have_row || col < 0 || col >= static_cast<int>(columns.size())
+      || columns[col].is_null)
+    return {};
+
+  const auto& c = columns[col];
+  const auto& b = column_binds[col];
+  switch (b.buffer_type)
+  {
+    case MYSQL_TYPE_LONGLONG:
+      if (b.is_unsigned)
+        return to_string(static_cast<unsigned long long>(c.integer));
+      return to_string(c.integer);
+
+    case MYSQL_TYPE_DOUBLE:
+      return format_real(c.real, c.single);
+
+    default:
+      return string(c.text.data(), min<size_t>(c.length, c.text.size()));
+  }
+}
+
+//--------------------------------------------------------------------------
+// Fetch field as int
+uint64_t PreparedStatement::get_int(int col)
+{
+  if (!have_row || col < 0 || col >= static_cast<int>(columns.size())
+      || columns[col].is_null)
+    return 0;
+
+  const auto& c = columns[col];
+  switch (column_binds[col].buffer_type)
+  {
+    case MYSQL_TYPE_LONGLONG:
+      return c.integer;
+
+    case MYSQL_TYPE_DOUBLE:
+      return static_cast<int64_t>(c.real);
+
+    default:
+    {
+      const auto s = get_string(col);
+      if (!s.empty() && s[0] == '-') return strtoll(s.c_str(), nullptr, 10);
+      return strtoull(s.c_str(), nullptr, 10);
+    }
+  }
+}
+
+//--------------------------------------------------------------------------
+// Fetch field as double
+double PreparedStatement::get_real(int col)
+{
+  if (!have_row || col < 0 || col >= static_cast<int>(columns.size())
+      || columns[col].is_null)
+    return 0;
+
+  const auto& c = columns[col];
+  const auto& b = column_binds[col];
+  switch (b.buffer_type)
+  {
+    case MYSQL_TYPE_LONGLONG:
+      if (b.is_unsigned) return static_cast<unsigned long long>(c.integer);
+      return c.integer;
+
+    case MYSQL_TYPE_DOUBLE:
+      return c.real;
+
+    default:
+      return strtod(get_string(col).c_str(), nullptr);
+  }
+}
+
+//--------------------------------------------------------------------------
+// Fetch field as Time::Stamp
+Time::Stamp PreparedStatement::get_time(int col)
+{
+  const auto s = get_string(col);
+  if (s.empty()) return {};
+  return Time::Stamp{s};
+}
+
+//--------------------------------------------------------------------------
+// Destructor
+PreparedStatement::~PreparedStatement()
+{
+  if (stmt) mysql_stmt_close(stmt);
+}
+
 //==========================================================================
 // MySQL result class
 
@@ -73,6 +486,40 @@ ResultSet::~ResultSet()
   mysql_free_result(res);
 }
 
+//==========================================================================
+// MySQL streaming result
+
+//--------------------------------------------------------------------------
+// Constructor
+Stream::Stream(MYSQL *_conn, MYSQL_RES *_res):
+  conn{_conn}, res{_res, mysql_free_result}
+{
+  const auto n = mysql_num_fields(_res);
+  const auto fields = mysql_fetch_fields(_res);
+  for(auto i=0u; i<n; i++)
+    column_names.push_back(fields[i].name);
+}
+
+//--------------------------------------------------------------------------
+// Move to next row
+bool Stream::next()
+{
+  row = mysql_fetch_row(res.get());
+  if (!row)
+  {
+    // End, or lost the connection part way through
+    if (mysql_errno(conn))
+    {
+      failed = true;
+      Log::Error log;
+      log << "MySQL stream failed: " << mysql_error(conn) << endl;
+    }
+    return false;
+  }
+  lengths = mysql_fetch_lengths(res.get());
+  return true;
+}
+
 //==========================================================================
 // MySQL connection class
 
@@ -162,6 +609,58 @@ Result Connection::query(const string& sql)
   return Result(new ResultSet(res));
 }
 
+//--------------------------------------------------------------------------
+// Execute a query and stream the result
+// Returns cursor - check this for validity
+Cursor Connection::stream(const string& sql)
+{
+  OBTOOLS_LOG_IF_DEBUG(log.debug << "DBstream: " << sql << endl;)
+
+  if (mysql_real_query(conn, sql.data(), sql.size()))
+  {
+    log.error << "MySQL stream failed: " << mysql_error(conn) << endl;
+    return Cursor();
+  }
+
+  // Rows are left on the server until fetched
+  MYSQL_RES *res = mysql_use_result(conn);
+  if (!res)
+  {
+    log.error << "MySQL stream returned no result: ";
+    log.error << sql << endl;
+    return Cursor();
+  }
+
+  OBTOOLS_LOG_IF_DEBUG(log.debug << "DBstream OK\n";)
+  return Cursor(new Stream(conn, res));
+}
+
+//--------------------------------------------------------------------------
+// Prepare a statement
+// Returns result - check this for validity
+Statement Connection::prepare(const string& sql)
+{
+  OBTOOLS_LOG_IF_DEBUG(log.debug << "DBprepare: " << sql << endl;)
+
+  auto stmt = conn ? mysql_stmt_init(conn) : nullptr;
+  if (!stmt)
+  {
+    log.error << "Can't allocate MySQL statement\n";
+    return Statement(new PreparedStatement(nullptr));
+  }
+
+  if (mysql_stmt_prepare(stmt, sql.c_str(), sql.size()))
+  {
+    log.error << "MySQL prepare failed: " << mysql_stmt_error(stmt) << endl;
+    log.error << "  " << sql << endl;
+    mysql_stmt_close(stmt);
+    return Statement(new PreparedStatement(nullptr));
+  }
+
+  OBTOOLS_LOG_IF_DEBUG(log.debug << "DBprepare OK\n";)
+  return Statement(new PreparedStatement(stmt));
+}
+
 //--------------------------------------------------------------------------
 // Gets the last insert id
 uint64_t Connection::get_last_insert_id()
@@ -169,10 +668,78 @@ uint64_t Connection::get_last_insert_id()
   return mysql_insert_id(conn);
 }
 
+//--------------------------------------------------------------------------
+// Execute an INSERT and get the generated ID
+bool Connection::insert_returning(const string& sql, const string&,
+                                  const string&, uint64_t& id, bool)
+{
+  if (!exec(sql)) return false;
+  id = mysql_insert_id(conn);
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// INSERT a batch of rows getting IDs
+// In the 'traditional' and 'consecutive' lock modes the rows of a multi-row
+// INSERT get IDs auto_increment_increment apart, from mysql_insert_id(),
+// but not in 'interleaved' mode (the default from 8.0)
+bool Connection::insert_batch_returning(const string& table,
+                                        const vector<Row>& rows,
+                                        const string& id_field,
+                                        vector<uint64_t>& ids)
+{
+  if (autoinc_step < 0)
+  {
+    Row row;
+    autoinc_step = 0;
+    if (DB::Connection::query("SELECT @@innodb_autoinc_lock_mode AS mode,"
+                              " @@auto_increment_increment AS step", row)
+        && row.get_int("mode", 2) < 2)
+      autoinc_step = row.get_int("step");
+  }
+
+  if (autoinc_step <= 0)
+    return DB::Connection::insert_batch_returning(table, rows, id_field, ids);
+
+  // Limit statement size
+  const size_t max_rows_per_statement = 1000;
+
+  for(auto start = 0ul; start < rows.size(); start += max_rows_per_statement)
+  {
+    const auto end = min(rows.size(), start + max_rows_per_statement);
+    ostringstream oss;
+    oss << "INSERT INTO " << table;
+    oss << " (" << rows[start].get_fields() << ") VALUES ";
+    for(auto i=start; i<end; i++)
+    {
+      if (i != start) oss << ", ";
+      oss << "(" << rows[i].get_escaped_values() << ")";
+    }
+
+    if (!exec(oss.str())) return false;
+    if (mysql_affected_rows(conn) != end - start)
+    {
+      log.error << "MySQL INSERT into " << table << " inserted "
+                << mysql_affected_rows(conn) << " of " << end - start
+                << " rows\n";
+      return false;
+    }
+
+    // Gives the ID of the first row
+    const uint64_t first = mysql_insert_id(conn);
+    for(auto i=0ul; i<end-start; i++)
+      ids.push_back(first + i*autoinc_step);
+  }
+
+  return true;
+}
+
 //--------------------------------------------------------------------------
 // Destructor
 Connection::~Connection()
 {
+  // Statements must be closed before the connection
+  prepared_statements.clear();
   if (conn) mysql_close(conn);
 }
 
@@ -13,6 +13,7 @@
 #include "ot-db.h"
 #include "ot-log.h"
 #include <mysql/mysql.h>
+#include <type_traits>
 
 namespace ObTools { namespace DB { namespace MySQL {
 
@@ -55,6 +56,173 @@ public:
   ~ResultSet();
 };
 
+//==========================================================================
+// MySQL streaming result
+// Read with mysql_use_result(), so rows are fetched from the server one at
+// a time rather than stored.  Abandoning it early reads and discards the
+// rest
+class Stream: public DB::ResultStream
+{
+private:
+  MYSQL *conn;
+  unique_ptr<MYSQL_RES, decltype(&mysql_free_result)> res;
+  MYSQL_ROW row = nullptr;
+  unsigned long *lengths = nullptr;
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor
+  Stream(MYSQL *_conn, MYSQL_RES *res);
+
+  //------------------------------------------------------------------------
+  // Move to next row
+  bool next() override;
+
+  //------------------------------------------------------------------------
+  // Check whether a field is null
+  bool is_null(int col) override { return !row[col]; }
+
+  //------------------------------------------------------------------------
+  // Get a field as a string view
+  string_view get_string_view(int col) override
+  {
+    return row[col] ? string_view(row[col], lengths[col]) : string_view();
+  }
+};
+
+//==========================================================================
+// MySQL prepared statement
+// Uses the mysql_stmt binary protocol: parameters are bound as native
+// values, and integer and floating point columns are received as such
+// rather than as text.  Parameters are numbered from 1, columns from 0
+class PreparedStatement: public DB::PreparedStatement
+{
+private:
+  // my_bool or bool, depending on the client library version
+  using flag_t = remove_pointer<decltype(MYSQL_BIND::is_null)>::type;
+
+  struct Param
+  {
+    long long integer = 0;
+    double real = 0;
+    string text;
+    unsigned long length = 0;
+  };
+
+  struct Column
+  {
+    long long integer = 0;
+    double real = 0;
+    bool single = false;      // FLOAT rather than DOUBLE
+    vector<char> text;
+    unsigned long length = 0;
+    flag_t is_null = 0;
+    flag_t error = 0;
+  };
+
+  MYSQL_STMT *stmt;
+  vector<MYSQL_BIND> param_binds;
+  vector<Param> params;       // Buffers for param_binds
+  vector<MYSQL_BIND> column_binds;
+  vector<Column> columns;     // Buffers for column_binds
+  vector<string> field_names;
+  bool executed = false;
+  bool have_row = false;
+
+  MYSQL_BIND *start_param(int index, enum_field_types type);
+  bool run();
+  bool fetch_truncated();
+  void log_error(const string& what);
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor - takes ownership of the statement, which is null if
+  // preparation failed
+  PreparedStatement(MYSQL_STMT *_stmt);
+
+  //------------------------------------------------------------------------
+  // Bind a parameter (bool)
+  bool bind(int index, bool value) override
+  {
+    return bind(index, static_cast<int64_t>(value));
+  }
+
+  //------------------------------------------------------------------------
+  // Bind a parameter (integer)
+  bool bind(int index, int64_t value) override;
+
+  //------------------------------------------------------------------------
+  // Bind a parameter (unsigned integer)
+  bool bind(int index, uint64_t value) override;
+
+  //------------------------------------------------------------------------
+  // Bind a parameter (unsigned integer)
+  bool bind(int index, unsigned value) override
+  {
+    return bind(index, static_cast<int64_t>(value));
+  }
+
+  //------------------------------------------------------------------------
+  // Bind a parameter (real)
+  bool bind(int index, double value) override;
+
+  //------------------------------------------------------------------------
+  // Bind a parameter (text)
+  bool bind(int index, const string& value) override;
+
+  //------------------------------------------------------------------------
+  // Bind a parameter (null)
+  bool bind(int index) override;
+
+  //------------------------------------------------------------------------
+  // Reset statement - drops any result, keeps the parameters
+  void reset() override;
+
+  //------------------------------------------------------------------------
+  // Execute statement
+  bool execute() override;
+
+  //------------------------------------------------------------------------
+  // Get row count - executes if not already done
+  int count() override;
+
+  //------------------------------------------------------------------------
+  // Get next row from result set - executes if not already done
+  bool fetch(Row& row) override;
+
+  //------------------------------------------------------------------------
+  // Get first value of next row from result set
+  bool fetch(string& value) override;
+
+  //------------------------------------------------------------------------
+  // Move to next row - executes if not already done
+  bool next() override;
+
+  //------------------------------------------------------------------------
+  // Fetch field as string
+  string get_string(int col) override;
+
+  //------------------------------------------------------------------------
+  // Fetch field as int
+  uint64_t get_int(int col) override;
+
+  //------------------------------------------------------------------------
+  // Fetch field as double
+  double get_real(int col) override;
+
+  //------------------------------------------------------------------------
+  // Fetch field as Time::Stamp
+  Time::Stamp get_time(int col) override;
+
+  //------------------------------------------------------------------------
+  // Is valid?
+  explicit operator bool() const override { return stmt; }
+
+  //------------------------------------------------------------------------
+  // Destructor
+  ~PreparedStatement();
+};
+
 //==========================================================================
 // MySQL connection class
 class Connection: public DB::Connection
@@ -63,6 +231,8 @@ private:
   MYSQL *conn = nullptr;  // MySQL connection structure
   Log::Streams log; // Private (therefore per-thread, assuming connections
                     // are not shared) log streams
+  int autoinc_step = -1;  // Step between IDs from a multi-row INSERT, 0 if
+                          // not reliable, -1 if not yet known
 
 public:
   //------------------------------------------------------------------------
@@ -88,15 +258,31 @@ public:
   //------------------------------------------------------------------------
   // Prepare a statement
   // Returns result - check this for validity
-  Statement prepare(const string& /* sql */) override
-  {
-    throw runtime_error("Prepare not implemented for MySQL");
-  }
+  Statement prepare(const string& sql) override;
+
+  //------------------------------------------------------------------------
+  // Execute a query and stream the result
+  // Returns cursor - check this for validity
+  Cursor stream(const string& sql) override;
 
   //------------------------------------------------------------------------
   // Gets the last insert id
   uint64_t get_last_insert_id() override;
 
+  //------------------------------------------------------------------------
+  // Execute an INSERT and get the generated ID, from mysql_insert_id()
+  bool insert_returning(const string& sql, const string& table,
+                        const string& id_field, uint64_t& id,
+                        bool in_transaction) override;
+
+  //------------------------------------------------------------------------
+  // INSERT a batch of rows getting IDs - with multi-row INSERTs if the
+  // server gives them consecutive IDs (innodb_autoinc_lock_mode below 2),
+  // otherwise a row at a time
+  bool insert_batch_returning(const string& table, const vector<Row>& rows,
+                              const string& id_field,
+                              vector<uint64_t>& ids) override;
+
   //------------------------------------------------------------------------
   // Expression to get current datetime in UTC
   string utc_timestamp() override { return "utc_timestamp()"; }
@@ -0,0 +1,191 @@
+//==========================================================================
+// ObTools::DB: test-db-mysql.cc
+//
+// Test harness for MySQL database driver
+//
+// Needs a server: set OBTOOLS_TEST_MYSQL to the host, user, password and
+// database, separated by spaces, e.g.
+//   OBTOOLS_TEST_MYSQL="localhost test secret test"
+// Tests are skipped if it is not set
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include <gtest/gtest.h>
+#include "ot-db-mysql.h"
+#include <cstdlib>
+#include <sstream>
+
+using namespace std;
+using namespace ObTools;
+
+namespace {
+class DBMySQLTest: public ::testing::Test
+{
+protected:
+  string host, user, passwd, dbname;
+  unique_ptr<DB::Connection> conn;
+
+  void SetUp() override
+  {
+    const auto env = getenv("OBTOOLS_TEST_MYSQL");
+    if (!env) GTEST_SKIP() << "OBTOOLS_TEST_MYSQL not set";
+    istringstream iss(env);
+    iss >> host >> user >> passwd >> dbname;
+    conn.reset(new DB::MySQL::Connection(host, user, passwd, dbname));
+    ASSERT_TRUE(!!*conn);
+    conn->exec("drop table if exists obtools_test");
+    ASSERT_TRUE(conn->exec("create table obtools_test (id bigint primary key, "
+                           "small smallint, name varchar(256), score double, "
+                           "ratio float, flag bool, price decimal(10,2), "
+                           "notes text)"));
+  }
+
+  void TearDown() override
+  {
+    if (conn) conn->exec("drop table if exists obtools_test");
+  }
+};
+}
+
+//--------------------------------------------------------------------------
+// Tests
+TEST_F(DBMySQLTest, TestPreparedInsertAndSelect)
+{
+  auto insert = conn->prepare("insert into obtools_test "
+                              "(id, small, name, score, ratio, flag, price) "
+                              "values (?, ?, ?, ?, ?, ?, ?)");
+  ASSERT_TRUE(!!insert);
+  ASSERT_TRUE(insert.bind(1, int64_t{-1234567890123}));
+  ASSERT_TRUE(insert.bind(2, int64_t{-5}));
+  ASSERT_TRUE(insert.bind(3, string{"O'Brien \\ \"quoted\""}));
+  ASSERT_TRUE(insert.bind(4, 0.1));
+  ASSERT_TRUE(insert.bind(5, 1.0/3));
+  ASSERT_TRUE(insert.bind(6, true));
+  ASSERT_TRUE(insert.bind(7, 12.5));
+  ASSERT_TRUE(insert.execute());
+  EXPECT_FALSE(insert.bind(8, int64_t{1}));
+
+  // Null
+  insert.reset();
+  ASSERT_TRUE(insert.bind(1, uint64_t{2}));
+  ASSERT_TRUE(insert.bind(3));
+  ASSERT_TRUE(insert.execute());
+
+  // Native integer and real columns
+  auto select = conn->prepare("select id, small, name, score, ratio, flag "
+                              "from obtools_test where id = ?");
+  ASSERT_TRUE(select.bind(1, int64_t{-1234567890123}));
+  ASSERT_TRUE(select.next());
+  EXPECT_EQ(-1234567890123, static_cast<int64_t>(select.get_int(0)));
+  EXPECT_EQ("-5", select.get_string(1));
+  EXPECT_EQ("O'Brien \\ \"quoted\"", select.get_string(2));
+  EXPECT_EQ(0.1, select.get_real(3));
+  EXPECT_EQ("0.33333334", select.get_string(4));
+  EXPECT_EQ(1u, select.get_int(5));
+  EXPECT_FALSE(select.next());
+
+  // Same as a text query gives (float differs - the server rounds it)
+  const auto sql = string{"select id, small, name, score, flag "
+                          "from obtools_test where id = -1234567890123"};
+  DB::Row binary_row, text_row;
+  auto same = conn->prepare(sql);
+  ASSERT_TRUE(same.fetch(binary_row));
+  ASSERT_TRUE(conn->query(sql, text_row));
+  EXPECT_EQ(text_row.get_escaped_values(), binary_row.get_escaped_values());
+
+  // Decimal as text, null as empty
+  auto price = conn->prepare("select price, name from obtools_test "
+                             "order by id");
+  ASSERT_TRUE(!!price);
+  EXPECT_EQ(2, price.count());
+  ASSERT_TRUE(price.next());
+  EXPECT_EQ("12.50", price.get_string(0));
+  EXPECT_EQ(12.5, price.get_real(0));
+  ASSERT_TRUE(price.next());
+  EXPECT_EQ("", price.get_string(1));
+}
+
+TEST_F(DBMySQLTest, TestLongTextIsRefetched)
+{
+  const auto notes = string(10000, 'x') + "end";
+  auto insert = conn->prepare("insert into obtools_test (id, notes) "
+                              "values (?, ?)");
+  ASSERT_TRUE(insert.bind(1, int64_t{1}));
+  ASSERT_TRUE(insert.bind(2, notes));
+  ASSERT_TRUE(insert.execute());
+  insert.reset();
+  ASSERT_TRUE(insert.bind(1, int64_t{2}));
+  ASSERT_TRUE(insert.bind(2, string{"short"}));
+  ASSERT_TRUE(insert.execute());
+
+  auto select = conn->prepare("select notes from obtools_test order by id");
+  string value;
+  ASSERT_TRUE(select.fetch(value));
+  EXPECT_EQ(notes, value);
+  ASSERT_TRUE(select.fetch(value));
+  EXPECT_EQ("short", value);
+  EXPECT_FALSE(select.fetch(value));
+}
+
+TEST_F(DBMySQLTest, TestBadStatementIsInvalid)
+{
+  auto statement = conn->prepare("select nonsense from nowhere");
+  EXPECT_FALSE(!!statement);
+  EXPECT_FALSE(statement.execute());
+  EXPECT_FALSE(statement.next());
+}
+
+TEST_F(DBMySQLTest, TestHeldStatementsFromFactory)
+{
+  DB::MySQL::ConnectionFactory factory(host, user, passwd, dbname, 0,
+    {{"insert", "insert into obtools_test (id, name) values (?, ?)"},
+     {"name", "select name from obtools_test where id = ?"}});
+  auto c = unique_ptr<DB::Connection>(factory.create());
+  ASSERT_TRUE(c.get());
+
+  for(auto i=0; i<3; i++)
+  {
+    auto insert = c->get_statement("insert");
+    ASSERT_TRUE(insert.bind(1, int64_t{i}));
+    ASSERT_TRUE(insert.bind(2, "name" + to_string(i)));
+    ASSERT_TRUE(insert.execute());
+  }
+
+  auto name = c->get_statement("name");
+  ASSERT_TRUE(name.bind(1, 2u));
+  string value;
+  ASSERT_TRUE(name.fetch(value));
+  EXPECT_EQ("name2", value);
+}
+
+TEST_F(DBMySQLTest, TestInsertReturningIds)
+{
+  ASSERT_TRUE(conn->exec("create temporary table obtools_serial "
+                         "(id bigint auto_increment primary key, "
+                         "name text)"));
+  DB::Row row;
+  row.add("name", "first");
+  EXPECT_EQ(1u, conn->insert64("obtools_serial", row));
+  EXPECT_EQ(1u, conn->get_last_insert_id());
+
+  vector<DB::Row> rows(2500);
+  for(auto i=0u; i<rows.size(); i++)
+    rows[i].add("name", "row" + to_string(i));
+  vector<uint64_t> ids;
+  ASSERT_TRUE(conn->insert_many("obtools_serial", rows, ids));
+  ASSERT_EQ(rows.size(), ids.size());
+  for(auto i=0u; i<ids.size(); i+=99)
+    EXPECT_EQ("row" + to_string(i),
+              conn->query_string("select name from obtools_serial where id = "
+                                 + to_string(ids[i])));
+}
+
+//--------------------------------------------------------------------------
+// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
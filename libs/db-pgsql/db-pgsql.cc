@@ -9,9 +9,514 @@
 
 #include "ot-db-pgsql.h"
 #include "ot-log.h"
+#include "ot-text.h"
+#include <cmath>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include <sstream>
+#include <poll.h>
 
 namespace ObTools { namespace DB { namespace PG {
 
+namespace
+{
+  // Type OIDs from pg_type, for the types we send and receive in binary
+  const Oid bool_oid = 16;
+  const Oid char_oid = 18;
+  const Oid name_oid = 19;
+  const Oid int8_oid = 20;
+  const Oid int2_oid = 21;
+  const Oid int4_oid = 23;
+  const Oid text_oid = 25;
+  const Oid oid_oid = 26;
+  const Oid float4_oid = 700;
+  const Oid float8_oid = 701;
+  const Oid bpchar_oid = 1042;
+  const Oid varchar_oid = 1043;
+
+  bool is_integer_type(Oid type)
+  {
+    return type == int2_oid || type == int4_oid || type == int8_oid
+      || type == oid_oid;
+  }
+
+  bool is_float_type(Oid type)
+  {
+    return type == float4_oid || type == float8_oid;
+  }
+
+  // Types whose binary form is the same as their text
+  bool is_text_type(Oid type)
+  {
+    return type == text_oid || type == varchar_oid || type == bpchar_oid
+      || type == name_oid || type == char_oid;
+  }
+
+#if defined(LIBPQ_HAS_CHUNK_MODE)
+  // Rows per result when streaming
+  const int stream_chunk_rows = 256;
+#endif
+
+  // Whether a result is part of a stream of rows
+  bool is_rows_result(const PGresult *res)
+  {
+    const auto status = PQresultStatus(res);
+#if defined(LIBPQ_HAS_CHUNK_MODE)
+    if (status == PGRES_TUPLES_CHUNK) return true;
+#endif
+    return status == PGRES_SINGLE_TUPLE;
+  }
+
+  bool is_binary_readable(Oid type)
+  {
+    return type == bool_oid || is_integer_type(type) || is_float_type(type)
+      || is_text_type(type);
+  }
+
+  // Big-endian integer of the given size
+  string encode_int(uint64_t value, int bytes)
+  {
+    string s(bytes, 0);
+    for(auto i=bytes-1; i>=0; i--, value >>= 8)
+      s[i] = static_cast<char>(value & 0xff);
+    return s;
+  }
+
+  // Sign-extended from the given size
+  int64_t decode_int(const char *p, int bytes)
+  {
+    uint64_t value = 0;
+    for(auto i=0; i<bytes; i++)
+      value = value << 8 | static_cast<unsigned char>(p[i]);
+    if (bytes && bytes < 8 && (p[0] & 0x80)) value |= ~0ULL << (8*bytes);
+    return static_cast<int64_t>(value);
+  }
+
+  string encode_real(double value, Oid type)
+  {
+    if (type == float4_oid)
+    {
+      const auto f = static_cast<float>(value);
+      uint32_t bits;
+      memcpy(&bits, &f, sizeof(bits));
+      return encode_int(bits, 4);
+    }
+
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return encode_int(bits, 8);
+  }
+
+  double decode_real(const char *p, int bytes)
+  {
+    if (bytes == 4)
+    {
+      const auto bits = static_cast<uint32_t>(decode_int(p, 4));
+      float f;
+      memcpy(&f, &bits, sizeof(f));
+      return f;
+    }
+
+    const auto bits = static_cast<uint64_t>(decode_int(p, 8));
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+  }
+
+  // Shortest text which reads back the same, as Postgres prints it
+  string format_real(double value, Oid type)
+  {
+    if (std::isnan(value)) return "NaN";
+    if (std::isinf(value)) return value < 0 ? "-Infinity" : "Infinity";
+
+    char buf[32];
+    if (type == float4_oid)
+    {
+      const auto f = static_cast<float>(value);
+      for(auto digits = 6; digits <= 9; digits++)
+      {
+        snprintf(buf, sizeof(buf), "%.*g", digits, f);
+        if (strtof(buf, nullptr) == f) break;
+      }
+    }
+    else
+    {
+      for(auto digits = 15; digits <= 17; digits++)
+      {
+        snprintf(buf, sizeof(buf), "%.*g", digits, value);
+        if (strtod(buf, nullptr) == value) break;
+      }
+    }
+    return buf;
+  }
+
+  // Bytes of COPY data to send at once
+  const size_t copy_chunk_size = 65536;
+
+  // Rows in each multi-row INSERT ... RETURNING
+  const size_t returning_chunk_rows = 1000;
+
+  // Append a value to a line of COPY text, escaped
+  void append_copy_value(string& data, const FieldValue& value)
+  {
+    switch (value.get_type())
+    {
+      case NULLTYPE:
+        data += "\\N";
+        return;
+
+      case REAL:
+        data += format_real(value.as_real(), float8_oid);
+        return;
+
+      default:
+        break;
+    }
+
+    for(auto c: value.as_string())
+    {
+      switch (c)
+      {
+        case '\\': data += "\\\\"; break;
+        case '\t': data += "\\t"; break;
+        case '\n': data += "\\n"; break;
+        case '\r': data += "\\r"; break;
+        default: data += c;
+      }
+    }
+  }
+}
+
+//==========================================================================
+// Postgres prepared statement
+
+//--------------------------------------------------------------------------
+// Constructor
+PreparedStatement::PreparedStatement(PGconn *_conn, const string& _name,
+                                     PGresult *desc):
+  conn{_conn}, name{_name}
+{
+  if (!desc)
+  {
+    name.clear();
+    return;
+  }
+
+  const auto np = PQnparams(desc);
+  for(auto i=0; i<np; i++)
+    param_types.push_back(PQparamtype(desc, i));
+  param_values.resize(np);
+  param_formats.resize(np);
+  param_nulls.resize(np, true);
+
+  // Binary results only if we can read every column
+  const auto nf = PQnfields(desc);
+  result_format = nf ? 1 : 0;
+  for(auto i=0; i<nf; i++)
+  {
+    column_types.push_back(PQftype(desc, i));
+    field_names.push_back(PQfname(desc, i));
+    if (!is_binary_readable(column_types.back())) result_format = 0;
+  }
+
+  PQclear(desc);
+}
+
+//--------------------------------------------------------------------------
+// Get the type of a parameter, or 0 if out of range
+Oid PreparedStatement::get_param_type(int index) const
+{
+  if (index < 1 || index > static_cast<int>(param_types.size())) return 0;
+  return param_types[index-1];
+}
+
+//--------------------------------------------------------------------------
+// Set a parameter value
+bool PreparedStatement::set_param(int index, string&& value, int format)
+{
+  if (index < 1 || index > static_cast<int>(param_values.size()))
+    return false;
+  param_values[index-1] = move(value);
+  param_formats[index-1] = format;
+  param_nulls[index-1] = false;
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Bind a parameter (bool)
+bool PreparedStatement::bind(int index, bool value)
+{
+  if (get_param_type(index) == bool_oid)
+    return set_param(index, string(1, value ? 1 : 0), 1);
+  return bind(index, static_cast<int64_t>(value));
+}
+
+//--------------------------------------------------------------------------
+// Bind a parameter (integer)
+// Binary if the parameter is numeric and the value fits, otherwise text
+// for the server to convert
+bool PreparedStatement::bind(int index, int64_t value)
+{
+  switch (get_param_type(index))
+  {
+    case int8_oid:
+      return set_param(index, encode_int(value, 8), 1);
+
+    case int4_oid:
+      if (value >= INT_MIN && value <= INT_MAX)
+        return set_param(index, encode_int(value, 4), 1);
+      break;
+
+    case int2_oid:
+      if (value >= SHRT_MIN && value <= SHRT_MAX)
+        return set_param(index, encode_int(value, 2), 1);
+      break;
+
+    case oid_oid:
+      if (value >= 0 && value <= UINT_MAX)
+        return set_param(index, encode_int(value, 4), 1);
+      break;
+
+    case bool_oid:
+      return set_param(index, string(1, value ? 1 : 0), 1);
+
+    case float4_oid:
+    case float8_oid:
+      return set_param(index, encode_real(value, get_param_type(index)), 1);
+  }
+
+  return set_param(index, to_string(value), 0);
+}
+
+//--------------------------------------------------------------------------
+// Bind a parameter (unsigned integer)
+bool PreparedStatement::bind(int index, uint64_t value)
+{
+  if (value <= static_cast<uint64_t>(INT64_MAX))
+    return bind(index, static_cast<int64_t>(value));
+  return set_param(index, to_string(value), 0);
+}
+
+//--------------------------------------------------------------------------
+// Bind a parameter (real)
+bool PreparedStatement::bind(int index, double value)
+{
+  const auto type = get_param_type(index);
+  if (is_float_type(type))
+    return set_param(index, encode_real(value, type), 1);
+  return set_param(index, format_real(value, float8_oid), 0);
+}
+
+//--------------------------------------------------------------------------
+// Bind a parameter (text)
+bool PreparedStatement::bind(int index, const string& value)
+{
+  return set_param(index, string(value),
+                   is_text_type(get_param_type(index)) ? 1 : 0);
+}
+
+//--------------------------------------------------------------------------
+// Bind a parameter (null)
+bool PreparedStatement::bind(int index)
+{
+  if (index < 1 || index > static_cast<int>(param_nulls.size()))
+    return false;
+  param_nulls[index-1] = true;
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Reset statement
+void PreparedStatement::reset()
+{
+  res.reset();
+  row_cursor = -1;
+}
+
+//--------------------------------------------------------------------------
+// Run the statement with the current parameters
+// Keeps the result even on failure, so it isn't rerun by next()
+bool PreparedStatement::run()
+{
+  if (name.empty()) return false;
+
+  OBTOOLS_LOG_IF_DEBUG(Log::Debug dlog;
+                       dlog << "DBexecPrepared: " << name << endl;)
+  const auto n = param_values.size();
+  vector<const char *> values(n);
+  vector<int> lengths(n);
+  for(auto i=0u; i<n; i++)
+  {
+    values[i] = param_nulls[i] ? nullptr : param_values[i].c_str();
+    lengths[i] = param_values[i].size();
+  }
+
+  row_cursor = -1;
+  res.reset(PQexecPrepared(conn, name.c_str(), n, values.data(),
+                           lengths.data(), param_formats.data(),
+                           result_format));
+  if (!res)
+  {
+    Log::Error log;
+    log << "Postgres prepared statement failed - NULL result\n";
+    return false;
+  }
+
+  const auto status = PQresultStatus(res.get());
+  if (status != PGRES_COMMAND_OK && status != PGRES_TUPLES_OK)
+  {
+    Log::Error log;
+    log << "Postgres prepared statement failed (" << PQresStatus(status)
+        << "): " << PQresultErrorMessage(res.get());
+    return false;
+  }
+
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Execute statement
+bool PreparedStatement::execute()
+{
+  return run();
+}
+
+//--------------------------------------------------------------------------
+// Get number of rows in result set
+int PreparedStatement::count()
+{
+  if (!res && !run()) return 0;
+  return PQntuples(res.get());
+}
+
+//--------------------------------------------------------------------------
+// Move to next row
+bool PreparedStatement::next()
+{
+  if (!res && !run()) return false;
+  if (row_cursor >= PQntuples(res.get())) return false;
+  return ++row_cursor < PQntuples(res.get());
+}
+
+//--------------------------------------------------------------------------
+// Get next row from result set
+// Whether another was found - if so, clears and writes into row
+bool PreparedStatement::fetch(Row& row)
+{
+  if (!next()) return false;
+
+  row.clear();
+  for(auto i=0u; i<field_names.size(); i++)
+    row.add(field_names[i], get_string(i));
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Get first value of next row from result set
+// Whether another was found - if so, writes into value
+bool PreparedStatement::fetch(string& value)
+{
+  if (field_names.empty() || !next()) return false;
+  value = get_string(0);
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Get the raw value of a column in the current row, and its length
+// Returns nullptr if no row, no such column, or the value is null
+const char *PreparedStatement::get_value(int col, int& length)
+{
+  if (!res || row_cursor < 0 || row_cursor >= PQntuples(res.get())
+      || col < 0 || col >= PQnfields(res.get())
+      || PQgetisnull(res.get(), row_cursor, col))
+    return nullptr;
+
+  length = PQgetlength(res.get(), row_cursor, col);
+  return PQgetvalue(res.get(), row_cursor, col);
+}
+
+//--------------------------------------------------------------------------
+// Fetch field as string - in the same form as a text result
+string PreparedStatement::get_string(int col)
+{
+  auto length = 0;
+  const auto v = get_value(col, length);
+  if (!v) return {};
+  if (!result_format) return string(v, length);
+
+  const auto type = column_types[col];
+  if (type == bool_oid) return *v ? "t" : "f";
+  if (type == oid_oid)
+    return to_string(static_cast<uint32_t>(decode_int(v, length)));
+  if (is_integer_type(type)) return to_string(decode_int(v, length));
+  if (is_float_type(type)) return format_real(decode_real(v, length), type);
+  return string(v, length);
+}
+
+//--------------------------------------------------------------------------
+// Fetch field as int
+uint64_t PreparedStatement::get_int(int col)
+{
+  auto length = 0;
+  const auto v = get_value(col, length);
+  if (!v) return 0;
+
+  const auto type = column_types[col];
+  if (result_format)
+  {
+    if (type == bool_oid) return *v ? 1 : 0;
+    if (type == oid_oid) return static_cast<uint32_t>(decode_int(v, length));
+    if (is_integer_type(type)) return decode_int(v, length);
+    if (is_float_type(type))
+      return static_cast<int64_t>(decode_real(v, length));
+  }
+  else if (type == bool_oid) return *v == 't' ? 1 : 0;
+
+  // Text - always null terminated
+  if (*v == '-') return strtoll(v, nullptr, 10);
+  return strtoull(v, nullptr, 10);
+}
+
+//--------------------------------------------------------------------------
+// Fetch field as double
+double PreparedStatement::get_real(int col)
+{
+  auto length = 0;
+  const auto v = get_value(col, length);
+  if (!v) return 0;
+
+  if (result_format)
+  {
+    const auto type = column_types[col];
+    if (type == bool_oid) return *v ? 1 : 0;
+    if (type == oid_oid) return static_cast<uint32_t>(decode_int(v, length));
+    if (is_integer_type(type)) return decode_int(v, length);
+    if (is_float_type(type)) return decode_real(v, length);
+  }
+
+  return strtod(v, nullptr);
+}
+
+//--------------------------------------------------------------------------
+// Fetch field as Time::Stamp
+Time::Stamp PreparedStatement::get_time(int col)
+{
+  const auto s = get_string(col);
+  if (s.empty()) return {};
+  return Time::Stamp{s};
+}
+
+//--------------------------------------------------------------------------
+// Destructor
+PreparedStatement::~PreparedStatement()
+{
+  if (name.empty() || PQstatus(conn) != CONNECTION_OK) return;
+  res.reset();
+  auto r = PQexec(conn, ("DEALLOCATE " + name).c_str());
+  if (r) PQclear(r);
+}
+
 //==========================================================================
 // Postgres result class
 
@@ -62,6 +567,82 @@ ResultSet::~ResultSet()
   PQclear(res);
 }
 
+//==========================================================================
+// Postgres streaming result
+
+//--------------------------------------------------------------------------
+// Constructor
+Stream::Stream(PGconn *_conn, PGresult *first):
+  conn{_conn}, res{first, PQclear}
+{
+  const auto n = PQnfields(first);
+  for(auto i=0; i<n; i++)
+    column_names.push_back(PQfname(first, i));
+
+  // Final (empty) result comes after any rows
+  if (!is_rows_result(first)) finish(res.release());
+}
+
+//--------------------------------------------------------------------------
+// Read any remaining results from r on, to leave the connection usable
+void Stream::finish(PGresult *r)
+{
+  for(; r; r = PQgetResult(conn))
+  {
+    const auto status = PQresultStatus(r);
+    if (status != PGRES_TUPLES_OK && !is_rows_result(r))
+    {
+      failed = true;
+      Log::Error log;
+      log << "Postgres stream failed (" << PQresStatus(status) << "): "
+          << PQresultErrorMessage(r);
+    }
+    PQclear(r);
+  }
+  finished = true;
+}
+
+//--------------------------------------------------------------------------
+// Move to next row
+bool Stream::next()
+{
+  if (res && ++row < PQntuples(res.get())) return true;
+
+  res.reset();
+  row = 0;
+  if (finished) return false;
+
+  auto r = PQgetResult(conn);
+  if (r && is_rows_result(r) && PQntuples(r))
+  {
+    res.reset(r);
+    return true;
+  }
+
+  // Anything else is the end, or an error
+  finish(r);
+  return false;
+}
+
+//--------------------------------------------------------------------------
+// Destructor
+Stream::~Stream()
+{
+  if (finished) return;
+
+  // Don't wait for the rest to come in
+  auto cancel = PQgetCancel(conn);
+  if (cancel)
+  {
+    char err[256];
+    PQcancel(cancel, err, sizeof(err));
+    PQfreeCancel(cancel);
+  }
+
+  // Expected to end with a cancellation error, which isn't worth logging
+  while (auto r = PQgetResult(conn)) PQclear(r);
+}
+
 //==========================================================================
 // Postgres connection class
 
@@ -79,6 +660,7 @@ Connection::Connection(const string& conninfo)
     {
       log.error << PQerrorMessage(conn) << endl;
       PQfinish(conn);
+      conn = nullptr;
     }
     else log.error << "Can't allocate connection\n";
     return;
@@ -132,6 +714,261 @@ bool Connection::exec(const string& sql)
   }
 }
 
+//--------------------------------------------------------------------------
+// Wait for the connection's socket to be readable, or also writable if
+// 'write' is set
+// Returns whether successful - reads any input which has arrived
+bool Connection::wait_socket(bool write)
+{
+  struct pollfd pfd;
+  pfd.fd = PQsocket(conn);
+  pfd.events = POLLIN | (write ? POLLOUT : 0);
+  pfd.revents = 0;
+  if (pfd.fd < 0) return false;
+
+  while (poll(&pfd, 1, -1) < 0)
+    if (errno != EINTR) return false;
+
+  return !(pfd.revents & POLLIN) || PQconsumeInput(conn);
+}
+
+//--------------------------------------------------------------------------
+// Run a number of queries - results from PQexec() are already in memory,
+// so this only has to pipeline them
+// Each query is followed by its own sync, so it is its own implicit
+// transaction, and a failure in one doesn't affect the others
+void Connection::query_batch(const vector<string>& sqls,
+                             vector<Result>& results)
+{
+  results.clear();
+#if defined(LIBPQ_HAS_PIPELINING)
+  // Non-blocking, so we can read results while a long pipeline is still
+  // being sent and neither side blocks on a full buffer
+  if (sqls.size() > 1 && !PQsetnonblocking(conn, 1))
+  {
+    if (!PQenterPipelineMode(conn))
+    {
+      PQsetnonblocking(conn, 0);
+      for(const auto& sql: sqls)
+        results.push_back(query(sql));
+      return;
+    }
+
+    OBTOOLS_LOG_IF_DEBUG(log.debug << "DBpipeline: " << sqls.size()
+                         << " queries\n";)
+
+    // Queue them all - pipelines need the extended query protocol
+    auto sent = 0u;
+    for(; sent < sqls.size(); sent++)
+    {
+      if (!PQsendQueryParams(conn, sqls[sent].c_str(), 0, nullptr, nullptr,
+                             nullptr, nullptr, 0)
+          || !PQpipelineSync(conn))
+      {
+        log.error << "Postgres pipeline send failed: "
+                  << PQerrorMessage(conn);
+        break;
+      }
+    }
+
+    // Flush, reading anything which comes back meanwhile
+    auto ok = true;
+    for(;;)
+    {
+      const auto flushed = PQflush(conn);
+      if (!flushed) break;
+      if (flushed < 0 || !wait_socket(true))
+      {
+        log.error << "Postgres pipeline flush failed: "
+                  << PQerrorMessage(conn);
+        ok = false;
+        break;
+      }
+    }
+
+    // Each query's results end with a null, then its sync
+    for(auto i=0u; ok && i<sent; i++)
+    {
+      Result result;
+      for(;;)
+      {
+        while (PQisBusy(conn))
+          if (!wait_socket(false)) { ok = false; break; }
+        if (!ok) break;
+
+        auto res = PQgetResult(conn);
+        if (!res) break;
+
+        const auto status = PQresultStatus(res);
+        if (status == PGRES_TUPLES_OK && !result)
+        {
+          result = Result(new ResultSet(res));
+          continue;
+        }
+
+        if (status != PGRES_TUPLES_OK)
+        {
+          log.error << "Postgres pipelined query failed ("
+                    << PQresStatus(status) << "):\n";
+          log.error << "  " << sqls[i] << endl;
+          log.error << "  " << PQresultErrorMessage(res);
+        }
+        PQclear(res);
+      }
+
+      while (ok)
+      {
+        while (PQisBusy(conn))
+          if (!wait_socket(false)) { ok = false; break; }
+        if (!ok) break;
+
+        auto res = PQgetResult(conn);
+        if (!res) { ok = false; break; }  // Sync missing
+        const auto status = PQresultStatus(res);
+        PQclear(res);
+        if (status == PGRES_PIPELINE_SYNC) break;
+      }
+
+      if (ok)
+        results.push_back(move(result));
+      else
+        log.error << "Postgres pipeline read failed: "
+                  << PQerrorMessage(conn);
+    }
+
+    PQexitPipelineMode(conn);
+    PQsetnonblocking(conn, 0);
+    results.resize(sqls.size());
+    return;
+  }
+#endif
+
+  for(const auto& sql: sqls)
+    results.push_back(query(sql));
+}
+
+//--------------------------------------------------------------------------
+// INSERT a batch of rows with COPY
+bool Connection::insert_batch(const string& table, const vector<Row>& rows)
+{
+  if (rows.empty()) return true;
+
+  const auto& first = rows.front();
+  for(const auto& row: rows)
+  {
+    if (!row.has_same_fields(first))
+    {
+      log.error << "Postgres COPY into " << table
+                << " failed: rows have different fields\n";
+      return false;
+    }
+  }
+
+  const auto sql = "COPY " + table + " (" + first.get_fields()
+    + ") FROM STDIN";
+  OBTOOLS_LOG_IF_DEBUG(log.debug << "DBcopy: " << sql << endl;)
+
+  PGresult *res = PQexec(conn, sql.c_str());
+  const auto status = res ? PQresultStatus(res) : PGRES_FATAL_ERROR;
+  if (res) PQclear(res);
+  if (status != PGRES_COPY_IN)
+  {
+    log.error << "Postgres COPY failed (" << PQresStatus(status) << "):\n";
+    log.error << "  " << sql << endl;
+    log.error << "  " << PQerrorMessage(conn);
+    return false;
+  }
+
+  // Send as text lines, a chunk at a time
+  string data;
+  data.reserve(copy_chunk_size + 1024);
+  const char *error = nullptr;
+  for(const auto& row: rows)
+  {
+    auto tab = false;
+    for(const auto& p: row)
+    {
+      if (tab) data += '\t';
+      tab = true;
+      append_copy_value(data, p.second);
+    }
+    data += '\n';
+
+    if (data.size() >= copy_chunk_size)
+    {
+      if (PQputCopyData(conn, data.data(), data.size()) != 1)
+      {
+        error = "Can't send data";
+        break;
+      }
+      data.clear();
+    }
+  }
+
+  if (!error && !data.empty()
+      && PQputCopyData(conn, data.data(), data.size()) != 1)
+    error = "Can't send data";
+  PQputCopyEnd(conn, error);
+
+  // Result of the COPY, and make sure there's nothing left
+  auto ok = true;
+  while ((res = PQgetResult(conn)))
+  {
+    if (PQresultStatus(res) != PGRES_COMMAND_OK)
+    {
+      log.error << "Postgres COPY failed: " << PQresultErrorMessage(res);
+      ok = false;
+    }
+    PQclear(res);
+  }
+
+  OBTOOLS_LOG_IF_DEBUG(if (ok) log.debug << "DBcopy OK: " << rows.size()
+                       << " rows\n";)
+  return ok && !error;
+}
+
+//--------------------------------------------------------------------------
+// INSERT a batch of rows getting IDs, with multi-row INSERT ... RETURNING
+// The rows of a VALUES list are inserted in order, so IDs from a sequence
+// rise with row order - RETURNING doesn't promise any order, so they are
+// sorted
+bool Connection::insert_batch_returning(const string& table,
+                                        const vector<Row>& rows,
+                                        const string& id_field,
+                                        vector<uint64_t>& ids)
+{
+  for(auto start = 0ul; start < rows.size(); start += returning_chunk_rows)
+  {
+    const auto end = min(rows.size(), start + returning_chunk_rows);
+    ostringstream oss;
+    oss << "INSERT INTO " << table;
+    oss << " (" << rows[start].get_fields() << ") VALUES ";
+    for(auto i=start; i<end; i++)
+    {
+      if (i != start) oss << ", ";
+      oss << "(" << rows[i].get_escaped_values() << ")";
+    }
+    oss << " RETURNING " << id_field;
+
+    auto result = query(oss.str());
+    if (!result) return false;
+
+    const auto first = ids.size();
+    string value;
+    while (result.fetch(value)) ids.push_back(Text::stoi64(value));
+    if (ids.size() - first != end - start)
+    {
+      log.error << "Postgres INSERT into " << table << " returned "
+                << ids.size() - first << " IDs for " << end - start
+                << " rows\n";
+      return false;
+    }
+    sort(ids.begin() + first, ids.end());
+  }
+
+  return true;
+}
+
 //--------------------------------------------------------------------------
 // Execute a query and get result (e.g. SELECT)
 // Returns result - check this for validity
@@ -164,10 +1001,90 @@ Result Connection::query(const string& sql)
   }
 }
 
+//--------------------------------------------------------------------------
+// Execute a query and stream the result
+// Returns cursor - check this for validity
+Cursor Connection::stream(const string& sql)
+{
+  OBTOOLS_LOG_IF_DEBUG(log.debug << "DBstream: " << sql << endl;)
+
+  if (!PQsendQuery(conn, sql.c_str()))
+  {
+    log.error << "Postgres stream failed: " << PQerrorMessage(conn);
+    return Cursor();
+  }
+
+#if defined(LIBPQ_HAS_CHUNK_MODE)
+  auto moded = PQsetChunkedRowsMode(conn, stream_chunk_rows);
+#else
+  auto moded = PQsetSingleRowMode(conn);
+#endif
+  if (!moded) log.error << "Postgres can't set row mode for stream\n";
+
+  // First result says whether it worked, and gives the columns
+  auto r = PQgetResult(conn);
+  const auto status = r ? PQresultStatus(r) : PGRES_FATAL_ERROR;
+  if (!moded || (status != PGRES_TUPLES_OK && !is_rows_result(r)))
+  {
+    log.error << "Postgres stream failed (" << PQresStatus(status) << "):\n";
+    log.error << "  " << sql << endl;
+    log.error << "  " << PQerrorMessage(conn);
+    if (r) PQclear(r);
+    while ((r = PQgetResult(conn))) PQclear(r);
+    return Cursor();
+  }
+
+  OBTOOLS_LOG_IF_DEBUG(log.debug << "DBstream OK\n";)
+  return Cursor(new Stream(conn, r));
+}
+
+//--------------------------------------------------------------------------
+// Prepare a statement
+// Returns result - check this for validity
+Statement Connection::prepare(const string& sql)
+{
+  OBTOOLS_LOG_IF_DEBUG(log.debug << "DBprepare: " << sql << endl;)
+
+  const auto name = "obtools_" + to_string(++statements_prepared);
+  PGresult *res = PQprepare(conn, name.c_str(), sql.c_str(), 0, nullptr);
+  auto status = res ? PQresultStatus(res) : PGRES_FATAL_ERROR;
+  if (res) PQclear(res);
+
+  // Find the parameter and column types
+  PGresult *desc = nullptr;
+  if (status == PGRES_COMMAND_OK)
+  {
+    desc = PQdescribePrepared(conn, name.c_str());
+    status = desc ? PQresultStatus(desc) : PGRES_FATAL_ERROR;
+    if (status != PGRES_COMMAND_OK)
+    {
+      if (desc) PQclear(desc);
+      desc = nullptr;
+      res = PQexec(conn, ("DEALLOCATE " + name).c_str());
+      if (res) PQclear(res);
+    }
+  }
+
+  if (!desc)
+  {
+    log.error << "Postgres prepare failed (" << PQresStatus(status) << "):\n";
+    log.error << "  " << sql << endl;
+    log.error << "  " << PQerrorMessage(conn);
+  }
+  else
+  {
+    OBTOOLS_LOG_IF_DEBUG(log.debug << "DBprepare OK: " << name << endl;)
+  }
+
+  return Statement(new PreparedStatement(conn, name, desc));
+}
+
 //--------------------------------------------------------------------------
 // Destructor
 Connection::~Connection()
 {
+  // Statements deallocate themselves, so must go before the connection
+  prepared_statements.clear();
   if (conn) PQfinish(conn);
 }
 
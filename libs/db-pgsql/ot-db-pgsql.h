@@ -52,15 +52,175 @@ public:
   ~ResultSet();
 };
 
+//==========================================================================
+// Postgres prepared statement
+// Prepared on the server with PQprepare() and run with PQexecPrepared().
+// Parameters of known numeric and text types are sent in binary, and
+// results are received in binary if every column has a type we can decode,
+// to avoid formatting and parsing text at both ends.  Parameters are
+// numbered from 1 ($1), columns from 0
+class PreparedStatement: public DB::PreparedStatement
+{
+private:
+  PGconn *conn;
+  string name;                // Empty if preparation failed
+  vector<Oid> param_types;
+  vector<string> param_values;
+  vector<int> param_formats;  // 0 = text, 1 = binary
+  vector<bool> param_nulls;
+  vector<Oid> column_types;
+  vector<string> field_names;
+  int result_format = 0;
+  unique_ptr<PGresult, decltype(&PQclear)> res{nullptr, PQclear};
+  int row_cursor = -1;
+
+  Oid get_param_type(int index) const;
+  bool set_param(int index, string&& value, int format);
+  bool run();
+  const char *get_value(int col, int& length);
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor - takes ownership of the result of PQdescribePrepared(),
+  // which is null if preparation failed
+  PreparedStatement(PGconn *_conn, const string& _name, PGresult *desc);
+
+  //------------------------------------------------------------------------
+  // Bind a parameter (bool)
+  bool bind(int index, bool value) override;
+
+  //------------------------------------------------------------------------
+  // Bind a parameter (integer)
+  bool bind(int index, int64_t value) override;
+
+  //------------------------------------------------------------------------
+  // Bind a parameter (unsigned integer)
+  bool bind(int index, uint64_t value) override;
+
+  //------------------------------------------------------------------------
+  // Bind a parameter (unsigned integer)
+  bool bind(int index, unsigned value) override
+  {
+    return bind(index, static_cast<int64_t>(value));
+  }
+
+  //------------------------------------------------------------------------
+  // Bind a parameter (real)
+  bool bind(int index, double value) override;
+
+  //------------------------------------------------------------------------
+  // Bind a parameter (text)
+  bool bind(int index, const string& value) override;
+
+  //------------------------------------------------------------------------
+  // Bind a parameter (null)
+  bool bind(int index) override;
+
+  //------------------------------------------------------------------------
+  // Reset statement - drops any result, keeps the parameters
+  void reset() override;
+
+  //------------------------------------------------------------------------
+  // Execute statement
+  bool execute() override;
+
+  //------------------------------------------------------------------------
+  // Get row count - executes if not already done
+  int count() override;
+
+  //------------------------------------------------------------------------
+  // Get next row from result set - executes if not already done
+  bool fetch(Row& row) override;
+
+  //------------------------------------------------------------------------
+  // Get first value of next row from result set
+  bool fetch(string& value) override;
+
+  //------------------------------------------------------------------------
+  // Move to next row - executes if not already done
+  bool next() override;
+
+  //------------------------------------------------------------------------
+  // Fetch field as string
+  string get_string(int col) override;
+
+  //------------------------------------------------------------------------
+  // Fetch field as int
+  uint64_t get_int(int col) override;
+
+  //------------------------------------------------------------------------
+  // Fetch field as double
+  double get_real(int col) override;
+
+  //------------------------------------------------------------------------
+  // Fetch field as Time::Stamp
+  Time::Stamp get_time(int col) override;
+
+  //------------------------------------------------------------------------
+  // Is valid?
+  explicit operator bool() const override { return !name.empty(); }
+
+  //------------------------------------------------------------------------
+  // Destructor - deallocates on the server
+  ~PreparedStatement();
+};
+
+//==========================================================================
+// Postgres streaming result
+// Sent with PQsendQuery() and read in chunked rows mode where libpq has it
+// (17+), otherwise single row mode, so only one chunk or row is held at a
+// time.  Abandoning it early cancels the query
+class Stream: public DB::ResultStream
+{
+private:
+  PGconn *conn;
+  unique_ptr<PGresult, decltype(&PQclear)> res;  // Current row(s)
+  int row = -1;             // Index of current row in res
+  bool finished = false;    // All results read
+
+  void finish(PGresult *r);
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor - takes the first result, which may have no rows
+  Stream(PGconn *_conn, PGresult *first);
+
+  //------------------------------------------------------------------------
+  // Move to next row
+  bool next() override;
+
+  //------------------------------------------------------------------------
+  // Check whether a field is null
+  bool is_null(int col) override
+  {
+    return PQgetisnull(res.get(), row, col);
+  }
+
+  //------------------------------------------------------------------------
+  // Get a field as a string view
+  string_view get_string_view(int col) override
+  {
+    return string_view(PQgetvalue(res.get(), row, col),
+                       PQgetlength(res.get(), row, col));
+  }
+
+  //------------------------------------------------------------------------
+  // Destructor - cancels the query if not finished
+  ~Stream();
+};
+
 //==========================================================================
 // Postgres connection class
 class Connection: public DB::Connection
 {
 private:
   PGconn *conn = nullptr; // PGconn structure
+  uint64_t statements_prepared = 0;  // For unique names
   Log::Streams log; // Private (therefore per-thread, assuming connections
                     // are not shared) log streams
 
+  bool wait_socket(bool write);
+
 public:
   //------------------------------------------------------------------------
   // Constructor - takes Postgres connection string
@@ -84,18 +244,47 @@ public:
   //------------------------------------------------------------------------
   // Prepare a statement
   // Returns result - check this for validity
-  Statement prepare(const string& /* sql */) override
+  Statement prepare(const string& sql) override;
+
+  //------------------------------------------------------------------------
+  // Execute a query and stream the result
+  // Returns cursor - check this for validity
+  Cursor stream(const string& sql) override;
+
+  //------------------------------------------------------------------------
+  // Gets the last value generated by a sequence in this session
+  uint64_t get_last_insert_id() override
   {
-    throw runtime_error("Prepare not implemented for PGSQL");
+    return query_int64("SELECT lastval()");
   }
 
   //------------------------------------------------------------------------
-  // Gets the last insert id
-  uint64_t get_last_insert_id() override
+  // Execute an INSERT and get the generated ID, with RETURNING
+  bool insert_returning(const string& sql, const string&,
+                        const string& id_field, uint64_t& id, bool) override
   {
-    throw runtime_error("Last insert id not implemented for PGSQL");
+    return insert_with_returning_clause(sql, id_field, id);
   }
 
+  //------------------------------------------------------------------------
+  // Run a number of queries, in pipeline mode if libpq has it (14+), so
+  // they are all sent before waiting for the results.  Each query is
+  // synced separately, so it is its own implicit transaction
+  void query_batch(const vector<string>& sqls,
+                   vector<Result>& results) override;
+
+  //------------------------------------------------------------------------
+  // INSERT a batch of rows with COPY FROM STDIN
+  bool insert_batch(const string& table, const vector<Row>& rows) override;
+
+  //------------------------------------------------------------------------
+  // INSERT a batch of rows getting IDs, with multi-row INSERT ... RETURNING
+  // IDs must come from a sequence (SERIAL or IDENTITY), so they rise with
+  // row order
+  bool insert_batch_returning(const string& table, const vector<Row>& rows,
+                              const string& id_field,
+                              vector<uint64_t>& ids) override;
+
   //------------------------------------------------------------------------
   // Expression to get current datetime in UTC
   string utc_timestamp() override
@@ -0,0 +1,334 @@
+//==========================================================================
+// ObTools::DB: test-db-pgsql.cc
+//
+// Test harness for Postgres database driver, including a benchmark of
+// prepared statements against text SQL
+//
+// Needs a server: set OBTOOLS_TEST_PGSQL to a connection string, e.g.
+//   OBTOOLS_TEST_PGSQL="host=localhost dbname=test user=postgres"
+// Tests are skipped if it is not set
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include <gtest/gtest.h>
+#include "ot-db-pgsql.h"
+#include <cstdlib>
+
+using namespace std;
+using namespace ObTools;
+
+namespace {
+class DBPgSQLTest: public ::testing::Test
+{
+protected:
+  string conninfo;
+  unique_ptr<DB::Connection> conn;
+
+  void SetUp() override
+  {
+    const auto env = getenv("OBTOOLS_TEST_PGSQL");
+    if (!env) GTEST_SKIP() << "OBTOOLS_TEST_PGSQL not set";
+    conninfo = env;
+    conn.reset(new DB::PG::Connection(conninfo));
+    ASSERT_TRUE(!!*conn);
+    conn->exec("drop table if exists obtools_test");
+    ASSERT_TRUE(conn->exec("create table obtools_test (id int8 primary key, "
+                           "small int2, name varchar(256), score float8, "
+                           "ratio float4, flag bool, price numeric(10,2))"));
+  }
+
+  void TearDown() override
+  {
+    if (conn) conn->exec("drop table if exists obtools_test");
+  }
+};
+}
+
+//--------------------------------------------------------------------------
+// Tests
+TEST_F(DBPgSQLTest, TestPreparedInsertAndSelect)
+{
+  auto insert = conn->prepare("insert into obtools_test "
+                              "(id, small, name, score, ratio, flag, price) "
+                              "values ($1, $2, $3, $4, $5, $6, $7)");
+  ASSERT_TRUE(!!insert);
+  ASSERT_TRUE(insert.bind(1, int64_t{-1234567890123}));
+  ASSERT_TRUE(insert.bind(2, int64_t{-5}));
+  ASSERT_TRUE(insert.bind(3, string{"O'Brien \\ \"quoted\""}));
+  ASSERT_TRUE(insert.bind(4, 0.1));
+  ASSERT_TRUE(insert.bind(5, 1.0/3));
+  ASSERT_TRUE(insert.bind(6, true));
+  ASSERT_TRUE(insert.bind(7, 12.5));
+  ASSERT_TRUE(insert.execute());
+  EXPECT_FALSE(insert.bind(8, int64_t{1}));
+
+  // Null
+  insert.reset();
+  ASSERT_TRUE(insert.bind(1, uint64_t{2}));
+  ASSERT_TRUE(insert.bind(3));
+  ASSERT_TRUE(insert.execute());
+
+  // Binary result (all types readable)
+  auto select = conn->prepare("select id, small, name, score, ratio, flag "
+                              "from obtools_test where id = $1");
+  ASSERT_TRUE(select.bind(1, int64_t{-1234567890123}));
+  ASSERT_TRUE(select.next());
+  EXPECT_EQ(-1234567890123, static_cast<int64_t>(select.get_int(0)));
+  EXPECT_EQ("-5", select.get_string(1));
+  EXPECT_EQ("O'Brien \\ \"quoted\"", select.get_string(2));
+  EXPECT_EQ(0.1, select.get_real(3));
+  EXPECT_EQ("0.33333334", select.get_string(4));
+  EXPECT_EQ("t", select.get_string(5));
+  EXPECT_EQ(1u, select.get_int(5));
+  EXPECT_FALSE(select.next());
+
+  // Same as a text query gives
+  DB::Row binary_row, text_row;
+  select.reset();
+  ASSERT_TRUE(select.fetch(binary_row));
+  ASSERT_TRUE(conn->query("select id, small, name, score, ratio, flag "
+                          "from obtools_test where id = -1234567890123",
+                          text_row));
+  EXPECT_EQ(text_row.get_escaped_values(), binary_row.get_escaped_values());
+
+  // Text result (numeric isn't read in binary)
+  auto price = conn->prepare("select price, name from obtools_test "
+                             "order by id");
+  ASSERT_TRUE(!!price);
+  EXPECT_EQ(2, price.count());
+  ASSERT_TRUE(price.next());
+  EXPECT_EQ("12.50", price.get_string(0));
+  EXPECT_EQ(12.5, price.get_real(0));
+  ASSERT_TRUE(price.next());
+  EXPECT_EQ("", price.get_string(1));
+}
+
+TEST_F(DBPgSQLTest, TestBadStatementIsInvalid)
+{
+  auto statement = conn->prepare("select nonsense from nowhere");
+  EXPECT_FALSE(!!statement);
+  EXPECT_FALSE(statement.execute());
+  EXPECT_FALSE(statement.next());
+}
+
+TEST_F(DBPgSQLTest, TestHeldStatementsFromFactory)
+{
+  DB::PG::ConnectionFactory factory(conninfo,
+    {{"insert", "insert into obtools_test (id, name) values ($1, $2)"},
+     {"name", "select name from obtools_test where id = $1"}});
+  auto c = unique_ptr<DB::Connection>(factory.create());
+  ASSERT_TRUE(c.get());
+
+  for(auto i=0; i<3; i++)
+  {
+    auto insert = c->get_statement("insert");
+    ASSERT_TRUE(insert.bind(1, int64_t{i}));
+    ASSERT_TRUE(insert.bind(2, "name" + to_string(i)));
+    ASSERT_TRUE(insert.execute());
+  }
+
+  auto name = c->get_statement("name");
+  ASSERT_TRUE(name.bind(1, 2u));
+  string value;
+  ASSERT_TRUE(name.fetch(value));
+  EXPECT_EQ("name2", value);
+}
+
+TEST_F(DBPgSQLTest, TestInsertReturningIds)
+{
+  ASSERT_TRUE(conn->exec("create temporary table obtools_serial "
+                         "(id bigserial primary key, name text)"));
+  DB::Row row;
+  row.add("name", "first");
+  EXPECT_EQ(1u, conn->insert64("obtools_serial", row));
+  EXPECT_EQ(1u, conn->get_last_insert_id());
+
+  vector<DB::Row> rows(3, row);
+  vector<uint64_t> ids;
+  ASSERT_TRUE(conn->insert_many("obtools_serial", rows, ids));
+  EXPECT_EQ((vector<uint64_t>{2, 3, 4}), ids);
+
+  // More than one statement's worth, each ID matching its row
+  rows.resize(2500);
+  for(auto i=0u; i<rows.size(); i++)
+  {
+    rows[i] = DB::Row();
+    rows[i].add("name", "row" + to_string(i));
+  }
+  ASSERT_TRUE(conn->insert_many("obtools_serial", rows, ids));
+  ASSERT_EQ(rows.size(), ids.size());
+  for(auto i=0u; i<ids.size(); i+=99)
+    EXPECT_EQ("row" + to_string(i),
+              conn->query_string("select name from obtools_serial where id = "
+                                 + to_string(ids[i])));
+}
+
+TEST_F(DBPgSQLTest, TestStreamingCursor)
+{
+  ASSERT_TRUE(conn->exec("insert into obtools_test (id, name, score) "
+                         "select i, 'name' || i, i * 0.5 "
+                         "from generate_series(1, 1000) i"));
+  auto cursor = conn->stream("select id, name, score, flag from obtools_test "
+                             "order by id");
+  ASSERT_TRUE(!!cursor);
+  EXPECT_EQ((vector<string>{"id", "name", "score", "flag"}),
+            cursor.get_column_names());
+  auto rows = 0;
+  while (cursor.next())
+  {
+    rows++;
+    ASSERT_EQ(rows, cursor.get_int(0));
+    ASSERT_EQ("name" + to_string(rows), cursor.get_string_view(1));
+    ASSERT_EQ(rows * 0.5, cursor.get_real(2));
+    ASSERT_TRUE(cursor.is_null(3));
+  }
+  EXPECT_EQ(1000, rows);
+
+  // Empty result still has columns
+  cursor = conn->stream("select id from obtools_test where id < 0");
+  ASSERT_TRUE(!!cursor);
+  EXPECT_EQ(0, cursor.get_column("id"));
+  EXPECT_FALSE(cursor.next());
+
+  // Abandoned early leaves the connection usable
+  cursor = conn->stream("select id from obtools_test");
+  ASSERT_TRUE(cursor.next());
+  cursor = DB::Cursor();
+  EXPECT_EQ(1000, conn->query_int("select count(*) from obtools_test"));
+
+  EXPECT_FALSE(!!conn->stream("select nonsense from nowhere"));
+  EXPECT_EQ(1000, conn->query_int("select count(*) from obtools_test"));
+}
+
+TEST_F(DBPgSQLTest, TestBulkWriterWithCopy)
+{
+  {
+    DB::BulkWriter writer(*conn, "obtools_test", 100);
+    for(auto i=0; i<1000; i++)
+    {
+      DB::Row row;
+      row.add_int64("id", i);
+      if (i) row.add("name", "tab\there\nback\\slash " + to_string(i));
+      else row.add_null("name");
+      row.add("score", 1.0/(i+1));
+      row.add("flag", i%2 == 0);
+      ASSERT_TRUE(writer.write(row));
+    }
+    ASSERT_TRUE(writer.finish());
+  }
+  EXPECT_EQ(1000, conn->query_int("select count(*) from obtools_test"));
+
+  auto cursor = conn->stream("select name, score, flag from obtools_test "
+                             "where id in (0, 999) order by id");
+  ASSERT_TRUE(cursor.next());
+  EXPECT_TRUE(cursor.is_null(0));
+  ASSERT_TRUE(cursor.next());
+  EXPECT_EQ("tab\there\nback\\slash 999", cursor.get_string_view(0));
+  EXPECT_EQ(1.0/1000, cursor.get_real(1));
+  EXPECT_EQ("f", cursor.get_string_view(2));
+  EXPECT_FALSE(cursor.next());
+  cursor = DB::Cursor();
+
+  // Failure rolls back, and leaves the connection usable
+  {
+    DB::BulkWriter writer(*conn, "obtools_test");
+    DB::Row row;
+    row.add_int64("id", 5);
+    ASSERT_TRUE(writer.write(row));
+    EXPECT_FALSE(writer.finish());
+  }
+  EXPECT_EQ(1000, conn->query_int("select count(*) from obtools_test"));
+}
+
+TEST_F(DBPgSQLTest, TestPipelinedAsyncQueries)
+{
+  DB::PG::ConnectionFactory factory(conninfo);
+  DB::ConnectionPool pool(factory, 1, 2, Time::Duration(10));
+  vector<future<DB::Result>> futures;
+  for(auto i=0; i<200; i++)
+    futures.push_back(pool.query_async("select " + to_string(i)));
+
+  // Failure doesn't affect others sent with it, or roll back their writes
+  auto write = pool.query_async("insert into obtools_test (id) values (99) "
+                                "returning id");
+  auto bad = pool.query_async("select nonsense from nowhere");
+  auto after = pool.query_async("select 'after'");
+
+  for(auto i=0; i<200; i++)
+  {
+    auto result = futures[i].get();
+    string value;
+    ASSERT_TRUE(result.fetch(value));
+    EXPECT_EQ(to_string(i), value);
+  }
+  EXPECT_TRUE(!!write.get());
+  EXPECT_FALSE(!!bad.get());
+  EXPECT_EQ(1, conn->query_int("select count(*) from obtools_test "
+                               "where id = 99"));
+  string value;
+  ASSERT_TRUE(after.get().fetch(value));
+  EXPECT_EQ("after", value);
+  EXPECT_GT(202u, pool.get_stats().claims);
+}
+
+TEST_F(DBPgSQLTest, BenchmarkPreparedAgainstTextSQL)
+{
+  if (!getenv("OBTOOLS_BENCHMARK"))
+    GTEST_SKIP() << "OBTOOLS_BENCHMARK not set";
+
+  const auto n = 2000;
+
+  // Text: escaped row values in SQL, parsed and planned every time
+  auto start = chrono::steady_clock::now();
+  for(auto i=0; i<n; i++)
+  {
+    DB::Row row;
+    row.add_int64("id", i);
+    row.add("name", "Name " + to_string(i));
+    row.add("score", i * 0.5);
+    ASSERT_TRUE(conn->insert("obtools_test", row, ""));
+  }
+  for(auto i=0; i<n; i++)
+  {
+    DB::Row row;
+    ASSERT_TRUE(conn->query("select name, score from obtools_test where id = "
+                            + to_string(i), row));
+  }
+  chrono::duration<double> text_time = chrono::steady_clock::now() - start;
+  ASSERT_TRUE(conn->exec("delete from obtools_test"));
+
+  // Prepared: bound binary values
+  start = chrono::steady_clock::now();
+  auto insert = conn->prepare("insert into obtools_test (id, name, score) "
+                              "values ($1, $2, $3)");
+  for(auto i=0; i<n; i++)
+  {
+    insert.bind(1, int64_t{i});
+    insert.bind(2, "Name " + to_string(i));
+    insert.bind(3, i * 0.5);
+    ASSERT_TRUE(insert.execute());
+  }
+  auto select = conn->prepare("select name, score from obtools_test "
+                              "where id = $1");
+  for(auto i=0; i<n; i++)
+  {
+    select.reset();
+    select.bind(1, int64_t{i});
+    ASSERT_TRUE(select.next());
+  }
+  chrono::duration<double> prepared_time = chrono::steady_clock::now() - start;
+
+  cout << n << " inserts + selects: text " << text_time.count()
+       << "s, prepared " << prepared_time.count() << "s (x"
+       << text_time.count() / prepared_time.count() << ")\n";
+}
+
+//--------------------------------------------------------------------------
+// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -15,6 +15,31 @@
 
 namespace ObTools { namespace DB { namespace SQLite {
 
+namespace
+{
+  // Bind a row value to a statement parameter, by its type
+  bool bind_value(DB::PreparedStatement& statement, int index,
+                  const FieldValue& value)
+  {
+    switch (value.get_type())
+    {
+      case NULLTYPE:
+        return statement.bind(index);
+
+      case INT:
+      case INT64:
+      case BOOL:
+        return statement.bind(index, static_cast<int64_t>(value.as_int64()));
+
+      case REAL:
+        return statement.bind(index, value.as_real());
+
+      default:
+        return statement.bind(index, value.as_string());
+    }
+  }
+}
+
 //==========================================================================
 // SQLite prepare statement class
 
@@ -166,6 +191,50 @@ Time::Stamp PreparedStatement::get_time(int col)
   return Time::Stamp{string{reinterpret_cast<const char *>(v)}};
 }
 
+//==========================================================================
+// SQLite streaming result
+
+//--------------------------------------------------------------------------
+// Constructor
+Stream::Stream(sqlite3_stmt *_stmt):
+  stmt{_stmt, sqlite3_finalize}
+{
+  const auto n = sqlite3_column_count(stmt.get());
+  for(auto i=0; i<n; i++)
+    column_names.push_back(sqlite3_column_name(stmt.get(), i));
+}
+
+//--------------------------------------------------------------------------
+// Move to next row
+bool Stream::next()
+{
+  if (finished) return false;
+
+  const auto e = sqlite3_step(stmt.get());
+  if (e == SQLITE_ROW) return true;
+
+  finished = true;
+  if (e != SQLITE_DONE)
+  {
+    failed = true;
+    Log::Error log;
+    log << "SQLite stream failed: "
+        << sqlite3_errmsg(sqlite3_db_handle(stmt.get())) << endl;
+  }
+  return false;
+}
+
+//--------------------------------------------------------------------------
+// Get a field as a string view
+string_view Stream::get_string_view(int col)
+{
+  // Note text must be fetched before its length, since it may be converted
+  auto v = sqlite3_column_text(stmt.get(), col);
+  if (!v) return {};
+  return string_view(reinterpret_cast<const char *>(v),
+                     sqlite3_column_bytes(stmt.get(), col));
+}
+
 //==========================================================================
 // SQLite connection class
 
@@ -267,6 +336,26 @@ Statement Connection::prepare(const string& sql)
   return Statement(new PreparedStatement{stmt});
 }
 
+//--------------------------------------------------------------------------
+// Execute a query and stream the result
+// Returns cursor - check this for validity
+Cursor Connection::stream(const string& sql)
+{
+  OBTOOLS_LOG_IF_DEBUG({Log::Debug dlog; dlog << "DBstream: " << sql << endl;})
+
+  sqlite3_stmt *stmt{0};
+  auto e = sqlite3_prepare_v2(conn.get(), sql.c_str(), sql.size(), &stmt,
+                              nullptr);
+  if (e != SQLITE_OK)
+  {
+    Log::Error log;
+    log << "SQLite stream failed: " << sqlite3_errmsg(conn.get()) << endl;
+    sqlite3_finalize(stmt);
+    return Cursor();
+  }
+  return Cursor(new Stream{stmt});
+}
+
 //--------------------------------------------------------------------------
 // Gets the last insert id
 uint64_t Connection::get_last_insert_id()
@@ -274,6 +363,84 @@ uint64_t Connection::get_last_insert_id()
   return sqlite3_last_insert_rowid(conn.get());
 }
 
+//--------------------------------------------------------------------------
+// Execute an INSERT and get the generated ID
+bool Connection::insert_returning(const string& sql, const string&,
+                                  const string& id_field, uint64_t& id, bool)
+{
+  if (sqlite3_libversion_number() >= 3035000)
+    return insert_with_returning_clause(sql, id_field, id);
+
+  if (!exec(sql)) return false;
+  id = get_last_insert_id();
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// INSERT a batch of rows with a prepared statement, getting the IDs
+// generated in id_field if ids is given
+bool Connection::insert_prepared(const string& table, const vector<Row>& rows,
+                                 const string& id_field,
+                                 vector<uint64_t> *ids)
+{
+  if (rows.empty()) return true;
+
+  const auto& first = rows.front();
+  for(const auto& row: rows)
+  {
+    if (!row.has_same_fields(first))
+    {
+      Log::Error log;
+      log << "SQLite batch insert into " << table
+          << " failed: rows have different fields\n";
+      return false;
+    }
+  }
+
+  const auto fields = distance(first.begin(), first.end());
+  ostringstream oss;
+  oss << "INSERT INTO " << table << " (" << first.get_fields() << ") VALUES (";
+  for(auto i=0; i<fields; i++) oss << (i ? ", ?" : "?");
+  oss << ")";
+  const auto returning = ids && sqlite3_libversion_number() >= 3035000;
+  if (returning) oss << " RETURNING " << id_field;
+
+  if (oss.str() != batch_sql)
+  {
+    batch_statement = prepare(oss.str());
+    if (!batch_statement)
+    {
+      batch_sql.clear();
+      return false;
+    }
+    batch_sql = oss.str();
+  }
+
+  for(const auto& row: rows)
+  {
+    batch_statement.reset();
+    auto index = 1;
+    for(const auto& p: row)
+      if (!bind_value(batch_statement, index++, p.second)) return false;
+    if (returning ? !batch_statement.next() : !batch_statement.execute())
+    {
+      Log::Error log;
+      log << "SQLite batch insert into " << table << " failed" << endl;
+      batch_statement.reset();
+      return false;
+    }
+
+    if (returning)
+      ids->push_back(batch_statement.get_int(0));
+    else if (ids)
+      ids->push_back(get_last_insert_id());
+  }
+
+  // Don't hold the statement open
+  batch_statement.reset();
+  return true;
+}
+
 //--------------------------------------------------------------------------
 // Do an INSERT or UPDATE if it already exists (violates unique key)
 // Uses INSERT ... ON CONFLICT DO UPDATE
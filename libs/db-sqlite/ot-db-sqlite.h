@@ -132,12 +132,60 @@ public:
   {}
 };
 
+//==========================================================================
+// SQLite streaming result - steps the statement row by row
+class Stream: public DB::ResultStream
+{
+private:
+  unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)> stmt;
+  bool finished = false;    // Stepping again would re-run the query
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor - takes ownership of a prepared statement
+  Stream(sqlite3_stmt *stmt);
+
+  //------------------------------------------------------------------------
+  // Move to next row
+  bool next() override;
+
+  //------------------------------------------------------------------------
+  // Check whether a field is null
+  bool is_null(int col) override
+  {
+    return sqlite3_column_type(stmt.get(), col) == SQLITE_NULL;
+  }
+
+  //------------------------------------------------------------------------
+  // Get a field as a string view
+  string_view get_string_view(int col) override;
+
+  //------------------------------------------------------------------------
+  // Get a field as an integer
+  int64_t get_int(int col) override
+  {
+    return sqlite3_column_int64(stmt.get(), col);
+  }
+
+  //------------------------------------------------------------------------
+  // Get a field as a real
+  double get_real(int col) override
+  {
+    return sqlite3_column_double(stmt.get(), col);
+  }
+};
+
 //==========================================================================
 // SQLite connection class
 class Connection: public DB::Connection
 {
 private:
   unique_ptr<sqlite3, decltype(&sqlite3_close)> conn;
+  string batch_sql;          // Statement kept for insert_batch()
+  Statement batch_statement;
+
+  bool insert_prepared(const string& table, const vector<Row>& rows,
+                       const string& id_field, vector<uint64_t> *ids);
 
 public:
   //------------------------------------------------------------------------
@@ -163,10 +211,41 @@ public:
   // Returns result - check this for validity
   Statement prepare(const string& sql) override;
 
+  //------------------------------------------------------------------------
+  // Execute a query and stream the result
+  // Returns cursor - check this for validity
+  Cursor stream(const string& sql) override;
+
   //------------------------------------------------------------------------
   // Gets the last insert id
   uint64_t get_last_insert_id() override;
 
+  //------------------------------------------------------------------------
+  // Execute an INSERT and get the generated ID - with RETURNING if the
+  // library supports it (3.35), otherwise from the last insert rowid
+  bool insert_returning(const string& sql, const string& table,
+                        const string& id_field, uint64_t& id,
+                        bool in_transaction) override;
+
+  //------------------------------------------------------------------------
+  // INSERT a batch of rows with one prepared statement, kept for the next
+  // batch to the same table and fields
+  bool insert_batch(const string& table, const vector<Row>& rows) override
+  {
+    return insert_prepared(table, rows, "", nullptr);
+  }
+
+  //------------------------------------------------------------------------
+  // INSERT a batch of rows getting IDs, as insert_batch() - reads each ID
+  // with RETURNING if the library supports it, otherwise from the last
+  // insert rowid
+  bool insert_batch_returning(const string& table, const vector<Row>& rows,
+                              const string& id_field,
+                              vector<uint64_t>& ids) override
+  {
+    return insert_prepared(table, rows, id_field, &ids);
+  }
+
   //--------------------------------------------------------------------------
   // Do an INSERT or UPDATE if it already exists (violates unique key)
   // (see ot-db.h)
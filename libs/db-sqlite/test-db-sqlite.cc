@@ -166,6 +166,289 @@ TEST_F(DBSQLiteTest, TestLastInsertId)
   trans.commit();
 }
 
+TEST_F(DBSQLiteTest, TestInsertReturnsGeneratedId)
+{
+  auto factory = DB::SQLite::ConnectionFactory(dbfile, timeout);
+  auto conn = unique_ptr<DB::Connection>(factory.create());
+  ASSERT_TRUE(conn->exec("create table test (id integer primary key, "
+                         "a text)"));
+  ASSERT_TRUE(conn->exec("insert into test(id, a) values (100, 'x')"));
+
+  DB::Row row;
+  row.add("a", "y");
+  EXPECT_EQ(101, conn->insert("test", row));
+  EXPECT_EQ(102u, conn->insert64("insert into test(a) values ('z')",
+                                 "test"));
+  EXPECT_EQ(102u, conn->get_last_insert_id());
+  EXPECT_EQ(0, conn->insert("insert into nowhere(a) values ('z')", "test"));
+}
+
+TEST_F(DBSQLiteTest, TestInsertManyReturnsIdsInOrder)
+{
+  auto factory = DB::SQLite::ConnectionFactory(dbfile, timeout);
+  auto conn = unique_ptr<DB::Connection>(factory.create());
+  ASSERT_TRUE(conn->exec("create table test (id integer primary key, "
+                         "a text, n int)"));
+
+  // More than one statement's worth
+  vector<DB::Row> rows(2500);
+  for(auto i=0u; i<rows.size(); i++)
+  {
+    rows[i].add("a", "it's " + Text::itos(i));
+    rows[i].add("n", static_cast<int>(i));
+  }
+
+  vector<uint64_t> ids;
+  ASSERT_TRUE(conn->insert_many("test", rows, ids));
+  ASSERT_EQ(rows.size(), ids.size());
+  for(auto i=0u; i<ids.size(); i++)
+    ASSERT_EQ(Text::itos(i),
+              conn->query_string("select n from test where id = "
+                                 + Text::i64tos(ids[i])));
+  EXPECT_EQ("it's 7",
+            conn->query_string("select a from test where id = "
+                               + Text::i64tos(ids[7])));
+
+  // Failure leaves nothing inserted
+  rows[2400].add("nonsense", 1);
+  rows.resize(2401);
+  EXPECT_FALSE(conn->insert_many("test", rows, ids));
+  EXPECT_TRUE(ids.empty());
+  EXPECT_EQ(2500, conn->query_int("select count(*) from test"));
+
+  // No IDs wanted
+  rows.resize(10);
+  EXPECT_TRUE(conn->insert_many("test", rows, ids, ""));
+  EXPECT_TRUE(ids.empty());
+  EXPECT_EQ(2510, conn->query_int("select count(*) from test"));
+}
+
+TEST_F(DBSQLiteTest, TestInsertWithTrailingSemicolonOrReturning)
+{
+  auto factory = DB::SQLite::ConnectionFactory(dbfile, timeout);
+  auto conn = unique_ptr<DB::Connection>(factory.create());
+  ASSERT_TRUE(conn->exec("create table test (id integer primary key, "
+                         "a text)"));
+  EXPECT_EQ(1u, conn->insert64("INSERT INTO test (a) VALUES ('x'); ", "test"));
+  EXPECT_EQ(2u, conn->insert64("INSERT INTO test (a) VALUES ('returning') "
+                               "RETURNING id;", "test"));
+  EXPECT_EQ(3u, conn->insert64("insert into test (a) values ('y') "
+                               "returning id", "test"));
+  EXPECT_EQ("returning", conn->query_string("select a from test where id=2"));
+}
+
+TEST_F(DBSQLiteTest, TestStreamingCursor)
+{
+  auto factory = DB::SQLite::ConnectionFactory(dbfile, timeout);
+  auto conn = unique_ptr<DB::Connection>(factory.create());
+  ASSERT_TRUE(conn->exec("create table test (id int, name text, score real)"));
+  ASSERT_TRUE(conn->exec("insert into test values (-5, 'it''s', 0.5)"));
+  ASSERT_TRUE(conn->exec("insert into test values (6, null, null)"));
+
+  auto cursor = conn->stream("select id, name, score from test order by id");
+  ASSERT_TRUE(!!cursor);
+  EXPECT_EQ((vector<string>{"id", "name", "score"}),
+            cursor.get_column_names());
+  EXPECT_EQ(2, cursor.get_column("score"));
+  EXPECT_EQ(-1, cursor.get_column("nonsense"));
+
+  ASSERT_TRUE(cursor.next());
+  EXPECT_EQ(-5, cursor.get_int(0));
+  EXPECT_EQ("-5", cursor.get_string_view(0));
+  EXPECT_EQ("it's", cursor.get_string_view(1));
+  EXPECT_EQ(0.5, cursor.get_real(2));
+  EXPECT_FALSE(cursor.is_null(1));
+
+  ASSERT_TRUE(cursor.next());
+  EXPECT_EQ(6, cursor.get_int(0));
+  EXPECT_TRUE(cursor.is_null(1));
+  EXPECT_EQ("", cursor.get_string_view(1));
+  EXPECT_EQ(0.0, cursor.get_real(2));
+  EXPECT_FALSE(cursor.next());
+  EXPECT_FALSE(cursor.has_failed());
+
+  // Doesn't start again
+  EXPECT_FALSE(cursor.next());
+
+  auto bad = conn->stream("select nonsense from nowhere");
+  EXPECT_FALSE(!!bad);
+  EXPECT_FALSE(bad.next());
+  EXPECT_TRUE(bad.get_column_names().empty());
+}
+
+TEST_F(DBSQLiteTest, TestStreamingCursorErrorIsNotEnd)
+{
+  auto factory = DB::SQLite::ConnectionFactory(dbfile, timeout);
+  auto conn = unique_ptr<DB::Connection>(factory.create());
+  ASSERT_TRUE(conn->exec("create table test (id int)"));
+  for(auto i=1; i<=3; i++)
+    ASSERT_TRUE(conn->exec("insert into test values ("+Text::itos(i)+")"));
+
+  // abs() of the smallest integer overflows, on the last row only - not
+  // sorted, since that would read every row before the first
+  auto cursor = conn->stream("select abs(-9223372036854775805 - id) "
+                             "from test");
+  ASSERT_TRUE(!!cursor);
+  EXPECT_TRUE(cursor.next());
+  EXPECT_TRUE(cursor.next());
+  EXPECT_FALSE(cursor.has_failed());
+  EXPECT_FALSE(cursor.next());
+  EXPECT_TRUE(cursor.has_failed());
+  EXPECT_FALSE(cursor.next());
+
+  vector<DB::Result> results;
+  conn->query_batch({"select id from test",
+                     "select abs(-9223372036854775805 - id) from test"},
+                    results);
+  ASSERT_EQ(2u, results.size());
+  EXPECT_TRUE(!!results[0]);
+  EXPECT_FALSE(!!results[1]);
+}
+
+TEST_F(DBSQLiteTest, TestBulkWriter)
+{
+  auto factory = DB::SQLite::ConnectionFactory(dbfile, timeout);
+  auto conn = unique_ptr<DB::Connection>(factory.create());
+  ASSERT_TRUE(conn->exec("create table test (id integer primary key, "
+                         "name text, score real, flag int)"));
+  {
+    DB::BulkWriter writer(*conn, "test", 10);
+    for(auto i=0; i<25; i++)
+    {
+      DB::Row row;
+      row.add_int64("id", i);
+      if (i != 3) row.add("name", "it's \\ " + Text::itos(i));
+      else row.add_null("name");
+      row.add("score", i + 0.1);
+      row.add("flag", i % 2 == 0);
+      ASSERT_TRUE(writer.write(row));
+    }
+    EXPECT_EQ(20u, writer.get_written());
+    ASSERT_TRUE(writer.finish());
+    EXPECT_EQ(25u, writer.get_written());
+  }
+
+  EXPECT_EQ(25, conn->query_int("select count(*) from test"));
+  auto cursor = conn->stream("select name, score, flag from test "
+                             "where id in (3, 24) order by id");
+  ASSERT_TRUE(cursor.next());
+  EXPECT_TRUE(cursor.is_null(0));
+  ASSERT_TRUE(cursor.next());
+  EXPECT_EQ("it's \\ 24", cursor.get_string_view(0));
+  EXPECT_EQ(24.1, cursor.get_real(1));
+  EXPECT_EQ(1, cursor.get_int(2));
+  cursor = DB::Cursor();
+
+  // Not finished is rolled back
+  {
+    DB::BulkWriter writer(*conn, "test", 10);
+    for(auto i=100; i<150; i++)
+    {
+      DB::Row row;
+      row.add_int64("id", i);
+      ASSERT_TRUE(writer.write(row));
+    }
+  }
+  EXPECT_EQ(25, conn->query_int("select count(*) from test"));
+
+  // Failure stops it
+  {
+    DB::BulkWriter writer(*conn, "test", 10);
+    DB::Row row;
+    row.add_int64("id", 1);  // Duplicate
+    ASSERT_TRUE(writer.write(row));
+    EXPECT_FALSE(writer.finish());
+    EXPECT_FALSE(!!writer);
+    EXPECT_FALSE(writer.write(row));
+  }
+  EXPECT_EQ(25, conn->query_int("select count(*) from test"));
+
+  // Same number of fields, but different names
+  {
+    DB::BulkWriter writer(*conn, "test", 10);
+    DB::Row row;
+    row.add_int64("id", 200);
+    row.add("name", "x");
+    ASSERT_TRUE(writer.write(row));
+    DB::Row row2;
+    row2.add_int64("id", 201);
+    row2.add("score", 1.5);
+    ASSERT_TRUE(writer.write(row2));
+    EXPECT_FALSE(writer.finish());
+  }
+  EXPECT_EQ(25, conn->query_int("select count(*) from test"));
+
+  // And for insert_many()
+  DB::Row a, b;
+  a.add("name", "a");
+  b.add("score", 2.0);
+  vector<uint64_t> ids;
+  EXPECT_FALSE(conn->insert_many("test", {a, b}, ids, ""));
+  EXPECT_EQ(25, conn->query_int("select count(*) from test"));
+}
+
+TEST_F(DBSQLiteTest, BenchmarkBulkWriterAgainstRowInsert)
+{
+  if (!getenv("OBTOOLS_BENCHMARK"))
+    GTEST_SKIP() << "OBTOOLS_BENCHMARK not set";
+
+  auto factory = DB::SQLite::ConnectionFactory(dbfile, timeout);
+  auto conn = unique_ptr<DB::Connection>(factory.create());
+  ASSERT_TRUE(conn->exec("create table test (id integer primary key, "
+                         "name text, score real)"));
+  const auto n = 2000;
+  const auto bulk_n = 200000;
+  auto make_row = [](int i)
+  {
+    DB::Row row;
+    row.add_int64("id", i);
+    row.add("name", "Name number " + Text::itos(i));
+    row.add("score", i * 0.5);
+    return row;
+  };
+
+  // Row at a time, each its own transaction
+  auto start = chrono::steady_clock::now();
+  for(auto i=0; i<n; i++)
+  {
+    auto row = make_row(i);
+    ASSERT_TRUE(conn->insert("test", row, ""));
+  }
+  chrono::duration<double> row_time = chrono::steady_clock::now() - start;
+  ASSERT_TRUE(conn->exec("delete from test"));
+
+  // Row at a time in one transaction
+  start = chrono::steady_clock::now();
+  {
+    DB::Transaction t(*conn);
+    for(auto i=0; i<bulk_n; i++)
+    {
+      auto row = make_row(i);
+      ASSERT_TRUE(conn->insert("test", row, "", true));
+    }
+    ASSERT_TRUE(t.commit());
+  }
+  chrono::duration<double> trans_time = chrono::steady_clock::now() - start;
+  ASSERT_TRUE(conn->exec("delete from test"));
+
+  // Bulk
+  start = chrono::steady_clock::now();
+  DB::BulkWriter writer(*conn, "test");
+  for(auto i=0; i<bulk_n; i++)
+    ASSERT_TRUE(writer.write(make_row(i)));
+  ASSERT_TRUE(writer.finish());
+  chrono::duration<double> bulk_time = chrono::steady_clock::now() - start;
+  EXPECT_EQ(bulk_n, conn->query_int("select count(*) from test"));
+
+  const auto row_rate = n / row_time.count();
+  const auto trans_rate = bulk_n / trans_time.count();
+  const auto bulk_rate = bulk_n / bulk_time.count();
+  cout << "Rows/s: insert " << static_cast<int>(row_rate)
+       << ", insert in transaction " << static_cast<int>(trans_rate)
+       << ", BulkWriter " << static_cast<int>(bulk_rate)
+       << " (x" << bulk_rate / trans_rate << ")\n";
+}
+
 TEST_F(DBSQLiteTest, TestMultithreadingWithConnectionPerThread)
 {
   auto factory = DB::SQLite::ConnectionFactory(dbfile, timeout);
@@ -294,6 +577,45 @@ TEST_F(DBSQLiteTest, TestMultithreadingWithPooledConnectionPerThread)
   EXPECT_EQ("999", value);
 }
 
+TEST_F(DBSQLiteTest, TestAsyncQueriesOnPool)
+{
+  auto factory = DB::SQLite::ConnectionFactory(dbfile, timeout);
+  DB::ConnectionPool pool(factory, 1, 2, Time::Duration("10s"));
+  {
+    DB::AutoConnection conn(pool);
+    ASSERT_TRUE(conn.exec("create table test (id int, name text)"));
+    ASSERT_TRUE(conn.exec("insert into test values (1, 'one'), (2, null)"));
+  }
+
+  vector<future<DB::Result>> futures;
+  for(auto i=0; i<500; i++)
+    futures.push_back(pool.query_async("select id, name, " + Text::itos(i)
+                                       + " as n from test order by id"));
+  auto bad = pool.query_async("select nonsense from nowhere");
+
+  for(auto i=0; i<500; i++)
+  {
+    auto result = futures[i].get();
+    ASSERT_TRUE(!!result);
+    ASSERT_EQ(2, result.count());
+    DB::Row row;
+    ASSERT_TRUE(result.fetch(row));
+    EXPECT_EQ("one", row["name"]);
+    EXPECT_EQ(i, row.get_int("n"));
+    string id;
+    ASSERT_TRUE(result.fetch(id));  // First column
+    EXPECT_EQ("2", id);
+    EXPECT_FALSE(result.fetch(row));
+  }
+  EXPECT_FALSE(!!bad.get());
+
+  auto stats = pool.get_stats();
+  EXPECT_EQ(501u, stats.async_completed);
+  EXPECT_GE(2u, stats.peak_in_use);
+  cout << "Async: " << stats.claims << " claims for 501 queries, "
+       << "utilisation " << stats.utilisation << endl;
+}
+
 //--------------------------------------------------------------------------
 // Main
 int main(int argc, char **argv)
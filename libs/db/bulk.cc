@@ -0,0 +1,103 @@
+//==========================================================================
+// ObTools::DB: bulk.cc
+//
+// Bulk writer - batched inserts
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "ot-db.h"
+
+namespace ObTools { namespace DB {
+
+//--------------------------------------------------------------------------
+// Constructor from plain connection
+BulkWriter::BulkWriter(Connection& _conn, const string& _table,
+                       size_t _batch_size, bool transaction):
+  BulkWriter(&_conn, _table, _batch_size, transaction)
+{
+}
+
+//--------------------------------------------------------------------------
+// Constructor from AutoConnection
+BulkWriter::BulkWriter(AutoConnection& _conn, const string& _table,
+                       size_t _batch_size, bool transaction):
+  BulkWriter(_conn.conn, _table, _batch_size, transaction)
+{
+}
+
+//--------------------------------------------------------------------------
+// Constructor from connection pointer, which may be null
+BulkWriter::BulkWriter(Connection *_conn, const string& _table,
+                       size_t _batch_size, bool transaction):
+  conn(_conn), table(_table), batch_size(max(_batch_size, size_t{1}))
+{
+  if (!conn)
+  {
+    failed = true;
+    return;
+  }
+  batch.reserve(batch_size);
+  if (transaction)
+  {
+    in_transaction = conn->transaction_begin();
+    failed = !in_transaction;
+  }
+}
+
+//--------------------------------------------------------------------------
+// Add a row
+bool BulkWriter::write(const Row& row)
+{
+  if (failed) return false;
+  batch.push_back(row);
+  return batch.size() < batch_size || flush();
+}
+
+bool BulkWriter::write(Row&& row)
+{
+  if (failed) return false;
+  batch.push_back(move(row));
+  return batch.size() < batch_size || flush();
+}
+
+//--------------------------------------------------------------------------
+// Write any rows held
+bool BulkWriter::flush()
+{
+  if (failed) return false;
+  if (batch.empty()) return true;
+
+  if (!conn->insert_batch(table, batch))
+  {
+    failed = true;
+    return false;
+  }
+
+  written += batch.size();
+  batch.clear();
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Write any rows held and commit
+bool BulkWriter::finish()
+{
+  if (!flush()) return false;
+  if (in_transaction)
+  {
+    in_transaction = false;
+    failed = !conn->transaction_commit();
+  }
+  return !failed;
+}
+
+//--------------------------------------------------------------------------
+// Destructor
+BulkWriter::~BulkWriter()
+{
+  if (in_transaction) conn->transaction_rollback();
+}
+
+}} // namespaces
@@ -12,6 +12,8 @@
 #include "ot-text.h"
 #include "ot-log.h"
 #include <stdlib.h>
+#include <strings.h>
+#include <ctype.h>
 #include <sstream>
 
 namespace ObTools { namespace DB {
@@ -42,6 +44,36 @@ AutoStatement Connection::get_statement(const string& id)
   return &it->second;
 }
 
+//--------------------------------------------------------------------------
+// Execute a query and stream the result - default can't
+Cursor Connection::stream(const string&)
+{
+  Log::Error log;
+  log << "Streaming queries not supported by this database driver" << endl;
+  return Cursor();
+}
+
+//--------------------------------------------------------------------------
+// Run a number of queries, reading the results into memory - default
+// streams each in turn
+void Connection::query_batch(const vector<string>& sqls,
+                             vector<Result>& results)
+{
+  results.clear();
+  for(const auto& sql: sqls)
+  {
+    auto cursor = stream(sql);
+    if (cursor)
+    {
+      // Partial results are no use
+      results.emplace_back(new StoredResultSet(cursor));
+      if (cursor.has_failed()) results.back() = Result();
+    }
+    else
+      results.emplace_back();
+  }
+}
+
 //--------------------------------------------------------------------------
 // Execute a query and get first (only) row
 // Returns whether successful - row is cleared and filled in if so
@@ -124,35 +156,78 @@ bool Connection::query_bool(const string& sql, bool def)
 }
 
 //--------------------------------------------------------------------------
-// Do an INSERT and retrieve the last inserted serial ID
-// Fetches max(<id_field>) inside a transaction, unless id_field is ""
-// If id_field is "", does a normal insert and returns 1
-// Returns ID, or 0 if failed
-int Connection::insert(const string& sql,
-                       const string& table, const string& id_field,
-                       bool in_transaction)
+// Execute an INSERT and get the generated ID - generic version
+// Assumes autoincrementing IDs always increase, so the largest is ours,
+// which is only true if there are no other writers
+bool Connection::insert_returning(const string& sql, const string& table,
+                                  const string& id_field, uint64_t& id,
+                                  bool in_transaction)
 {
-  // Allow for not interested in returned ID - simple version
-  if (id_field.empty()) return exec(sql)?1:0;
-
-  // Want ID back in transaction
-  if (!in_transaction && !exec("BEGIN")) return 0;
+  if (!in_transaction && !exec("BEGIN")) return false;
   if (!exec(sql))
   {
     if (!in_transaction) exec("ROLLBACK");  // Try to roll back
-    return 0;
+    return false;
   }
 
-  // Assume autoincrementing IDs always increase, so max is the largest
   string sql2("SELECT max(");
   sql2 += id_field;
   sql2 += ") from ";
   sql2 += table;
-  int id=query_int(sql2);
+  id = query_int64(sql2);
 
   if (!in_transaction) exec("COMMIT");
+  return true;
+}
 
-  return id;
+//--------------------------------------------------------------------------
+// insert_returning() for drivers which support INSERT ... RETURNING
+// Uses the SQL's own RETURNING clause if it has one, taking the first column
+bool Connection::insert_with_returning_clause(const string& sql,
+                                              const string& id_field,
+                                              uint64_t& id)
+{
+  // Drop any trailing ';', and look for RETURNING outside quotes
+  auto end = sql.find_last_not_of("; \t\r\n");
+  auto stmt = sql.substr(0, end == string::npos ? 0 : end+1);
+  const auto is_word = [](char c)
+    { return isalnum(static_cast<unsigned char>(c)) || c == '_'; };
+  auto has_returning = false;
+  char quote = 0;
+  for(auto i=0u; i<stmt.size() && !has_returning; i++)
+  {
+    const auto c = stmt[i];
+    if (quote)
+    {
+      if (c == quote) quote = 0;
+    }
+    else if (c == '\'' || c == '"' || c == '`')
+      quote = c;
+    else if ((c == 'R' || c == 'r') && (!i || !is_word(stmt[i-1]))
+             && !strncasecmp(stmt.c_str()+i, "returning", 9)
+             && (i+9 == stmt.size() || !is_word(stmt[i+9])))
+      has_returning = true;
+  }
+  if (!has_returning) stmt += " RETURNING " + id_field;
+
+  auto result = query(stmt);
+  if (!result) return false;
+
+  string value;
+  if (!result.fetch(value)) return false;
+  id = Text::stoi64(value);
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Do an INSERT and retrieve the last inserted serial ID
+// If id_field is "", does a normal insert and returns 1
+// Returns ID, or 0 if failed
+int Connection::insert(const string& sql,
+                       const string& table, const string& id_field,
+                       bool in_transaction)
+{
+  return static_cast<int>(insert64(sql, table, id_field, in_transaction));
 }
 
 //--------------------------------------------------------------------------
@@ -164,23 +239,8 @@ uint64_t Connection::insert64(const string& sql,
   // Allow for not interested in returned ID - simple version
   if (id_field.empty()) return exec(sql)?1:0;
 
-  // Want ID back in transaction
-  if (!in_transaction && !exec("BEGIN")) return 0;
-  if (!exec(sql))
-  {
-    if (!in_transaction) exec("ROLLBACK");  // Try to roll back
-    return 0;
-  }
-
-  // Assume autoincrementing IDs always increase, so max is the largest
-  string sql2("SELECT max(");
-  sql2 += id_field;
-  sql2 += ") from ";
-  sql2 += table;
-  uint64_t id=query_int64(sql2);
-
-  if (!in_transaction) exec("COMMIT");
-
+  uint64_t id = 0;
+  if (!insert_returning(sql, table, id_field, id, in_transaction)) return 0;
   return id;
 }
 
@@ -211,6 +271,107 @@ uint64_t Connection::insert64(const string& table, Row& row,
   return insert64(oss.str(), table, id_field, in_transaction);
 }
 
+//--------------------------------------------------------------------------
+// INSERT a number of rows with insert_batch_returning(), or insert_batch()
+// if IDs aren't wanted
+// Returns whether successful - ids is filled in if so
+bool Connection::insert_many(const string& table, const vector<Row>& rows,
+                             vector<uint64_t>& ids, const string& id_field,
+                             bool in_transaction)
+{
+  ids.clear();
+  if (rows.empty()) return true;
+
+  for(const auto& row: rows)
+  {
+    if (!row.has_same_fields(rows.front()))
+    {
+      Log::Error log;
+      log << "Rows inserted into " << table << " have different fields\n";
+      return false;
+    }
+  }
+
+  const auto multiple = rows.size() > 1;
+  if (multiple && !in_transaction && !exec("BEGIN")) return false;
+
+  const auto ok = id_field.empty()
+    ? insert_batch(table, rows)
+    : insert_batch_returning(table, rows, id_field, ids);
+  if (!ok)
+  {
+    if (multiple && !in_transaction) exec("ROLLBACK");
+    ids.clear();
+    return false;
+  }
+
+  if (multiple && !in_transaction && !exec("COMMIT"))
+  {
+    ids.clear();
+    return false;
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// INSERT a batch of rows - generic version with multi-row INSERTs
+bool Connection::insert_batch(const string& table, const vector<Row>& rows)
+{
+  // Limit statement size
+  const size_t max_rows_per_statement = 1000;
+
+  for(const auto& row: rows)
+  {
+    if (!row.has_same_fields(rows.front()))
+    {
+      Log::Error log;
+      log << "Rows inserted into " << table << " have different fields\n";
+      return false;
+    }
+  }
+
+  for(auto start = 0ul; start < rows.size(); start += max_rows_per_statement)
+  {
+    const auto end = min(rows.size(), start + max_rows_per_statement);
+    ostringstream oss;
+    oss << "INSERT INTO " << table;
+    oss << " (" << rows[start].get_fields() << ") VALUES ";
+    for(auto i=start; i<end; i++)
+    {
+      if (i != start) oss << ", ";
+      oss << "(" << rows[i].get_escaped_values() << ")";
+    }
+
+    if (!exec(oss.str())) return false;
+  }
+
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// INSERT a batch of rows getting IDs - generic version with a statement
+// for each row
+bool Connection::insert_batch_returning(const string& table,
+                                        const vector<Row>& rows,
+                                        const string& id_field,
+                                        vector<uint64_t>& ids)
+{
+  for(const auto& row: rows)
+  {
+    ostringstream oss;
+    oss << "INSERT INTO " << table;
+    oss << " (" << row.get_fields() << ")";
+    oss << " VALUES (" << row.get_escaped_values() << ")";
+
+    uint64_t id = 0;
+    if (!insert_returning(oss.str(), table, id_field, id, true))
+      return false;
+    ids.push_back(id);
+  }
+
+  return true;
+}
+
 //--------------------------------------------------------------------------
 // Do an INSERT or UPDATE if it already exists (violates unique key)
 // Uses INSERT ... ON DUPLICATE KEY UPDATE
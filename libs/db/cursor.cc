@@ -0,0 +1,88 @@
+//==========================================================================
+// ObTools::DB: cursor.cc
+//
+// Generic streaming result functions, and stored results read from them
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "ot-db.h"
+#include <charconv>
+#include <stdlib.h>
+
+namespace ObTools { namespace DB {
+
+//--------------------------------------------------------------------------
+// Get index of a named column, or -1 if not found
+int ResultStream::get_column(const string& name) const
+{
+  for(auto i=0u; i<column_names.size(); i++)
+    if (column_names[i] == name) return i;
+  return -1;
+}
+
+//--------------------------------------------------------------------------
+// Get a field as an integer, from its text
+int64_t ResultStream::get_int(int col)
+{
+  const auto s = get_string_view(col);
+  int64_t value = 0;
+  from_chars(s.data(), s.data()+s.size(), value);
+  return value;
+}
+
+//--------------------------------------------------------------------------
+// Get a field as a real, from its text
+double ResultStream::get_real(int col)
+{
+  const auto s = get_string_view(col);
+  double value = 0.0;
+  from_chars(s.data(), s.data()+s.size(), value);
+  return value;
+}
+
+//==========================================================================
+// Stored result set
+
+//--------------------------------------------------------------------------
+// Constructor - reads the rest of the cursor
+StoredResultSet::StoredResultSet(Cursor& cursor):
+  column_names(cursor.get_column_names())
+{
+  while (cursor.next())
+    for(auto i=0u; i<column_names.size(); i++)
+      values.emplace_back(cursor.get_string_view(i));
+}
+
+//--------------------------------------------------------------------------
+// Get number of rows in result set
+int StoredResultSet::count()
+{
+  return column_names.empty() ? 0 : values.size() / column_names.size();
+}
+
+//--------------------------------------------------------------------------
+// Get next row from result set
+bool StoredResultSet::fetch(Row& row)
+{
+  if (column_names.empty() || next_value >= values.size()) return false;
+
+  row.clear();
+  for(const auto& name: column_names)
+    row.add(name, values[next_value++]);
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Get first value of next row from result set
+bool StoredResultSet::fetch(string& value)
+{
+  if (column_names.empty() || next_value >= values.size()) return false;
+
+  value = move(values[next_value]);
+  next_value += column_names.size();
+  return true;
+}
+
+}} // namespaces
@@ -12,6 +12,8 @@
 #define __OBTOOLS_DB_H
 
 #include <map>
+#include <vector>
+#include <string_view>
 #include <iostream>
 #include <stdint.h>
 #include "ot-time.h"
@@ -284,6 +286,13 @@ public:
       fields[fieldname] = FieldValue{};
   }
 
+  //------------------------------------------------------------------------
+  // Iterate the fields, in name order
+  map<string, FieldValue>::const_iterator begin() const
+  { return fields.begin(); }
+  map<string, FieldValue>::const_iterator end() const
+  { return fields.end(); }
+
   //------------------------------------------------------------------------
   // Finds whether the row contains a value for the given fieldname
   bool has(const string& fieldname) const
@@ -319,6 +328,10 @@ public:
   // Get string with field names in order, separated by commas and spaces
   string get_fields() const;
 
+  //------------------------------------------------------------------------
+  // Check whether another row has exactly the same field names
+  bool has_same_fields(const Row& other) const;
+
   //--------------------------------------------------------------------------
   // Get fields that are *not* in a suppressed fields row
   string get_fields_not_in(const Row& suppressed_fields) const;
@@ -411,6 +424,143 @@ public:
   bool fetch(string& value) { return rset && rset->fetch(value); }
 };
 
+//==========================================================================
+// Streaming query result (abstract)
+// Rows are read one at a time as the driver receives them, so memory is
+// constant in the size of the result.  Column names are held once for the
+// whole result, and values are accessed by column index; string views are
+// only valid until the next call to next()
+// The connection can't be used for anything else until this is destroyed
+class ResultStream
+{
+protected:
+  vector<string> column_names;
+  bool failed = false;      // Stopped on an error rather than at the end
+
+public:
+  //------------------------------------------------------------------------
+  // Get column names, in column order
+  const vector<string>& get_column_names() const { return column_names; }
+
+  //------------------------------------------------------------------------
+  // Get index of a named column, or -1 if not found
+  int get_column(const string& name) const;
+
+  //------------------------------------------------------------------------
+  // Move to next row
+  // Whether there is one - false at the end, or on error (see has_failed())
+  // and stays false after that
+  virtual bool next() = 0;
+
+  //------------------------------------------------------------------------
+  // Check whether next() returned false because of an error rather than
+  // the end of the result
+  bool has_failed() const { return failed; }
+
+  //------------------------------------------------------------------------
+  // Check whether a field in the current row is null
+  virtual bool is_null(int col) = 0;
+
+  //------------------------------------------------------------------------
+  // Get a field in the current row as a string view - empty if null
+  virtual string_view get_string_view(int col) = 0;
+
+  //------------------------------------------------------------------------
+  // Get a field in the current row as an integer - 0 if null or invalid
+  // Default parses the string view
+  virtual int64_t get_int(int col);
+
+  //------------------------------------------------------------------------
+  // Get a field in the current row as a real - 0 if null or invalid
+  // Default parses the string view
+  virtual double get_real(int col);
+
+  //------------------------------------------------------------------------
+  // Virtual destructor
+  virtual ~ResultStream() {}
+};
+
+//==========================================================================
+// Streaming query result auto-ptr wrapper
+// e.g.
+//   auto cursor = conn.stream("select id, name from users");
+//   while (cursor.next())
+//     process(cursor.get_int(0), cursor.get_string_view(1));
+class Cursor
+{
+private:
+  unique_ptr<ResultStream> stream;
+
+public:
+  //------------------------------------------------------------------------
+  // Constructors
+  Cursor() = default;                      // Invalid cursor
+  Cursor(ResultStream *s): stream{s} {}    // Valid cursor
+
+  //------------------------------------------------------------------------
+  // Handy bool cast to check for (in)validity
+  explicit operator bool() const { return stream.get(); }
+
+  //------------------------------------------------------------------------
+  // Get column names, in column order
+  const vector<string>& get_column_names() const
+  {
+    static const vector<string> none;
+    return stream ? stream->get_column_names() : none;
+  }
+
+  //------------------------------------------------------------------------
+  // Get index of a named column, or -1 if not found
+  int get_column(const string& name) const
+  { return stream ? stream->get_column(name) : -1; }
+
+  //------------------------------------------------------------------------
+  // Move to next row
+  // Whether there is one
+  bool next() { return stream && stream->next(); }
+
+  //------------------------------------------------------------------------
+  // Check whether reading stopped on an error rather than at the end
+  bool has_failed() const { return stream && stream->has_failed(); }
+
+  //------------------------------------------------------------------------
+  // Field accessors for the current row - see ResultStream
+  bool is_null(int col) { return !stream || stream->is_null(col); }
+  string_view get_string_view(int col)
+  { return stream ? stream->get_string_view(col) : string_view(); }
+  string get_string(int col) { return string(get_string_view(col)); }
+  int64_t get_int(int col) { return stream ? stream->get_int(col) : 0; }
+  double get_real(int col) { return stream ? stream->get_real(col) : 0.0; }
+};
+
+//==========================================================================
+// Result set read completely into memory from a cursor, so it doesn't
+// depend on the connection afterwards
+class StoredResultSet: public ResultSet
+{
+private:
+  vector<string> column_names;
+  vector<string> values;   // Row by row, null as empty
+  size_t next_value = 0;
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor - reads the rest of the cursor
+  StoredResultSet(Cursor& cursor);
+
+  //------------------------------------------------------------------------
+  // Get number of rows in result set
+  int count() override;
+
+  //------------------------------------------------------------------------
+  // Get next row from result set
+  bool fetch(Row& row) override;
+
+  //------------------------------------------------------------------------
+  // Get first value of next row from result set
+  bool fetch(string& value) override;
+};
+
 //==========================================================================
 // Abstract Prepared Statement
 class PreparedStatement: public ResultSet
@@ -811,6 +961,12 @@ public:
   // Returns result - check this for validity
   virtual Statement prepare(const string& sql) = 0;
 
+  //------------------------------------------------------------------------
+  // Execute a query and stream the result row by row (e.g. a large SELECT)
+  // Returns cursor - check this for validity
+  // Default returns an invalid cursor, for drivers which can't stream
+  virtual Cursor stream(const string& sql);
+
   //------------------------------------------------------------------------
   // Gets the last insert id
   virtual uint64_t get_last_insert_id() = 0;
@@ -847,10 +1003,57 @@ public:
   // Expression to get current datetime in UTC
   virtual string utc_timestamp() = 0;
 
+  //------------------------------------------------------------------------
+  // Execute an INSERT of a single row and get the ID generated in id_field
+  // Returns whether successful - id is filled in if so
+  // Default takes max(id_field) in a transaction, which is only right if
+  // there are no other writers - drivers override it with something better
+  virtual bool insert_returning(const string& sql, const string& table,
+                                const string& id_field, uint64_t& id,
+                                bool in_transaction);
+
+  //------------------------------------------------------------------------
+  // Run a number of queries, getting results which don't depend on the
+  // connection afterwards, so it can be released before they are read
+  // results is filled in with one for each query, invalid if it failed
+  // Default reads each stream() into memory - drivers which can send them
+  // all before reading the results override it
+  virtual void query_batch(const vector<string>& sqls,
+                           vector<Result>& results);
+
+  //------------------------------------------------------------------------
+  // INSERT a batch of rows, all with the same fields, in the fastest way the
+  // driver has, without getting IDs back
+  // Doesn't create its own transaction
+  // Returns whether successful
+  // Default uses multi-row INSERT statements
+  virtual bool insert_batch(const string& table, const vector<Row>& rows);
+
+  //------------------------------------------------------------------------
+  // INSERT a batch of rows, all with the same fields, and get the IDs
+  // generated in id_field, in row order
+  // Doesn't create its own transaction
+  // Returns whether successful - ids is filled in if so
+  // Default inserts one row per statement with insert_returning(), since
+  // the order of IDs from a multi-row INSERT isn't reliable in general -
+  // drivers which can get them in order override it
+  virtual bool insert_batch_returning(const string& table,
+                                      const vector<Row>& rows,
+                                      const string& id_field,
+                                      vector<uint64_t>& ids);
+
   //------------------------------------------------------------------------
   // Virtual destructor
   virtual ~Connection() {}
 
+protected:
+  //------------------------------------------------------------------------
+  // insert_returning() for drivers supporting INSERT ... RETURNING
+  // Adds the clause unless the SQL already has one
+  bool insert_with_returning_clause(const string& sql,
+                                    const string& id_field, uint64_t& id);
+
+public:
   //========================================================================
   // Helper functions implemented in connection.cc
 
@@ -895,9 +1098,9 @@ public:
   bool query_bool(const string& sql, bool def=false);
 
   //------------------------------------------------------------------------
-  // Do an INSERT and retrieve the last inserted (max) automatic ID
+  // Do an INSERT and retrieve the last inserted automatic ID
   // Returns ID, or 0 if failed
-  // Fetches max(<id_field>) inside a transaction, unless id_field is ""
+  // Gets the ID with insert_returning(), unless id_field is ""
   // If id_field is "", does a normal insert and returns 1
   // Set in_transaction only if you're already doing a transaction; by
   // default this function may create its own
@@ -922,6 +1125,18 @@ public:
   uint64_t insert64(const string& table, Row& row, const string& id_field="id",
                     bool in_transaction=false);
 
+  //------------------------------------------------------------------------
+  // INSERT a number of rows, all with the same fields, and get the generated
+  // IDs in id_field, in row order
+  // Rows are inserted with insert_batch_returning(), or if id_field is ""
+  // (when ids is left empty), with insert_batch()
+  // Creates its own transaction for more than one row, unless
+  // in_transaction is set
+  // Returns whether successful - ids is filled in if so
+  bool insert_many(const string& table, const vector<Row>& rows,
+                   vector<uint64_t>& ids, const string& id_field="id",
+                   bool in_transaction=false);
+
   //--------------------------------------------------------------------------
   // Do an INSERT or UPDATE if it already exists (violates unique key)
   // Uses INSERT ... ON DUPLICATE KEY UPDATE
@@ -1210,8 +1425,43 @@ class ConnectionPool: MT::Thread
   map<Connection *, Time::Stamp> last_used;
   Time::Duration reap_interval{1.0};
 
+  // Asynchronous queries, run by a set of threads started on first use
+  struct AsyncQuery
+  {
+    string sql;
+    promise<Result> result;              // Either this...
+    function<void(Result&)> callback;    // ... or this is used
+  };
+  class AsyncThread: public MT::Thread
+  {
+    ConnectionPool& pool;
+    void run() override { pool.run_async(); }
+  public:
+    AsyncThread(ConnectionPool& _pool): pool(_pool) { start(); }
+  };
+  unique_ptr<MT::BoundedQueue<shared_ptr<AsyncQuery>>> async_queue;
+  vector<unique_ptr<AsyncThread>> async_threads;
+  unsigned num_async_threads = 2;
+  unsigned max_pipeline = 16;
+  atomic<uint64_t> async_completed{0};
+
+  // Statistics (in mutex)
+  uint64_t claims = 0;
+  uint64_t waits = 0;
+  uint64_t failed_claims = 0;
+  Time::Duration total_wait;
+  Time::Duration max_wait;
+  unsigned peak_in_use = 0;
+  Time::Stamp usage_updated = Time::Stamp::now();
+  double busy_seconds = 0.0;   // Integral of connections in use
+  double open_seconds = 0.0;   // Integral of connections open
+
   // Internals
   void fill_to_minimum();
+  void update_usage();
+  void record_claim(bool ok);
+  void queue_async(shared_ptr<AsyncQuery> query);
+  void run_async();
 
   //------------------------------------------------------------------------
   // Run background timeout loop (called from internal thread)
@@ -1255,6 +1505,56 @@ public:
   unsigned num_in_use() const
   { MT::Lock lock(mutex); return connections.size()-available.size(); }
 
+  //------------------------------------------------------------------------
+  // Set the number of threads running asynchronous queries, and the most
+  // queries each sends on a connection at once - before the first one
+  void set_async_threads(unsigned n) { num_async_threads = max(n, 1u); }
+  void set_max_pipeline(unsigned n) { max_pipeline = max(n, 1u); }
+
+  //------------------------------------------------------------------------
+  // Run a query asynchronously, on a connection from the pool
+  // Queries waiting are sent together where the driver can (see
+  // Connection::query_batch()), so many can share a few connections
+  // Returns a future for the result - invalid if it failed
+  future<Result> query_async(const string& sql);
+
+  //------------------------------------------------------------------------
+  // Run a query asynchronously and call back with the result, which is
+  // invalid if it failed
+  // The callback is called on an internal thread, and must not block
+  void query_async(const string& sql,
+                   const function<void(Result& result)>& callback);
+
+  //------------------------------------------------------------------------
+  // Statistics
+  struct Stats
+  {
+    unsigned connections = 0;      // Now open
+    unsigned in_use = 0;           // Now claimed
+    unsigned peak_in_use = 0;      // Most claimed at once
+    uint64_t claims = 0;           // Successful claims
+    uint64_t waits = 0;            // Claims which had to wait for a release
+    uint64_t failed_claims = 0;    // Including timed out waits
+    Time::Duration total_wait;     // Time spent waiting
+    Time::Duration max_wait;       // Longest wait
+    double utilisation = 0.0;      // Mean fraction of open connections in use
+    size_t async_waiting = 0;      // Asynchronous queries not yet sent
+    uint64_t async_completed = 0;  // Asynchronous queries done
+
+    // Mean wait of those which waited
+    Time::Duration mean_wait() const
+    { return waits ? total_wait / static_cast<double>(waits)
+                   : Time::Duration(); }
+  };
+
+  //------------------------------------------------------------------------
+  // Get statistics since creation or the last reset
+  Stats get_stats() const;
+
+  //------------------------------------------------------------------------
+  // Reset statistics
+  void reset_stats();
+
   //------------------------------------------------------------------------
   // Destructor
   ~ConnectionPool();
@@ -1501,6 +1801,73 @@ public:
   ~Transaction();
 };
 
+//==========================================================================
+// Bulk writer - INSERTs rows into a table in batches with the connection's
+// insert_batch(), so only one batch is held at a time.  All rows must have
+// the same fields.  By default runs in a transaction which finish() commits
+// and which is rolled back if it is destroyed without
+// e.g.
+//   DB::BulkWriter writer(conn, "readings");
+//   while (...) writer.write(row);
+//   if (!writer.finish()) ...
+class BulkWriter
+{
+private:
+  Connection *conn;
+  string table;
+  size_t batch_size;
+  vector<Row> batch;
+  bool in_transaction = false;
+  bool failed = false;
+  uint64_t written = 0;
+
+  BulkWriter(Connection *_conn, const string& _table, size_t _batch_size,
+             bool transaction);
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor from plain connection
+  BulkWriter(Connection& _conn, const string& _table,
+             size_t _batch_size = 1000, bool transaction = true);
+
+  //------------------------------------------------------------------------
+  // Constructor from AutoConnection
+  BulkWriter(AutoConnection& _conn, const string& _table,
+             size_t _batch_size = 1000, bool transaction = true);
+
+  // Not copyable - a copy would roll back the transaction again
+  BulkWriter(const BulkWriter&) = delete;
+  BulkWriter& operator=(const BulkWriter&) = delete;
+
+  //------------------------------------------------------------------------
+  // Check whether everything has worked so far
+  explicit operator bool() const { return !failed; }
+
+  //------------------------------------------------------------------------
+  // Add a row, writing the batch if it is full
+  // Returns whether successful
+  bool write(const Row& row);
+  bool write(Row&& row);
+
+  //------------------------------------------------------------------------
+  // Write any rows held
+  // Returns whether successful
+  bool flush();
+
+  //------------------------------------------------------------------------
+  // Write any rows held and commit the transaction, if any
+  // Returns whether successful
+  bool finish();
+
+  //------------------------------------------------------------------------
+  // Get number of rows written so far
+  uint64_t get_written() const { return written; }
+
+  //------------------------------------------------------------------------
+  // Destructor - rolls back the transaction if not finished
+  ~BulkWriter();
+};
+
 //==========================================================================
 }} //namespaces
 #endif // !__OBTOOLS_DB_H
@@ -13,6 +13,12 @@
 
 namespace ObTools { namespace DB {
 
+namespace
+{
+  // Most asynchronous queries waiting before query_async() blocks
+  const size_t async_queue_size = 4096;
+}
+
 //--------------------------------------------------------------------------
 // Constructor
 ConnectionPool::ConnectionPool(ConnectionFactory& _factory,
@@ -83,6 +89,7 @@ Connection *ConnectionPool::claim()
   {
     MT::Lock lock(mutex);
     Connection *conn;
+    update_usage();
 
     // Check if we have one available
     while (available.size())
@@ -94,6 +101,7 @@ Connection *ConnectionPool::claim()
       if (*conn)
       {
         last_used[conn] = Time::Stamp::now();
+        record_claim(true);
         OBTOOLS_LOG_IF_DEBUG(log.debug << "Database connection claimed - "
                              << connections.size() << " total, "
                              << available.size() << " available\n";)
@@ -119,18 +127,17 @@ Connection *ConnectionPool::claim()
         {
           connections.push_back(conn);
           last_used[conn] = Time::Stamp::now();
+          record_claim(true);
 
           OBTOOLS_LOG_IF_DEBUG(log.debug << "New database connection created - "
                                << "now "<< connections.size() << " in total\n";)
           return conn;
         }
-        else
-        {
-          delete conn;
-          return 0;
-        }
+        else delete conn;
       }
-      else return 0;
+
+      record_claim(false);
+      return 0;
     }
   } // out of mutex
 
@@ -145,6 +152,15 @@ Connection *ConnectionPool::claim()
 
   pr->available.wait();
 
+  {
+    MT::Lock lock(mutex);
+    const auto wait = Time::Stamp::now() - pr->started;
+    waits++;
+    total_wait += wait;
+    if (wait > max_wait) max_wait = wait;
+    record_claim(pr->connection);
+  }
+
   if (pr->connection)
     log.summary << "Database connection returned - unblocking waiting request\n";
   else
@@ -157,6 +173,7 @@ Connection *ConnectionPool::claim()
 void ConnectionPool::release(Connection *conn)
 {
   MT::Lock lock(mutex);
+  update_usage();
 
   // Check if any pending requests could use it
   if (pending_requests.size())
@@ -197,6 +214,7 @@ void ConnectionPool::run()
     { // Not inside sleep
       MT::Lock lock(mutex);
       Time::Stamp now = Time::Stamp::now();
+      update_usage();
 
       // Look for idle connections which have died
       // Note:  We only check available (idle) connections because
@@ -270,10 +288,185 @@ void ConnectionPool::run()
   }
 }
 
+//--------------------------------------------------------------------------
+// Accumulate connection usage up to now (call within mutex)
+void ConnectionPool::update_usage()
+{
+  const auto now = Time::Stamp::now();
+  const auto dt = (now - usage_updated).seconds();
+  busy_seconds += dt * (connections.size() - available.size());
+  open_seconds += dt * connections.size();
+  usage_updated = now;
+}
+
+//--------------------------------------------------------------------------
+// Record a claim (call within mutex)
+void ConnectionPool::record_claim(bool ok)
+{
+  if (!ok)
+  {
+    failed_claims++;
+    return;
+  }
+
+  claims++;
+  peak_in_use = max(peak_in_use,
+                    static_cast<unsigned>(connections.size()
+                                          - available.size()));
+}
+
+//--------------------------------------------------------------------------
+// Get statistics
+ConnectionPool::Stats ConnectionPool::get_stats() const
+{
+  MT::Lock lock(mutex);
+  Stats stats;
+  stats.connections = connections.size();
+  stats.in_use = connections.size() - available.size();
+  stats.peak_in_use = peak_in_use;
+  stats.claims = claims;
+  stats.waits = waits;
+  stats.failed_claims = failed_claims;
+  stats.total_wait = total_wait;
+  stats.max_wait = max_wait;
+
+  // Including the time since the last change
+  const auto dt = (Time::Stamp::now() - usage_updated).seconds();
+  const auto busy = busy_seconds + dt * stats.in_use;
+  const auto open = open_seconds + dt * stats.connections;
+  if (open > 0) stats.utilisation = busy / open;
+
+  stats.async_waiting = async_queue ? async_queue->waiting() : 0;
+  stats.async_completed = async_completed;
+  return stats;
+}
+
+//--------------------------------------------------------------------------
+// Reset statistics
+void ConnectionPool::reset_stats()
+{
+  MT::Lock lock(mutex);
+  claims = waits = failed_claims = 0;
+  total_wait = max_wait = Time::Duration();
+  peak_in_use = connections.size() - available.size();
+  usage_updated = Time::Stamp::now();
+  busy_seconds = open_seconds = 0.0;
+  async_completed = 0;
+}
+
+//--------------------------------------------------------------------------
+// Run a query asynchronously, returning a future
+future<Result> ConnectionPool::query_async(const string& sql)
+{
+  auto query = make_shared<AsyncQuery>();
+  query->sql = sql;
+  auto result = query->result.get_future();
+  queue_async(query);
+  return result;
+}
+
+//--------------------------------------------------------------------------
+// Run a query asynchronously, calling back with the result
+void ConnectionPool::query_async(const string& sql,
+                                 const function<void(Result&)>& callback)
+{
+  auto query = make_shared<AsyncQuery>();
+  query->sql = sql;
+  query->callback = callback;
+  queue_async(query);
+}
+
+//--------------------------------------------------------------------------
+// Queue an asynchronous query, starting the threads if not yet done
+void ConnectionPool::queue_async(shared_ptr<AsyncQuery> query)
+{
+  {
+    MT::Lock lock(mutex);
+    if (!async_queue)
+    {
+      async_queue.reset(new MT::BoundedQueue<shared_ptr<AsyncQuery>>(
+                          async_queue_size));
+      for(auto i=0u; i<num_async_threads; i++)
+        async_threads.emplace_back(new AsyncThread(*this));
+    }
+  }
+
+  async_queue->send(move(query));  // Blocks if full
+}
+
+//--------------------------------------------------------------------------
+// Run asynchronous queries (called from internal threads)
+// Takes as many as are waiting, up to max_pipeline, and runs them together
+// on one connection
+void ConnectionPool::run_async()
+{
+  vector<shared_ptr<AsyncQuery>> batch;
+  vector<string> sqls;
+  vector<Result> results;
+
+  for(;;)
+  {
+    auto query = async_queue->wait();
+    if (!query) break;  // Shutting down
+
+    batch.clear();
+    batch.push_back(move(query));
+    while (batch.size() < max_pipeline && async_queue->try_receive(query))
+    {
+      if (!query)
+      {
+        async_queue->send(nullptr);  // Put it back for after this batch
+        break;
+      }
+      batch.push_back(move(query));
+    }
+
+    sqls.clear();
+    for(const auto& q: batch) sqls.push_back(q->sql);
+
+    results.clear();
+    auto conn = claim();
+    if (conn)
+    {
+      conn->query_batch(sqls, results);
+      release(conn);
+    }
+    results.resize(batch.size());
+
+    for(auto i=0u; i<batch.size(); i++)
+    {
+      auto& q = *batch[i];
+      async_completed++;  // Before anyone sees it
+      if (q.callback)
+      {
+        try
+        {
+          q.callback(results[i]);
+        }
+        catch (const exception& e)
+        {
+          Log::Error log;
+          log << "Exception in database query callback: " << e.what()
+              << endl;
+        }
+      }
+      else q.result.set_value(move(results[i]));
+    }
+  }
+}
+
 //--------------------------------------------------------------------------
 // Destructor
 ConnectionPool::~ConnectionPool()
 {
+  // Finish asynchronous queries first, since they need connections
+  if (async_queue)
+  {
+    for(auto i=0u; i<async_threads.size(); i++)
+      async_queue->send(nullptr);
+    for(auto& t: async_threads) t->join();
+  }
+
   cancel();
   join();
 
@@ -84,6 +84,17 @@ string Row::get_fields() const
   return result;
 }
 
+//--------------------------------------------------------------------------
+// Check whether another row has exactly the same field names
+bool Row::has_same_fields(const Row& other) const
+{
+  if (fields.size() != other.fields.size()) return false;
+  for(auto p = fields.begin(), q = other.fields.begin(); p!=fields.end();
+      ++p, ++q)
+    if (p->first != q->first) return false;
+  return true;
+}
+
 //--------------------------------------------------------------------------
 // Get fields that are *not* in a suppressed fields row
 string Row::get_fields_not_in(const Row& suppressed_fields) const
@@ -15,6 +15,19 @@ using namespace std;
 using namespace ObTools;
 using namespace ObTools::DB;
 
+// Fake streamed result, with one row giving the SQL
+class FakeStream: public ResultStream
+{
+  string sql;
+  bool done = false;
+
+public:
+  FakeStream(const string& _sql): sql(_sql) { column_names.push_back("sql"); }
+  bool next() override { return !done && (done = true); }
+  bool is_null(int) override { return false; }
+  string_view get_string_view(int) override { return sql; }
+};
+
 // Fake connection
 class FakeConnection: public Connection
 {
@@ -31,6 +44,8 @@ public:
   bool exec(const string&) override { return true; }
   Result query(const string&) override { return Result(); }
   Statement prepare(const string&) override { return Statement(); }
+  Cursor stream(const string& sql) override
+  { return sql == "fail" ? Cursor() : Cursor(new FakeStream(sql)); }
   uint64_t get_last_insert_id() override { return 0; }
   string utc_timestamp() override { return "utc_timestamp()"; }
 
@@ -206,6 +221,79 @@ TEST(DatabasePool, TestTimeoutOfBlockedClaims)
   ASSERT_TRUE(!conn2);  // Should fail after 1 second
 }
 
+TEST(DatabasePool, TestStatsCountWaitsAndUtilisation)
+{
+  FakeConnectionFactory factory;
+  ConnectionPool pool(factory, 1, 1, Time::Duration(5));
+  Connection *conn1 = pool.claim();
+  ASSERT_TRUE(!!conn1);
+
+  thread releaser([&pool, conn1]()
+  {
+    this_thread::sleep_for(chrono::milliseconds(200));
+    pool.release(conn1);
+  });
+  Connection *conn2 = pool.claim();
+  ASSERT_TRUE(!!conn2);
+  releaser.join();
+
+  auto stats = pool.get_stats();
+  EXPECT_EQ(1, stats.connections);
+  EXPECT_EQ(1, stats.in_use);
+  EXPECT_EQ(1, stats.peak_in_use);
+  EXPECT_EQ(2, stats.claims);
+  EXPECT_EQ(1, stats.waits);
+  EXPECT_EQ(0, stats.failed_claims);
+  EXPECT_LE(0.15, stats.max_wait.seconds());
+  EXPECT_EQ(stats.max_wait, stats.mean_wait());
+  EXPECT_LT(0.9, stats.utilisation);  // Always in use
+
+  pool.release(conn2);
+  pool.reset_stats();
+  this_thread::sleep_for(chrono::milliseconds(50));
+  stats = pool.get_stats();
+  EXPECT_EQ(0, stats.claims);
+  EXPECT_EQ(0, stats.peak_in_use);
+  EXPECT_EQ(0.0, stats.utilisation);  // Never in use
+}
+
+TEST(DatabasePool, TestAsyncQueries)
+{
+  FakeConnectionFactory factory;
+  ConnectionPool pool(factory, 1, 2, Time::Duration(5));
+  vector<future<Result>> futures;
+  for(auto i=0; i<100; i++)
+    futures.push_back(pool.query_async("select " + to_string(i)));
+
+  MT::Condition called;
+  string value;
+  pool.query_async("select x", [&called, &value](Result& result)
+  {
+    result.fetch(value);
+    called.signal();
+  });
+
+  for(auto i=0; i<100; i++)
+  {
+    auto result = futures[i].get();
+    ASSERT_TRUE(!!result);
+    EXPECT_EQ(1, result.count());
+    string v;
+    ASSERT_TRUE(result.fetch(v));
+    EXPECT_EQ("select " + to_string(i), v);
+    EXPECT_FALSE(result.fetch(v));
+  }
+
+  called.wait();
+  EXPECT_EQ("select x", value);
+  EXPECT_FALSE(!!pool.query_async("fail").get());
+
+  auto stats = pool.get_stats();
+  EXPECT_EQ(102, stats.async_completed);
+  EXPECT_EQ(0, stats.async_waiting);
+  EXPECT_GE(2, stats.connections);
+}
+
 int main(int argc, char **argv)
 {
   if (argc > 1 && string(argv[1]) == "-v")
@@ -0,0 +1,135 @@
+//==========================================================================
+// ObTools::Huffman: decoder.cc
+//
+// Compiled table-driven decoders for Tree and MultiTree
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "ot-huffman.h"
+
+namespace ObTools { namespace Huffman {
+
+namespace
+{
+  // Get the depth of the deepest leaf below a node
+  unsigned get_depth(const Node& node)
+  {
+    if (node.is_leaf()) return 0;
+    auto depth = 0u;
+    for(const auto bit: {false, true})
+    {
+      const auto child = node.get_node(bit);
+      if (child) depth = max(depth, 1 + get_depth(*child));
+    }
+    return depth;
+  }
+}
+
+//==========================================================================
+// Decoder
+
+//--------------------------------------------------------------------------
+// Constructor
+Decoder::Decoder(const Tree& tree, unsigned table_bits)
+{
+  // Tree's root isn't accessible, so make one from its children
+  Node root;
+  for(const auto bit: {false, true})
+    if (tree.get_node(bit)) root.set_node(bit, *tree.get_node(bit));
+
+  const auto depth = get_depth(root);
+  if (!depth) return;
+  table_bits = max(1u, min(table_bits, max_table_bits));
+  root_bits = min(table_bits, depth);
+  build_table(root, root_bits);
+}
+
+//--------------------------------------------------------------------------
+// Build a table of the given bits for codes below a node, and any
+// sub-tables it needs.  Returns the table's offset
+size_t Decoder::build_table(const Node& node, unsigned bits)
+{
+  const auto offset = entries.size();
+  const auto size = 1u << bits;
+  entries.resize(offset + size);
+
+  // Fill each entry by walking its bits
+  for(auto i=0u; i<size; i++)
+  {
+    const Node *n = &node;
+    auto used = 0u;
+    while (used < bits && n && !n->is_leaf())
+      n = n->get_node((i >> (bits - ++used)) & 1);
+    if (!n) continue;  // invalid
+
+    if (n->is_leaf())
+    {
+      auto& entry = entries[offset + i];
+      entry.type = Type::leaf;
+      entry.bits = used;
+      entry.data = index_of(n->get_value());
+    }
+    else
+    {
+      // Longer code - needs a sub-table, unless it's a dead end
+      const auto sub_bits = min(bits, get_depth(*n));
+      if (!sub_bits) continue;
+      const auto sub = build_table(*n, sub_bits);
+      auto& entry = entries[offset + i];  // May have moved
+      entry.type = Type::table;
+      entry.bits = sub_bits;
+      entry.data = sub;
+    }
+  }
+  return offset;
+}
+
+//==========================================================================
+// MultiDecoder
+
+//--------------------------------------------------------------------------
+// Constructor
+MultiDecoder::MultiDecoder(const MultiTree& tree, unsigned table_bits):
+  decoders(Decoder::num_values)
+{
+  for(const auto& p: tree.get_trees())
+    decoders[Decoder::index_of(p.first)] = Decoder(p.second, table_bits);
+}
+
+//--------------------------------------------------------------------------
+// Decode a string from a byte buffer
+bool MultiDecoder::decode_string(const unsigned char *data, size_t length,
+                                 string& s) const
+{
+  static const auto stop = Decoder::index_of(Value(Value::Special::stop));
+  static const auto escape = Decoder::index_of(Value(Value::Special::escape));
+
+  BitBuffer buffer(data, length);
+  auto index = Decoder::index_of(Value(Value::Special::start));
+  while (decoders[index].read_index(buffer, index))
+  {
+    if (index < 256)
+      s.push_back(static_cast<char>(index));
+    else if (index == stop)
+      break;
+    else if (index == escape)
+    {
+      // Escaped data is read 8 bits at a time until an ASCII (0-127)
+      // character is read, then huffman decoding begins again
+      unsigned char c;
+      do
+      {
+        if (buffer.remaining() < 8) return true;
+        c = buffer.peek(8);
+        buffer.skip(8);
+        s.push_back(c);
+      } while (c & 0x80);
+      index = c;
+    }
+  }
+  return true;
+}
+
+}} // namespaces
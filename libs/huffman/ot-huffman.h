@@ -13,6 +13,7 @@
 
 #include <map>
 #include <memory>
+#include <vector>
 #include "ot-chan.h"
 #include "ot-gen.h"
 
@@ -294,6 +295,169 @@ public:
   //------------------------------------------------------------------------
   // Read a string from a BitReader
   bool read_string(Channel::BitReader& reader, string& s) const;
+
+  //------------------------------------------------------------------------
+  // Get the trees, by previous value
+  const map<Value, Tree>& get_trees() const { return trees; }
+};
+
+//==========================================================================
+// Bit buffer - reads bits MSB first from a byte buffer, for decoders
+class BitBuffer
+{
+private:
+  const unsigned char *data;
+  size_t length;   // bytes
+  size_t pos{0};   // bits
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor
+  BitBuffer(const unsigned char *_data, size_t _length):
+    data(_data), length(_length) {}
+
+  //------------------------------------------------------------------------
+  // Get number of bits left
+  size_t remaining() const { return length*8 - pos; }
+
+  //------------------------------------------------------------------------
+  // Look at the next n (1-24) bits without consuming them, padded with
+  // zeros past the end
+  uint32_t peek(unsigned n) const
+  {
+    const auto byte = pos >> 3;
+    uint32_t word = 0;
+    for(auto i=0u; i<4; i++)
+      word = (word << 8) | (byte+i < length ? data[byte+i] : 0);
+    return (word << (pos & 7)) >> (32-n);
+  }
+
+  //------------------------------------------------------------------------
+  // Consume n bits
+  void skip(unsigned n) { pos += n; }
+};
+
+//==========================================================================
+// Compiled decoder for a Tree (decoder.cc)
+// Decodes table_bits at a time through lookup tables, with sub-tables for
+// longer codes, rather than walking the tree bit by bit
+class Decoder
+{
+public:
+  static constexpr unsigned default_table_bits = 8;
+  static constexpr unsigned max_table_bits = 16;
+
+private:
+  enum class Type: uint8_t
+  {
+    invalid,
+    leaf,
+    table
+  };
+
+  struct Entry
+  {
+    uint32_t data{0};   // Value index for leaf, table offset for table
+    uint8_t bits{0};    // Code bits used for leaf, table bits for table
+    Type type{Type::invalid};
+  };
+
+  vector<Entry> entries;  // All tables, root first
+  unsigned root_bits{0};
+
+  size_t build_table(const Node& node, unsigned bits);
+
+public:
+  //------------------------------------------------------------------------
+  // Value index used in tables - chars, then specials
+  static constexpr unsigned num_values = 256 + 4;
+  static unsigned index_of(const Value& value)
+  {
+    return value.is_special()
+      ? 256 + static_cast<unsigned>(value.get_special_value())
+      : value.get_value();
+  }
+  static Value value_of(unsigned index)
+  {
+    return index < 256 ? Value(static_cast<unsigned char>(index))
+      : Value(static_cast<Value::Special>(index - 256));
+  }
+
+  //------------------------------------------------------------------------
+  // Constructors - an empty decoder never decodes anything
+  Decoder() {}
+  Decoder(const Tree& tree, unsigned table_bits = default_table_bits);
+
+  //------------------------------------------------------------------------
+  // Check whether the decoder has a tree
+  bool operator!() const { return entries.empty(); }
+
+  //------------------------------------------------------------------------
+  // Read the index of a value from a bit buffer
+  // Returns false if no valid code or not enough data
+  bool read_index(BitBuffer& buffer, unsigned& index) const
+  {
+    if (entries.empty()) return false;
+    auto offset = 0u;
+    auto bits = root_bits;
+    for(;;)
+    {
+      const auto& entry = entries[offset + buffer.peek(bits)];
+      switch (entry.type)
+      {
+        case Type::leaf:
+          if (entry.bits > buffer.remaining()) return false;
+          buffer.skip(entry.bits);
+          index = entry.data;
+          return true;
+
+        case Type::table:
+          if (bits > buffer.remaining()) return false;
+          buffer.skip(bits);
+          offset = entry.data;
+          bits = entry.bits;
+          break;
+
+        default:
+          return false;
+      }
+    }
+  }
+
+  //------------------------------------------------------------------------
+  // Read a value from a bit buffer, as read_index()
+  bool read_value(BitBuffer& buffer, Value& value) const
+  {
+    unsigned index;
+    if (!read_index(buffer, index)) return false;
+    value = value_of(index);
+    return true;
+  }
+};
+
+//==========================================================================
+// Compiled decoder for a MultiTree (decoder.cc)
+// Holds a Decoder for each previous value in a flat array
+class MultiDecoder
+{
+private:
+  vector<Decoder> decoders;  // By Decoder::index_of(previous value)
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor
+  MultiDecoder(const MultiTree& tree,
+               unsigned table_bits = Decoder::default_table_bits);
+
+  //------------------------------------------------------------------------
+  // Decode a string from a byte buffer, as MultiTree::read_string()
+  bool decode_string(const unsigned char *data, size_t length,
+                     string& s) const;
+  bool decode_string(const string& data, string& s) const
+  {
+    return decode_string(reinterpret_cast<const unsigned char *>(
+                           data.data()), data.size(), s);
+  }
 };
 
 //==========================================================================
@@ -0,0 +1,314 @@
+//==========================================================================
+// ObTools::Huffman: test-decoder.cc
+//
+// Test harness for compiled Huffman decoders, including a benchmark
+// against tree walking
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include <gtest/gtest.h>
+#include "ot-huffman.h"
+#include "ot-text.h"
+#include <chrono>
+#include <random>
+#include <queue>
+
+const auto mapping = R"(START:00:T:
+p:101:ESCAPE:
+x:01:0x3a:
+START:01:a:
+a:0110:b:
+b:1011:c:
+c:00:STOP:
+c:01:d:
+d:1:ESCAPE:
+f:011:g:
+g:0:STOP:
+)";
+
+using namespace std;
+using namespace ObTools;
+
+namespace {
+Huffman::MultiTree make_tree(const string& text)
+{
+  istringstream is(text);
+  Huffman::MultiReader mr(is);
+  Huffman::MultiTree tree;
+  tree.populate_from(mr);
+  return tree;
+}
+
+string read_string(const Huffman::MultiTree& tree, const string& data)
+{
+  Channel::BlockReader blr(
+    reinterpret_cast<const unsigned char *>(data.data()), data.size());
+  Channel::BitReader br(blr);
+  string s;
+  tree.read_string(br, s);
+  return s;
+}
+
+string decode_string(const Huffman::MultiDecoder& decoder,
+                     const string& data)
+{
+  string s;
+  decoder.decode_string(data, s);
+  return s;
+}
+
+//--------------------------------------------------------------------------
+// Generator of EPG-like text, with Huffman codes per previous character
+// built from it, and an encoder using them
+class Generator
+{
+  mt19937 rng{42};
+  map<string, map<string, vector<bool>>> codes;  // prev -> value -> code
+
+  static string name(unsigned char c)
+  {
+    return Text::itox(c).size() == 1 ? "0x0" + Text::itox(c)
+      : "0x" + Text::itox(c);
+  }
+
+  static string name(const string& s)
+  {
+    return s.size() == 1 ? name(static_cast<unsigned char>(s[0])) : s;
+  }
+
+  void add_codes(const string& prev, const map<string, unsigned>& counts)
+  {
+    struct Item
+    {
+      unsigned count;
+      vector<string> values;
+      bool operator<(const Item& o) const { return count > o.count; }
+    };
+    priority_queue<Item> q;
+    for(const auto& p: counts) q.push({p.second, {p.first}});
+    auto& context = codes[prev];
+    while (q.size() > 1)
+    {
+      auto a = q.top(); q.pop();
+      auto b = q.top(); q.pop();
+      for(const auto& v: a.values) context[v].insert(context[v].begin(), 0);
+      for(const auto& v: b.values) context[v].insert(context[v].begin(), 1);
+      a.values.insert(a.values.end(), b.values.begin(), b.values.end());
+      q.push({a.count + b.count, a.values});
+    }
+  }
+
+  void write(Channel::BitWriter& bw, const string& prev, const string& value)
+  {
+    for(const auto bit: codes[prev][value]) bw.write_bit(bit);
+  }
+
+public:
+  vector<string> texts;
+
+  Generator(int n)
+  {
+    const vector<string> words{"the", "news", "and", "weather", "film",
+      "drama", "series", "of", "in", "a", "with", "comedy", "live",
+      "football", "documentary", "presents", "new", "caf\xc3\xa9",
+      "episode", "Followed", "by", "The", "At", "Home", "wildlife"};
+    map<string, map<string, unsigned>> counts;
+    for(auto i=0; i<n; i++)
+    {
+      string text;
+      const auto length = 5 + rng() % 30;
+      for(auto j=0u; j<length; j++)
+      {
+        if (j) text += (rng() % 8) ? " " : ", ";
+        text += words[rng() % words.size()];
+      }
+      text += ".";
+      texts.push_back(text);
+
+      string prev = "START";
+      for(auto j=0u; j<text.size(); j++)
+      {
+        if (text[j] & 0x80)
+        {
+          // Escaped through to the next ASCII char
+          counts[prev]["ESCAPE"]++;
+          while (text[j] & 0x80) j++;
+        }
+        else counts[prev][string(1, text[j])]++;
+        prev = string(1, text[j]);
+      }
+      counts[prev]["STOP"]++;
+    }
+    for(auto& p: counts)
+    {
+      // Every context can stop or escape, which also means none has
+      // only one value
+      p.second["STOP"]++;
+      p.second["ESCAPE"]++;
+      add_codes(p.first, p.second);
+    }
+  }
+
+  // Get the mappings in MultiReader format
+  string get_mappings()
+  {
+    string text;
+    for(const auto& c: codes)
+      for(const auto& v: c.second)
+      {
+        text += name(c.first) + ":";
+        for(const auto bit: v.second) text += bit ? '1' : '0';
+        text += ":" + name(v.first) + ":\n";
+      }
+    return text;
+  }
+
+  // Encode a text
+  string encode(const string& text)
+  {
+    vector<unsigned char> data(text.size() * 4 + 16);
+    Channel::BlockWriter blw(&data[0], data.size());
+    Channel::BitWriter bw(blw);
+    string prev = "START";
+    for(auto j=0u; j<text.size(); j++)
+    {
+      if (text[j] & 0x80)
+      {
+        write(bw, prev, "ESCAPE");
+        for(; text[j] & 0x80; j++) bw.write_bits(8, text[j]);
+        bw.write_bits(8, text[j]);
+      }
+      else write(bw, prev, string(1, text[j]));
+      prev = string(1, text[j]);
+    }
+    write(bw, prev, "STOP");
+    bw.write_bits(7, 0);  // Flush last byte
+    return string(reinterpret_cast<const char *>(&data[0]),
+                  blw.get_offset());
+  }
+};
+}
+
+//--------------------------------------------------------------------------
+// Tests
+TEST(DecoderTest, TestSingleTreeDecode)
+{
+  Huffman::Tree tree;
+  Huffman::Node node1;
+  node1.set_node(false, Huffman::Node('a'));
+  node1.set_node(true, Huffman::Node('b'));
+  tree.set_node(false, node1);
+  tree.set_node(true, Huffman::Node('c'));
+
+  for(const auto bits: {1u, 2u, 8u})
+  {
+    Huffman::Decoder decoder(tree, bits);
+    const unsigned char data[] = { 0x1c };  // 00-a 01-b 1-c 100-?
+    Huffman::BitBuffer buffer(data, 1);
+    Huffman::Value a, b, c, d;
+    ASSERT_TRUE(decoder.read_value(buffer, a));
+    ASSERT_TRUE(decoder.read_value(buffer, b));
+    ASSERT_TRUE(decoder.read_value(buffer, c));
+    EXPECT_EQ(Huffman::Value('a'), a);
+    EXPECT_EQ(Huffman::Value('b'), b);
+    EXPECT_EQ(Huffman::Value('c'), c);
+    EXPECT_TRUE(decoder.read_value(buffer, d));  // c
+    EXPECT_TRUE(decoder.read_value(buffer, d));  // a
+    EXPECT_FALSE(decoder.read_value(buffer, d)); // Only one bit left
+  }
+
+  EXPECT_TRUE(!Huffman::Decoder(Huffman::Tree()));
+}
+
+TEST(DecoderTest, TestMultiDecoderMatchesExistingTests)
+{
+  const auto tree = make_tree(mapping);
+  for(const auto bits: {1u, 3u, 8u, 12u})
+  {
+    Huffman::MultiDecoder decoder(tree, bits);
+    EXPECT_EQ("abc", decode_string(decoder, "\x5a\xc0"));
+    EXPECT_EQ("abcd\xc3\xa9" "fg",
+              decode_string(decoder, "\x5a\xde\x1d\x4b\x33" + string(1, 0)));
+
+    // Truncated
+    EXPECT_EQ("ab", decode_string(decoder, "\x5a"));
+    EXPECT_EQ("abcd\xc3", decode_string(decoder, "\x5a\xde\x1d"));
+  }
+}
+
+TEST(DecoderTest, TestAgreesWithTreeOnGeneratedText)
+{
+  Generator gen(200);
+  const auto tree = make_tree(gen.get_mappings());
+  const Huffman::MultiDecoder decoder(tree);
+  const Huffman::MultiDecoder small_decoder(tree, 3);
+  for(const auto& text: gen.texts)
+  {
+    const auto data = gen.encode(text);
+    ASSERT_EQ(text, read_string(tree, data));
+    ASSERT_EQ(text, decode_string(decoder, data));
+    ASSERT_EQ(text, decode_string(small_decoder, data));
+
+    // Same with missing data, and garbage
+    const auto cut = data.substr(0, data.size()/2);
+    ASSERT_EQ(read_string(tree, cut), decode_string(decoder, cut));
+    auto bad = data;
+    bad[bad.size()/3] ^= 0x5a;
+    ASSERT_EQ(read_string(tree, bad), decode_string(decoder, bad));
+  }
+}
+
+TEST(DecoderTest, BenchmarkAgainstTree)
+{
+  if (!getenv("OBTOOLS_BENCHMARK"))
+    GTEST_SKIP() << "OBTOOLS_BENCHMARK not set";
+
+  Generator gen(2000);
+  const auto tree = make_tree(gen.get_mappings());
+  const Huffman::MultiDecoder decoder(tree);
+  vector<string> data;
+  auto chars = 0u;
+  for(const auto& text: gen.texts)
+  {
+    data.push_back(gen.encode(text));
+    chars += text.size();
+  }
+
+  // Existing test data, repeated
+  const auto small_tree = make_tree(mapping);
+  const Huffman::MultiDecoder small_decoder(small_tree);
+  const auto small = "\x5a\xde\x1d\x4b\x33" + string(1, 0);
+
+  const auto runs = 10;
+  auto start = chrono::steady_clock::now();
+  for(auto i=0; i<runs; i++)
+    for(const auto& d: data)
+      ASSERT_FALSE(read_string(tree, d).empty());
+  for(auto i=0; i<runs*10000; i++)
+    ASSERT_EQ(8u, read_string(small_tree, small).size());
+  chrono::duration<double> tree_time = chrono::steady_clock::now() - start;
+
+  start = chrono::steady_clock::now();
+  for(auto i=0; i<runs; i++)
+    for(const auto& d: data)
+      ASSERT_FALSE(decode_string(decoder, d).empty());
+  for(auto i=0; i<runs*10000; i++)
+    ASSERT_EQ(8u, decode_string(small_decoder, small).size());
+  chrono::duration<double> decoder_time = chrono::steady_clock::now() - start;
+
+  const auto total = (chars + 10000 * 8) * runs;
+  cout << "Decode " << total << " chars: tree "
+       << total / tree_time.count() / 1e6 << "M/s, tables "
+       << total / decoder_time.count() / 1e6 << "M/s (x"
+       << tree_time.count() / decoder_time.count() << ")\n";
+}
+
+//--------------------------------------------------------------------------
+// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
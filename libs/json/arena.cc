@@ -0,0 +1,45 @@
+//==========================================================================
+// ObTools::JSON: arena.cc
+//
+// Block arena allocator for compact values
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "ot-json.h"
+
+namespace ObTools { namespace JSON {
+
+//--------------------------------------------------------------------------
+// Allocate from a new block
+void *Arena::allocate_from_new_block(size_t size)
+{
+  if (!size) return next;
+
+  // Oversize requests get their own block, leaving the current one in use
+  if (size > block_size / 4)
+  {
+    blocks.emplace_back(new char[size]);
+    total += size;
+    return blocks.back().get();
+  }
+
+  blocks.emplace_back(new char[block_size]);
+  total += block_size;
+  next = blocks.back().get() + size;
+  left = block_size - size;
+  return blocks.back().get();
+}
+
+//--------------------------------------------------------------------------
+// Copy a string into the arena
+string_view Arena::copy(string_view s)
+{
+  if (s.empty()) return s;
+  auto p = static_cast<char *>(allocate(s.size(), 1));
+  memcpy(p, s.data(), s.size());
+  return string_view(p, s.size());
+}
+
+}} // namespaces
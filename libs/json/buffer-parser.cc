@@ -0,0 +1,555 @@
+//==========================================================================
+// ObTools::JSON: buffer-parser.cc
+//
+// JSON parser on a contiguous buffer - a hand-written single pass over the
+// text, accepting and producing the same as Parser, without Lex
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "ot-json.h"
+#include <charconv>
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ObTools { namespace JSON {
+
+namespace
+{
+  // Whitespace as isspace() in the C locale
+  inline bool is_space(char c)
+  {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+  }
+
+  inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+  inline bool is_name_start(char c)
+  {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+  }
+
+  inline bool is_name_char(char c)
+  {
+    return is_name_start(c) || is_digit(c);
+  }
+
+  // Check for a number at p - and - or . are symbols unless followed by a
+  // digit (or . for -)
+  inline bool starts_number(const char *p, const char *end)
+  {
+    if (is_digit(*p)) return true;
+    if (*p != '-' && *p != '.') return false;
+    return p+1 != end && (is_digit(p[1]) || (*p == '-' && p[1] == '.'));
+  }
+
+  // Symbols Parser recognises, for errors
+  inline bool is_symbol(char c)
+  {
+    return c == '{' || c == '}' || c == '[' || c == ']' || c == ':'
+      || c == ',';
+  }
+}
+
+//--------------------------------------------------------------------------
+// Skip whitespace
+inline void BufferParser::skip_whitespace()
+{
+  // Usually none, or a single space
+  if (p == end || !is_space(*p)) return;
+  ++p;
+
+#if defined(__SSE2__)
+  // Indentation runs, 16 at a time
+  const auto space = _mm_set1_epi8(' ');
+  const auto tab = _mm_set1_epi8('\t');
+  const auto range = _mm_set1_epi8('\r' - '\t');
+  while (end - p >= 16)
+  {
+    const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    const auto offset = _mm_sub_epi8(chunk, tab);
+    const auto is_ws = _mm_or_si128(
+      _mm_cmpeq_epi8(chunk, space),
+      _mm_cmpeq_epi8(_mm_min_epu8(offset, range), offset));
+    const auto mask = _mm_movemask_epi8(is_ws) ^ 0xFFFF;
+    if (mask)
+    {
+      p += __builtin_ctz(mask);
+      return;
+    }
+    p += 16;
+  }
+#endif
+
+  while (p != end && is_space(*p)) ++p;
+}
+
+//--------------------------------------------------------------------------
+// Get the next significant character, or 0 at the end
+// Parser also stops at a NUL
+inline char BufferParser::next_char()
+{
+  skip_whitespace();
+  return p == end ? 0 : *p;
+}
+
+//--------------------------------------------------------------------------
+// Read a string, after the opening quote
+void BufferParser::read_string(string& value)
+{
+  for(;;)
+  {
+    // Find the next quote, escape or NUL and take everything before it
+    auto q = p;
+#if defined(__SSE2__)
+    const auto quote = _mm_set1_epi8('"');
+    const auto backslash = _mm_set1_epi8('\\');
+    const auto zero = _mm_setzero_si128();
+    while (end - q >= 16)
+    {
+      const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(q));
+      const auto mask = _mm_movemask_epi8(
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                  _mm_cmpeq_epi8(chunk, backslash)),
+                     _mm_cmpeq_epi8(chunk, zero)));
+      if (mask)
+      {
+        q += __builtin_ctz(mask);
+        goto found;
+      }
+      q += 16;
+    }
+#endif
+    while (q != end && *q != '"' && *q != '\\' && *q) ++q;
+#if defined(__SSE2__)
+  found:
+#endif
+    value.append(p, q);
+    p = q;
+    if (p == end || !*p) throw Exception("End of input in string");
+
+    if (*p++ == '"') return;
+
+    // Escape
+    if (p == end || !*p) throw Exception("End of input in escape");
+    const auto c = *p++;
+    switch (c)
+    {
+      case '/': case '\\': case '"': value += c; break;
+      case 'b': value += '\b'; break;
+      case 'f': value += '\f'; break;
+      case 'n': value += '\n'; break;
+      case 'r': value += '\r'; break;
+      case 't': value += '\t'; break;
+
+      case 'u':
+      {
+        string hex;
+        for(int i=0; i<4; i++)
+        {
+          if (p == end || !*p) throw Exception("End of input in \\u escape");
+          hex += *p++;
+        }
+        Text::UTF8::append(value, Text::xtoi(hex));
+      }
+      break;
+
+      default:
+        throw Exception(string("Unrecognised string escape '")+c+"'");
+    }
+  }
+}
+
+//--------------------------------------------------------------------------
+// Read a number, at its first character - returns INTEGER with n or
+// NUMBER with f
+Value::Type BufferParser::read_number(int64_t& n_out, double& f)
+{
+  const auto start = p;
+  const auto negative = (*p == '-');
+  if (negative) ++p;
+
+  // Integer part, accumulated as Text::stoi64() would
+  uint64_t n = 0;
+  auto overflow = false;
+  for(; p != end && is_digit(*p); ++p)
+  {
+    const auto digit = static_cast<unsigned>(*p - '0');
+    if (n > (UINT64_MAX - digit) / 10) overflow = true;
+    n = n*10 + digit;
+  }
+
+  // Optional decimal part
+  auto is_float = false;
+  if (p != end && *p == '.')
+  {
+    is_float = true;
+    for(++p; p != end && is_digit(*p); ++p)
+      ;
+  }
+
+  // Optional exponent - ignored for integers, as Parser
+  if (p != end && (*p == 'e' || *p == 'E'))
+  {
+    ++p;
+    if (p == end || !*p) throw Exception("End of input in number exponent");
+    if (*p == '+' || *p == '-')
+    {
+      ++p;
+      if (p == end || !*p)
+        throw Exception("End of input in number exponent");
+    }
+    if (!is_digit(*p)) throw Exception("Bad character in number exponent");
+    for(++p; p != end && is_digit(*p); ++p)
+      ;
+  }
+
+  if (is_float)
+  {
+    // As atof(), which takes 0 for a bare '.' or '-.'
+    f = 0.0;
+    from_chars(start, p, f);
+    return Value::NUMBER;
+  }
+
+  if (overflow) n = UINT64_MAX;
+  else if (negative) n = -n;
+  n_out = static_cast<int64_t>(n);
+  return Value::INTEGER;
+}
+
+//--------------------------------------------------------------------------
+// Read a bare name
+string_view BufferParser::read_name()
+{
+  const auto start = p;
+  for(++p; p != end && is_name_char(*p); ++p)
+    ;
+  return string_view(start, p-start);
+}
+
+//--------------------------------------------------------------------------
+// Read a bare name value - null, true or false
+Value::Type BufferParser::read_bare_value()
+{
+  const auto name = read_name();
+  if (name == "null") return Value::NULL_;
+  if (name == "true") return Value::TRUE_;
+  if (name == "false") return Value::FALSE_;
+  throw Exception(string("Unrecognised bare name ")+string(name));
+}
+
+//--------------------------------------------------------------------------
+// Get a description of the token at p, for errors
+string BufferParser::describe_token()
+{
+  const auto c = next_char();
+  if (!c) return "";
+  if (is_name_start(c)) return string(read_name());
+  if (c == '"')
+  {
+    ++p;
+    string s;
+    read_string(s);
+    return s;
+  }
+  if (starts_number(p, end))
+  {
+    const auto start = p;
+    int64_t n;
+    double f;
+    read_number(n, f);
+    return string(start, p-start);
+  }
+  check_symbol(c);
+  return string(1, c);
+}
+
+//--------------------------------------------------------------------------
+// Check a symbol is one Parser knows, and throw if not
+void BufferParser::check_symbol(char c)
+{
+  if (!is_symbol(c))
+    throw Exception(string("Unrecognised token near '")+c+"'");
+}
+
+//--------------------------------------------------------------------------
+// Throw for an unexpected character where a symbol was needed - but as
+// Parser, a token which can't be read fails as such first
+void BufferParser::unexpected(char c, const string& error)
+{
+  if (c) describe_token();
+  throw Exception(error);
+}
+
+//--------------------------------------------------------------------------
+// Read the separator after an element - returns whether it was the close
+bool BufferParser::read_separator(char close, const char *error)
+{
+  const auto c = next_char();
+  if (c != close && c != ',') unexpected(c, error);
+  ++p;
+  return c == close;
+}
+
+//--------------------------------------------------------------------------
+// Read the rest of an object (after the {)
+void BufferParser::read_rest_of_object(Value& object)
+{
+  string name;
+  for(;;)
+  {
+    auto c = next_char();
+    if (c == '}')
+    {
+      ++p;
+      return;
+    }
+    else if (c == '"')
+    {
+      ++p;
+      name.clear();
+      read_string(name);
+    }
+    else if (is_name_start(c))
+      name = read_name();
+    else
+    {
+      throw Exception(string("Bad property name ")+describe_token());
+    }
+
+    c = next_char();
+    if (c != ':') unexpected(c, "Expected :");
+    ++p;
+
+    // Read straight into place - later duplicates win, as Parser
+    auto& value = object.o[std::move(name)];
+    value = Value();
+    read_into(value);
+
+    if (read_separator('}', "Expected , or }")) return;
+  }
+}
+
+//--------------------------------------------------------------------------
+// Read the rest of an array (after the [)
+void BufferParser::read_rest_of_array(Value& array)
+{
+  for(;;)
+  {
+    auto c = next_char();
+    if (c == ']')
+    {
+      ++p;
+      return;
+    }
+
+    array.a.emplace_back();
+    read_into(array.a.back());
+
+    if (read_separator(']', "Expected , or ]")) return;
+  }
+}
+
+//--------------------------------------------------------------------------
+// Read a value into the given (UNDEFINED) one
+void BufferParser::read_into(Value& value)
+{
+  const auto c = next_char();
+  switch (c)
+  {
+    case 0:
+      value.type = Value::NULL_;
+      return;
+
+    case '"':
+      ++p;
+      value.type = Value::STRING;
+      read_string(value.s);
+      return;
+
+    case '{':
+      ++p;
+      value.type = Value::OBJECT;
+      read_rest_of_object(value);
+      return;
+
+    case '[':
+      ++p;
+      value.type = Value::ARRAY;
+      read_rest_of_array(value);
+      return;
+
+    default:
+      if (starts_number(p, end))
+      {
+        value.type = read_number(value.n, value.f);
+        return;
+      }
+
+      if (is_name_start(c))
+      {
+        value.type = read_bare_value();
+        return;
+      }
+
+      check_symbol(c);
+      throw Exception(string("Misplaced symbol ")+c);
+  }
+}
+
+//--------------------------------------------------------------------------
+// Read a value
+Value BufferParser::read_value()
+{
+  Value value;
+  read_into(value);
+  return value;
+}
+
+//--------------------------------------------------------------------------
+// Read the rest of a compact object (after the {)
+CompactValue BufferParser::read_compact_object(Arena& arena)
+{
+  // Members are gathered on the working stack above any of our parents'
+  const auto start = compact_members.size();
+  for(;;)
+  {
+    auto c = next_char();
+    if (c == '}')
+    {
+      ++p;
+      break;
+    }
+
+    CompactValue name;
+    if (c == '"')
+    {
+      ++p;
+      compact_string.clear();
+      read_string(compact_string);
+      name = CompactValue(compact_string, arena);
+    }
+    else if (is_name_start(c))
+      name = CompactValue(read_name(), arena);
+    else
+      throw Exception(string("Bad property name ")+describe_token());
+
+    c = next_char();
+    if (c != ':') unexpected(c, "Expected :");
+    ++p;
+
+    const auto value = read_compact(arena);
+    compact_members.push_back({name, value});
+
+    if (read_separator('}', "Expected , or }")) break;
+  }
+
+  // Sort by name, keeping the last of any duplicates, as Parser
+  const auto first = compact_members.begin() + start;
+  auto last = compact_members.end();
+  const auto by_name = [](const CompactValue::Member& a,
+                          const CompactValue::Member& b)
+                       { return a.name.as_view() < b.name.as_view(); };
+  // (already sorted input can still have adjacent duplicates)
+  if (!is_sorted(first, last, by_name))
+    stable_sort(first, last, by_name);
+  auto out = first;
+  for(auto it = first; it != last; ++it)
+    if (it+1 == last || (it+1)->name.as_view() != it->name.as_view())
+      *out++ = *it;
+  last = out;
+
+  const auto size = last - first;
+  auto members = static_cast<CompactValue::Member *>(
+    arena.allocate(size * sizeof(CompactValue::Member),
+                   alignof(CompactValue::Member)));
+  uninitialized_copy(first, last, members);
+  compact_members.resize(start);
+  return CompactValue(members, size);
+}
+
+//--------------------------------------------------------------------------
+// Read the rest of a compact array (after the [)
+CompactValue BufferParser::read_compact_array(Arena& arena)
+{
+  const auto start = compact_elements.size();
+  for(;;)
+  {
+    const auto c = next_char();
+    if (c == ']')
+    {
+      ++p;
+      break;
+    }
+
+    // Not straight into push_back, which could see the stack move under it
+    const auto value = read_compact(arena);
+    compact_elements.push_back(value);
+
+    if (read_separator(']', "Expected , or ]")) break;
+  }
+
+  const auto first = compact_elements.begin() + start;
+  const auto size = compact_elements.end() - first;
+  auto elements = static_cast<CompactValue *>(
+    arena.allocate(size * sizeof(CompactValue), alignof(CompactValue)));
+  uninitialized_copy(first, compact_elements.end(), elements);
+  compact_elements.resize(start);
+  return CompactValue(elements, size);
+}
+
+//--------------------------------------------------------------------------
+// Read a compact value
+CompactValue BufferParser::read_compact(Arena& arena)
+{
+  const auto c = next_char();
+  switch (c)
+  {
+    case 0:
+      return CompactValue(Value::NULL_);
+
+    case '"':
+      ++p;
+      compact_string.clear();
+      read_string(compact_string);
+      return CompactValue(compact_string, arena);
+
+    case '{':
+      ++p;
+      return read_compact_object(arena);
+
+    case '[':
+      ++p;
+      return read_compact_array(arena);
+
+    default:
+      if (starts_number(p, end))
+      {
+        int64_t n;
+        double f;
+        if (read_number(n, f) == Value::INTEGER) return CompactValue(n);
+        return CompactValue(f);
+      }
+
+      if (is_name_start(c)) return CompactValue(read_bare_value());
+
+      check_symbol(c);
+      throw Exception(string("Misplaced symbol ")+c);
+  }
+}
+
+//--------------------------------------------------------------------------
+// Read a compact value into the given arena
+CompactValue BufferParser::read_compact_value(Arena& arena)
+{
+  // Clear up after any earlier failure
+  compact_elements.clear();
+  compact_members.clear();
+  return read_compact(arena);
+}
+
+}} // namespaces
@@ -7,6 +7,8 @@
 //==========================================================================
 
 #include "ot-json.h"
+#include <cmath>
+#include <cstring>
 
 namespace ObTools { namespace JSON {
 
@@ -32,6 +34,44 @@ uint64_t CBORReader::read_int(uint8_t initial_byte)
   }
 }
 
+//------------------------------------------------------------------------
+// Read a half, single or double float following the given first byte
+double CBORReader::read_float(uint8_t initial_byte)
+{
+  switch (initial_byte & 0x1f)
+  {
+    case 25:  // Half - RFC 8949 Appendix D
+    {
+      const auto half = reader.read_nbo_16();
+      const auto exp = (half >> 10) & 0x1f;
+      const auto mant = half & 0x3ff;
+      double f;
+      if (!exp)
+        f = ldexp(mant, -24);
+      else if (exp != 31)
+        f = ldexp(mant + 1024, exp - 25);
+      else
+        f = mant ? NAN : INFINITY;
+      return (half & 0x8000) ? -f : f;
+    }
+
+    case 26:  // Single
+    {
+      const uint32_t n = reader.read_nbo_32();
+      float f;
+      memcpy(&f, &n, sizeof(f));
+      return f;
+    }
+
+    case 27:  // Double
+      return reader.read_nbo_double();
+
+    default:
+      throw Channel::Error(12, "Not a CBOR float "
+                           +Text::itos(initial_byte & 0x1f));
+  }
+}
+
 //------------------------------------------------------------------------
 // Read and decode a single CBOR value
 Value CBORReader::decode()
@@ -155,6 +195,7 @@ Value CBORReader::decode()
         case 21: return Value(Value::TRUE_);
         case 22: return Value(Value::NULL_);
         case 23: return Value();
+        case 25: case 26: case 27: return Value(read_float(initial_byte));
         case 31: return Value(Value::BREAK);
         default: throw Channel::Error(12, "Unhandled float/simple type "
                                       +Text::itos(initial_byte & 0x1f));
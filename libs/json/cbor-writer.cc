@@ -55,6 +55,11 @@ void CBORWriter::encode(const Value& v)
         write_int(-1-v.n, 1);
     break;
 
+    case Value::NUMBER:
+      writer.write_byte(0xfb);
+      writer.write_nbo_double(v.f);
+    break;
+
     case Value::FALSE_:
       writer.write_byte(0xf4);
     break;
@@ -101,6 +106,72 @@ void CBORWriter::encode(const Value& v)
   }
 }
 
+//------------------------------------------------------------------------
+// Output a compact JSON value as CBOR - as above
+void CBORWriter::encode(const CompactValue& v)
+{
+  switch (v.get_type())
+  {
+    case Value::INTEGER:
+    {
+      const auto n = v.as_int();
+      if (n >= 0)
+        write_int(n, 0);
+      else
+        write_int(-1-n, 1);
+    }
+    break;
+
+    case Value::NUMBER:
+      writer.write_byte(0xfb);
+      writer.write_nbo_double(v.as_float());
+    break;
+
+    case Value::FALSE_:
+      writer.write_byte(0xf4);
+    break;
+
+    case Value::TRUE_:
+      writer.write_byte(0xf5);
+    break;
+
+    case Value::NULL_:
+      writer.write_byte(0xf6);
+    break;
+
+    case Value::UNDEFINED:
+      writer.write_byte(0xf7);
+    break;
+
+    case Value::BINARY:
+    case Value::STRING:
+    {
+      const auto s = v.as_view();
+      write_int(s.size(), v.get_type() == Value::BINARY ? 2 : 3);
+      writer.write(s.data(), s.size());
+    }
+    break;
+
+    case Value::ARRAY:
+      write_int(v.size(), 4);
+      for(auto i=0u; i<v.size(); i++)
+        encode(v[i]);
+    break;
+
+    case Value::OBJECT:
+      write_int(v.object_size(), 5);
+      for(auto i=0u; i<v.object_size(); i++)
+      {
+        const auto& m = v.get_member(i);
+        encode(m.name);
+        encode(m.value);
+      }
+    break;
+
+    default:;
+  }
+}
+
 //------------------------------------------------------------------------
 // Open an indefinite array
 // Then continue to write any number of member values, and close it
@@ -0,0 +1,313 @@
+//==========================================================================
+// ObTools::JSON: compact-value.cc
+//
+// Compact JSON value operations, including writing
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "ot-json.h"
+#include <sstream>
+#include <new>
+
+namespace ObTools { namespace JSON {
+
+static_assert(sizeof(CompactValue) == 16, "CompactValue should be 16 bytes");
+
+// Invalid marker value
+const CompactValue CompactValue::none;
+
+//--------------------------------------------------------------------------
+// Constructor for a string (or binary)
+CompactValue::CompactValue(string_view s, Arena& arena, Value::Type type):
+  data{}, tag(static_cast<unsigned char>(type))
+{
+  if (s.size() <= max_inline_length)
+  {
+    memcpy(data, s.data(), s.size());
+    data[14] = static_cast<unsigned char>(s.size());
+    tag |= inline_flag;
+  }
+  else
+  {
+    store(0, arena.copy(s).data());
+    store(8, static_cast<uint32_t>(s.size()));
+  }
+}
+
+//--------------------------------------------------------------------------
+// Constructor for an array
+CompactValue::CompactValue(const CompactValue *elements, uint32_t size):
+  data{}, tag(Value::ARRAY)
+{
+  store(0, elements);
+  store(8, size);
+}
+
+//--------------------------------------------------------------------------
+// Constructor for an object
+CompactValue::CompactValue(const Member *members, uint32_t size):
+  data{}, tag(Value::OBJECT)
+{
+  store(0, members);
+  store(8, size);
+}
+
+//--------------------------------------------------------------------------
+// Deep copy of a Value
+CompactValue::CompactValue(const Value& v, Arena& arena):
+  CompactValue(v.type)
+{
+  switch (v.type)
+  {
+    case Value::NUMBER:
+      *this = CompactValue(v.f);
+      break;
+
+    case Value::INTEGER:
+      *this = CompactValue(v.n);
+      break;
+
+    case Value::STRING:
+    case Value::BINARY:
+      *this = CompactValue(v.s, arena, v.type);
+      break;
+
+    case Value::ARRAY:
+    {
+      auto elements = static_cast<CompactValue *>(
+        arena.allocate(v.a.size() * sizeof(CompactValue),
+                       alignof(CompactValue)));
+      for(auto i=0u; i<v.a.size(); i++)
+        new(&elements[i]) CompactValue(v.a[i], arena);
+      *this = CompactValue(elements, v.a.size());
+    }
+    break;
+
+    case Value::OBJECT:
+    {
+      // Map is already sorted and unique
+      auto members = static_cast<Member *>(
+        arena.allocate(v.o.size() * sizeof(Member), alignof(Member)));
+      auto m = members;
+      for(const auto& it: v.o)
+        new(m++) Member{CompactValue(it.first, arena),
+                        CompactValue(it.second, arena)};
+      *this = CompactValue(members, v.o.size());
+    }
+    break;
+
+    default:;
+  }
+}
+
+//--------------------------------------------------------------------------
+// Get a value from the given object property
+const CompactValue& CompactValue::get(string_view property) const
+{
+  if (tag != Value::OBJECT) return none;
+  const auto begin = members();
+  const auto end = begin + count();
+  const auto p = lower_bound(begin, end, property,
+                             [](const Member& m, string_view name)
+                             { return m.name.as_view() < name; });
+  if (p != end && p->name.as_view() == property) return p->value;
+  return none;
+}
+
+//--------------------------------------------------------------------------
+// Read as a binary value, including Base64 strings
+vector<byte> CompactValue::as_binary() const
+{
+  const auto s = as_view();
+  switch (get_type())
+  {
+    case Value::BINARY:
+      return vector<byte>{reinterpret_cast<const byte *>(s.data()),
+                          reinterpret_cast<const byte *>(s.data()+s.size())};
+
+    case Value::STRING:
+    {
+      Text::Base64 base64;
+      vector<byte> binary;
+      base64.decode(string(s), binary);
+      return binary;
+    }
+
+    default:
+      return vector<byte>();
+  }
+}
+
+//--------------------------------------------------------------------------
+// Convert to a full Value
+Value CompactValue::to_value() const
+{
+  const auto type = get_type();
+  switch (type)
+  {
+    case Value::NUMBER:  return Value(load<double>(0));
+    case Value::INTEGER: return Value(load<int64_t>(0));
+
+    case Value::STRING:
+    case Value::BINARY:
+    {
+      Value v(type);
+      v.s = as_view();
+      return v;
+    }
+
+    case Value::ARRAY:
+    {
+      Value v(Value::ARRAY);
+      v.a.reserve(count());
+      for(auto i=0u; i<count(); i++)
+        v.a.push_back(elements()[i].to_value());
+      return v;
+    }
+
+    case Value::OBJECT:
+    {
+      Value v(Value::OBJECT);
+      for(auto i=0u; i<count(); i++)
+        v.o.emplace_hint(v.o.end(), members()[i].name.as_view(),
+                         members()[i].value.to_value());
+      return v;
+    }
+
+    default:
+      return Value(type);
+  }
+}
+
+//--------------------------------------------------------------------------
+// Write an object value to the output - as Value::write_object_to()
+void CompactValue::write_object_to(ostream& out, bool pretty,
+                                   int indent) const
+{
+  // Whether to pretty print on multiple lines - optimise for {}
+  const auto multiline = pretty && count();
+
+  out << '{';
+  if (multiline) out << '\n';
+
+  for(auto i=0u; i<count(); i++)
+  {
+    const auto& m = members()[i];
+    if (pretty) for(int j=0; j<indent+2; j++) out << ' ';
+    out << "\"" << m.name.as_view() << "\":";
+
+    const auto& v = m.value;
+    if (pretty)
+    {
+      // 'ANSI' bracing style if sub-object is OBJECT or ARRAY and non-empty
+      if (v.size() || v.object_size())
+      {
+        out << '\n';
+        for(int j=0; j<indent+2; j++) out << ' ';
+      }
+      else out << ' ';  // on same line
+    }
+    v.write_to(out, pretty, indent+2);
+    if (i+1 < count()) out << ',';
+    if (pretty) out << '\n';
+  }
+
+  if (multiline) for(int i=0; i<indent; i++) out << ' ';
+  out << "}";
+  if (multiline && !indent) out << '\n';  // Tidy last line
+}
+
+//--------------------------------------------------------------------------
+// Write an array value to the output - as Value::write_array_to()
+void CompactValue::write_array_to(ostream& out, bool pretty,
+                                  int indent) const
+{
+  // Only go multi-line if we contain OBJECTs or ARRAYs which are non-empty
+  auto multiline = false;
+  if (pretty)
+    for(auto i=0u; i<count() && !multiline; i++)
+      multiline = elements()[i].size() || elements()[i].object_size();
+
+  out << "[";
+  if (multiline) out << '\n';
+
+  for(auto i=0u; i<count(); i++)
+  {
+    if (multiline) for(int j=0; j<indent+2; j++) out << ' ';
+    else if (pretty) out << ' ';
+
+    elements()[i].write_to(out, pretty, indent+2);
+    if (i+1 < count())
+    {
+      out << ',';
+      if (multiline) out << '\n';
+    }
+    else if (multiline)
+      out << '\n';
+    else if (pretty)
+      out << ' ';
+  }
+
+  if (multiline) for(int i=0; i<indent; i++) out << ' ';
+  out << "]";
+  if (multiline && !indent) out << '\n';  // Tidy last line
+}
+
+//--------------------------------------------------------------------------
+// Write the value to the given stream
+void CompactValue::write_to(ostream& out, bool pretty, int indent) const
+{
+  switch (get_type())
+  {
+    case Value::UNDEFINED: out << "undefined";                   break;
+    case Value::NULL_:     out << "null";                        break;
+    case Value::NUMBER:    out << load<double>(0);               break;
+    case Value::INTEGER:   out << load<int64_t>(0);              break;
+    case Value::STRING:
+      Value::write_string_to(out, string(as_view()));
+      break;
+    case Value::OBJECT:    write_object_to(out, pretty, indent); break;
+    case Value::ARRAY:     write_array_to(out, pretty, indent);  break;
+    case Value::TRUE_:     out << "true";                        break;
+    case Value::FALSE_:    out << "false";                       break;
+    case Value::BINARY:
+    {
+      Text::Base64 base64;
+      out << '"' << base64.encode(string(as_view())) << '"';
+    }
+    break;
+    case Value::BREAK:     out << "BREAK";                       break;
+  }
+}
+
+//--------------------------------------------------------------------------
+// Output value as a string, with optional prettiness
+string CompactValue::str(bool pretty) const
+{
+  ostringstream oss;
+  write_to(oss, pretty);
+  return oss.str();
+}
+
+//--------------------------------------------------------------------------
+// Output value as a CBOR binary string
+string CompactValue::cbor() const
+{
+  string s;
+  Channel::StringWriter w(s);
+  CBORWriter cw(w);
+  cw.encode(*this);
+  return s;
+}
+
+//--------------------------------------------------------------------------
+// >> operator to write to ostream
+ostream& operator<<(ostream& s, const CompactValue& v)
+{
+  v.write_to(s, true);  // Pretty print, 0 indent
+  return s;
+}
+
+}} // namespaces
@@ -12,8 +12,12 @@
 #define __OBTOOLS_JSON_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
+#include <memory>
+#include <cstring>
+#include <sstream>
 #include "ot-lex.h"
 #include "ot-text.h"
 #include "ot-chan.h"
@@ -23,11 +27,15 @@ namespace ObTools { namespace JSON {
 // Make our lives easier without polluting anyone else
 using namespace std;
 
+class CompactValue;
+
 //==========================================================================
 // JSON value
 class Value
 {
-  void write_string_to(ostream& out) const;
+  friend class CompactValue;
+  friend class JSONStreamWriter;
+  static void write_string_to(ostream& out, const string& s);
   void write_object_to(ostream& out, bool pretty, int indent) const;
   void write_array_to(ostream& out, bool pretty, int indent) const;
 
@@ -195,6 +203,282 @@ public:
   Value read_value();
 };
 
+//==========================================================================
+// Arena allocator for compact values (arena.cc)
+// Hands out memory from large blocks, which are all freed together when
+// the arena is destroyed - nothing is freed individually
+class Arena
+{
+  size_t block_size;
+  vector<unique_ptr<char[]>> blocks;
+  char *next = nullptr;
+  size_t left = 0;
+  size_t total = 0;
+
+  void *allocate_from_new_block(size_t size);
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor, with the size of each block
+  Arena(size_t _block_size = 65536): block_size(_block_size) {}
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  //------------------------------------------------------------------------
+  // Allocate memory with the given alignment (a power of 2, no more than
+  // that of max_align_t)
+  void *allocate(size_t size, size_t align = alignof(max_align_t))
+  {
+    const auto pad = -reinterpret_cast<uintptr_t>(next) & (align-1);
+    if (pad + size > left) return allocate_from_new_block(size);
+    auto result = next + pad;
+    next = result + size;
+    left -= pad + size;
+    return result;
+  }
+
+  //------------------------------------------------------------------------
+  // Copy a string into the arena
+  string_view copy(string_view s);
+
+  //------------------------------------------------------------------------
+  // Get the total memory held in blocks
+  size_t get_size() const { return total; }
+};
+
+//==========================================================================
+// Compact, read-only JSON value (compact-value.cc)
+// A 16-byte tagged union: strings of up to 14 bytes are held inline,
+// longer ones and the elements of arrays and objects live in an Arena,
+// which must outlive the value.  Object members are held sorted by name,
+// so lookup is a binary search and output matches Value.  Values are
+// trivially copyable and never freed individually
+class CompactValue
+{
+public:
+  struct Member;
+  static const CompactValue none;
+  static constexpr size_t max_inline_length = 14;
+
+private:
+  // Layout: 8 bytes number or pointer, 4 bytes size, then tag in the last
+  // byte; or inline string with its length in byte 14
+  alignas(8) unsigned char data[15];
+  unsigned char tag;
+  static constexpr unsigned char inline_flag = 0x80;
+
+  template<typename T> T load(size_t offset) const
+  { T t; memcpy(&t, data+offset, sizeof(T)); return t; }
+  template<typename T> void store(size_t offset, T t)
+  { memcpy(data+offset, &t, sizeof(T)); }
+
+  const CompactValue *elements() const
+  { return load<const CompactValue *>(0); }
+  const Member *members() const { return load<const Member *>(0); }
+  uint32_t count() const { return load<uint32_t>(8); }
+
+  void write_object_to(ostream& out, bool pretty, int indent) const;
+  void write_array_to(ostream& out, bool pretty, int indent) const;
+
+public:
+  //------------------------------------------------------------------------
+  // Constructors for scalars
+  CompactValue(Value::Type type = Value::UNDEFINED):
+    data{}, tag(static_cast<unsigned char>(type)) {}
+  CompactValue(int32_t n): CompactValue(static_cast<int64_t>(n)) {}
+  CompactValue(uint32_t n): CompactValue(static_cast<int64_t>(n)) {}
+  CompactValue(int64_t n): data{}, tag(Value::INTEGER) { store(0, n); }
+  CompactValue(uint64_t n): CompactValue(static_cast<int64_t>(n)) {}
+  CompactValue(double f): data{}, tag(Value::NUMBER) { store(0, f); }
+
+  //------------------------------------------------------------------------
+  // Constructor for a string (or binary), copied into the arena if too
+  // long to hold inline
+  CompactValue(string_view s, Arena& arena,
+               Value::Type type = Value::STRING);
+  CompactValue(const string& s, Arena& arena,
+               Value::Type type = Value::STRING):
+    CompactValue(string_view(s), arena, type) {}
+  CompactValue(const char *s, Arena& arena):
+    CompactValue(string_view(s), arena) {}
+
+  //------------------------------------------------------------------------
+  // Constructor for an array, from elements already in the arena
+  CompactValue(const CompactValue *elements, uint32_t size);
+
+  //------------------------------------------------------------------------
+  // Constructor for an object, from members already in the arena, which
+  // must be sorted by name without duplicates
+  CompactValue(const Member *members, uint32_t size);
+
+  //------------------------------------------------------------------------
+  // Deep copy of a Value into the arena
+  CompactValue(const Value& v, Arena& arena);
+
+  //------------------------------------------------------------------------
+  // Get the type
+  Value::Type get_type() const
+  { return static_cast<Value::Type>(tag & ~inline_flag); }
+
+  //------------------------------------------------------------------------
+  // Check whether a value is valid - NB FALSE, NULL and 0 are still valid!
+  bool operator!() const { return tag == Value::UNDEFINED; }
+
+  //------------------------------------------------------------------------
+  // Check whether a value is true - TRUE or non-zero INTEGER accepted
+  bool is_true() const
+  { return tag == Value::TRUE_
+      || (tag == Value::INTEGER && load<int64_t>(0)); }
+
+  //------------------------------------------------------------------------
+  // Get a value from the given object property
+  // Returns CompactValue::none if this is not an object or property doesn't
+  // exist
+  const CompactValue& get(string_view property) const;
+  const CompactValue& operator[](string_view property) const
+  { return get(property); }
+
+  //------------------------------------------------------------------------
+  // Get a value from the given array index
+  // Returns CompactValue::none if this is not an array or index doesn't
+  // exist
+  const CompactValue& get(unsigned int index) const
+  { return (tag == Value::ARRAY && index < count()) ? elements()[index]
+                                                    : none; }
+  const CompactValue& operator[](unsigned int index) const
+  { return get(index); }
+
+  //------------------------------------------------------------------------
+  // Get the size of an array (if it is an array, otherwise 0)
+  size_t size() const { return tag == Value::ARRAY ? count() : 0; }
+
+  //------------------------------------------------------------------------
+  // Get the number of properties of an object (if it is one, otherwise 0)
+  size_t object_size() const { return tag == Value::OBJECT ? count() : 0; }
+
+  //------------------------------------------------------------------------
+  // Get a property by position, in name order - object only
+  const Member& get_member(unsigned int index) const;
+
+  //------------------------------------------------------------------------
+  // Read the string (or binary) data without copying - empty otherwise
+  string_view as_view() const
+  {
+    if (tag & inline_flag)
+      return string_view(reinterpret_cast<const char *>(data), data[14]);
+    if (tag == Value::STRING || tag == Value::BINARY)
+      return string_view(load<const char *>(0), count());
+    return string_view();
+  }
+
+  //------------------------------------------------------------------------
+  // Read as a string value with the given default
+  string as_str(const string& def="") const
+  { return get_type() == Value::STRING ? string(as_view()) : def; }
+
+  //------------------------------------------------------------------------
+  // Read as an integer value with the given default
+  // Will cast numeric strings
+  int64_t as_int(int64_t def=0) const
+  { return (tag == Value::INTEGER) ? load<int64_t>(0):
+      ((get_type() == Value::STRING) ? Text::stoi(string(as_view())):def); }
+
+  //------------------------------------------------------------------------
+  // Read as a float value with the given default - also promotes integers
+  // Will cast numeric strings
+  double as_float(double def=0.0) const
+  { return (tag == Value::NUMBER) ? load<double>(0):
+      ((tag == Value::INTEGER) ? load<int64_t>(0):
+       ((get_type() == Value::STRING) ? Text::stof(string(as_view())):def)); }
+
+  //------------------------------------------------------------------------
+  // Read as a binary value, including Base64 strings
+  vector<byte> as_binary() const;
+
+  //------------------------------------------------------------------------
+  // Convert to a full Value
+  Value to_value() const;
+
+  //------------------------------------------------------------------------
+  // Write the value to the given stream, as Value
+  void write_to(ostream& s, bool pretty=false, int indent=0) const;
+
+  //------------------------------------------------------------------------
+  // Output value as a string, with optional prettiness
+  string str(bool pretty=false) const;
+
+  //------------------------------------------------------------------------
+  // Output value as a CBOR binary string
+  string cbor() const;
+};
+
+struct CompactValue::Member
+{
+  CompactValue name;
+  CompactValue value;
+};
+
+inline const CompactValue::Member& CompactValue::get_member(
+  unsigned int index) const
+{ return members()[index]; }
+
+//--------------------------------------------------------------------------
+// >> operator to write to ostream
+ostream& operator<<(ostream& s, const CompactValue& v);
+
+//==========================================================================
+// JSON parser on a contiguous buffer (buffer-parser.cc)
+// Accepts and produces the same as Parser, but in a single pass over the
+// text without going through Lex or an istream - use for whole documents
+// in memory.  The buffer must outlive the parser
+class BufferParser
+{
+  const char *p;
+  const char *end;
+
+  // Working space for compact values
+  string compact_string;
+  vector<CompactValue> compact_elements;
+  vector<CompactValue::Member> compact_members;
+
+  void skip_whitespace();
+  char next_char();
+  void read_string(string& value);
+  Value::Type read_number(int64_t& n, double& f);
+  string_view read_name();
+  Value::Type read_bare_value();
+  string describe_token();
+  void check_symbol(char c);
+  [[noreturn]] void unexpected(char c, const string& error);
+  void read_rest_of_object(Value& object);
+  void read_rest_of_array(Value& array);
+  void read_into(Value& value);
+  bool read_separator(char close, const char *error);
+  CompactValue read_compact_object(Arena& arena);
+  CompactValue read_compact_array(Arena& arena);
+  CompactValue read_compact(Arena& arena);
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor on a buffer
+  BufferParser(string_view text): p(text.data()), end(p + text.size()) {}
+
+  //------------------------------------------------------------------------
+  // Read a value - can be called again for following values, returns
+  // NULL_ at the end
+  // Throws Exception on error
+  Value read_value();
+
+  //------------------------------------------------------------------------
+  // Read a compact value, allocated in the given arena - likewise
+  // Throws Exception on error
+  CompactValue read_compact_value(Arena& arena);
+
+  //------------------------------------------------------------------------
+  // Get the number of characters not yet read
+  size_t remaining() const { return end - p; }
+};
+
 //==========================================================================
 // CBOR generator
 class CBORWriter
@@ -211,6 +495,10 @@ public:
   // Output a JSON value as CBOR
   void encode(const Value& v);
 
+  //------------------------------------------------------------------------
+  // Output a compact JSON value as CBOR
+  void encode(const CompactValue& v);
+
   //------------------------------------------------------------------------
   // Open an indefinite array
   // Then continue to write any number of member values, and close it
@@ -237,6 +525,11 @@ public:
   // Read and decode a single CBOR value
   JSON::Value decode();
 
+  //------------------------------------------------------------------------
+  // Read a half, single or double float following the given first byte
+  // (0xf9, 0xfa or 0xfb)
+  double read_float(uint8_t initial_byte);
+
   //------------------------------------------------------------------------
   // Read the open of an indefinite array
   // Then continue to read any number of member values until you get BREAK
@@ -246,6 +539,212 @@ public:
   bool open_indefinite_array();
 };
 
+//==========================================================================
+// Event handler for streaming readers - override the events you need
+// Streaming writers are also handlers, so a reader can feed one directly
+class Handler
+{
+public:
+  //------------------------------------------------------------------------
+  // Start and end of an object - members are given as key then a value
+  // (or a start of object or array)
+  virtual void start_object() {}
+  virtual void key(const string&) {}
+  virtual void end_object() {}
+
+  //------------------------------------------------------------------------
+  // Start and end of an array
+  virtual void start_array() {}
+  virtual void end_array() {}
+
+  //------------------------------------------------------------------------
+  // A scalar value - writers also accept whole objects and arrays
+  virtual void value(const Value&) {}
+
+  // Virtual destructor to keep compiler happy
+  virtual ~Handler() {}
+};
+
+//==========================================================================
+// Path filter for streaming readers (stream-reader.cc)
+// Paths are JSON pointers (RFC 6901), with '*' matching any key or index;
+// the empty pointer matches the whole document.  Memory used is bounded by
+// depth times the number of paths
+class PathFilter
+{
+  vector<vector<string>> paths;  // Segments of each pointer
+  vector<uint32_t> live;         // Paths matching so far, level by level
+  vector<size_t> levels;         // Start of each level in live
+
+public:
+  enum class Mode
+  {
+    skip,    // Not wanted
+    filter,  // Wanted only for descendants
+    all      // Wanted with everything below it
+  };
+
+  //------------------------------------------------------------------------
+  // Add a path
+  // Throws Exception if it isn't a valid pointer
+  void add(const string& pointer);
+
+  //------------------------------------------------------------------------
+  // Check whether there are any paths
+  bool empty() const { return paths.empty(); }
+
+  //------------------------------------------------------------------------
+  // Start a new document - returns mode for the root
+  Mode start();
+
+  //------------------------------------------------------------------------
+  // Enter a child of a container in filter mode, by key or index - returns
+  // its mode.  Call leave() afterwards if it was filter
+  Mode enter(string_view segment);
+
+  //------------------------------------------------------------------------
+  // Leave a child entered in filter mode
+  void leave();
+};
+
+//==========================================================================
+// Streaming JSON text reader (stream-reader.cc)
+// Reads values from a channel, delivering events to a handler, accepting
+// the same as Parser - but members are delivered in document order, and
+// duplicates are not removed.  Memory used is bounded by depth and the
+// longest string or number, not the size of the document
+class JSONStreamReader
+{
+  Channel::Reader& reader;
+  Handler& handler;
+  PathFilter filter;
+  vector<char> buffer;
+  size_t pos = 0;
+  size_t length = 0;
+  string token;   // Working space
+  Value scalar;   // Likewise
+
+  bool fill();
+  int peek()
+  { return (pos < length || fill())
+      ? static_cast<unsigned char>(buffer[pos]) : -1; }
+  int next_char();
+  void read_string(bool keep);
+  void read_number();
+  void read_name();
+  [[noreturn]] void unexpected(int c, const string& error);
+  void read_rest_of_object(PathFilter::Mode mode);
+  void read_rest_of_array(PathFilter::Mode mode);
+  void read_value(PathFilter::Mode mode, const string *key);
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor
+  JSONStreamReader(Channel::Reader& _reader, Handler& _handler):
+    reader(_reader), handler(_handler), buffer(65536) {}
+
+  //------------------------------------------------------------------------
+  // Only deliver the parts of the document at the given path (pointer),
+  // and the containers leading to them - anything else is skipped without
+  // being built.  Call more than once for multiple paths
+  // Throws Exception if it isn't a valid pointer
+  void add_path(const string& pointer) { filter.add(pointer); }
+
+  //------------------------------------------------------------------------
+  // Read a value - can be called again for following values
+  // Returns false at the end of input
+  // Throws Exception on bad JSON, or Channel::Error on failure
+  bool read();
+};
+
+//==========================================================================
+// Streaming CBOR reader (stream-reader.cc)
+// Reads values from a channel, delivering events to a handler, as
+// CBORReader but without building the tree
+class CBORStreamReader
+{
+  Channel::Reader& reader;
+  Handler& handler;
+  PathFilter filter;
+  string key_string;  // Working space
+  Value scalar;       // Likewise
+
+  uint64_t read_int(uint8_t initial_byte);
+  void read_key(uint8_t initial_byte, bool keep);
+  void read_item(uint8_t initial_byte, PathFilter::Mode mode,
+                 const string *key);
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor
+  CBORStreamReader(Channel::Reader& _reader, Handler& _handler):
+    reader(_reader), handler(_handler) {}
+
+  //------------------------------------------------------------------------
+  // Only deliver the parts of the document at the given path - as above
+  void add_path(const string& pointer) { filter.add(pointer); }
+
+  //------------------------------------------------------------------------
+  // Read a value - can be called again for following values
+  // Returns false at the end of input
+  // Throws Channel::Error on bad CBOR or failure
+  bool read();
+};
+
+//==========================================================================
+// Streaming JSON text writer (stream-writer.cc)
+// Writes optimal (not pretty) JSON to a channel as events are given, with
+// values at the top level on separate lines.  Memory used is bounded by
+// depth.  Events must be well formed
+class JSONStreamWriter: public Handler
+{
+  Channel::Writer& writer;
+  vector<bool> firsts;        // Whether nothing is yet in each container
+  bool after_key = false;
+  bool any_top_level = false;
+  ostringstream scratch;
+
+  void start_value();
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor
+  JSONStreamWriter(Channel::Writer& _writer): writer(_writer) {}
+
+  //------------------------------------------------------------------------
+  // Events
+  void start_object() override;
+  void key(const string& name) override;
+  void end_object() override;
+  void start_array() override;
+  void end_array() override;
+  void value(const Value& v) override;
+};
+
+//==========================================================================
+// Streaming CBOR writer (stream-writer.cc)
+// Writes CBOR to a channel as events are given, using indefinite length
+// objects and arrays.  Events must be well formed
+class CBORStreamWriter: public Handler
+{
+  Channel::Writer& writer;
+  CBORWriter cbor;
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor
+  CBORStreamWriter(Channel::Writer& _writer): writer(_writer), cbor(writer) {}
+
+  //------------------------------------------------------------------------
+  // Events
+  void start_object() override { writer.write_byte(0xbf); }
+  void key(const string& name) override { cbor.encode(Value(name)); }
+  void end_object() override { writer.write_byte(0xff); }
+  void start_array() override { writer.write_byte(0x9f); }
+  void end_array() override { writer.write_byte(0xff); }
+  void value(const Value& v) override { cbor.encode(v); }
+};
+
 //==========================================================================
 }} // namespaces
 
@@ -0,0 +1,661 @@
+//==========================================================================
+// ObTools::JSON: stream-reader.cc
+//
+// Streaming event readers for JSON text and CBOR, with path filtering
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "ot-json.h"
+#include <charconv>
+
+namespace ObTools { namespace JSON {
+
+namespace
+{
+  // Character classes as Parser
+  inline bool is_space(int c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+  inline bool is_digit(int c) { return c >= '0' && c <= '9'; }
+  inline bool is_name_start(int c)
+  {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+  }
+  inline bool is_name_char(int c) { return is_name_start(c) || is_digit(c); }
+  inline bool is_symbol(int c)
+  {
+    return c == '{' || c == '}' || c == '[' || c == ']' || c == ':'
+      || c == ',';
+  }
+
+  // Format an array index as a path segment
+  string_view index_segment(char (&buf)[24], uint64_t index)
+  {
+    const auto r = to_chars(buf, buf+sizeof(buf), index);
+    return string_view(buf, r.ptr - buf);
+  }
+}
+
+//==========================================================================
+// Path filter
+
+//--------------------------------------------------------------------------
+// Add a path
+void PathFilter::add(const string& pointer)
+{
+  vector<string> segments;
+  if (!pointer.empty())
+  {
+    if (pointer[0] != '/')
+      throw Exception("Bad JSON pointer "+pointer);
+
+    for(auto i=1u; i<=pointer.size(); i++)
+    {
+      if (i == 1 || pointer[i-1] == '/') segments.emplace_back();
+      if (i == pointer.size()) break;
+
+      const auto c = pointer[i];
+      if (c == '/') continue;
+      if (c == '~')
+      {
+        const auto e = (i+1 < pointer.size()) ? pointer[++i] : 0;
+        if (e == '0') segments.back() += '~';
+        else if (e == '1') segments.back() += '/';
+        else throw Exception("Bad JSON pointer "+pointer);
+      }
+      else segments.back() += c;
+    }
+  }
+  paths.push_back(segments);
+}
+
+//--------------------------------------------------------------------------
+// Start a new document
+PathFilter::Mode PathFilter::start()
+{
+  live.clear();
+  levels.clear();
+  if (paths.empty()) return Mode::all;
+
+  levels.push_back(0);
+  for(auto i=0u; i<paths.size(); i++)
+  {
+    if (paths[i].empty())
+    {
+      levels.clear();
+      live.clear();
+      return Mode::all;
+    }
+    live.push_back(i);
+  }
+  return Mode::filter;
+}
+
+//--------------------------------------------------------------------------
+// Enter a child
+PathFilter::Mode PathFilter::enter(string_view segment)
+{
+  const auto depth = levels.size()-1;
+  const auto start = levels.back();
+  const auto end = live.size();
+  for(auto i=start; i<end; i++)
+  {
+    const auto& path = paths[live[i]];
+    const auto& wanted = path[depth];
+    if (wanted == segment || wanted == "*")
+    {
+      if (path.size() == depth+1)
+      {
+        live.resize(end);
+        return Mode::all;
+      }
+      live.push_back(live[i]);
+    }
+  }
+
+  if (live.size() == end) return Mode::skip;
+  levels.push_back(end);
+  return Mode::filter;
+}
+
+//--------------------------------------------------------------------------
+// Leave a child
+void PathFilter::leave()
+{
+  live.resize(levels.back());
+  levels.pop_back();
+}
+
+//==========================================================================
+// JSON text reader
+
+//--------------------------------------------------------------------------
+// Refill the buffer - returns false at the end of input
+bool JSONStreamReader::fill()
+{
+  pos = 0;
+  length = reader.basic_read(buffer.data(), buffer.size());
+  return length > 0;
+}
+
+//--------------------------------------------------------------------------
+// Get the next significant character, or -1 at the end
+// Parser also stops at a NUL
+int JSONStreamReader::next_char()
+{
+  for(;;)
+  {
+    const auto c = peek();
+    if (!is_space(c)) return c ? c : -1;
+    pos++;
+  }
+}
+
+//--------------------------------------------------------------------------
+// Read a string, after the opening quote, into token if keep is set
+void JSONStreamReader::read_string(bool keep)
+{
+  for(;;)
+  {
+    if (pos == length && !fill()) throw Exception("End of input in string");
+
+    // Take everything up to a quote, escape or NUL
+    const auto start = pos;
+    while (pos < length)
+    {
+      const auto c = buffer[pos];
+      if (c == '"' || c == '\\' || !c) break;
+      pos++;
+    }
+    if (keep) token.append(&buffer[start], pos-start);
+    if (pos == length) continue;
+
+    const auto c = buffer[pos++];
+    if (!c) throw Exception("End of input in string");
+    if (c == '"') return;
+
+    // Escape
+    auto e = peek();
+    if (e <= 0) throw Exception("End of input in escape");
+    pos++;
+    switch (e)
+    {
+      case '/': case '\\': case '"': break;
+      case 'b': e = '\b'; break;
+      case 'f': e = '\f'; break;
+      case 'n': e = '\n'; break;
+      case 'r': e = '\r'; break;
+      case 't': e = '\t'; break;
+
+      case 'u':
+      {
+        char hex[5] = "";
+        for(int i=0; i<4; i++)
+        {
+          const auto h = peek();
+          if (h <= 0) throw Exception("End of input in \\u escape");
+          hex[i] = h;
+          pos++;
+        }
+        if (keep) Text::UTF8::append(token, Text::xtoi(hex));
+        continue;
+      }
+
+      default:
+        throw Exception(string("Unrecognised string escape '")
+                        +static_cast<char>(e)+"'");
+    }
+    if (keep) token += static_cast<char>(e);
+  }
+}
+
+//--------------------------------------------------------------------------
+// Read a number, at its first character, into scalar
+void JSONStreamReader::read_number()
+{
+  token.clear();
+  token += static_cast<char>(peek());
+  pos++;
+
+  // - and . are symbols unless followed by a digit (or . for -)
+  const auto first = token[0];
+  if (first == '-' || first == '.')
+  {
+    const auto c = peek();
+    if (!is_digit(c) && (first == '.' || c != '.'))
+      throw Exception(string("Unrecognised token near '")+first+"'");
+  }
+
+  // Digits, optional decimal part, as BufferParser
+  auto c = peek();
+  auto decimal = (first == '.');
+  for(;;)
+  {
+    for(; is_digit(c); c = peek())
+    {
+      token += static_cast<char>(c);
+      pos++;
+    }
+    if (decimal || c != '.') break;
+    decimal = true;
+    token += '.';
+    pos++;
+    c = peek();
+  }
+
+  if (c == 'e' || c == 'E')
+  {
+    token += static_cast<char>(c);
+    pos++;
+    c = peek();
+    if (c <= 0) throw Exception("End of input in number exponent");
+    if (c == '+' || c == '-')
+    {
+      token += static_cast<char>(c);
+      pos++;
+      c = peek();
+      if (c <= 0) throw Exception("End of input in number exponent");
+    }
+    if (!is_digit(c)) throw Exception("Bad character in number exponent");
+    for(; is_digit(c); c = peek())
+    {
+      token += static_cast<char>(c);
+      pos++;
+    }
+  }
+
+  // Convert exactly as BufferParser does
+  const auto v = BufferParser(token).read_value();
+  scalar.type = v.type;
+  scalar.n = v.n;
+  scalar.f = v.f;
+}
+
+//--------------------------------------------------------------------------
+// Read a bare name into token
+void JSONStreamReader::read_name()
+{
+  token.clear();
+  for(auto c = peek(); is_name_char(c); c = peek())
+  {
+    token += static_cast<char>(c);
+    pos++;
+  }
+}
+
+//--------------------------------------------------------------------------
+// Throw for an unexpected character where a symbol was needed - but as
+// Parser, a token which can't be read fails as such first
+void JSONStreamReader::unexpected(int c, const string& error)
+{
+  if (c == '"')
+  {
+    pos++;
+    read_string(false);
+  }
+  else if (is_name_start(c)) read_name();
+  else if (is_digit(c) || c == '-' || c == '.') read_number();
+  else if (c > 0 && !is_symbol(c))
+    throw Exception(string("Unrecognised token near '")
+                    +static_cast<char>(c)+"'");
+  throw Exception(error);
+}
+
+//--------------------------------------------------------------------------
+// Read the rest of an object (after the {)
+void JSONStreamReader::read_rest_of_object(PathFilter::Mode mode)
+{
+  string name;
+  for(;;)
+  {
+    auto c = next_char();
+    if (c == '}')
+    {
+      pos++;
+      break;
+    }
+
+    token.clear();
+    if (c == '"')
+    {
+      pos++;
+      read_string(mode != PathFilter::Mode::skip);
+    }
+    else if (is_name_start(c))
+      read_name();
+    else
+    {
+      // Get the token for the error, as Parser
+      if (c == -1) throw Exception("Bad property name ");
+      if (is_digit(c) || c == '-' || c == '.')
+      {
+        read_number();
+        throw Exception("Bad property name "+token);
+      }
+      unexpected(c, string("Bad property name ")+static_cast<char>(c));
+    }
+    name.assign(token);
+
+    c = next_char();
+    if (c != ':') unexpected(c, "Expected :");
+    pos++;
+
+    const auto child = (mode == PathFilter::Mode::filter)
+      ? filter.enter(name) : mode;
+    read_value(child, &name);
+    if (child == PathFilter::Mode::filter) filter.leave();
+
+    // The next symbol must be , or }
+    c = next_char();
+    if (c == '}')
+    {
+      pos++;
+      break;
+    }
+    if (c != ',') unexpected(c, "Expected , or }");
+    pos++;
+  }
+
+  if (mode != PathFilter::Mode::skip) handler.end_object();
+}
+
+//--------------------------------------------------------------------------
+// Read the rest of an array (after the [)
+void JSONStreamReader::read_rest_of_array(PathFilter::Mode mode)
+{
+  for(uint64_t index = 0;; index++)
+  {
+    auto c = next_char();
+    if (c == ']')
+    {
+      pos++;
+      break;
+    }
+
+    auto child = mode;
+    if (mode == PathFilter::Mode::filter)
+    {
+      char buf[24];
+      child = filter.enter(index_segment(buf, index));
+    }
+    read_value(child, nullptr);
+    if (child == PathFilter::Mode::filter) filter.leave();
+
+    // The next symbol must be , or ]
+    c = next_char();
+    if (c == ']')
+    {
+      pos++;
+      break;
+    }
+    if (c != ',') unexpected(c, "Expected , or ]");
+    pos++;
+  }
+
+  if (mode != PathFilter::Mode::skip) handler.end_array();
+}
+
+//--------------------------------------------------------------------------
+// Read a value, with the key it is under in an object
+void JSONStreamReader::read_value(PathFilter::Mode mode, const string *key)
+{
+  const auto c = next_char();
+  switch (c)
+  {
+    case '{':
+      pos++;
+      if (mode != PathFilter::Mode::skip)
+      {
+        if (key) handler.key(*key);
+        handler.start_object();
+      }
+      read_rest_of_object(mode);
+      return;
+
+    case '[':
+      pos++;
+      if (mode != PathFilter::Mode::skip)
+      {
+        if (key) handler.key(*key);
+        handler.start_array();
+      }
+      read_rest_of_array(mode);
+      return;
+
+    case '"':
+      pos++;
+      token.clear();
+      read_string(mode == PathFilter::Mode::all);
+      scalar.type = Value::STRING;
+      scalar.s.swap(token);  // Keeps both capacities
+      break;
+
+    case -1:
+      scalar.type = Value::NULL_;
+      break;
+
+    default:
+      if (is_digit(c) || c == '-' || c == '.')
+        read_number();
+      else if (is_name_start(c))
+      {
+        read_name();
+        if (token == "null") scalar.type = Value::NULL_;
+        else if (token == "true") scalar.type = Value::TRUE_;
+        else if (token == "false") scalar.type = Value::FALSE_;
+        else throw Exception("Unrecognised bare name "+token);
+      }
+      else if (!is_symbol(c))
+        throw Exception(string("Unrecognised token near '")
+                        +static_cast<char>(c)+"'");
+      else
+        throw Exception(string("Misplaced symbol ")+static_cast<char>(c));
+  }
+
+  if (mode == PathFilter::Mode::all)
+  {
+    if (key) handler.key(*key);
+    handler.value(scalar);
+  }
+}
+
+//--------------------------------------------------------------------------
+// Read a value
+bool JSONStreamReader::read()
+{
+  if (next_char() == -1) return false;
+  read_value(filter.start(), nullptr);
+  return true;
+}
+
+//==========================================================================
+// CBOR reader
+
+//--------------------------------------------------------------------------
+// Read an integer following the given first byte
+uint64_t CBORStreamReader::read_int(uint8_t initial_byte)
+{
+  auto ai = initial_byte & 0x1f;
+  if (ai < 24) return ai;
+  switch (ai)
+  {
+    case 24: return reader.read_byte();
+    case 25: return reader.read_nbo_16();
+    case 26: return reader.read_nbo_32();
+    case 27: return reader.read_nbo_64();
+    default:
+      throw Channel::Error(11, "Unknown additional information "
+                           + Text::itos(ai));
+  }
+}
+
+//--------------------------------------------------------------------------
+// Read an object key into key_string - skipped if keep is not set
+void CBORStreamReader::read_key(uint8_t initial_byte, bool keep)
+{
+  switch (initial_byte >> 5)
+  {
+    case 0:
+      key_string = to_string(read_int(initial_byte));
+      break;
+
+    case 1:
+      key_string = to_string(-1-static_cast<int64_t>(read_int(initial_byte)));
+      break;
+
+    case 3:
+    {
+      const auto len = read_int(initial_byte);
+      key_string.clear();
+      if (keep)
+        reader.read(key_string, len);
+      else
+        reader.skip(len);
+    }
+    break;
+
+    default:
+      throw Channel::Error(13,
+                       "Can't handle non-string or integer CBOR object keys");
+  }
+}
+
+//--------------------------------------------------------------------------
+// Read an item with the given first byte, with the key it is under in an
+// object
+void CBORStreamReader::read_item(uint8_t initial_byte, PathFilter::Mode mode,
+                                 const string *key)
+{
+  const auto keep = (mode != PathFilter::Mode::skip);
+  switch (initial_byte >> 5)
+  {
+    case 0:  // Positive integer
+      scalar.type = Value::INTEGER;
+      scalar.n = read_int(initial_byte);
+      break;
+
+    case 1:  // Negative integer
+      scalar.type = Value::INTEGER;
+      scalar.n = -1-read_int(initial_byte);
+      break;
+
+    case 2:  // Binary
+    case 3:  // String
+    {
+      scalar.type = (initial_byte >> 5) == 2 ? Value::BINARY : Value::STRING;
+      const auto len = read_int(initial_byte);
+      scalar.s.clear();
+      if (mode == PathFilter::Mode::all)
+        reader.read(scalar.s, len);
+      else
+        reader.skip(len);
+    }
+    break;
+
+    case 4:  // Array
+    {
+      if (keep)
+      {
+        if (key) handler.key(*key);
+        handler.start_array();
+      }
+
+      const auto indefinite = (initial_byte == 0x9f);
+      const auto len = indefinite ? 0 : read_int(initial_byte);
+      for(uint64_t i=0; indefinite || i<len; i++)
+      {
+        const auto b = reader.read_byte();
+        if (indefinite && b == 0xff) break;
+
+        auto child = mode;
+        if (mode == PathFilter::Mode::filter)
+        {
+          char buf[24];
+          child = filter.enter(index_segment(buf, i));
+        }
+        read_item(b, child, nullptr);
+        if (child == PathFilter::Mode::filter) filter.leave();
+      }
+
+      if (keep) handler.end_array();
+      return;
+    }
+
+    case 5:  // Object
+    {
+      if (keep)
+      {
+        if (key) handler.key(*key);
+        handler.start_object();
+      }
+
+      const auto indefinite = (initial_byte == 0xbf);
+      const auto len = indefinite ? 0 : read_int(initial_byte);
+      string name;
+      for(uint64_t i=0; indefinite || i<len; i++)
+      {
+        auto b = reader.read_byte();
+        if (indefinite && b == 0xff) break;
+        read_key(b, keep);
+        name.assign(key_string);
+
+        const auto child = (mode == PathFilter::Mode::filter)
+          ? filter.enter(name) : mode;
+        read_item(reader.read_byte(), child, &name);
+        if (child == PathFilter::Mode::filter) filter.leave();
+      }
+
+      if (keep) handler.end_object();
+      return;
+    }
+
+    case 6:  // Semantic tags - as CBORReader
+    {
+      auto type = initial_byte & 0x1f;
+      if (type > 23) type = reader.read_byte();
+      if (type != 24)
+        throw Channel::Error(14, "Unhandled tag type " + Text::itos(type));
+
+      // Embedded CBOR - one bounded item
+      CBORReader cr(reader);
+      const auto str = cr.decode().cbor();
+      scalar.type = Value::BINARY;
+      scalar.s = str;
+    }
+    break;
+
+    default:  // Floats & simple
+      switch (initial_byte & 0x1f)
+      {
+        case 20: scalar.type = Value::FALSE_;    break;
+        case 21: scalar.type = Value::TRUE_;     break;
+        case 22: scalar.type = Value::NULL_;     break;
+        case 23: scalar.type = Value::UNDEFINED; break;
+        case 25: case 26: case 27:
+          scalar.type = Value::NUMBER;
+          scalar.f = CBORReader(reader).read_float(initial_byte);
+          break;
+        case 31: throw Channel::Error(15, "Unexpected CBOR break");
+        default: throw Channel::Error(12, "Unhandled float/simple type "
+                                      +Text::itos(initial_byte & 0x1f));
+      }
+  }
+
+  if (mode == PathFilter::Mode::all)
+  {
+    if (key) handler.key(*key);
+    handler.value(scalar);
+  }
+}
+
+//--------------------------------------------------------------------------
+// Read a value
+bool CBORStreamReader::read()
+{
+  unsigned char b;
+  if (!reader.try_read_byte(b)) return false;
+  read_item(b, filter.start(), nullptr);
+  return true;
+}
+
+}} // namespaces
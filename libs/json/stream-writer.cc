@@ -0,0 +1,94 @@
+//==========================================================================
+// ObTools::JSON: stream-writer.cc
+//
+// Streaming event writer for JSON text (CBOR is inline in ot-json.h)
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "ot-json.h"
+
+namespace ObTools { namespace JSON {
+
+//--------------------------------------------------------------------------
+// Write any separator needed before a value
+void JSONStreamWriter::start_value()
+{
+  if (after_key)
+  {
+    after_key = false;
+    return;
+  }
+
+  if (firsts.empty())
+  {
+    // Top level values on separate lines
+    if (any_top_level) writer.write_byte('\n');
+    any_top_level = true;
+    return;
+  }
+
+  if (!firsts.back()) writer.write_byte(',');
+  firsts.back() = false;
+}
+
+//--------------------------------------------------------------------------
+// Start an object
+void JSONStreamWriter::start_object()
+{
+  start_value();
+  writer.write_byte('{');
+  firsts.push_back(true);
+}
+
+//--------------------------------------------------------------------------
+// Write an object key
+void JSONStreamWriter::key(const string& name)
+{
+  if (!firsts.back()) writer.write_byte(',');
+  firsts.back() = false;
+
+  scratch.str("");
+  Value::write_string_to(scratch, name);
+  scratch << ':';
+  writer.write(scratch.str());
+  after_key = true;
+}
+
+//--------------------------------------------------------------------------
+// End an object
+void JSONStreamWriter::end_object()
+{
+  firsts.pop_back();
+  writer.write_byte('}');
+}
+
+//--------------------------------------------------------------------------
+// Start an array
+void JSONStreamWriter::start_array()
+{
+  start_value();
+  writer.write_byte('[');
+  firsts.push_back(true);
+}
+
+//--------------------------------------------------------------------------
+// End an array
+void JSONStreamWriter::end_array()
+{
+  firsts.pop_back();
+  writer.write_byte(']');
+}
+
+//--------------------------------------------------------------------------
+// Write a value
+void JSONStreamWriter::value(const Value& v)
+{
+  start_value();
+  scratch.str("");
+  v.write_to(scratch);
+  writer.write(scratch.str());
+}
+
+}} // namespaces
@@ -0,0 +1,187 @@
+//==========================================================================
+// ObTools::JSON: test-buffer-parser.cc
+//
+// Test harness for JSON buffer parser, checking it against Parser, and
+// benchmarks against it on large and small documents
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include <gtest/gtest.h>
+#include "ot-json.h"
+#include <fstream>
+#include <chrono>
+#include <random>
+
+using namespace std;
+using namespace ObTools;
+using namespace ObTools::JSON;
+
+namespace {
+// Parse with Parser, returning value or "!" + error
+string parse_stream(const string& text)
+{
+  istringstream input(text);
+  Parser parser(input);
+  try
+  {
+    const auto v = parser.read_value();
+    return v.str() + "/" + Text::itos(v.type);
+  }
+  catch (const Exception& e)
+  {
+    return "!" + e.error;
+  }
+}
+
+// Parse with BufferParser, likewise
+string parse_buffer(const string& text)
+{
+  BufferParser parser(text);
+  try
+  {
+    const auto v = parser.read_value();
+    return v.str() + "/" + Text::itos(v.type);
+  }
+  catch (const Exception& e)
+  {
+    return "!" + e.error;
+  }
+}
+
+string read_file(const string& fn)
+{
+  ifstream input(fn);
+  return string(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+}
+}
+
+//--------------------------------------------------------------------------
+// Tests
+TEST(BufferParser, TestValuesAndErrorsMatchParser)
+{
+  const vector<string> cases{
+    "", "   ", "0", "-1", "1234567890123456789", "18446744073709551615",
+    "99999999999999999999", "-99999999999999999999", "3.14", "-0.5",
+    ".5", "-.5", "1.", "1e5", "1.5e3", "2.5E-3", "1.5e+3", "1e", "1e+",
+    "1ex", "-", "-x", ".", "null", "true", "false", "nulls", "bare",
+    "\"\"", "\"hello\"", "\"a\\\"b\\\\c\\/d\\b\\f\\n\\r\\t\"",
+    "\"\\u00e9\\u20AC\\u0041\"", "\"\\u12\"", "\"\\x\"", "\"unterminated",
+    "\"esc\\", string("\"nul\0\"", 6), "{}", "{ }", "[]", "[ ]",
+    "{\"a\":1}", "{a:1, b_2 : \"x\"}", "{\"a\":1,\"a\":2}", "{\"a\":1,}",
+    "[1,]", "[,]", "{,}", "{\"a\"}", "{\"a\" 1}", "{\"a\":}", "{\"a\":1",
+    "{\"a\":1 \"b\":2}", "{1:2}", "[1 2]", "[1", "[", "{", "]", "}", ":",
+    ",", "+", "[1+2]", "{\"a\"+1}", "{\"a\":1+}", "[1,2]]",
+    "[[[]],{\"x\":[{}]}]", " \t\r\n\v\f[ 1 ,\n\t 2 ]  ",
+    "{\"deep\":{\"er\":{\"est\":[1,2.5,\"three\",true,false,null]}}}",
+    "[1,2,3]garbage", "12abc", "[12abc]", "[\"" + string(100, 'x') + "\"]",
+    "[\"" + string(40, 'y') + "\\n" + string(40, 'z') + "\"]",
+    "[" + string(100, ' ') + "1" + string(37, '\n') + "]",
+  };
+
+  for(const auto& text: cases)
+    EXPECT_EQ(parse_stream(text), parse_buffer(text)) << text;
+}
+
+TEST(BufferParser, TestSuccessiveValues)
+{
+  BufferParser parser(" {\"a\":1} [2] 3 \"four\" ");
+  EXPECT_EQ(Value::OBJECT, parser.read_value().type);
+  EXPECT_EQ(Value::ARRAY, parser.read_value().type);
+  EXPECT_EQ(3, parser.read_value().n);
+  EXPECT_EQ("four", parser.read_value().s);
+  EXPECT_EQ(Value::NULL_, parser.read_value().type);
+  EXPECT_EQ(0u, parser.remaining());
+}
+
+TEST(BufferParser, TestRealDataMatchesParser)
+{
+  for(const auto fn: {"tests/twitter.json", "tests/facebook.json",
+                      "tests/json.org.json"})
+  {
+    const auto text = read_file(fn);
+    ASSERT_FALSE(text.empty()) << fn;
+    istringstream input(text);
+    const auto expected = Parser(input).read_value();
+    EXPECT_TRUE(expected == BufferParser(text).read_value()) << fn;
+  }
+}
+
+TEST(BufferParser, TestRandomDocumentsMatchParser)
+{
+  mt19937 rng(7);
+  const string alphabet = "{}[]:,\"\\ \n-.0123456789eE+truefalsenulxu";
+  for(auto i=0; i<20000; i++)
+  {
+    string text;
+    const auto n = rng() % 20;
+    for(auto j=0u; j<n; j++) text += alphabet[rng() % alphabet.size()];
+    ASSERT_EQ(parse_stream(text), parse_buffer(text)) << text;
+  }
+}
+
+TEST(BufferParser, BenchmarkAgainstParser)
+{
+  if (!getenv("OBTOOLS_BENCHMARK"))
+    GTEST_SKIP() << "OBTOOLS_BENCHMARK not set";
+
+  // Large: a REST-style listing built from the real data samples
+  vector<string> samples;
+  for(const auto fn: {"tests/twitter.json", "tests/facebook.json",
+                      "tests/json.org.json"})
+  {
+    const auto text = read_file(fn);
+    samples.push_back(BufferParser(text).read_value().str(true));
+  }
+
+  string large = "{\"items\": [";
+  for(auto i=0; i<300; i++)
+    for(const auto& s: samples)
+      large += (i || &s != &samples[0] ? ",\n" : "\n") + s;
+  large += "]}";
+
+  // Small: typical request body
+  const string small = "{\"id\": 12345, \"name\": \"Widget\", "
+    "\"price\": 9.99, \"tags\": [\"a\", \"b\"], \"active\": true}";
+
+  const vector<pair<string, const string *>> docs{{"large", &large},
+                                                  {"small", &small}};
+  for(const auto& doc: docs)
+  {
+    const auto& text = *doc.second;
+    const auto runs = max<size_t>(10, 2000000 / text.size());
+
+    auto start = chrono::steady_clock::now();
+    Value stream_value;
+    for(auto i=0u; i<runs; i++)
+    {
+      istringstream input(text);
+      stream_value = Parser(input).read_value();
+    }
+    chrono::duration<double> stream_time = chrono::steady_clock::now()
+                                           - start;
+
+    start = chrono::steady_clock::now();
+    Value buffer_value;
+    for(auto i=0u; i<runs; i++)
+      buffer_value = BufferParser(text).read_value();
+    chrono::duration<double> buffer_time = chrono::steady_clock::now()
+                                           - start;
+
+    ASSERT_TRUE(stream_value == buffer_value);
+    const auto mb = static_cast<double>(text.size()) * runs / 1e6;
+    cout << doc.first << " (" << text.size() << " bytes): Parser "
+         << mb / stream_time.count() << "MB/s, BufferParser "
+         << mb / buffer_time.count() << "MB/s (x"
+         << stream_time.count() / buffer_time.count() << ")\n";
+  }
+}
+
+//--------------------------------------------------------------------------
+// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
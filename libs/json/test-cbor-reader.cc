@@ -10,6 +10,7 @@
 #include <gtest/gtest.h>
 #include "ot-json.h"
 #include <limits.h>
+#include <cmath>
 
 using namespace std;
 using namespace ObTools;
@@ -244,6 +245,37 @@ TEST(CBORReader, TestUnhandledSemanticTagThrows)
   EXPECT_THROW(cr.decode(), Channel::Error);
 }
 
+// Get float from CBOR hex
+double decode_float(const string& hex)
+{
+  auto binary = Text::xtob(hex);
+  Channel::StringReader sr(binary);
+  CBORReader cr(sr);
+  const auto v = cr.decode();
+  EXPECT_EQ(Value::NUMBER, v.type);
+  return v.f;
+}
+
+TEST(CBORReader, TestFloat)
+{
+  // Half
+  EXPECT_EQ(0.0,          decode_float("f90000"));
+  EXPECT_EQ(1.5,          decode_float("f93e00"));
+  EXPECT_EQ(65504.0,      decode_float("f97bff"));
+  EXPECT_EQ(5.960464477539063e-8, decode_float("f90001"));
+  EXPECT_EQ(-4.0,         decode_float("f9c400"));
+  EXPECT_EQ(-INFINITY,    decode_float("f9fc00"));
+  EXPECT_TRUE(isnan(decode_float("f97e00")));
+
+  // Single
+  EXPECT_EQ(100000.0,     decode_float("fa47c35000"));
+  EXPECT_EQ(3.4028234663852886e+38, decode_float("fa7f7fffff"));
+
+  // Double
+  EXPECT_EQ(1.1,          decode_float("fb3ff199999999999a"));
+  EXPECT_EQ(-4.1,         decode_float("fbc010666666666666"));
+}
+
 TEST(CBORReader, TestUnhandledFloatSimpleThrows)
 {
   // Simple value 16 (0xf0 = major 7, additional info 16)
@@ -100,6 +100,14 @@ TEST(CBORWriter, TestNullUndefined)
   EXPECT_EQ("f7", Text::btox(Value().cbor()));
 }
 
+TEST(CBORWriter, TestFloat)
+{
+  EXPECT_EQ("fb3ff199999999999a", Text::btox(Value(1.1).cbor()));
+  EXPECT_EQ("fbc010666666666666", Text::btox(Value(-4.1).cbor()));
+  EXPECT_EQ("fb4004000000000000",
+            Text::btox(CompactValue(2.5).cbor()));
+}
+
 TEST(CBORWriter, TestBinary)
 {
   vector<unsigned char> b{42, 99};
@@ -0,0 +1,307 @@
+//==========================================================================
+// ObTools::JSON: test-compact-value.cc
+//
+// Test harness for compact JSON values and arena, including a benchmark
+// of memory per parsed document against Value
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include <gtest/gtest.h>
+#include "ot-json.h"
+#include <fstream>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+
+using namespace std;
+using namespace ObTools;
+using namespace ObTools::JSON;
+
+//--------------------------------------------------------------------------
+// Count of heap bytes live, to measure documents
+namespace {
+size_t heap_bytes = 0;
+const size_t heap_header = alignof(max_align_t);
+}
+
+void *operator new(size_t size)
+{
+  auto p = static_cast<char *>(malloc(size + heap_header));
+  if (!p) throw bad_alloc();
+  *reinterpret_cast<size_t *>(p) = size;
+  heap_bytes += size;
+  return p + heap_header;
+}
+
+void operator delete(void *p) noexcept
+{
+  if (!p) return;
+  auto q = static_cast<char *>(p) - heap_header;
+  heap_bytes -= *reinterpret_cast<size_t *>(q);
+  free(q);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+  operator delete(p);
+}
+
+namespace {
+string read_file(const string& fn)
+{
+  ifstream input(fn);
+  return string(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+}
+
+// Parse both ways, returning value or "!" + error
+string parse_value(const string& text)
+{
+  try
+  {
+    return BufferParser(text).read_value().str();
+  }
+  catch (const Exception& e)
+  {
+    return "!" + e.error;
+  }
+}
+
+string parse_compact(const string& text)
+{
+  Arena arena;
+  try
+  {
+    return BufferParser(text).read_compact_value(arena).str();
+  }
+  catch (const Exception& e)
+  {
+    return "!" + e.error;
+  }
+}
+}
+
+//--------------------------------------------------------------------------
+// Tests
+TEST(CompactValue, TestScalars)
+{
+  Arena arena;
+  EXPECT_EQ(16u, sizeof(CompactValue));
+  EXPECT_TRUE(!CompactValue());
+  EXPECT_FALSE(!CompactValue(Value::NULL_));
+  EXPECT_TRUE(CompactValue(Value::TRUE_).is_true());
+  EXPECT_FALSE(CompactValue(Value::FALSE_).is_true());
+  EXPECT_TRUE(CompactValue(42).is_true());
+  EXPECT_EQ(42, CompactValue(42).as_int());
+  EXPECT_EQ(42.0, CompactValue(42).as_float());
+  const int64_t big = -1234567890123;
+  EXPECT_EQ(big, CompactValue(big).as_int());
+  EXPECT_EQ(3.5, CompactValue(3.5).as_float());
+  EXPECT_EQ(99, CompactValue(3.5).as_int(99));
+  EXPECT_EQ(123, CompactValue("123", arena).as_int());
+  EXPECT_EQ(1.5, CompactValue("1.5", arena).as_float());
+  EXPECT_EQ("def", CompactValue(1).as_str("def"));
+}
+
+TEST(CompactValue, TestInlineAndArenaStrings)
+{
+  Arena arena;
+  const string short_s(CompactValue::max_inline_length, 'x');
+  const string long_s(CompactValue::max_inline_length+1, 'y');
+
+  const CompactValue sv(short_s, arena);
+  EXPECT_EQ(0u, arena.get_size());
+  const CompactValue lv(long_s, arena);
+  EXPECT_LT(0u, arena.get_size());
+
+  EXPECT_EQ(Value::STRING, sv.get_type());
+  EXPECT_EQ(Value::STRING, lv.get_type());
+  EXPECT_EQ(short_s, sv.as_str());
+  EXPECT_EQ(long_s, lv.as_str());
+  EXPECT_EQ("", CompactValue("", arena).as_str("def"));
+  EXPECT_EQ(string("a\0b", 3), CompactValue(string("a\0b", 3), arena).as_str());
+}
+
+TEST(CompactValue, TestArrayAndObjectAccess)
+{
+  Arena arena;
+  BufferParser parser("{\"b\": [1, \"two\", {\"c\": null}], \"a\": true,"
+                      " \"b\": [1, \"two\", {\"c\": null}, 4.5], \"e\": {}}");
+  const auto v = parser.read_compact_value(arena);
+  EXPECT_EQ(Value::OBJECT, v.get_type());
+  EXPECT_EQ(3u, v.object_size());
+  EXPECT_EQ(0u, v.size());
+  EXPECT_EQ("a", v.get_member(0).name.as_str());
+  EXPECT_TRUE(v["a"].is_true());
+  EXPECT_TRUE(!v["missing"]);
+  EXPECT_TRUE(!v[0]);
+
+  const auto& b = v["b"];
+  ASSERT_EQ(4u, b.size());  // Last duplicate wins
+  EXPECT_EQ(1, b[0].as_int());
+  EXPECT_EQ("two", b[1].as_str());
+  EXPECT_EQ(Value::NULL_, b[2]["c"].get_type());
+  EXPECT_EQ(4.5, b[3].as_float());
+  EXPECT_TRUE(!b[4]);
+  EXPECT_TRUE(!b["c"]);
+  EXPECT_EQ(Value::OBJECT, v["e"].get_type());
+  EXPECT_EQ(0u, v["e"].object_size());
+}
+
+TEST(CompactValue, TestSortedDuplicateKeys)
+{
+  Arena arena;
+  const auto text = "{\"a\": 1, \"a\": 2, \"b\": 3, \"b\": 4, \"b\": 5}";
+  const auto v = BufferParser(text).read_compact_value(arena);
+  ASSERT_EQ(2u, v.object_size());
+  EXPECT_EQ(2, v["a"].as_int());
+  EXPECT_EQ(5, v["b"].as_int());
+  EXPECT_EQ(BufferParser(text).read_value(), v.to_value());
+}
+
+TEST(CompactValue, TestLookupInLargeObject)
+{
+  Value value(Value::OBJECT);
+  for(auto i=0; i<1000; i++)
+    value.set("key" + Text::itos(i*7 % 1000), i);
+
+  Arena arena;
+  const CompactValue v(value, arena);
+  ASSERT_EQ(1000u, v.object_size());
+  for(auto i=0; i<1000; i++)
+    EXPECT_EQ(i, v["key" + Text::itos(i*7 % 1000)].as_int());
+  EXPECT_TRUE(!v["key1000"]);
+}
+
+TEST(CompactValue, TestConversionsAndOutputMatchValue)
+{
+  Value value(Value::OBJECT);
+  value.set("int", -42)
+       .set("float", 2.25)
+       .set("short", "text")
+       .set("long", "a longer string \"quoted\" with \xc3\xa9 in it")
+       .set("binary", Value(vector<byte>{byte{0}, byte{1}, byte{0xff}}))
+       .set("null", Value(Value::NULL_))
+       .set("true", Value(Value::TRUE_))
+       .set("empty", Value(Value::ARRAY));
+  auto& array = value.put("array", Value(Value::ARRAY));
+  array.add(1);
+  array.add("two");
+  array.add(Value(Value::OBJECT)).set("deep", Value(Value::FALSE_));
+
+  Arena arena;
+  const CompactValue compact(value, arena);
+  EXPECT_EQ(value, compact.to_value());
+  EXPECT_EQ(value.str(), compact.str());
+  EXPECT_EQ(value.str(true), compact.str(true));
+  EXPECT_EQ(value.cbor(), compact.cbor());
+  EXPECT_EQ(value["binary"].as_binary(), compact["binary"].as_binary());
+
+  ostringstream vs, cs;
+  vs << value;
+  cs << compact;
+  EXPECT_EQ(vs.str(), cs.str());
+}
+
+TEST(CompactValue, TestParsingMatchesValue)
+{
+  for(const auto fn: {"tests/twitter.json", "tests/facebook.json",
+                      "tests/json.org.json"})
+  {
+    const auto text = read_file(fn);
+    const auto expected = BufferParser(text).read_value();
+    Arena arena;
+    const auto compact = BufferParser(text).read_compact_value(arena);
+    EXPECT_EQ(expected, compact.to_value()) << fn;
+    EXPECT_EQ(expected.str(true), compact.str(true)) << fn;
+  }
+
+  mt19937 rng(22);
+  const string alphabet = "{}[]:,\"\"\"\\ -.0123456789eab";
+  for(auto i=0; i<20000; i++)
+  {
+    string text;
+    const auto n = rng() % 24;
+    for(auto j=0u; j<n; j++) text += alphabet[rng() % alphabet.size()];
+    ASSERT_EQ(parse_value(text), parse_compact(text)) << text;
+  }
+}
+
+TEST(CompactValue, TestSuccessiveValuesShareArena)
+{
+  Arena arena;
+  BufferParser parser("[\"a string long enough for the arena\"] {\"x\": 1}");
+  const auto a = parser.read_compact_value(arena);
+  const auto o = parser.read_compact_value(arena);
+  EXPECT_EQ("a string long enough for the arena", a[0].as_str());
+  EXPECT_EQ(1, o["x"].as_int());
+  EXPECT_EQ(Value::NULL_, parser.read_compact_value(arena).get_type());
+
+  // Reusable after an error
+  BufferParser bad("[[1, 2, {\"x\": [3,,]}]] [4]");
+  EXPECT_THROW(bad.read_compact_value(arena), Exception);
+}
+
+TEST(CompactValue, BenchmarkMemoryAndParseAgainstValue)
+{
+  if (!getenv("OBTOOLS_BENCHMARK"))
+    GTEST_SKIP() << "OBTOOLS_BENCHMARK not set";
+
+  // A REST-style listing built from the real data samples
+  vector<string> samples;
+  for(const auto fn: {"tests/twitter.json", "tests/facebook.json",
+                      "tests/json.org.json"})
+    samples.push_back(BufferParser(read_file(fn)).read_value().str(true));
+
+  string text = "{\"items\": [";
+  for(auto i=0; i<300; i++)
+    for(const auto& s: samples)
+      text += (i || &s != &samples[0] ? ",\n" : "\n") + s;
+  text += "]}";
+
+  const auto runs = 20;
+  auto base = heap_bytes;
+  size_t value_bytes = 0;
+  auto start = chrono::steady_clock::now();
+  for(auto i=0; i<runs; i++)
+  {
+    const auto value = BufferParser(text).read_value();
+    value_bytes = heap_bytes - base;
+  }
+  chrono::duration<double> value_time = chrono::steady_clock::now() - start;
+
+  size_t compact_bytes = 0;
+  string compact_str;
+  start = chrono::steady_clock::now();
+  for(auto i=0; i<runs; i++)
+  {
+    Arena arena;
+    const auto compact = BufferParser(text).read_compact_value(arena);
+    if (!i)
+    {
+      compact_bytes = heap_bytes - base;
+      compact_str = compact.str();
+    }
+  }
+  chrono::duration<double> compact_time = chrono::steady_clock::now() - start;
+
+  EXPECT_EQ(BufferParser(text).read_value().str(), compact_str);
+  EXPECT_LT(compact_bytes * 3, value_bytes);
+
+  const auto mb = static_cast<double>(text.size()) * runs / 1e6;
+  cout << "Document of " << text.size() << " bytes: Value "
+       << value_bytes << " bytes, compact " << compact_bytes
+       << " bytes (x" << static_cast<double>(value_bytes) / compact_bytes
+       << ")\nParse: Value " << mb / value_time.count()
+       << "MB/s, compact " << mb / compact_time.count() << "MB/s (x"
+       << value_time.count() / compact_time.count() << ")\n";
+}
+
+//--------------------------------------------------------------------------
+// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,435 @@
+//==========================================================================
+// ObTools::JSON: test-stream.cc
+//
+// Test harness for streaming JSON and CBOR readers and writers, including
+// a benchmark of filtered reading of a large generated document
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include <gtest/gtest.h>
+#include "ot-json.h"
+#include <fstream>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+
+using namespace std;
+using namespace ObTools;
+using namespace ObTools::JSON;
+
+//--------------------------------------------------------------------------
+// Count of heap bytes live, and the peak, to check memory is bounded
+namespace {
+size_t heap_bytes = 0;
+size_t heap_peak = 0;
+const size_t heap_header = alignof(max_align_t);
+}
+
+void *operator new(size_t size)
+{
+  auto p = static_cast<char *>(malloc(size + heap_header));
+  if (!p) throw bad_alloc();
+  *reinterpret_cast<size_t *>(p) = size;
+  heap_bytes += size;
+  if (heap_bytes > heap_peak) heap_peak = heap_bytes;
+  return p + heap_header;
+}
+
+// Not inlined, where the compiler sees free() of a new'd pointer
+__attribute__((noinline)) void operator delete(void *p) noexcept
+{
+  if (!p) return;
+  auto q = static_cast<char *>(p) - heap_header;
+  heap_bytes -= *reinterpret_cast<size_t *>(q);
+  free(q);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+  operator delete(p);
+}
+
+namespace {
+string read_file(const string& fn)
+{
+  ifstream input(fn);
+  return string(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+}
+
+// Stream JSON text to JSON text, with optional paths
+string json_to_json(const string& text, const vector<string>& paths = {})
+{
+  string out;
+  Channel::StringReader sr(text);
+  Channel::StringWriter sw(out);
+  JSONStreamWriter writer(sw);
+  JSONStreamReader reader(sr, writer);
+  for(const auto& p: paths) reader.add_path(p);
+  while (reader.read())
+    ;
+  return out;
+}
+
+// Stream CBOR to JSON text, with optional paths
+string cbor_to_json(const string& cbor, const vector<string>& paths = {})
+{
+  string out;
+  Channel::StringReader sr(cbor);
+  Channel::StringWriter sw(out);
+  JSONStreamWriter writer(sw);
+  CBORStreamReader reader(sr, writer);
+  for(const auto& p: paths) reader.add_path(p);
+  while (reader.read())
+    ;
+  return out;
+}
+
+// Builds a Value from events
+struct BuildingHandler: public Handler
+{
+  Value root;
+  vector<Value *> stack;
+  string pending_key;
+
+  Value& add(const Value& v)
+  {
+    if (stack.empty()) return root = v;
+    auto& top = *stack.back();
+    if (top.type == Value::ARRAY) return top.add(v);
+    return top.put(pending_key, v);
+  }
+
+  void start_object() override
+  { stack.push_back(&add(Value(Value::OBJECT))); }
+  void key(const string& name) override { pending_key = name; }
+  void end_object() override { stack.pop_back(); }
+  void start_array() override
+  { stack.push_back(&add(Value(Value::ARRAY))); }
+  void end_array() override { stack.pop_back(); }
+  void value(const Value& v) override { add(v); }
+};
+
+// Stream the first JSON value into a Value, or "!" + error
+string stream_first(const string& text)
+{
+  Channel::StringReader sr(text);
+  BuildingHandler builder;
+  JSONStreamReader reader(sr, builder);
+  try
+  {
+    if (!reader.read()) return "null";
+  }
+  catch (const Exception& e)
+  {
+    return "!" + e.error;
+  }
+  return builder.root.str();
+}
+
+string buffer_parse(const string& text)
+{
+  try
+  {
+    return BufferParser(text).read_value().str();
+  }
+  catch (const Exception& e)
+  {
+    return "!" + e.error;
+  }
+}
+
+// Generates a large JSON array of log records on the fly
+class RecordReader: public Channel::Reader
+{
+  uint64_t records;
+  uint64_t next = 0;
+  string pending;
+  size_t pending_pos = 0;
+
+public:
+  RecordReader(uint64_t _records): records(_records) {}
+
+  size_t basic_read(void *buf, size_t count) override
+  {
+    size_t done = 0;
+    while (done < count)
+    {
+      if (pending_pos == pending.size() && !generate()) break;
+      const auto n = min(count - done, pending.size() - pending_pos);
+      if (buf) memcpy(static_cast<char *>(buf) + done,
+                      pending.data() + pending_pos, n);
+      pending_pos += n;
+      done += n;
+    }
+    offset += done;
+    return done;
+  }
+
+  // Make the next piece - returns false at the end
+  bool generate()
+  {
+    pending_pos = 0;
+    if (next > records) return false;
+    if (!next) pending = "[";
+    else
+    {
+      const auto id = Text::i64tos(next);
+      pending = "{\"id\": " + id + ", \"user\": {\"name\": \"user" + id
+        + "\", \"roles\": [\"a\", \"b\"]}, \"payload\": {\"text\": \""
+        + string(200, 'x') + "\", \"values\": [1, 2.5, true, null]}}";
+      pending += (next < records) ? ",\n" : "]";
+    }
+    next++;
+    return true;
+  }
+};
+
+// Counts events
+struct CountingHandler: public Handler
+{
+  uint64_t values = 0;
+  int64_t total = 0;
+  void value(const Value& v) override { values++; total += v.n; }
+};
+}
+
+//--------------------------------------------------------------------------
+// Tests
+TEST(StreamTest, TestJSONTextEvents)
+{
+  EXPECT_EQ("{\"a\":1,\"b\":[true,false,null,\"x\\ny\",2.5,{}],\"c\":[]}",
+            json_to_json(" { \"a\" : 1, b: [true, false, null, \"x\\ny\","
+                         " 2.5, {}], \"c\": [ ] } "));
+  EXPECT_EQ("1\n\"two\"\n[3]\n{\"four\":4}",
+            json_to_json("1 \"two\" [3]\n{\"four\": 4}\n"));
+  EXPECT_EQ("", json_to_json("  "));
+
+  // Order and duplicates as given
+  EXPECT_EQ("{\"z\":1,\"a\":2,\"z\":3}",
+            json_to_json("{\"z\": 1, \"a\": 2, \"z\": 3}"));
+}
+
+TEST(StreamTest, TestJSONTextMatchesParser)
+{
+  for(const auto fn: {"tests/twitter.json", "tests/facebook.json",
+                      "tests/json.org.json"})
+  {
+    // Just the first value - twitter.json has trailing rubbish
+    const auto text = read_file(fn);
+    EXPECT_EQ(BufferParser(text).read_value().str(), stream_first(text))
+      << fn;
+  }
+
+  mt19937 rng(23);
+  const string alphabet = "{}[]:,\"\"\\ \n-.0123456789eE+trufalsenxu";
+  for(auto i=0; i<20000; i++)
+  {
+    string text;
+    const auto n = rng() % 20;
+    for(auto j=0u; j<n; j++) text += alphabet[rng() % alphabet.size()];
+    ASSERT_EQ(buffer_parse(text), stream_first(text)) << text;
+  }
+}
+
+TEST(StreamTest, TestSmallBufferRefills)
+{
+  // Tokens split at every point across refills
+  const string text = "{\"key\": \"str\\u00e9\\n\", \"num\": -12.5e+3, "
+                      "\"list\": [true, null, 123456789012]}";
+  class ByteReader: public Channel::StringReader
+  {
+  public:
+    ByteReader(const string& s): StringReader(s) {}
+    size_t basic_read(void *buf, size_t) override
+    { return StringReader::basic_read(buf, 1); }
+  };
+
+  ByteReader br(text);
+  string out;
+  Channel::StringWriter sw(out);
+  JSONStreamWriter writer(sw);
+  JSONStreamReader reader(br, writer);
+  ASSERT_TRUE(reader.read());
+  EXPECT_FALSE(reader.read());
+  EXPECT_EQ(BufferParser(text).read_value().str(),
+            BufferParser(out).read_value().str());
+}
+
+TEST(StreamTest, TestCBORRoundTrip)
+{
+  const string text =
+    "{\"a\": [1, -2, \"three\", true, false, null, {\"x\": []}],"
+    " \"b\": {\"c\": 12345678901234, \"f\": [2.5, -12.5e3]},"
+    " \"d\": \"\"}";
+  const auto value = BufferParser(text).read_value();
+  auto with_binary = value;
+  with_binary.set("e", Value(vector<byte>{byte{1}, byte{2}}));
+
+  // CBOR to CBOR
+  string cbor;
+  {
+    const auto in = with_binary.cbor();
+    Channel::StringReader sr(in);
+    Channel::StringWriter sw(cbor);
+    CBORStreamWriter writer(sw);
+    CBORStreamReader reader(sr, writer);
+    ASSERT_TRUE(reader.read());
+    EXPECT_FALSE(reader.read());
+  }
+  Channel::StringReader sr(cbor);
+  CBORReader cr(sr);
+  EXPECT_EQ(with_binary, cr.decode());
+
+  // CBOR to JSON - JSON text can't tell -12500.0 from -12500, so compare
+  // with the value written as JSON
+  EXPECT_EQ(BufferParser(value.str()).read_value(),
+            BufferParser(cbor_to_json(value.cbor())).read_value());
+
+  // JSON to CBOR
+  string json_cbor;
+  {
+    Channel::StringReader sr(text);
+    Channel::StringWriter sw(json_cbor);
+    CBORStreamWriter writer(sw);
+    JSONStreamReader reader(sr, writer);
+    ASSERT_TRUE(reader.read());
+  }
+  Channel::StringReader jsr(json_cbor);
+  CBORReader jcr(jsr);
+  EXPECT_EQ(value, jcr.decode());
+
+  // Integer keys as CBORReader
+  EXPECT_EQ("{\"1\":2,\"-3\":4}", cbor_to_json(Text::xtob("a201022204")));
+
+  // Bad CBOR
+  EXPECT_THROW(cbor_to_json(Text::xtob("a1f401")), Channel::Error);
+  EXPECT_THROW(cbor_to_json(Text::xtob("8201")), Channel::Error);
+  EXPECT_THROW(cbor_to_json(Text::xtob("ff")), Channel::Error);
+}
+
+TEST(StreamTest, TestWriterTakesWholeValues)
+{
+  string out;
+  Channel::StringWriter sw(out);
+  JSONStreamWriter writer(sw);
+  writer.start_object();
+  writer.key("records");
+  writer.start_array();
+  for(auto i=0; i<3; i++)
+    writer.value(Value(Value::OBJECT).set("id", i));
+  writer.end_array();
+  writer.key("quote\"d");
+  writer.value(Value("x"));
+  writer.end_object();
+  EXPECT_EQ("{\"records\":[{\"id\":0},{\"id\":1},{\"id\":2}],"
+            "\"quote\\\"d\":\"x\"}", out);
+}
+
+TEST(StreamTest, TestPathFiltering)
+{
+  const string text = "{\"items\": [{\"id\": 1, \"big\": {\"x\": [1,2,3]},"
+    " \"tags\": [\"a\"]}, {\"id\": 2, \"tags\": [\"b\", \"c\"]}, 3],"
+    " \"meta\": {\"count\": 2, \"a/b\": 1, \"m~n\": 2}, \"skip\": \"me\"}";
+
+  EXPECT_EQ("{\"items\":[{\"id\":1},{\"id\":2}]}",
+            json_to_json(text, {"/items/*/id"}));
+  EXPECT_EQ("{\"items\":[{\"id\":1,\"tags\":[\"a\"]},"
+            "{\"id\":2,\"tags\":[\"b\",\"c\"]}],\"meta\":{\"count\":2}}",
+            json_to_json(text, {"/items/*/id", "/items/*/tags",
+                                "/meta/count"}));
+  EXPECT_EQ("{\"items\":[{\"tags\":[\"b\",\"c\"]}]}",
+            json_to_json(text, {"/items/1/tags"}));
+  EXPECT_EQ("{\"items\":[{\"tags\":[\"a\"]},{\"tags\":[\"b\",\"c\"]}]}",
+            json_to_json(text, {"/items/*/tags/0", "/items/1/tags/1"}));
+  EXPECT_EQ("{\"meta\":{\"a/b\":1,\"m~n\":2}}",
+            json_to_json(text, {"/meta/a~1b", "/meta/m~0n"}));
+  EXPECT_EQ("{}", json_to_json(text, {"/nothing"}));
+  EXPECT_EQ(BufferParser(text).read_value().str(),
+            BufferParser(json_to_json(text, {""})).read_value().str());
+
+  // Same from CBOR
+  const auto cbor = BufferParser(text).read_value().cbor();
+  EXPECT_EQ("{\"items\":[{\"id\":1},{\"id\":2}]}",
+            cbor_to_json(cbor, {"/items/*/id"}));
+  EXPECT_EQ("{\"meta\":{\"a/b\":1,\"m~n\":2}}",
+            cbor_to_json(cbor, {"/meta/a~1b", "/meta/m~0n"}));
+
+  // Still checked when skipped
+  EXPECT_THROW(json_to_json("{\"a\": 1, \"b\": [1 2]}", {"/a"}), Exception);
+
+  // Bad pointers
+  PathFilter filter;
+  EXPECT_THROW(filter.add("items"), Exception);
+  EXPECT_THROW(filter.add("/a~2"), Exception);
+  EXPECT_THROW(filter.add("/a~"), Exception);
+}
+
+TEST(StreamTest, BenchmarkFilteredReadOfLargeDocument)
+{
+  if (!getenv("OBTOOLS_BENCHMARK"))
+    GTEST_SKIP() << "OBTOOLS_BENCHMARK not set";
+
+  const auto records = 200000;
+  const auto base = heap_bytes;
+  heap_peak = heap_bytes;
+
+  // Stream everything, then filtered to ids only
+  uint64_t size = 0;
+  auto run = [&](Handler& handler, const string& path,
+                 chrono::duration<double>& time, size_t& peak)
+  {
+    heap_peak = heap_bytes;
+    RecordReader input(records);
+    JSONStreamReader reader(input, handler);
+    if (!path.empty()) reader.add_path(path);
+    const auto start = chrono::steady_clock::now();
+    ASSERT_TRUE(reader.read());
+    time = chrono::steady_clock::now() - start;
+    peak = heap_peak - base;
+    size = input.get_offset();
+  };
+
+  CountingHandler all, ids;
+  chrono::duration<double> all_time{0}, ids_time{0};
+  size_t all_peak = 0, ids_peak = 0;
+  run(all, "", all_time, all_peak);
+  run(ids, "/*/id", ids_time, ids_peak);
+
+  EXPECT_EQ(static_cast<uint64_t>(records), ids.values);
+  EXPECT_EQ(static_cast<int64_t>(records) * (records + 1) / 2, ids.total);
+  EXPECT_EQ(records * 9u, all.values);
+
+  // Whole document as a Value, for a tenth of the records
+  RecordReader tree_input(records / 10);
+  string text;
+  tree_input.read_to_eof(text);
+  heap_peak = heap_bytes;
+  const auto tree_base = heap_bytes;
+  const auto start = chrono::steady_clock::now();
+  const auto tree = BufferParser(text).read_value();
+  chrono::duration<double> tree_time = chrono::steady_clock::now() - start;
+  const auto tree_peak = heap_peak - tree_base;
+  EXPECT_EQ(static_cast<size_t>(records / 10), tree.size());
+
+  // Bounded by depth, not size
+  EXPECT_LT(all_peak, 200000u);
+  EXPECT_LT(ids_peak, 200000u);
+
+  const auto mb = static_cast<double>(size) / 1e6;
+  cout << mb << "MB streamed: all " << mb / all_time.count() << "MB/s, "
+       << all_peak << " bytes peak; ids only " << mb / ids_time.count()
+       << "MB/s, " << ids_peak << " bytes peak\n"
+       << text.size() / 1e6 << "MB as Value tree: "
+       << text.size() / 1e6 / tree_time.count() << "MB/s, "
+       << tree_peak << " bytes peak\n";
+}
+
+//--------------------------------------------------------------------------
+// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
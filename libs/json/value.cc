@@ -58,7 +58,7 @@ vector<byte> Value::as_binary() const
 
 //--------------------------------------------------------------------------
 // Escape the string and write to the output
-void Value::write_string_to(ostream& out) const
+void Value::write_string_to(ostream& out, const string& s)
 {
   out << '"';
 
@@ -191,7 +191,7 @@ void Value::write_to(ostream& out, bool pretty, int indent) const
     case NULL_:     out << "null";                        break;
     case NUMBER:    out << f;                             break;
     case INTEGER:   out << n;                             break;
-    case STRING:    write_string_to(out);                 break;
+    case STRING:    write_string_to(out, s);              break;
     case OBJECT:    write_object_to(out, pretty, indent); break;
     case ARRAY:     write_array_to(out, pretty, indent);  break;
     case TRUE_:     out << "true";                        break;
@@ -0,0 +1,122 @@
+//==========================================================================
+// ObTools::Log: async.cc
+//
+// Asynchronous batching channel
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "ot-log.h"
+
+namespace ObTools { namespace Log {
+
+//--------------------------------------------------------------------------
+// Constructor
+AsyncChannel::AsyncChannel(Channel *_next, size_t queue_size,
+                           Policy _policy, Level _flush_level,
+                           Time::Duration _max_delay, size_t _max_batch):
+  next(_next), policy(_policy), flush_level(_flush_level),
+  max_delay(_max_delay), max_batch(max(_max_batch, size_t{1})),
+  queue(queue_size)
+{
+  writer = thread([this]() { run(); });
+}
+
+//--------------------------------------------------------------------------
+// Log a message - queues it
+void AsyncChannel::log(const Message& msg)
+{
+  if (policy == Policy::drop)
+  {
+    if (!queue.try_send(Entry{msg}))
+    {
+      dropped++;
+      return;
+    }
+  }
+  else queue.send(Entry{msg});
+
+  queued++;
+}
+
+//--------------------------------------------------------------------------
+// Write a batch and tell anyone waiting in flush()
+void AsyncChannel::write(vector<Message>& batch)
+{
+  // Report any drops since last time, in order
+  const auto d = dropped.load();
+  if (d != reported_dropped)
+  {
+    batch.emplace_back(Level::error,
+                       to_string(d - reported_dropped)
+                       + " log messages dropped");
+    reported_dropped = d;
+    next->log_batch(batch);
+    batch.pop_back();
+  }
+  else next->log_batch(batch);
+
+  {
+    MT::Lock lock(written_mutex);
+    written += batch.size();
+  }
+  written_cv.notify_all();
+  batch.clear();
+}
+
+//--------------------------------------------------------------------------
+// Background writer
+void AsyncChannel::run()
+{
+  const auto delay = chrono::duration<double>(max_delay.seconds());
+  vector<Message> batch;
+  batch.reserve(max_batch);
+
+  while (running || queue.waiting())
+  {
+    auto entry = queue.wait();
+
+    // Collect what we can, waiting up to max_delay for more unless
+    // something is urgent
+    const auto until = chrono::steady_clock::now() + delay;
+    auto urgent = false;
+    for(;;)
+    {
+      if (!entry.wakeup)
+      {
+        if (entry.msg.level <= flush_level) urgent = true;
+        batch.push_back(move(entry.msg));
+        if (batch.size() >= max_batch) break;
+      }
+      if (queue.try_receive(entry)) continue;
+      if (urgent || !running) break;
+
+      const auto now = chrono::steady_clock::now();
+      if (now >= until || !queue.wait_for(entry, until - now)) break;
+    }
+
+    if (!batch.empty()) write(batch);
+  }
+}
+
+//--------------------------------------------------------------------------
+// Wait until everything logged so far has been written
+void AsyncChannel::flush()
+{
+  const auto target = queued.load();
+  MT::Lock lock(written_mutex);
+  written_cv.wait(lock, [this, target]() { return written >= target; });
+}
+
+//--------------------------------------------------------------------------
+// Destructor
+AsyncChannel::~AsyncChannel()
+{
+  running = false;
+  // If full, the writer is busy anyway
+  queue.try_send(Entry{Message(), true});
+  if (writer.joinable()) writer.join();
+}
+
+}} // namespaces
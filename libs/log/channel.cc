@@ -10,10 +10,56 @@
 #include "ot-log.h"
 #if !defined(PLATFORM_WINDOWS)
 #include <syslog.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
 #endif
 
 namespace ObTools { namespace Log {
 
+#if !defined(PLATFORM_WINDOWS)
+namespace
+{
+  // Write all of a set of iovecs, coping with partial writes and IOV_MAX
+  void write_all(int fd, vector<iovec>& iov)
+  {
+    auto p = iov.data();
+    auto n = iov.size();
+    while (n)
+    {
+      const auto count = min(n, static_cast<size_t>(IOV_MAX));
+      auto written = ::writev(fd, p, count);
+      if (written < 0)
+      {
+        if (errno == EINTR) continue;
+        return;  // Nowhere to report it
+      }
+
+      // Skip what was written, adjusting any partly written one
+      while (n && written >= static_cast<ssize_t>(p->iov_len))
+      {
+        written -= p->iov_len;
+        p++;
+        n--;
+      }
+      if (n && written)
+      {
+        p->iov_base = static_cast<char *>(p->iov_base) + written;
+        p->iov_len -= written;
+      }
+    }
+  }
+
+  // Add a message and its EOL to iovecs
+  void add_message(vector<iovec>& iov, const Message& msg)
+  {
+    static char eol[] = "\n";
+    iov.push_back({const_cast<char *>(msg.text.data()), msg.text.size()});
+    iov.push_back({eol, 1});
+  }
+}
+#endif
 
 //==========================================================================
 // StreamChannel
@@ -29,6 +75,17 @@ void StreamChannel::log(const Message& msg)
   *stream << msg.text << endl;
 }
 
+//--------------------------------------------------------------------------
+// Log a batch, flushing once at the end
+void StreamChannel::log_batch(const vector<Message>& msgs)
+{
+  if (!stream->good())
+    stream->clear();
+  for(const auto& msg: msgs)
+    *stream << msg.text << '\n';
+  stream->flush();
+}
+
 //==========================================================================
 // OwnedStreamChannel
 
@@ -64,6 +121,36 @@ void SyslogChannel::log(const Message& msg)
 
   syslog(priority, "%s", msg.text.c_str());
 }
+
+//==========================================================================
+// FDChannel
+
+//--------------------------------------------------------------------------
+// Logging function
+void FDChannel::log(const Message& msg)
+{
+  vector<iovec> iov;
+  add_message(iov, msg);
+  write_all(fd, iov);
+}
+
+//--------------------------------------------------------------------------
+// Log a batch
+void FDChannel::log_batch(const vector<Message>& msgs)
+{
+  vector<iovec> iov;
+  iov.reserve(msgs.size()*2);
+  for(const auto& msg: msgs)
+    add_message(iov, msg);
+  write_all(fd, iov);
+}
+
+//--------------------------------------------------------------------------
+// Destructor
+FDChannel::~FDChannel()
+{
+  if (owned) ::close(fd);
+}
 #endif
 
 }} // namespaces
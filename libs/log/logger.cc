@@ -19,6 +19,10 @@ namespace ObTools { namespace Log {
 // Singleton Logger for simple Logs
 Distributor logger;
 
+//==========================================================================
+// Runtime maximum level - everything by default
+atomic<Level> max_level{Level::dump};
+
 //==========================================================================
 // Simple global log streams
 // Do not remove this restriction to single-threaded code without reading
@@ -9,6 +9,7 @@
 
 #include "ot-log.h"
 #include <cstdio>
+#include <algorithm>
 
 namespace ObTools { namespace Log {
 
@@ -22,38 +23,78 @@ StreamBuf::StreamBuf(Channel& _channel, Level _level):
   setg(0,0,0);
 }
 
+//--------------------------------------------------------------------------
+// Start a message - checks whether its level is enabled now
+void StreamBuf::start_message()
+{
+  in_message = true;
+  discarding = !is_enabled(level);
+}
+
+//--------------------------------------------------------------------------
+// End a message - passes buffer on, without EOL in it - moved, not copied
+void StreamBuf::end_message()
+{
+  if (!discarding)
+  {
+    Message msg(level, move(buffer));
+    channel.log(msg);
+  }
+  buffer.clear();
+  in_message = false;
+}
+
 //--------------------------------------------------------------------------
 // StreamBuf close() function
-// Does all the real work here!
 void StreamBuf::close()
 {
   // Avoid doing this more than once
   if (closed) return;
   closed = true;
 
-  Message msg(level, buffer);
-  channel.log(msg);
+  if (!in_message) start_message();
+  end_message();
 }
 
 //--------------------------------------------------------------------------
-// StreamBuf overflow() functitcon
+// StreamBuf overflow() function
 // Handles characters one at a time, since streambuf is unbuffered
 int StreamBuf::overflow(int c)
 {
   if (c==EOF)
-    close();
-  else if (c=='\n')
   {
-    // Pass buffer on at EOL, without EOL in it
-    Message msg(level, buffer);
-    channel.log(msg);
-    buffer.erase();
+    close();
+    return 0;
   }
-  else buffer += static_cast<char>(c);
+
+  if (!in_message) start_message();
+  if (c=='\n')
+    end_message();
+  else if (!discarding)
+    buffer += static_cast<char>(c);
 
   return 0;
 }
 
+//--------------------------------------------------------------------------
+// StreamBuf xsputn() function
+// Handles strings a line at a time
+streamsize StreamBuf::xsputn(const char *s, streamsize n)
+{
+  const auto end = s+n;
+  while (s < end)
+  {
+    if (!in_message) start_message();
+    const auto eol = find(s, end, '\n');
+    if (!discarding) buffer.append(s, eol);
+    if (eol == end) break;
+    end_message();
+    s = eol+1;
+  }
+
+  return n;
+}
+
 }} // namespaces
 
 
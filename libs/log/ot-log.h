@@ -14,8 +14,11 @@
 #include "ot-mt.h"
 #include "ot-time.h"
 #include <list>
+#include <vector>
 #include <string>
 #include <iostream>
+#include <utility>
+#include <type_traits>
 
 namespace ObTools { namespace Log {
 
@@ -69,6 +72,30 @@ inline Level& operator--(Level& level)
 #endif
 #endif
 
+//==========================================================================
+// Runtime maximum log level (logger.cc)
+// Checked by Stream at the start of each message, and then by each insert
+// before it formats anything - but the arguments are still evaluated, so
+// guard expensive ones with OBTOOLS_LOG_IF_* or if (stream).  Global to all
+// Streams, whichever channel they log to - set it
+// to the most verbose level any channel wants.  Defaults to everything
+extern atomic<Level> max_level;
+
+inline void set_max_level(Level level)
+{ max_level.store(level, memory_order_relaxed); }
+
+inline Level get_max_level()
+{ return max_level.load(memory_order_relaxed); }
+
+//--------------------------------------------------------------------------
+// Check whether a level is enabled, both at compile time and at runtime
+// Folds to false for levels above OBTOOLS_LOG_MAX_LEVEL
+inline bool is_enabled(Level level)
+{
+  return static_cast<int>(level) <= OBTOOLS_LOG_MAX_LEVEL
+    && level <= max_level.load(memory_order_relaxed);
+}
+
 //==========================================================================
 // Log message
 class Message
@@ -83,6 +110,8 @@ public:
   Message(): level(Level::none) {}
   Message(Level l, const string& t): level(l), text(t)
   { timestamp=Time::Stamp::now(); }
+  Message(Level l, string&& t): level(l), text(move(t))
+  { timestamp=Time::Stamp::now(); }
   Message(Level l, const Time::Stamp& ts, const string& t):
   level(l), timestamp(ts), text(t) {}
 };
@@ -98,6 +127,12 @@ public:
   // Abstract virtual logging function
   virtual void log(const Message& msg) = 0;
 
+  //------------------------------------------------------------------------
+  // Log a batch of messages - override if the channel can write them more
+  // efficiently together
+  virtual void log_batch(const vector<Message>& msgs)
+  { for(const auto& msg: msgs) log(msg); }
+
   //------------------------------------------------------------------------
   // Virtual destructor
   virtual ~Channel() {}
@@ -218,6 +253,10 @@ public:
   //------------------------------------------------------------------------
   // Logging function
   void log(const Message& msg);
+
+  //------------------------------------------------------------------------
+  // Log a batch, flushing once at the end
+  void log_batch(const vector<Message>& msgs) override;
 };
 
 //==========================================================================
@@ -271,8 +310,109 @@ public:
   // Logging function
   void log(const Message& msg);
 };
+
+//==========================================================================
+// Channel direct to a file descriptor, writing each message with its EOL
+// in a single writev(), and batches in as few as possible
+class FDChannel: public Channel
+{
+private:
+  int fd;
+  bool owned;
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor - closes the fd on destruction if owned is set
+  FDChannel(int _fd, bool _owned = false): fd(_fd), owned(_owned) {}
+
+  //------------------------------------------------------------------------
+  // Logging function
+  void log(const Message& msg) override;
+
+  //------------------------------------------------------------------------
+  // Log a batch
+  void log_batch(const vector<Message>& msgs) override;
+
+  //------------------------------------------------------------------------
+  // Destructor
+  ~FDChannel();
+};
 #endif
 
+//==========================================================================
+// Asynchronous channel (async.cc)
+// Queues messages in a bounded lock-free queue, and passes them to another
+// channel in batches on a background thread, so callers don't wait for
+// I/O.  Put it after any filters which format the message, so they run on
+// the caller's thread.
+// If the queue is full, either drops the message (and counts it) or blocks
+// until there is room.  Waits up to max_delay to collect a bigger batch,
+// unless a message at flush_level or more urgent arrives
+class AsyncChannel: public Channel
+{
+public:
+  enum class Policy
+  {
+    block,    // Wait for room in the queue
+    drop      // Drop the message, and count it
+  };
+
+private:
+  unique_ptr<Channel> next;
+  Policy policy;
+  Level flush_level;
+  Time::Duration max_delay;
+  size_t max_batch;
+
+  // Queued message, or a wakeup for shutdown which is never written
+  struct Entry
+  {
+    Message msg;
+    bool wakeup{false};
+  };
+  MT::BoundedQueue<Entry> queue;
+  atomic<uint64_t> queued{0};
+  atomic<uint64_t> dropped{0};
+  uint64_t reported_dropped{0};
+  atomic<bool> running{true};
+
+  // For flush() to wait for the writer
+  MT::Mutex written_mutex;
+  condition_variable written_cv;
+  uint64_t written{0};
+
+  thread writer;
+
+  void run();
+  void write(vector<Message>& batch);
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor - takes ownership of the next channel
+  // queue_size is the maximum number of messages waiting
+  AsyncChannel(Channel *_next, size_t queue_size = 4096,
+               Policy _policy = Policy::block,
+               Level _flush_level = Level::error,
+               Time::Duration _max_delay = Time::Duration{},
+               size_t _max_batch = 256);
+
+  //------------------------------------------------------------------------
+  // Log a message - queues it
+  void log(const Message& msg) override;
+
+  //------------------------------------------------------------------------
+  // Wait until everything logged so far has been written
+  void flush();
+
+  //------------------------------------------------------------------------
+  // Get the number of messages dropped because the queue was full
+  uint64_t get_dropped() const { return dropped.load(); }
+
+  //------------------------------------------------------------------------
+  // Destructor - writes anything still queued
+  ~AsyncChannel();
+};
+
 //==========================================================================
 // Log distribution point
 // Also a channel, so they can be chained
@@ -311,29 +451,76 @@ class StreamBuf: public streambuf
 private:
   string buffer;
   bool closed;
+  bool in_message = false;
+  bool discarding = false;  // Level was disabled when the message started
   Channel& channel;
   Level level;
 
+  void start_message();
+  void end_message();
+
 protected:
   // Streambuf overflow - handles characters
   int overflow(int);
 
+  // Streambuf xsputn - handles strings
+  streamsize xsputn(const char *s, streamsize n);
+
 public:
   // Constructor
   StreamBuf(Channel& _channel, Level level);
 
+  // Check whether the current message is being discarded, starting one
+  // (and checking the level) if not in one already
+  bool is_discarding()
+  {
+    if (!in_message) start_message();
+    return discarding;
+  }
+
   // Close stream
   void close();
 };
 
 // Log stream
 //  *** Note:  Not shareable between threads - see *** below
+// The level is checked at the start of each message, so long-lived streams
+// follow changes to it, and inserts into a message at a disabled level are
+// skipped without formatting - test the stream (if (log.debug) ...) to avoid
+// building the arguments as well
 class Stream: public ostream
 {
+private:
+  Level level;
+
+  bool is_discarding()
+  { return static_cast<StreamBuf *>(rdbuf())->is_discarding(); }
+
 public:
   // Constructor - like ofstream
-  Stream(Channel &channel, Level level):
-    ostream(new StreamBuf(channel, level)) {}
+  Stream(Channel &channel, Level _level):
+    ostream(new StreamBuf(channel, _level)), level(_level) {}
+
+  // Check whether the level is enabled now - hide ostream's
+  explicit operator bool() const { return !fail() && is_enabled(level); }
+  bool operator!() const { return !static_cast<bool>(*this); }
+
+  // Insert anything ostream can - skipped if the level is disabled, except
+  // for text, which costs nothing to format and may end the message
+  template<typename T> Stream& operator<<(T&& value)
+  {
+    using V = decay_t<T>;
+    if (is_same<V, char>::value || is_same<V, const char *>::value
+        || is_same<V, char *>::value || is_same<V, string>::value
+        || !is_discarding())
+      static_cast<ostream&>(*this) << forward<T>(value);
+    return *this;
+  }
+
+  // Manipulators are always applied, so endl still ends the message
+  Stream& operator<<(ostream& (*f)(ostream&)) { f(*this); return *this; }
+  Stream& operator<<(ios& (*f)(ios&)) { f(*this); return *this; }
+  Stream& operator<<(ios_base& (*f)(ios_base&)) { f(*this); return *this; }
 
   // Destructor
   ~Stream() { delete rdbuf(); }
@@ -349,6 +536,8 @@ extern Distributor logger;
 
 //==========================================================================
 // Useful macros for optimising out high log levels
+// Compiled out entirely above OBTOOLS_LOG_MAX_LEVEL, otherwise skipped unless
+// the level is enabled at runtime
 //
 // e.g.
 //  OBTOOLS_LOG_IF_DUMP(ObTools::Log::Dump << "Packet: " << packet;)
@@ -357,8 +546,19 @@ extern Distributor logger;
 // #if OBTOOLS_LOG_DEBUG
 //  ...
 
+#define OBTOOLS_LOG_IF_ENABLED(_level, _s) \
+  if (!ObTools::Log::is_enabled(ObTools::Log::Level::_level)) {} else { _s }
+
+#if OBTOOLS_LOG_MAX_LEVEL >= OBTOOLS_LOG_LEVEL_DETAIL
+#define OBTOOLS_LOG_IF_DETAIL(_s) OBTOOLS_LOG_IF_ENABLED(detail, _s)
+#define OBTOOLS_LOG_DETAIL 1
+#else
+#define OBTOOLS_LOG_IF_DETAIL(_s)
+#define OBTOOLS_LOG_DETAIL 0
+#endif
+
 #if OBTOOLS_LOG_MAX_LEVEL >= OBTOOLS_LOG_LEVEL_DEBUG
-#define OBTOOLS_LOG_IF_DEBUG(_s) _s
+#define OBTOOLS_LOG_IF_DEBUG(_s) OBTOOLS_LOG_IF_ENABLED(debug, _s)
 #define OBTOOLS_LOG_DEBUG 1
 #else
 #define OBTOOLS_LOG_IF_DEBUG(_s)
@@ -366,7 +566,7 @@ extern Distributor logger;
 #endif
 
 #if OBTOOLS_LOG_MAX_LEVEL >= OBTOOLS_LOG_LEVEL_DUMP
-#define OBTOOLS_LOG_IF_DUMP(_s) _s
+#define OBTOOLS_LOG_IF_DUMP(_s) OBTOOLS_LOG_IF_ENABLED(dump, _s)
 #define OBTOOLS_LOG_DUMP 1
 #else
 #define OBTOOLS_LOG_IF_DUMP(_s)
@@ -0,0 +1,226 @@
+//==========================================================================
+// ObTools::Log: test-async.cc
+//
+// Test harness for asynchronous logging, including a benchmark of caller
+// time against synchronous logging
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include <gtest/gtest.h>
+#include "ot-log.h"
+#include <fstream>
+#include <unistd.h>
+#include <fcntl.h>
+
+using namespace std;
+using namespace ObTools;
+
+// Channel which records batches, and can be held up
+class RecordingChannel: public Log::Channel
+{
+public:
+  MT::Mutex mutex;
+  vector<string> lines;
+  vector<size_t> batch_sizes;
+  MT::Condition open{true};
+
+  void log(const Log::Message& msg) override
+  {
+    log_batch(vector<Log::Message>{msg});
+  }
+
+  void log_batch(const vector<Log::Message>& msgs) override
+  {
+    open.wait();
+    MT::Lock lock(mutex);
+    for(const auto& msg: msgs) lines.push_back(msg.text);
+    batch_sizes.push_back(msgs.size());
+  }
+};
+
+TEST(AsyncChannelTest, TestMessagesArriveInOrder)
+{
+  auto rec = new RecordingChannel;
+  Log::AsyncChannel async(rec);
+  for(auto i=0; i<1000; i++)
+    async.log(Log::Message(Log::Level::detail, to_string(i)));
+  async.flush();
+
+  ASSERT_EQ(1000u, rec->lines.size());
+  for(auto i=0; i<1000; i++) ASSERT_EQ(to_string(i), rec->lines[i]);
+  EXPECT_EQ(0u, async.get_dropped());
+}
+
+TEST(AsyncChannelTest, TestEmptyMessageIsNotTakenAsWakeup)
+{
+  auto rec = new RecordingChannel;
+  Log::AsyncChannel async(rec);
+  async.log(Log::Message());
+  async.log(Log::Message(Log::Level::detail, "after"));
+  async.flush();
+
+  ASSERT_EQ(2u, rec->lines.size());
+  EXPECT_EQ("", rec->lines[0]);
+  EXPECT_EQ("after", rec->lines[1]);
+}
+
+TEST(AsyncChannelTest, TestBatchesWaitForDelayUnlessUrgent)
+{
+  auto rec = new RecordingChannel;
+  Log::AsyncChannel async(rec, 100, Log::AsyncChannel::Policy::block,
+                          Log::Level::error, Time::Duration{0.05}, 10);
+  for(auto i=0; i<25; i++)
+    async.log(Log::Message(Log::Level::detail, "x"));
+  async.flush();
+
+  // Limited by max batch
+  MT::Lock lock(rec->mutex);
+  EXPECT_EQ(25u, rec->lines.size());
+  for(auto n: rec->batch_sizes) EXPECT_LE(n, 10u);
+  lock.unlock();
+
+  // Error goes straight through, without waiting for the delay
+  auto start = chrono::steady_clock::now();
+  async.log(Log::Message(Log::Level::error, "oops"));
+  async.flush();
+  EXPECT_LT(chrono::steady_clock::now() - start, chrono::milliseconds{40});
+}
+
+TEST(AsyncChannelTest, TestDropPolicyCountsAndReports)
+{
+  auto rec = new RecordingChannel;
+  rec->open.clear();  // Hold up the writer
+  {
+    Log::AsyncChannel async(rec, 4, Log::AsyncChannel::Policy::drop);
+    for(auto i=0; i<100; i++)
+      async.log(Log::Message(Log::Level::detail, "m"));
+
+    // Writer has one batch in hand, up to 4 (rounded) queued
+    EXPECT_GE(async.get_dropped(), 90u);
+    EXPECT_LT(async.get_dropped(), 100u);
+    auto dropped = async.get_dropped();
+
+    rec->open.signal();
+    async.flush();
+    async.log(Log::Message(Log::Level::detail, "after"));
+    async.flush();
+
+    // Reported once, after the messages that were kept
+    MT::Lock lock(rec->mutex);
+    ASSERT_EQ(100 - dropped + 2, rec->lines.size());
+    EXPECT_EQ(to_string(dropped) + " log messages dropped",
+              rec->lines[rec->lines.size()-2]);
+    EXPECT_EQ("after", rec->lines.back());
+  }
+}
+
+TEST(AsyncChannelTest, TestFDChannelWritesBatches)
+{
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  {
+    Log::Distributor dtr;
+    dtr.connect(new Log::AsyncChannel(new Log::FDChannel(fds[1], true)));
+    Log::Stream s(dtr, Log::Level::summary);
+    s << "one\ntwo\n";
+    s << "three" << endl;
+  }
+
+  string text;
+  char buf[100];
+  ssize_t n;
+  while ((n = read(fds[0], buf, sizeof(buf))) > 0) text.append(buf, n);
+  close(fds[0]);
+  EXPECT_EQ("one\ntwo\nthree\n", text);
+}
+
+TEST(AsyncChannelTest, TestConcurrentProducersNotInterleaved)
+{
+  stringstream ss;
+  {
+    Log::Distributor dtr;
+    dtr.connect(new Log::AsyncChannel(new Log::StreamChannel(&ss), 64));
+    vector<thread> threads;
+    for(auto t=0; t<8; t++)
+      threads.emplace_back([&dtr]()
+      {
+        for(auto i=0; i<1000; i++)
+          dtr.log(Log::Message(Log::Level::detail,
+                               "This is not interleaved"));
+      });
+    for(auto& t: threads) t.join();
+  }
+
+  string line;
+  auto lines = 0;
+  while (getline(ss, line))
+  {
+    ASSERT_EQ("This is not interleaved", line);
+    lines++;
+  }
+  EXPECT_EQ(8000, lines);
+}
+
+//--------------------------------------------------------------------------
+// Log from a number of threads, return caller time per message in ns
+double run_load(Log::Channel& channel, int threads, int messages)
+{
+  auto start = chrono::steady_clock::now();
+  vector<thread> ts;
+  for(auto t=0; t<threads; t++)
+    ts.emplace_back([&channel, messages]()
+    {
+      for(auto i=0; i<messages; i++)
+        channel.log(Log::Message(Log::Level::detail,
+                                 "12:00:00 [3]: Request handled in 42us"));
+    });
+  for(auto& t: ts) t.join();
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  return elapsed.count() * 1e9 / (threads * messages);
+}
+
+TEST(AsyncChannelTest, BenchmarkCallerTimeAgainstSynchronous)
+{
+  if (!getenv("OBTOOLS_BENCHMARK"))
+    GTEST_SKIP() << "OBTOOLS_BENCHMARK not set";
+
+  const auto threads = 4;
+  const auto messages = 50000;
+  const auto path = "/tmp/ot-log-test-async.log";
+
+  double sync_ns, async_ns;
+  {
+    Log::Distributor dtr;
+    dtr.connect(new Log::OwnedStreamChannel(new ofstream(path)));
+    sync_ns = run_load(dtr, threads, messages);
+  }
+  {
+    Log::Distributor dtr;
+    auto fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ASSERT_LE(0, fd);
+    auto async = new Log::AsyncChannel(new Log::FDChannel(fd, true), 16384);
+    dtr.connect(async);
+    async_ns = run_load(dtr, threads, messages);
+    async->flush();
+  }
+
+  // All written
+  ifstream in(path);
+  auto lines = 0;
+  string line;
+  while (getline(in, line)) lines++;
+  EXPECT_EQ(threads * messages, lines);
+  unlink(path);
+
+  cout << threads << " threads, caller ns/message: synchronous "
+       << static_cast<int>(sync_ns) << ", async "
+       << static_cast<int>(async_ns) << " (x" << sync_ns / async_ns << ")\n";
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -67,6 +67,157 @@ TEST(LogFilters, TestMessagesLoggedOkFromConcurrentThreads)
   }
 }
 
+TEST(LogLevels, TestDisabledLevelIsNotFormatted)
+{
+  ostringstream oss;
+  Log::Distributor dtr{};
+  dtr.connect(new Log::StreamChannel{&oss});
+
+  Log::set_max_level(Log::Level::summary);
+  EXPECT_TRUE(Log::is_enabled(Log::Level::error));
+  EXPECT_FALSE(Log::is_enabled(Log::Level::detail));
+  {
+    Log::Stream detail(dtr, Log::Level::detail);
+    EXPECT_FALSE(detail);
+    detail << "Detail " << 42 << endl;
+    Log::Stream summary(dtr, Log::Level::summary);
+    EXPECT_TRUE(summary);
+    summary << "Summary " << 42 << endl;
+  }
+  EXPECT_EQ("Summary 42\n", oss.str());
+
+  Log::set_max_level(Log::Level::dump);
+  Log::Stream detail(dtr, Log::Level::detail);
+  detail << "Detail " << 42 << endl;
+  EXPECT_EQ("Summary 42\nDetail 42\n", oss.str());
+}
+
+TEST(LogLevels, TestLongLivedStreamFollowsLevelChanges)
+{
+  ostringstream oss;
+  Log::Distributor dtr{};
+  dtr.connect(new Log::StreamChannel{&oss});
+
+  Log::set_max_level(Log::Level::summary);
+  Log::Stream detail(dtr, Log::Level::detail);
+  EXPECT_FALSE(detail);
+  detail << "One " << 1 << endl;
+
+  Log::set_max_level(Log::Level::detail);
+  EXPECT_TRUE(detail);
+  detail << "Two " << 2 << endl;
+
+  Log::set_max_level(Log::Level::summary);
+  EXPECT_FALSE(detail);
+  detail << "Three\nFour\n";
+  Log::set_max_level(Log::Level::dump);
+  detail << "Five\n";
+
+  EXPECT_EQ("Two 2\nFive\n", oss.str());
+}
+
+// Type which counts how often it is formatted
+struct Counted {};
+int counted_formats = 0;
+ostream& operator<<(ostream& s, const Counted&)
+{
+  counted_formats++;
+  return s << "counted";
+}
+
+TEST(LogLevels, TestDisabledLevelNeverCallsInserter)
+{
+  ostringstream oss;
+  Log::Distributor dtr{};
+  dtr.connect(new Log::StreamChannel{&oss});
+
+  counted_formats = 0;
+  Log::set_max_level(Log::Level::summary);
+  Log::Stream detail(dtr, Log::Level::detail);
+  detail << "One " << Counted() << hex << 42 << endl;
+  detail << Counted() << "\n" << Counted() << endl;
+  EXPECT_EQ(0, counted_formats);
+
+  Log::set_max_level(Log::Level::detail);
+  detail << "Two " << Counted() << " " << 42 << endl;
+  EXPECT_EQ(1, counted_formats);
+  Log::set_max_level(Log::Level::dump);
+
+  EXPECT_EQ("Two counted 2a\n", oss.str());
+}
+
+TEST(LogLevels, TestMacrosCheckRuntimeLevel)
+{
+  auto runs = 0;
+  Log::set_max_level(Log::Level::detail);
+  OBTOOLS_LOG_IF_DETAIL(runs++;)
+  OBTOOLS_LOG_IF_DEBUG(runs += 10;)
+
+  Log::set_max_level(Log::Level::dump);
+  OBTOOLS_LOG_IF_DEBUG(runs += 100;)
+
+  EXPECT_EQ(OBTOOLS_LOG_DETAIL + 100*OBTOOLS_LOG_DEBUG, runs);
+}
+
+//--------------------------------------------------------------------------
+// Per-call cost of a typical log statement, in ns
+double time_statement(Log::Channel& channel, Log::Level level, int n)
+{
+  auto start = chrono::steady_clock::now();
+  for(auto i=0; i<n; i++)
+  {
+    Log::Stream log(channel, level);
+    log << "Request " << i << " from " << "10.0.0.1:8080"
+        << " took " << 0.042 << "s\n";
+  }
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  return elapsed.count() * 1e9 / n;
+}
+
+// Same, but guarded by the macro so the stream isn't even created
+double time_guarded_statement(Log::Channel& channel, int n)
+{
+  auto start = chrono::steady_clock::now();
+  for(auto i=0; i<n; i++)
+  {
+    OBTOOLS_LOG_IF_DETAIL(
+      Log::Stream log(channel, Log::Level::detail);
+      log << "Request " << i << " from " << "10.0.0.1:8080"
+          << " took " << 0.042 << "s\n";
+    )
+  }
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  return elapsed.count() * 1e9 / n;
+}
+
+TEST(LogLevels, BenchmarkDisabledAndEnabledStatements)
+{
+  if (!getenv("OBTOOLS_BENCHMARK"))
+    GTEST_SKIP() << "OBTOOLS_BENCHMARK not set";
+
+  const auto n = 100000;
+  Log::Distributor dtr{};
+  dtr.connect(new Log::LevelFilter{new Log::OwnedStreamChannel{new ostringstream},
+                                   Log::Level::summary});
+
+  // Old behaviour: everything formatted, then dropped by the filter
+  Log::set_max_level(Log::Level::dump);
+  const auto filtered_ns = time_statement(dtr, Log::Level::detail, n);
+
+  Log::set_max_level(Log::Level::summary);
+  const auto disabled_ns = time_statement(dtr, Log::Level::detail, n);
+  const auto enabled_ns = time_statement(dtr, Log::Level::summary, n);
+  const auto guarded_ns = time_guarded_statement(dtr, n);
+  Log::set_max_level(Log::Level::dump);
+
+  cout << "Per statement: enabled " << static_cast<int>(enabled_ns)
+       << "ns, filtered " << static_cast<int>(filtered_ns)
+       << "ns, disabled " << static_cast<int>(disabled_ns) << "ns (x"
+       << filtered_ns / disabled_ns << "), disabled in macro "
+       << guarded_ns << "ns\n";
+  EXPECT_LT(disabled_ns, filtered_ns);
+}
+
 int main(int argc, char **argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
@@ -28,3 +28,17 @@ SHA256::hash_t SHA256::hash_func(const Node<SHA256::hash_t, void>& left,
   return result;
 }
 
+SHA256::fixed_hash_t SHA256::hash_pair(const fixed_hash_t& left,
+                                       const fixed_hash_t& right)
+{
+  static_assert(sizeof(fixed_hash_t) == Crypto::SHA256::DIGEST_LENGTH,
+                "SHA256 fixed hash size");
+
+  Crypto::SHA256 sha256;
+  sha256.update(left.data(), left.size());
+  sha256.update(right.data(), right.size());
+
+  fixed_hash_t result;
+  sha256.get_result(result.data());
+  return result;
+}
@@ -14,7 +14,11 @@
 #include <memory>
 #include <vector>
 #include <queue>
+#include <array>
 #include <functional>
+#include <utility>
+#include <stdexcept>
+#include <thread>
 
 namespace ObTools { namespace Merkle {
 
@@ -124,15 +128,15 @@ HashT pass_through_single_child_hash(const NodeT& left)
 //==========================================================================
 // Merkle Tree Branch
 template <typename NodeT>
-using BranchHashFuncT = decltype(((NodeT *)nullptr)->get_hash())
+using BranchHashFuncT = decltype(declval<NodeT&>().get_hash())
                         (*)(const NodeT& left, const NodeT& right);
 
 template <typename NodeT>
-using BranchSingleHashFuncT = decltype(((NodeT *)nullptr)->get_hash())
+using BranchSingleHashFuncT = decltype(declval<NodeT&>().get_hash())
                               (*)(const NodeT& left);
 
 template <typename NodeT>
-using BranchDataAggregationFuncT = decltype(((NodeT *)nullptr)->get_data())
+using BranchDataAggregationFuncT = decltype(declval<NodeT&>().get_data())
                                    (*)(const NodeT& left, const NodeT& right);
 
 template <typename HashT, typename DataT,
@@ -305,6 +309,257 @@ using SumTree = GenericTree<LeafDataT, Node<HashT, DataT>,
                             Branch<HashT, DataT, BranchHashFunc,
                                    BranchDataAggregationFunc, BranchSingleHashFunc>>;
 
+//==========================================================================
+// Flat Merkle Tree
+// Holds hashes in an array per level, leaves at level 0, with the same
+// shape as Tree - each level pairs left to right and an odd last node is
+// promoted unchanged - so the root hash is the same.  This is also the
+// RFC 6962 shape, which makes its consistency proofs work
+// Supports appending and updating leaves in O(log n), and inclusion and
+// consistency proofs
+template<typename HashT, HashT (*HashFunc)(const HashT& left,
+                                           const HashT& right)>
+class FlatTree
+{
+public:
+  using Proof = vector<HashT>;
+
+private:
+  vector<vector<HashT>> levels;  // [0] is leaves, back() is root if any
+
+  // Minimum nodes each thread takes when building in parallel
+  static constexpr size_t min_nodes_per_thread = 4096;
+
+  // Build one level from the one below, across threads
+  static void build_level(const vector<HashT>& below, vector<HashT>& level,
+                          unsigned threads)
+  {
+    level.resize((below.size()+1)/2);
+    auto build = [&below, &level](size_t from, size_t to)
+    {
+      for(auto i=from; i<to; i++)
+        level[i] = (2*i+1 < below.size())
+          ? HashFunc(below[2*i], below[2*i+1]) : below[2*i];
+    };
+
+    const auto per_thread = max(min_nodes_per_thread,
+                                (level.size() + threads - 1) / threads);
+    vector<thread> workers;
+    for(auto from = per_thread; from < level.size(); from += per_thread)
+      workers.emplace_back(build, from, min(from + per_thread,
+                                            level.size()));
+    build(0, min(per_thread, level.size()));
+    for(auto& w: workers) w.join();
+  }
+
+  // Recalculate the ancestors of a leaf
+  void update_path(uint64_t index)
+  {
+    for(auto k=0u; levels[k].size() > 1; k++)
+    {
+      if (k+1 == levels.size()) levels.emplace_back();
+      const auto& level = levels[k];
+      auto& parents = levels[k+1];
+      const auto left = index & ~1ULL;
+      const auto hash = (left+1 < level.size())
+        ? HashFunc(level[left], level[left+1]) : level[left];
+      index /= 2;
+      if (index == parents.size())
+        parents.push_back(hash);
+      else
+        parents[index] = hash;
+    }
+  }
+
+  // Get the hash of the leaves from start, 2^level of them or to the end
+  const HashT& subtree_hash(uint64_t start, unsigned level) const
+  {
+    return levels[level][start >> level];
+  }
+
+  // Consistency subproof for the first m leaves of the n from start,
+  // as RFC 6962 2.1.2 - whole says whether the m are a whole old tree
+  void add_consistency(uint64_t m, uint64_t start, uint64_t n, bool whole,
+                       Proof& proof) const
+  {
+    if (m == n)
+    {
+      if (!whole) proof.push_back(subtree_hash(start, ceil_log2(n)));
+      return;
+    }
+
+    // Largest power of 2 less than n
+    const auto k = 1ULL << (ceil_log2(n) - 1);
+    if (m <= k)
+    {
+      add_consistency(m, start, k, whole, proof);
+      proof.push_back(subtree_hash(start+k, ceil_log2(n-k)));
+    }
+    else
+    {
+      add_consistency(m-k, start+k, n-k, false, proof);
+      proof.push_back(subtree_hash(start, ceil_log2(k)));
+    }
+  }
+
+  // Smallest l with 2^l >= n
+  static unsigned ceil_log2(uint64_t n)
+  {
+    auto l = 0u;
+    while ((1ULL << l) < n) l++;
+    return l;
+  }
+
+public:
+  //------------------------------------------------------------------------
+  // Constructors - threads=0 means use all cores
+  FlatTree() {}
+  FlatTree(const vector<HashT>& leaves, unsigned threads = 0):
+    levels{leaves}
+  {
+    if (!threads) threads = max(1u, thread::hardware_concurrency());
+    while (levels.back().size() > 1)
+    {
+      vector<HashT> level;
+      build_level(levels.back(), level, threads);
+      levels.push_back(std::move(level));
+    }
+  }
+
+  //------------------------------------------------------------------------
+  // Get number of leaves
+  uint64_t size() const { return levels.empty() ? 0 : levels[0].size(); }
+
+  //------------------------------------------------------------------------
+  // Get the root hash - default HashT if empty
+  HashT get_hash() const
+  {
+    return size() ? levels.back()[0] : HashT{};
+  }
+
+  //------------------------------------------------------------------------
+  // Get a leaf
+  const HashT& get_leaf(uint64_t index) const { return levels.at(0).at(index); }
+
+  //------------------------------------------------------------------------
+  // Add a leaf at the end
+  void append(const HashT& leaf)
+  {
+    if (levels.empty()) levels.emplace_back();
+    levels[0].push_back(leaf);
+    update_path(levels[0].size()-1);
+  }
+
+  //------------------------------------------------------------------------
+  // Change a leaf
+  // Throws out_of_range if it doesn't exist
+  void update(uint64_t index, const HashT& leaf)
+  {
+    levels.at(0).at(index) = leaf;
+    update_path(index);
+  }
+
+  //------------------------------------------------------------------------
+  // Get proof that a leaf is included - sibling hashes from the bottom up
+  // Throws out_of_range if it doesn't exist
+  Proof inclusion_proof(uint64_t index) const
+  {
+    if (index >= size()) throw out_of_range("Merkle inclusion proof");
+    Proof proof;
+    for(auto k=0u; k+1 < levels.size(); k++, index /= 2)
+    {
+      const auto sibling = index ^ 1;
+      if (sibling < levels[k].size()) proof.push_back(levels[k][sibling]);
+    }
+    return proof;
+  }
+
+  //------------------------------------------------------------------------
+  // Verify an inclusion proof for a leaf at index in a tree of size
+  // leaves with the given root
+  static bool verify_proof(const HashT& leaf, uint64_t index, uint64_t size,
+                           const Proof& proof, const HashT& root)
+  {
+    if (index >= size) return false;
+    auto hash = leaf;
+    auto p = proof.begin();
+    for(; size > 1; index /= 2, size = (size+1)/2)
+    {
+      if (index & 1)
+      {
+        if (p == proof.end()) return false;
+        hash = HashFunc(*p++, hash);
+      }
+      else if (index+1 < size)
+      {
+        if (p == proof.end()) return false;
+        hash = HashFunc(hash, *p++);
+      }
+      // else promoted
+    }
+    return p == proof.end() && hash == root;
+  }
+
+  //------------------------------------------------------------------------
+  // Get proof that the tree of the first old_size leaves is a prefix of
+  // this one (RFC 6962 2.1.2)
+  // Throws out_of_range if old_size is more than size()
+  Proof consistency_proof(uint64_t old_size) const
+  {
+    if (old_size > size()) throw out_of_range("Merkle consistency proof");
+    Proof proof;
+    if (old_size) add_consistency(old_size, 0, size(), true, proof);
+    return proof;
+  }
+
+  //------------------------------------------------------------------------
+  // Verify a consistency proof between tree sizes and roots
+  // (RFC 9162 2.1.4.2)
+  static bool verify_consistency(uint64_t old_size, uint64_t new_size,
+                                 const HashT& old_root, const HashT& new_root,
+                                 const Proof& proof)
+  {
+    if (old_size > new_size) return false;
+    if (old_size == new_size) return proof.empty() && old_root == new_root;
+    if (!old_size) return proof.empty();
+
+    // A whole power of 2 old tree is left implicit in the proof
+    auto p = proof.begin();
+    const auto whole = !(old_size & (old_size-1));
+    if (!whole && p == proof.end()) return false;
+    auto old_hash = whole ? old_root : *p++;
+    auto new_hash = old_hash;
+
+    auto fn = old_size-1;
+    auto sn = new_size-1;
+    while (fn & 1)
+    {
+      fn >>= 1;
+      sn >>= 1;
+    }
+
+    for(; p != proof.end(); ++p)
+    {
+      if (!sn) return false;
+      if ((fn & 1) || fn == sn)
+      {
+        old_hash = HashFunc(*p, old_hash);
+        new_hash = HashFunc(*p, new_hash);
+        while (!(fn & 1) && fn)
+        {
+          fn >>= 1;
+          sn >>= 1;
+        }
+      }
+      else new_hash = HashFunc(new_hash, *p);
+      fn >>= 1;
+      sn >>= 1;
+    }
+
+    return !sn && old_hash == old_root && new_hash == new_root;
+  }
+};
+
 //==========================================================================
 // Common hash types
 namespace Hash
@@ -315,6 +570,11 @@ namespace Hash
     using hash_t = vector<byte>;
     static hash_t hash_func(const Node<hash_t, void>& left_hash,
                             const Node<hash_t, void>& right_hash);
+
+    // Fixed size, for FlatTree
+    using fixed_hash_t = array<byte, 32>;
+    static fixed_hash_t hash_pair(const fixed_hash_t& left_hash,
+                                  const fixed_hash_t& right_hash);
   };
 }
 
@@ -0,0 +1,207 @@
+//==========================================================================
+// ObTools::Merkle: test-flat-tree.cc
+//
+// Test harness for flat Merkle tree, including a benchmark against Tree
+//
+// Copyright (c) 2026 Paul Clark
+//==========================================================================
+
+#include <gtest/gtest.h>
+#include "ot-merkle.h"
+#include "ot-text.h"
+#include <chrono>
+
+using namespace std;
+using namespace ObTools;
+using namespace ObTools::Merkle;
+
+string test_hash_func(const string& left, const string& right)
+{
+  return "(" + left + ":" + right + ")";
+}
+
+string test_node_hash_func(const Node<string>& left, const Node<string>& right)
+{
+  return test_hash_func(left.get_hash(), right.get_hash());
+}
+
+using StringTree = FlatTree<string, test_hash_func>;
+using SHA256Tree = FlatTree<Hash::SHA256::fixed_hash_t,
+                            Hash::SHA256::hash_pair>;
+
+vector<string> make_leaves(int n)
+{
+  vector<string> leaves;
+  for(auto i=0; i<n; i++) leaves.push_back(Text::itos(i));
+  return leaves;
+}
+
+Hash::SHA256::fixed_hash_t make_sha256_leaf(int i)
+{
+  Hash::SHA256::fixed_hash_t hash{};
+  for(auto j=0u; j<sizeof(i); j++)
+    hash[j] = static_cast<byte>(i >> (8*j));
+  return hash;
+}
+
+TEST(FlatTree, RootMatchesTreeForAllSizes)
+{
+  for(auto n=1; n<=33; n++)
+  {
+    const auto leaves = make_leaves(n);
+    const auto tree = Tree<string, test_node_hash_func>(leaves);
+    const auto flat = StringTree(leaves);
+    ASSERT_EQ(tree.get_hash(), flat.get_hash()) << n;
+    ASSERT_EQ(static_cast<uint64_t>(n), flat.size());
+  }
+  EXPECT_EQ("(((0:1):(2:3)):4)", StringTree(make_leaves(5)).get_hash());
+}
+
+TEST(FlatTree, AppendAndUpdateMatchRebuild)
+{
+  StringTree tree;
+  EXPECT_EQ("", tree.get_hash());
+  vector<string> leaves;
+  for(auto i=0; i<40; i++)
+  {
+    leaves.push_back(Text::itos(i));
+    tree.append(leaves.back());
+    ASSERT_EQ(StringTree(leaves).get_hash(), tree.get_hash()) << i;
+  }
+
+  for(const auto i: {0, 17, 38, 39})
+  {
+    leaves[i] = "x" + leaves[i];
+    tree.update(i, leaves[i]);
+    ASSERT_EQ(StringTree(leaves).get_hash(), tree.get_hash()) << i;
+    EXPECT_EQ(leaves[i], tree.get_leaf(i));
+  }
+  EXPECT_THROW(tree.update(40, "no"), out_of_range);
+}
+
+TEST(FlatTree, InclusionProofsVerify)
+{
+  for(auto n=1; n<=20; n++)
+  {
+    const auto tree = StringTree(make_leaves(n));
+    const auto root = tree.get_hash();
+    for(auto i=0; i<n; i++)
+    {
+      auto proof = tree.inclusion_proof(i);
+      const auto leaf = Text::itos(i);
+      ASSERT_TRUE(StringTree::verify_proof(leaf, i, n, proof, root))
+        << n << "/" << i;
+      EXPECT_FALSE(StringTree::verify_proof("bad", i, n, proof, root));
+      if (n > 1)
+      {
+        EXPECT_FALSE(StringTree::verify_proof(leaf, (i+1)%n, n, proof,
+                                              root));
+      }
+      if (!proof.empty())
+      {
+        proof.pop_back();
+        EXPECT_FALSE(StringTree::verify_proof(leaf, i, n, proof, root));
+      }
+    }
+  }
+  EXPECT_THROW(StringTree(make_leaves(3)).inclusion_proof(3), out_of_range);
+}
+
+TEST(FlatTree, ConsistencyProofsVerify)
+{
+  vector<Hash::SHA256::fixed_hash_t> roots;
+  SHA256Tree tree;
+  roots.push_back(tree.get_hash());
+  for(auto n=1; n<=40; n++)
+  {
+    tree.append(make_sha256_leaf(n));
+    roots.push_back(tree.get_hash());
+    for(auto m=0; m<=n; m++)
+    {
+      const auto proof = tree.consistency_proof(m);
+      ASSERT_TRUE(SHA256Tree::verify_consistency(m, n, roots[m], roots[n],
+                                                 proof)) << m << "/" << n;
+      if (m && m < n)
+      {
+        EXPECT_FALSE(SHA256Tree::verify_consistency(m, n, roots[m-1],
+                                                    roots[n], proof));
+        EXPECT_FALSE(SHA256Tree::verify_consistency(m, n, roots[m],
+                                                    roots[n-1], proof));
+      }
+    }
+  }
+  EXPECT_THROW(tree.consistency_proof(41), out_of_range);
+}
+
+TEST(FlatTree, ParallelBuildMatchesSequential)
+{
+  vector<Hash::SHA256::fixed_hash_t> leaves;
+  for(auto i=0; i<100001; i++) leaves.push_back(make_sha256_leaf(i));
+  EXPECT_EQ(SHA256Tree(leaves, 1).get_hash(), SHA256Tree(leaves, 7).get_hash());
+}
+
+TEST(FlatTree, BenchmarkMillionLeavesAgainstTree)
+{
+  if (!getenv("OBTOOLS_BENCHMARK"))
+    GTEST_SKIP() << "OBTOOLS_BENCHMARK not set";
+
+  const auto n = 1000000;
+  vector<Hash::SHA256::fixed_hash_t> leaves;
+  vector<Hash::SHA256::hash_t> vector_leaves;
+  for(auto i=0; i<n; i++)
+  {
+    leaves.push_back(make_sha256_leaf(i));
+    vector_leaves.emplace_back(leaves.back().begin(), leaves.back().end());
+  }
+
+  auto start = chrono::steady_clock::now();
+  const auto tree = Tree<Hash::SHA256::hash_t,
+                         Hash::SHA256::hash_func>(vector_leaves);
+  const auto tree_hash = tree.get_hash();
+  chrono::duration<double> tree_time = chrono::steady_clock::now() - start;
+
+  start = chrono::steady_clock::now();
+  const auto flat = SHA256Tree(leaves, 1);
+  chrono::duration<double> flat_time = chrono::steady_clock::now() - start;
+
+  const auto threads = max(1u, thread::hardware_concurrency());
+  start = chrono::steady_clock::now();
+  auto parallel = SHA256Tree(leaves);
+  chrono::duration<double> parallel_time = chrono::steady_clock::now() - start;
+
+  const auto flat_hash = flat.get_hash();
+  ASSERT_EQ(tree_hash, Hash::SHA256::hash_t(flat_hash.begin(),
+                                            flat_hash.end()));
+  ASSERT_EQ(flat.get_hash(), parallel.get_hash());
+
+  const auto appends = 100000;
+  start = chrono::steady_clock::now();
+  for(auto i=0; i<appends; i++) parallel.append(make_sha256_leaf(n+i));
+  chrono::duration<double> append_time = chrono::steady_clock::now() - start;
+
+  start = chrono::steady_clock::now();
+  const auto root = parallel.get_hash();
+  for(auto i=0; i<appends; i++)
+  {
+    const auto index = i * 11;
+    ASSERT_TRUE(SHA256Tree::verify_proof(parallel.get_leaf(index), index,
+                                         parallel.size(),
+                                         parallel.inclusion_proof(index),
+                                         root));
+  }
+  chrono::duration<double> proof_time = chrono::steady_clock::now() - start;
+
+  cout << n << " leaves: Tree " << tree_time.count() << "s, FlatTree "
+       << flat_time.count() << "s (x" << tree_time.count() / flat_time.count()
+       << "), " << threads << " threads " << parallel_time.count() << "s (x"
+       << tree_time.count() / parallel_time.count() << ")\n"
+       << "Append " << append_time.count() * 1e6 / appends
+       << "us, proof and verify " << proof_time.count() * 1e6 / appends
+       << "us\n";
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
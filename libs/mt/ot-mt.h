@@ -13,9 +13,11 @@
 #define __OBTOOLS_MT_H
 
 #include <thread>
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
 #include <queue>
+#include <deque>
 #include <list>
 #include <memory>
 #include <map>
@@ -601,6 +603,243 @@ public:
   }
 };
 
+//==========================================================================
+// Bounded multi-producer, multi-consumer queue
+// Lock-free (Dmitry Vyukov's algorithm): each cell carries a sequence
+// number which says whether it is ready to be written or read on this lap,
+// so producers and consumers only contend on their own position counters
+// Capacity is rounded up to a power of 2
+// The blocking send() and wait() only take a mutex when they have to sleep
+template<class T> class BoundedQueue
+{
+private:
+  static const size_t cache_line = 64;
+  static const int spin_yields = 16;
+  using TimePoint = chrono::steady_clock::time_point;
+
+  struct Cell
+  {
+    atomic<size_t> sequence;
+    T item;
+  };
+
+  unique_ptr<Cell[]> cells;
+  size_t mask;
+
+  // Producers' and consumers' positions, on separate cache lines
+  alignas(cache_line) atomic<size_t> send_pos{0};
+  alignas(cache_line) atomic<size_t> receive_pos{0};
+
+  // Sleepers, only touched when the queue is full or empty
+  alignas(cache_line) atomic<int> sleepers{0};
+  mutex sleep_mutex;
+  condition_variable not_empty;
+  condition_variable not_full;
+
+  //------------------------------------------------------------------------
+  // Wake anyone sleeping on the given condition
+  void wake(condition_variable& cv)
+  {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (sleepers.load(memory_order_relaxed))
+    {
+      // Taking the lock ensures the sleeper is either still to check, or
+      // is waiting
+      lock_guard<mutex> lock{sleep_mutex};
+      cv.notify_all();
+    }
+  }
+
+  //------------------------------------------------------------------------
+  // Sleep on a condition until f() succeeds, or the time given passes -
+  // returns whether f() succeeded
+  // f() may be called with the mutex held, so mustn't call wake()
+  template<class F> bool sleep_until(condition_variable& cv, F f,
+                                     TimePoint until = TimePoint::max())
+  {
+    // Give the other side a chance before paying for the mutex
+    for(auto i=0; i<spin_yields; i++)
+    {
+      this_thread::yield();
+      if (f()) return true;
+    }
+
+    unique_lock<mutex> lock{sleep_mutex};
+    sleepers.fetch_add(1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    auto done = false;
+    while (!(done = f()))
+    {
+      if (until == TimePoint::max())
+        cv.wait(lock);
+      else if (cv.wait_until(lock, until) == cv_status::timeout)
+      {
+        done = f();
+        break;
+      }
+    }
+    sleepers.fetch_sub(1, memory_order_relaxed);
+    return done;
+  }
+
+  //------------------------------------------------------------------------
+  // Claim a cell to write - returns 0 if full
+  Cell *claim_send()
+  {
+    auto pos = send_pos.load(memory_order_relaxed);
+    for(;;)
+    {
+      auto& cell = cells[pos & mask];
+      const auto seq = cell.sequence.load(memory_order_acquire);
+      const auto diff = static_cast<intptr_t>(seq)
+                      - static_cast<intptr_t>(pos);
+      if (!diff)
+      {
+        if (send_pos.compare_exchange_weak(pos, pos+1,
+                                           memory_order_relaxed))
+          return &cell;
+      }
+      else if (diff < 0)
+        return 0;  // Full
+      else
+        pos = send_pos.load(memory_order_relaxed);
+    }
+  }
+
+  //------------------------------------------------------------------------
+  // Write an item, copied or moved, without waking receivers
+  template<class U> bool push(U&& item)
+  {
+    const auto cell = claim_send();
+    if (!cell) return false;
+    const auto pos = cell->sequence.load(memory_order_relaxed);
+    cell->item = std::forward<U>(item);
+    cell->sequence.store(pos+1, memory_order_release);
+    return true;
+  }
+
+  //------------------------------------------------------------------------
+  // Read an item, without waking senders
+  bool pop(T& msg)
+  {
+    auto pos = receive_pos.load(memory_order_relaxed);
+    Cell *cell;
+    for(;;)
+    {
+      cell = &cells[pos & mask];
+      const auto seq = cell->sequence.load(memory_order_acquire);
+      const auto diff = static_cast<intptr_t>(seq)
+                      - static_cast<intptr_t>(pos+1);
+      if (!diff)
+      {
+        if (receive_pos.compare_exchange_weak(pos, pos+1,
+                                              memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0)
+        return false;  // Empty
+      else
+        pos = receive_pos.load(memory_order_relaxed);
+    }
+
+    msg = std::move(cell->item);
+    cell->sequence.store(pos+mask+1, memory_order_release);
+    return true;
+  }
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor
+  BoundedQueue(size_t capacity)
+  {
+    size_t n = 2;
+    while (n < capacity) n <<= 1;
+    cells.reset(new Cell[n]);
+    mask = n-1;
+    for(auto i=0u; i<n; i++)
+      cells[i].sequence.store(i, memory_order_relaxed);
+  }
+
+  //------------------------------------------------------------------------
+  // Get capacity
+  size_t capacity() const { return mask+1; }
+
+  //------------------------------------------------------------------------
+  // Get current length - approximate if there are concurrent senders or
+  // receivers
+  size_t waiting() const
+  {
+    const auto r = receive_pos.load(memory_order_acquire);
+    const auto s = send_pos.load(memory_order_acquire);
+    return s > r ? s-r : 0;
+  }
+
+  //------------------------------------------------------------------------
+  // Try to send a message - returns whether sent (queue wasn't full)
+  bool try_send(const T& msg)
+  {
+    if (!push(msg)) return false;
+    wake(not_empty);
+    return true;
+  }
+
+  //------------------------------------------------------------------------
+  // Try to send a message by moving it - returns whether sent (queue
+  // wasn't full), msg is unchanged if not
+  bool try_send(T&& msg)
+  {
+    if (!push(std::move(msg))) return false;
+    wake(not_empty);
+    return true;
+  }
+
+  //------------------------------------------------------------------------
+  // Send a message, blocking while the queue is full
+  void send(T msg)
+  {
+    if (!push(std::move(msg)))
+      sleep_until(not_full, [this, &msg]() { return push(std::move(msg)); });
+    wake(not_empty);
+  }
+
+  //------------------------------------------------------------------------
+  // Try to receive a message - returns whether one was available, and
+  // moves it into msg if so
+  bool try_receive(T& msg)
+  {
+    if (!pop(msg)) return false;
+    wake(not_full);
+    return true;
+  }
+
+  //------------------------------------------------------------------------
+  // Wait to receive a message (blocking)
+  T wait()
+  {
+    T msg;
+    if (!pop(msg))
+      sleep_until(not_empty, [this, &msg]() { return pop(msg); });
+    wake(not_full);
+    return msg;
+  }
+
+  //------------------------------------------------------------------------
+  // Wait to receive a message for up to the given time - returns whether
+  // one was received, and moves it into msg if so
+  template <class Rep, class Period>
+    bool wait_for(T& msg, const std::chrono::duration<Rep, Period>& time)
+  {
+    if (!pop(msg)
+        && !sleep_until(not_empty, [this, &msg]() { return pop(msg); },
+                        chrono::steady_clock::now()
+                        + chrono::duration_cast<
+                            chrono::steady_clock::duration>(time)))
+      return false;
+    wake(not_full);
+    return true;
+  }
+};
+
 //==========================================================================
 // Data queue class (dqueue.cc)
 // Specific Queue for data blocks, with read/write support
@@ -1105,6 +1344,110 @@ public:
   }
 };
 
+//==========================================================================
+// Work-stealing scheduler (scheduler.cc)
+// Runs short jobs on a fixed set of worker threads, one per core by default
+// Each worker has its own deque of jobs: it takes the most recent from the
+// back, for cache locality, and idle workers steal the oldest from the
+// front of others'.  Jobs submitted from outside are dealt round-robin to
+// the workers, and jobs submitted from a job go to its own worker
+// Jobs shouldn't block waiting for other jobs' futures - use parallel_for()
+// or parallel_reduce(), which run other jobs while they wait
+class Scheduler
+{
+public:
+  using Job = function<void()>;
+
+private:
+  struct alignas(64) Worker
+  {
+    Mutex mutex;
+    deque<Job> jobs;
+    thread t;
+  };
+
+  vector<unique_ptr<Worker>> workers;
+  atomic<size_t> queued{0};
+  atomic<unsigned> next_worker{0};
+  atomic<bool> stopping{false};
+
+  // Idle workers sleep on this
+  atomic<int> sleepers{0};
+  Mutex sleep_mutex;
+  condition_variable wake;
+
+  void push(Job&& job);
+  bool pop(Job& job, int self);
+  void run_worker(unsigned index, int cpu);
+  size_t get_grain(size_t n, size_t grain) const;
+  void run_chunks(size_t begin, size_t end, size_t grain,
+                  const function<void(size_t, size_t)>& chunk);
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor
+  // threads = 0 means one per hardware thread
+  // If pin_to_cores is set, worker n is bound to CPU n (mod number of CPUs)
+  Scheduler(unsigned threads = 0, bool pin_to_cores = false);
+
+  //------------------------------------------------------------------------
+  // Get number of worker threads
+  unsigned get_threads() const { return workers.size(); }
+
+  //------------------------------------------------------------------------
+  // Schedule a job to run - exceptions from it are ignored
+  void schedule(Job job) { push(move(job)); }
+
+  //------------------------------------------------------------------------
+  // Submit a function to run, returning a future for its result (or
+  // exception)
+  template<class F> auto submit(F f) -> future<decltype(f())>
+  {
+    auto task = make_shared<packaged_task<decltype(f())()>>(move(f));
+    auto result = task->get_future();
+    push([task]() { (*task)(); });
+    return result;
+  }
+
+  //------------------------------------------------------------------------
+  // Run a job if there is one - allows an outside thread to help
+  // Returns whether one was run
+  bool run_one();
+
+  //------------------------------------------------------------------------
+  // Call f(i) for i in [begin, end), in parallel, in chunks of grain
+  // (default: enough for a few chunks per worker)
+  // Blocks, running jobs itself, until all done - rethrows the first
+  // exception thrown by f
+  template<class F> void parallel_for(size_t begin, size_t end, F f,
+                                      size_t grain = 0)
+  {
+    run_chunks(begin, end, get_grain(end-begin, grain),
+               [&f](size_t b, size_t e) { for(; b<e; b++) f(b); });
+  }
+
+  //------------------------------------------------------------------------
+  // Reduce over [begin, end) in parallel: f(b, e) gives the result for a
+  // chunk, and reduce(x, y) combines results, starting with identity
+  // Chunks are combined in order, so reduce needn't be commutative
+  template<class T, class F, class R>
+    T parallel_reduce(size_t begin, size_t end, T identity, F f, R reduce,
+                      size_t grain = 0)
+  {
+    grain = get_grain(end-begin, grain);
+    vector<T> results((end-begin+grain-1)/grain, identity);
+    run_chunks(begin, end, grain,
+               [&f, &results, begin, grain](size_t b, size_t e)
+               { results[(b-begin)/grain] = f(b, e); });
+    for(auto& r: results) identity = reduce(identity, r);
+    return identity;
+  }
+
+  //------------------------------------------------------------------------
+  // Destructor - runs all outstanding jobs, then stops the workers
+  ~Scheduler();
+};
+
 //==========================================================================
 }} //namespaces
 #endif // !__OBTOOLS_MT_H
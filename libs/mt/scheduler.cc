@@ -0,0 +1,248 @@
+//==========================================================================
+// ObTools::MT: scheduler.cc
+//
+// Work-stealing job scheduler
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "ot-mt.h"
+#if defined(PLATFORM_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace ObTools { namespace MT {
+
+namespace
+{
+  // Scheduler and worker index of the current thread, if a worker
+  thread_local Scheduler *current_scheduler = nullptr;
+  thread_local int current_worker = -1;
+
+  // Number of times an idle worker yields before sleeping
+  const int spin_yields = 32;
+
+  // Run a job, ignoring exceptions - there's nowhere to report them, and
+  // submit() and run_chunks() capture their own
+  void run_job(Scheduler::Job& job)
+  {
+    try
+    {
+      job();
+    }
+    catch (...) {}
+  }
+}
+
+//--------------------------------------------------------------------------
+// Constructor
+Scheduler::Scheduler(unsigned threads, bool pin_to_cores)
+{
+  const auto cpus = max(thread::hardware_concurrency(), 1u);
+  if (!threads) threads = cpus;
+
+  for(auto i=0u; i<threads; i++)
+    workers.emplace_back(new Worker);
+
+  // Start after all exist, since they steal from each other
+  for(auto i=0u; i<threads; i++)
+  {
+    const int cpu = pin_to_cores ? static_cast<int>(i % cpus) : -1;
+    workers[i]->t = thread([this, i, cpu]() { run_worker(i, cpu); });
+  }
+}
+
+//--------------------------------------------------------------------------
+// Push a job to the current worker, or the next one round
+void Scheduler::push(Job&& job)
+{
+  auto index = (current_scheduler == this)
+    ? current_worker
+    : next_worker.fetch_add(1, memory_order_relaxed) % workers.size();
+  auto& worker = *workers[index];
+  {
+    // Count before it's visible, so queued never underflows
+    Lock lock(worker.mutex);
+    queued.fetch_add(1);
+    worker.jobs.push_back(move(job));
+  }
+
+  // Wake a sleeper if there is one - pairs with the check in run_worker()
+  if (sleepers.load())
+  {
+    Lock lock(sleep_mutex);
+    wake.notify_one();
+  }
+}
+
+//--------------------------------------------------------------------------
+// Pop a job - from the back of our own deque if self is a worker index,
+// otherwise stolen from the front of another's
+// Returns whether one was found
+bool Scheduler::pop(Job& job, int self)
+{
+  if (self >= 0)
+  {
+    auto& worker = *workers[self];
+    Lock lock(worker.mutex);
+    if (!worker.jobs.empty())
+    {
+      job = move(worker.jobs.back());
+      worker.jobs.pop_back();
+      queued--;
+      return true;
+    }
+  }
+
+  if (!queued.load(memory_order_relaxed)) return false;
+
+  // Steal, starting from our neighbour to spread the load
+  const auto n = workers.size();
+  const auto start = self >= 0 ? self+1 : 0;
+  for(auto i=0u; i<n; i++)
+  {
+    auto& victim = *workers[(start + i) % n];
+    Lock lock(victim.mutex);
+    if (!victim.jobs.empty())
+    {
+      job = move(victim.jobs.front());
+      victim.jobs.pop_front();
+      queued--;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+//--------------------------------------------------------------------------
+// Run a job if there is one
+bool Scheduler::run_one()
+{
+  Job job;
+  if (!pop(job, current_scheduler == this ? current_worker : -1))
+    return false;
+  run_job(job);
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Worker thread loop
+void Scheduler::run_worker(unsigned index, int cpu)
+{
+#if defined(PLATFORM_LINUX)
+  if (cpu >= 0)
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+#else
+  (void)cpu;
+#endif
+
+  current_scheduler = this;
+  current_worker = index;
+
+  auto idle = 0;
+  for(;;)
+  {
+    Job job;
+    if (pop(job, index))
+    {
+      idle = 0;
+      run_job(job);
+      continue;
+    }
+
+    if (++idle < spin_yields)
+    {
+      this_thread::yield();
+      continue;
+    }
+
+    // Sleep until there's something queued - pairs with push()
+    Lock lock(sleep_mutex);
+    sleepers++;
+    wake.wait(lock, [this]() { return queued.load() || stopping.load(); });
+    sleepers--;
+    if (stopping && !queued) break;
+    idle = 0;
+  }
+}
+
+//--------------------------------------------------------------------------
+// Get a grain size for n items, if not given
+size_t Scheduler::get_grain(size_t n, size_t grain) const
+{
+  if (!grain) grain = n / (4 * workers.size());
+  return max(grain, size_t{1});
+}
+
+//--------------------------------------------------------------------------
+// Run chunks of a range in parallel and wait for them all, helping out
+// Rethrows the first exception
+void Scheduler::run_chunks(size_t begin, size_t end, size_t grain,
+                           const function<void(size_t, size_t)>& chunk)
+{
+  if (begin >= end) return;
+
+  atomic<size_t> pending{(end-begin+grain-1)/grain};
+  Mutex error_mutex;
+  exception_ptr error;
+
+  // Keep the first chunk for ourselves
+  for(auto b = begin+grain; b < end; b += grain)
+  {
+    const auto e = min(b+grain, end);
+    push([&, b, e]()
+    {
+      try
+      {
+        chunk(b, e);
+      }
+      catch (...)
+      {
+        Lock lock(error_mutex);
+        if (!error) error = current_exception();
+      }
+      pending--;
+    });
+  }
+
+  try
+  {
+    chunk(begin, min(begin+grain, end));
+  }
+  catch (...)
+  {
+    Lock lock(error_mutex);
+    if (!error) error = current_exception();
+  }
+  pending--;
+
+  // Help until all are done
+  while (pending.load())
+    if (!run_one()) this_thread::yield();
+
+  if (error) rethrow_exception(error);
+}
+
+//--------------------------------------------------------------------------
+// Destructor
+Scheduler::~Scheduler()
+{
+  {
+    Lock lock(sleep_mutex);
+    stopping = true;
+    wake.notify_all();
+  }
+
+  for(auto& w: workers)
+    if (w->t.joinable()) w->t.join();
+}
+
+}} // namespaces
@@ -0,0 +1,161 @@
+//==========================================================================
+// ObTools::MT: test-bounded-queue.cc
+//
+// Test harness for bounded MPMC queue, including a throughput benchmark
+// against Queue
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include <gtest/gtest.h>
+#include "ot-mt.h"
+
+using namespace std;
+using namespace ObTools;
+
+//--------------------------------------------------------------------------
+// Tests
+TEST(BoundedQueueTest, TestCapacityIsRoundedUp)
+{
+  MT::BoundedQueue<int> q(10);
+  EXPECT_EQ(16u, q.capacity());
+  EXPECT_EQ(0u, q.waiting());
+}
+
+TEST(BoundedQueueTest, TestFIFOAndFull)
+{
+  MT::BoundedQueue<int> q(4);
+  for(auto i=0; i<4; i++) ASSERT_TRUE(q.try_send(i));
+  EXPECT_FALSE(q.try_send(99));
+  EXPECT_EQ(4u, q.waiting());
+
+  int n;
+  for(auto i=0; i<4; i++)
+  {
+    ASSERT_TRUE(q.try_receive(n));
+    EXPECT_EQ(i, n);
+  }
+  EXPECT_FALSE(q.try_receive(n));
+
+  // Wraps round
+  for(auto i=0; i<10; i++)
+  {
+    ASSERT_TRUE(q.try_send(i));
+    EXPECT_EQ(i, q.wait());
+  }
+}
+
+TEST(BoundedQueueTest, TestMoveOnlyMessages)
+{
+  MT::BoundedQueue<unique_ptr<string>> q(2);
+  unique_ptr<string> s(new string("hello"));
+  ASSERT_TRUE(q.try_send(move(s)));
+  EXPECT_EQ(nullptr, s);
+  ASSERT_TRUE(q.try_send(unique_ptr<string>(new string("world"))));
+
+  unique_ptr<string> extra(new string("extra"));
+  EXPECT_FALSE(q.try_send(move(extra)));
+  ASSERT_NE(nullptr, extra);  // Unchanged if not sent
+
+  EXPECT_EQ("hello", *q.wait());
+  EXPECT_EQ("world", *q.wait());
+}
+
+TEST(BoundedQueueTest, TestWaitForTimesOut)
+{
+  MT::BoundedQueue<int> q(2);
+  int n = 0;
+  auto start = chrono::steady_clock::now();
+  EXPECT_FALSE(q.wait_for(n, chrono::milliseconds{20}));
+  EXPECT_GE(chrono::steady_clock::now() - start, chrono::milliseconds{20});
+
+  thread sender([&q]()
+  {
+    this_thread::sleep_for(chrono::milliseconds{10});
+    q.send(42);
+  });
+  EXPECT_TRUE(q.wait_for(n, chrono::seconds{5}));
+  EXPECT_EQ(42, n);
+  sender.join();
+}
+
+TEST(BoundedQueueTest, TestBlockingSendAndWait)
+{
+  MT::BoundedQueue<int> q(2);
+  const auto n = 10000;
+  thread sender([&q, n]()
+  {
+    for(auto i=0; i<n; i++) q.send(i);
+  });
+
+  auto ok = true;
+  for(auto i=0; i<n; i++)
+    if (q.wait() != i) ok = false;
+  sender.join();
+  EXPECT_TRUE(ok);
+}
+
+//--------------------------------------------------------------------------
+// Run producers and consumers through a queue, check every message
+// arrives once, return messages/sec
+template<class SEND, class RECEIVE>
+double run_load(int producers, int consumers, int per_producer,
+                SEND send, RECEIVE receive)
+{
+  const auto total = producers * per_producer;
+  atomic<long long> sum{0};
+  auto start = chrono::steady_clock::now();
+
+  vector<thread> threads;
+  for(auto p=0; p<producers; p++)
+    threads.emplace_back([p, per_producer, &send]()
+    {
+      for(auto i=0; i<per_producer; i++) send(p*per_producer + i + 1);
+    });
+  for(auto c=0; c<consumers; c++)
+    threads.emplace_back([c, consumers, total, &sum, &receive]()
+    {
+      long long local = 0;
+      for(auto i=c; i<total; i+=consumers) local += receive();
+      sum += local;
+    });
+  for(auto& t: threads) t.join();
+
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  EXPECT_EQ(static_cast<long long>(total) * (total+1) / 2, sum);
+  return total / elapsed.count();
+}
+
+TEST(BoundedQueueTest, BenchmarkAgainstQueue)
+{
+  if (!getenv("OBTOOLS_BENCHMARK"))
+    GTEST_SKIP() << "OBTOOLS_BENCHMARK not set";
+
+  const auto per_producer = 100000;
+  for(auto threads: {1, 4})
+  {
+    MT::Queue<int> queue;
+    auto queue_rate = run_load(threads, threads, per_producer,
+                               [&queue](int i) { queue.send(i); },
+                               [&queue]() { return queue.wait(); });
+
+    MT::BoundedQueue<int> bounded(1024);
+    auto bounded_rate = run_load(threads, threads, per_producer,
+                                 [&bounded](int i) { bounded.send(i); },
+                                 [&bounded]() { return bounded.wait(); });
+
+    cout << threads << " producers/" << threads << " consumers, msgs/sec: "
+         << "Queue " << static_cast<int>(queue_rate)
+         << ", BoundedQueue " << static_cast<int>(bounded_rate)
+         << " (x" << bounded_rate / queue_rate << ")\n";
+  }
+}
+
+//--------------------------------------------------------------------------
+// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
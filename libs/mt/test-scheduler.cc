@@ -0,0 +1,167 @@
+//==========================================================================
+// ObTools::MT: test-scheduler.cc
+//
+// Test harness for work-stealing scheduler, including a fine-grained task
+// benchmark against FunctionPool
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include <gtest/gtest.h>
+#include "ot-mt.h"
+#include <numeric>
+
+using namespace std;
+using namespace ObTools;
+
+//--------------------------------------------------------------------------
+// Tests
+TEST(SchedulerTest, TestSubmitReturnsFuture)
+{
+  MT::Scheduler scheduler(4);
+  EXPECT_EQ(4u, scheduler.get_threads());
+
+  auto f = scheduler.submit([]() { return 6*7; });
+  EXPECT_EQ(42, f.get());
+
+  auto g = scheduler.submit([]() -> int { throw runtime_error("oops"); });
+  EXPECT_THROW(g.get(), runtime_error);
+}
+
+TEST(SchedulerTest, TestScheduledJobsAllRun)
+{
+  atomic<int> count{0};
+  {
+    MT::Scheduler scheduler(3);
+    for(auto i=0; i<10000; i++)
+      scheduler.schedule([&count]() { count++; });
+  }
+  // Destructor runs all outstanding
+  EXPECT_EQ(10000, count);
+}
+
+TEST(SchedulerTest, TestParallelForCoversRangeOnce)
+{
+  MT::Scheduler scheduler(4);
+  vector<int> hits(10007);
+  scheduler.parallel_for(0, hits.size(), [&hits](size_t i) { hits[i]++; });
+  EXPECT_EQ(hits.size(), count(hits.begin(), hits.end(), 1));
+
+  // Empty and tiny ranges
+  scheduler.parallel_for(5, 5, [&hits](size_t i) { hits[i]++; });
+  scheduler.parallel_for(0, 1, [&hits](size_t i) { hits[i]++; }, 100);
+  EXPECT_EQ(2, hits[0]);
+  EXPECT_EQ(1, hits[5]);
+}
+
+TEST(SchedulerTest, TestParallelForRethrows)
+{
+  MT::Scheduler scheduler(2);
+  EXPECT_THROW(scheduler.parallel_for(0, 100, [](size_t i)
+               { if (i == 57) throw runtime_error("57"); }, 10),
+               runtime_error);
+}
+
+TEST(SchedulerTest, TestParallelReduceInOrder)
+{
+  MT::Scheduler scheduler(4);
+  auto sum = scheduler.parallel_reduce(
+    1, 100001, 0ULL,
+    [](size_t b, size_t e)
+    {
+      auto s = 0ULL;
+      for(; b<e; b++) s += b;
+      return s;
+    },
+    [](unsigned long long x, unsigned long long y) { return x+y; });
+  EXPECT_EQ(5000050000ULL, sum);
+
+  // Non-commutative reduce keeps chunk order
+  auto text = scheduler.parallel_reduce(
+    0, 26, string(),
+    [](size_t b, size_t e)
+    {
+      string s;
+      for(; b<e; b++) s += static_cast<char>('a'+b);
+      return s;
+    },
+    [](const string& x, const string& y) { return x+y; }, 3);
+  EXPECT_EQ("abcdefghijklmnopqrstuvwxyz", text);
+}
+
+TEST(SchedulerTest, TestNestedParallelForFromJobs)
+{
+  MT::Scheduler scheduler(2, true);
+  atomic<int> count{0};
+  scheduler.parallel_for(0, 8, [&scheduler, &count](size_t)
+  {
+    scheduler.parallel_for(0, 100, [&count](size_t) { count++; }, 7);
+  }, 1);
+  EXPECT_EQ(800, count);
+}
+
+//--------------------------------------------------------------------------
+// About a microsecond of work
+unsigned long work(unsigned long seed)
+{
+  for(auto i=0; i<200; i++) seed = seed * 6364136223846793005UL + 1;
+  return seed;
+}
+
+TEST(SchedulerTest, BenchmarkFineGrainedTasksAgainstFunctionPool)
+{
+  if (!getenv("OBTOOLS_BENCHMARK"))
+    GTEST_SKIP() << "OBTOOLS_BENCHMARK not set";
+
+  const auto pool_tasks = 2000;
+  const auto tasks = 200000;
+  atomic<unsigned long> sink{0};
+
+  // FunctionPool: a pool thread per task
+  auto start = chrono::steady_clock::now();
+  {
+    MT::FunctionPool pool(4, 16);
+    vector<function<void()>> fs;
+    for(auto i=0; i<pool_tasks; i++)
+      fs.push_back([i, &sink]() { sink += work(i); });
+    pool.run_and_wait(fs);
+  }
+  chrono::duration<double> pool_time = chrono::steady_clock::now() - start;
+
+  // Scheduler: submitted individually
+  start = chrono::steady_clock::now();
+  {
+    MT::Scheduler scheduler;
+    vector<future<void>> results;
+    results.reserve(tasks);
+    for(auto i=0; i<tasks; i++)
+      results.push_back(scheduler.submit([i, &sink]() { sink += work(i); }));
+    for(auto& r: results) r.get();
+  }
+  chrono::duration<double> submit_time = chrono::steady_clock::now() - start;
+
+  // Scheduler: parallel_for, one index per task
+  MT::Scheduler scheduler;
+  start = chrono::steady_clock::now();
+  scheduler.parallel_for(0, tasks,
+                         [&sink](size_t i) { sink += work(i); }, 1);
+  chrono::duration<double> for_time = chrono::steady_clock::now() - start;
+
+  const auto pool_ns = pool_time.count() * 1e9 / pool_tasks;
+  const auto submit_ns = submit_time.count() * 1e9 / tasks;
+  const auto for_ns = for_time.count() * 1e9 / tasks;
+  cout << "Per task: FunctionPool " << static_cast<int>(pool_ns)
+       << "ns, Scheduler submit " << static_cast<int>(submit_ns)
+       << "ns (x" << pool_ns / submit_ns << "), parallel_for "
+       << static_cast<int>(for_ns) << "ns (x" << pool_ns / for_ns << ")\n";
+  EXPECT_NE(0u, sink);
+}
+
+//--------------------------------------------------------------------------
+// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,410 @@
+//==========================================================================
+// ObTools::Net: event-server.cc
+//
+// Event-driven (epoll) multi-reactor TCP server
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "ot-net.h"
+
+#if defined(PLATFORM_LINUX)
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+
+namespace ObTools { namespace Net {
+
+// Maximum events to collect in each epoll_wait()
+const int MAX_EPOLL_EVENTS = 64;
+
+//==========================================================================
+// Reactor
+
+//--------------------------------------------------------------------------
+// Constructor - binds and listens on the given address
+EventReactor::EventReactor(EventTCPServer& _server, EndPoint address,
+                           int backlog):
+  server(_server),
+  epoll_fd(::epoll_create1(EPOLL_CLOEXEC)),
+  wake_fd(::eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC)),
+  spare_fd(::open("/dev/null", O_RDONLY|O_CLOEXEC))
+{
+  if (!listener) return;
+
+  // Allow fast restart, and multiple listeners across reactors
+  listener.enable_reuse();
+  listener.enable_reuse_port();
+
+  // Non-blocking so competing reactors can't get stuck in accept()
+  listener.go_nonblocking();
+
+  if (!listener.bind(address) || ::listen(listener.get_fd(), backlog))
+  {
+    listener.close();
+    return;
+  }
+
+  if (epoll_fd < 0 || wake_fd < 0) return;
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = nullptr;            // Listener
+  ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listener.get_fd(), &ev);
+
+  ev.events = EPOLLIN;
+  ev.data.ptr = this;               // Wake-up
+  ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+}
+
+//--------------------------------------------------------------------------
+// Hand an existing fd to this reactor - thread safe
+void EventReactor::take_over(int fd, EndPoint client)
+{
+  {
+    MT::Lock lock(pending_mutex);
+    pending.push_back(make_pair(fd, client));
+  }
+  wake();
+}
+
+//--------------------------------------------------------------------------
+// Wake the reactor
+void EventReactor::wake()
+{
+  if (wake_fd >= 0)
+  {
+    uint64_t one = 1;
+    auto n = ::write(wake_fd, &one, sizeof(one));
+    (void)n;  // Only fails if counter saturated, which still wakes
+  }
+}
+
+//--------------------------------------------------------------------------
+// Accept all waiting connections from the listener
+void EventReactor::accept_all()
+{
+  for(;;)
+  {
+    struct sockaddr_in saddr;
+    socklen_t len = sizeof(saddr);
+    int fd = ::accept4(listener.get_fd(),
+                       reinterpret_cast<struct sockaddr *>(&saddr),
+                       &len, SOCK_CLOEXEC);
+    if (fd < 0)
+    {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+
+      // Out of fds - the listener would stay readable and we would spin,
+      // so use the spare to accept the connection and close it
+      if ((errno == EMFILE || errno == ENFILE) && spare_fd >= 0)
+      {
+        ::close(spare_fd);
+        fd = ::accept4(listener.get_fd(), nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd >= 0) ::close(fd);
+        spare_fd = ::open("/dev/null", O_RDONLY|O_CLOEXEC);
+        if (fd >= 0) continue;
+      }
+
+      return;  // Nothing more waiting
+    }
+
+    EndPoint client(saddr);
+
+    // Check it's allowed before we spend anything on it
+    if (!server.verify(client))
+    {
+      ::close(fd);
+      continue;
+    }
+
+    adopt(fd, client);
+  }
+}
+
+//--------------------------------------------------------------------------
+// Adopt a connected fd into the epoll set
+void EventReactor::adopt(int fd, EndPoint client)
+{
+  auto s = server.create_client_socket(fd);
+  if (!s)
+  {
+    ::close(fd);  // Drop it
+    return;
+  }
+
+  // We write to and wait on the fd directly, which would bypass (e.g.) SSL
+  if (!s->is_plain())
+  {
+    delete s;     // Closes fd
+    return;
+  }
+
+  unique_ptr<EventConnection> conn(server.create_connection(s, client));
+  if (!conn) return;  // Socket was owned, so already closed
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN | EPOLLRDHUP;
+  ev.data.ptr = conn.get();
+  if (::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev)) return;
+
+  connections[fd] = move(conn);
+}
+
+//--------------------------------------------------------------------------
+// Dispatch an event on a connection
+void EventReactor::dispatch(EventConnection *conn)
+{
+  // Only writing until queued output is gone
+  if (!conn->writing)
+  {
+    // Let the handler find out what happened - hangups and errors show up
+    // as a zero read or SocketError
+    bool keep = false;
+    try
+    {
+      keep = server.handle(*conn);
+    }
+    catch (const SocketError&)
+    {
+      drop(conn);
+      return;
+    }
+
+    conn->closing = !keep;
+  }
+
+  if (!flush(conn))
+  {
+    drop(conn);
+    return;
+  }
+
+  const auto writing = conn->output_pos < conn->output.size();
+  if (!writing && conn->closing)
+  {
+    drop(conn);
+    return;
+  }
+
+  // Switch between waiting to read and waiting to write
+  if (writing != conn->writing)
+  {
+    struct epoll_event ev;
+    ev.events = writing ? EPOLLOUT : (EPOLLIN | EPOLLRDHUP);
+    ev.data.ptr = conn;
+    if (::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn->socket->get_fd(), &ev))
+    {
+      drop(conn);
+      return;
+    }
+    conn->writing = writing;
+  }
+}
+
+//--------------------------------------------------------------------------
+// Write as much queued output as the socket will take without blocking
+// Returns false on error
+bool EventReactor::flush(EventConnection *conn)
+{
+  auto& output = conn->output;
+  auto& pos = conn->output_pos;
+  while (pos < output.size())
+  {
+    auto n = ::send(conn->socket->get_fd(), output.data()+pos,
+                    output.size()-pos, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n < 0)
+    {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+      return false;
+    }
+    pos += n;
+  }
+
+  output.clear();
+  pos = 0;
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Drop a connection
+void EventReactor::drop(EventConnection *conn)
+{
+  auto fd = conn->socket->get_fd();
+  ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+  server.disconnected(*conn);
+  connections.erase(fd);  // Closes socket
+}
+
+//--------------------------------------------------------------------------
+// Thread run
+void EventReactor::run()
+{
+  struct epoll_event events[MAX_EPOLL_EVENTS];
+
+  while (server.alive && is_running())
+  {
+    int n = ::epoll_wait(epoll_fd, events, MAX_EPOLL_EVENTS, -1);
+    if (n < 0)
+    {
+      if (errno == EINTR) continue;
+      break;
+    }
+
+    for (int i=0; i<n; i++)
+    {
+      auto ptr = events[i].data.ptr;
+      if (!ptr)
+      {
+        accept_all();
+      }
+      else if (ptr == this)
+      {
+        uint64_t count;
+        auto r = ::read(wake_fd, &count, sizeof(count));
+        (void)r;
+
+        vector<pair<int, EndPoint>> adopted;
+        {
+          MT::Lock lock(pending_mutex);
+          adopted.swap(pending);
+        }
+
+        for (const auto& p: adopted)
+          adopt(p.first, p.second);
+      }
+      else
+      {
+        dispatch(static_cast<EventConnection *>(ptr));
+      }
+    }
+  }
+
+  // Close everything we own
+  while (!connections.empty())
+    drop(connections.begin()->second.get());
+}
+
+//--------------------------------------------------------------------------
+// Destructor
+EventReactor::~EventReactor()
+{
+  cancel();
+
+  // Anything not yet adopted
+  for (const auto& p: pending)
+    ::close(p.first);
+
+  if (epoll_fd >= 0) ::close(epoll_fd);
+  if (wake_fd >= 0) ::close(wake_fd);
+  if (spare_fd >= 0) ::close(spare_fd);
+}
+
+//==========================================================================
+// Server
+
+//--------------------------------------------------------------------------
+// Create reactors
+void EventTCPServer::start(int backlog, int threads)
+{
+  if (threads <= 0) threads = thread::hardware_concurrency();
+  if (threads <= 0) threads = 1;
+
+  for (int i=0; i<threads; i++)
+  {
+    auto reactor = make_unique<EventReactor>(*this, address, backlog);
+    if (!*reactor)
+    {
+      reactors.clear();
+      return;
+    }
+
+    // If we were given port 0, the rest must share the one we got
+    if (!i && !address.port) address.port = reactor->local().port;
+
+    reactors.push_back(move(reactor));
+  }
+}
+
+//--------------------------------------------------------------------------
+// Run server
+void EventTCPServer::run()
+{
+  if (reactors.empty() || !alive) return;
+
+  for (auto& reactor: reactors)
+    reactor->start();
+
+  stopped.wait();
+}
+
+//--------------------------------------------------------------------------
+// Default factory for creating a client socket - just return a standard
+// TCPSocket
+TCPSocket *EventTCPServer::create_client_socket(int client_fd)
+{
+  return new TCPSocket(client_fd);
+}
+
+//--------------------------------------------------------------------------
+// Default factory for connection state
+EventConnection *EventTCPServer::create_connection(TCPSocket *s,
+                                                   EndPoint client)
+{
+  return new EventConnection(s, client);
+}
+
+//--------------------------------------------------------------------------
+// Initiate an outgoing connection, from the same local address as we use
+// for serving, and then treat it as if it was an incoming one
+// Timeout is in seconds
+// Returns fd of connection
+Socket::fd_t EventTCPServer::initiate(EndPoint remote_address, int timeout)
+{
+  TCPClient client(address, remote_address, timeout);
+  if (!client) return Socket::INVALID_FD;
+
+  auto fd = client.detach_fd();
+  take_over(fd, remote_address);
+  return fd;
+}
+
+//--------------------------------------------------------------------------
+// Accept an existing socket into the server to be processed
+// Reactors are chosen round-robin
+void EventTCPServer::take_over(int fd, Net::EndPoint remote_address)
+{
+  if (reactors.empty() || !alive)
+  {
+    ::close(fd);
+    return;
+  }
+
+  auto i = next_reactor++ % reactors.size();
+  reactors[i]->take_over(fd, remote_address);
+}
+
+//--------------------------------------------------------------------------
+// Shut down server
+void EventTCPServer::shutdown()
+{
+  if (alive.exchange(false))
+  {
+    for (auto& reactor: reactors)
+      reactor->wake();
+
+    // Stop and join all reactors, closing connections
+    for (auto& reactor: reactors)
+      reactor->cancel();
+  }
+
+  stopped.signal();
+}
+
+}} // namespaces
+#endif // PLATFORM_LINUX
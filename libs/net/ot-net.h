@@ -16,6 +16,8 @@
 #include <string>
 #include <string.h>
 #include <set>
+#include <vector>
+#include <atomic>
 
 #if defined(PLATFORM_WINDOWS)
 
@@ -345,7 +347,7 @@ ostream& operator<<(ostream& s, const Port& p);
 // Abstract Socket (socket.cc)
 class Socket
 {
-protected:
+public:
 #if defined(PLATFORM_WINDOWS)
   typedef SOCKET fd_t;
   static const fd_t INVALID_FD = INVALID_SOCKET;
@@ -353,6 +355,8 @@ protected:
   typedef int fd_t;
   static const fd_t INVALID_FD = -1;
 #endif
+
+protected:
   fd_t fd;
 
   // Simple constructor - subclasses provide the fd
@@ -405,6 +409,12 @@ public:
   // Enable reuse
   void enable_reuse();
 
+  //------------------------------------------------------------------------
+  // Enable port reuse (SO_REUSEPORT) - allows multiple listeners to bind
+  // the same port with the kernel balancing connections between them
+  // No-op where not supported
+  void enable_reuse_port();
+
   //------------------------------------------------------------------------
   // Set socket TTL
   void set_ttl(int hops);
@@ -520,6 +530,11 @@ public:
   // Raw stream write wrapper
   virtual ssize_t cwrite(const void *buf, size_t count);
 
+  //------------------------------------------------------------------------
+  // Whether the raw wrappers read and write the fd directly - false in
+  // children which pass data through another layer (e.g. SSLSocket)
+  virtual bool is_plain() const { return true; }
+
   //------------------------------------------------------------------------
   // Safe stream read wrapper
   // Returns amount actually read - not necessarily all required!
@@ -574,6 +589,12 @@ public:
   // Throws SocketError on failure
   ssize_t sendmsg(struct iovec *gathers, int ngathers, int flags=0);
 
+  //------------------------------------------------------------------------
+  // Hold back partial segments while corked, so a header and its data
+  // written separately go out together when uncorked
+  // Linux only (TCP_CORK) - ignored elsewhere
+  void set_cork(bool on);
+
   //------------------------------------------------------------------------
   // Read a network byte order (MSB-first) 4-byte integer from the socket
   // Throws SocketError on failure or EOF
@@ -939,6 +960,210 @@ public:
   TCPServerThread(TCPServer &s): server(s) { start(); }
 };
 
+#if defined(PLATFORM_LINUX)
+//==========================================================================
+// Event-driven TCP server (event-server.cc)
+// Alternative to TCPServer for large numbers of mostly-idle connections:
+// connections are multiplexed with epoll across a fixed set of reactor
+// threads (default one per core), each with its own SO_REUSEPORT listener,
+// so an idle connection costs a file descriptor rather than a thread.
+// This is an abstract class which should be subclassed to implement
+// handle()
+
+//--------------------------------------------------------------------------
+// Per-connection state - subclass and return from
+// EventTCPServer::create_connection() to hold protocol state
+class EventConnection
+{
+  friend class EventReactor;
+  string output;             // Queued by send(), not yet written
+  string::size_type output_pos = 0;
+  bool writing = false;      // Waiting for the socket to be writable
+  bool closing = false;      // Close once output is written
+
+public:
+  unique_ptr<TCPSocket> socket;
+  EndPoint client;
+
+  EventConnection(TCPSocket *_socket, EndPoint _client):
+    socket(_socket), client(_client) {}
+
+  //------------------------------------------------------------------------
+  // Queue data to be written without blocking - the reactor writes what it
+  // can when handle() returns, and the rest as the socket becomes writable,
+  // not reading any more from this connection until it is all written.
+  // Written directly to the fd - the reactor only accepts plain sockets
+  void send(const string& data) { output.append(data); }
+
+  virtual ~EventConnection() {}
+};
+
+class EventTCPServer;  //forward
+
+//--------------------------------------------------------------------------
+// Reactor thread - owns a listener, an epoll set and its connections
+class EventReactor: public MT::Thread
+{
+  EventTCPServer& server;
+  TCPSocket listener;
+  int epoll_fd;
+  int wake_fd;
+  int spare_fd;   // Given up to accept and drop when out of fds
+  map<int, unique_ptr<EventConnection>> connections;
+
+  MT::Mutex pending_mutex;
+  vector<pair<int, EndPoint>> pending;   // Taken-over fds to adopt
+
+  void accept_all();
+  void adopt(int fd, EndPoint client);
+  void dispatch(EventConnection *conn);
+  bool flush(EventConnection *conn);
+  void drop(EventConnection *conn);
+  void run() override;
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor - binds and listens on the given address
+  EventReactor(EventTCPServer& _server, EndPoint address, int backlog);
+
+  //------------------------------------------------------------------------
+  // Check for failure to set up
+  bool operator!() const { return !listener || epoll_fd < 0 || wake_fd < 0; }
+
+  //------------------------------------------------------------------------
+  // Get local listening address
+  EndPoint local() const { return listener.local(); }
+
+  //------------------------------------------------------------------------
+  // Hand an existing fd to this reactor - thread safe
+  void take_over(int fd, EndPoint client);
+
+  //------------------------------------------------------------------------
+  // Wake the reactor from epoll_wait() - thread safe
+  void wake();
+
+  //------------------------------------------------------------------------
+  // Get number of connections currently owned (reactor thread only)
+  size_t count() const { return connections.size(); }
+
+  //------------------------------------------------------------------------
+  // Destructor - closes everything
+  ~EventReactor();
+};
+
+class EventTCPServer
+{
+  friend class EventReactor;
+
+  vector<unique_ptr<EventReactor>> reactors;
+  atomic<unsigned> next_reactor{0};
+  atomic<bool> alive{true};
+  MT::Condition stopped;
+  EndPoint address;
+
+  void start(int backlog, int threads);
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor with just port (INADDR_ANY binding)
+  // threads is the number of reactors - 0 means one per core
+  EventTCPServer(int _port, int backlog=128, int threads=0):
+    address(IPAddress(inaddr_any), _port) { start(backlog, threads); }
+
+  //------------------------------------------------------------------------
+  // Constructor with specified address (specific binding)
+  EventTCPServer(EndPoint _address, int backlog=128, int threads=0):
+    address(_address) { start(backlog, threads); }
+
+  //------------------------------------------------------------------------
+  // Check for failure to bind/listen
+  bool operator!() const { return reactors.empty(); }
+
+  //------------------------------------------------------------------------
+  // Get the actual listening address (e.g. if port 0 was given)
+  EndPoint local() const
+  { return reactors.empty() ? EndPoint() : reactors.front()->local(); }
+
+  //------------------------------------------------------------------------
+  // Get the number of reactor threads
+  int get_threads() const { return reactors.size(); }
+
+  //------------------------------------------------------------------------
+  // Run server - starts reactor threads
+  // Doesn't return unless shutdown() called
+  void run();
+
+  //------------------------------------------------------------------------
+  // Virtual function to verify acceptability of a client before adding
+  // the connection.  This function operates in a reactor thread and should
+  // be fast!
+  // Defaults to allowing anything
+  virtual bool verify(EndPoint) const { return true; }
+
+  //------------------------------------------------------------------------
+  // Factory for creating a client socket - overridable in subclass, but
+  // must return a plain socket (see TCPSocket::is_plain()): output is
+  // written straight to the fd and readiness comes from epoll, neither of
+  // which works through SSL, so anything else is dropped
+  virtual TCPSocket *create_client_socket(int client_fd);
+
+  //------------------------------------------------------------------------
+  // Factory for creating connection state - overridable to return a
+  // subclass of EventConnection.  Takes ownership of the socket
+  virtual EventConnection *create_connection(TCPSocket *s, EndPoint client);
+
+  //------------------------------------------------------------------------
+  // Virtual function to handle a readable connection.  Called in the
+  // reactor thread which owns the connection, so must not block: a single
+  // read() on the socket is guaranteed not to block, but any more may.
+  // Replies should be queued with conn.send() rather than written directly.
+  // Return false (or throw SocketError) to close the connection, after
+  // anything queued has been written
+  virtual bool handle(EventConnection& conn)=0;
+
+  //------------------------------------------------------------------------
+  // Virtual function called when a connection is about to be closed
+  virtual void disconnected(EventConnection&) {}
+
+  //------------------------------------------------------------------------
+  // Initiate an outgoing connection, and then treat it as if it was an
+  // incoming one - mainly for P2P
+  // Timeout is in seconds
+  // Returns fd of connection, or INVALID_FD if it failed
+  Socket::fd_t initiate(EndPoint addr, int timeout);
+
+  //------------------------------------------------------------------------
+  // Accept an existing socket into the server to be processed
+  // Used for P2P where 'server' socket may be initiated at this end
+  void take_over(int fd, Net::EndPoint remote_address);
+
+  //------------------------------------------------------------------------
+  // Shut down server - stops reactors and closes all connections
+  void shutdown();
+
+  //------------------------------------------------------------------------
+  // Destructor
+  // Note subclasses should call shutdown() in their own destructor to
+  // ensure handle() is not called on a partially destroyed object
+  virtual ~EventTCPServer() { shutdown(); }
+};
+
+//==========================================================================
+// EventTCPServer thread class
+// Runs event TCP server in the background
+class EventTCPServerThread: public MT::Thread
+{
+  EventTCPServer& server;
+  void run()
+  {
+    server.run();
+  }
+
+public:
+  EventTCPServerThread(EventTCPServer &s): server(s) { start(); }
+};
+#endif
+
 //==========================================================================
 // Host (host.cc)
 // Static access to hostname
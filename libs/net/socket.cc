@@ -24,6 +24,7 @@ typedef const char *sockopt_t;
 #include <sys/ioctl.h>
 #include <net/if_arp.h>
 #include <net/if.h>
+#include <netinet/tcp.h>
 #define SOCKCLOSE close
 #define SOCKIOCTL ioctl
 #define SOCKERRNO errno
@@ -120,6 +121,17 @@ void Socket::enable_reuse()
              sizeof(one));
 }
 
+//--------------------------------------------------------------------------
+// Enable port reuse
+void Socket::enable_reuse_port()
+{
+#if defined(SO_REUSEPORT)
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, reinterpret_cast<sockopt_t>(&one),
+             sizeof(one));
+#endif
+}
+
 //--------------------------------------------------------------------------
 // Set socket TTL
 void Socket::set_ttl(int hops)
@@ -716,6 +728,19 @@ ssize_t TCPSocket::sendmsg(struct iovec *gathers, int ngathers, int flags)
   return res;
 }
 
+//--------------------------------------------------------------------------
+// Cork or uncork the socket
+void TCPSocket::set_cork(bool on)
+{
+#if defined(PLATFORM_LINUX)
+  int n = on ? 1 : 0;
+  setsockopt(fd, IPPROTO_TCP, TCP_CORK, reinterpret_cast<sockopt_t>(&n),
+             sizeof(int));
+#else
+  (void)on;
+#endif
+}
+
 //--------------------------------------------------------------------------
 // << operator to write strings to TCPSockets
 // NOTE: Not a general stream operator!
@@ -0,0 +1,256 @@
+//==========================================================================
+// ObTools::Net: test-event-server.cc
+//
+// Test harness for event-driven TCP server
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include <gtest/gtest.h>
+#include "ot-net.h"
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace ObTools;
+
+//--------------------------------------------------------------------------
+// Test server class - echoes what it gets
+class EchoServer: public Net::EventTCPServer
+{
+public:
+  atomic<int> disconnects{0};
+  bool allow{true};
+  static constexpr size_t big_reply = 16*1024*1024;
+
+  EchoServer(int threads): Net::EventTCPServer(0, 128, threads) {}
+
+  bool verify(Net::EndPoint) const override { return allow; }
+
+  bool handle(Net::EventConnection& conn) override
+  {
+    string buf;
+    if (!conn.socket->read(buf)) return false;
+    if (buf == "big") buf = string(big_reply, 'x');
+    conn.send(buf);
+    return buf != "bye";
+  }
+
+  void disconnected(Net::EventConnection&) override { disconnects++; }
+
+  ~EchoServer() { shutdown(); }
+};
+
+TEST(EventTCPServerTests, TestServerStartsAndExits)
+{
+  EchoServer server(2);
+  ASSERT_FALSE(!server);
+  EXPECT_EQ(2, server.get_threads());
+  EXPECT_NE(0, server.local().port);
+
+  Net::EventTCPServerThread server_thread(server);
+  this_thread::sleep_for(chrono::milliseconds{50});
+  server.shutdown();
+}
+
+TEST(EventTCPServerTests, TestManyMoreConnectionsThanThreads)
+{
+  EchoServer server(2);
+  ASSERT_FALSE(!server);
+  Net::EventTCPServerThread server_thread(server);
+
+  const int n = 100;
+  Net::EndPoint ep(Net::IPAddress("127.0.0.1"), server.local().port);
+  vector<unique_ptr<Net::TCPClient>> clients;
+  for (int i=0; i<n; i++)
+  {
+    clients.emplace_back(new Net::TCPClient(ep, 5));
+    ASSERT_FALSE(!*clients.back());
+  }
+
+  // All connected at once, all served
+  for (int i=0; i<n; i++)
+  {
+    auto msg = "hello " + to_string(i);
+    clients[i]->write(msg);
+    string reply;
+    ASSERT_TRUE(clients[i]->read(reply, msg.size()));
+    EXPECT_EQ(msg, reply);
+  }
+
+  clients.clear();
+  for (int i=0; i<50 && server.disconnects < n; i++)
+    this_thread::sleep_for(chrono::milliseconds{10});
+  EXPECT_EQ(n, server.disconnects);
+
+  server.shutdown();
+}
+
+TEST(EventTCPServerTests, TestVerifyRejectsClient)
+{
+  EchoServer server(1);
+  server.allow = false;
+  Net::EventTCPServerThread server_thread(server);
+
+  Net::TCPClient client(Net::EndPoint(Net::IPAddress("127.0.0.1"),
+                                      server.local().port), 5);
+  ASSERT_FALSE(!client);
+  string reply;
+  client.set_timeout(5);
+  EXPECT_FALSE(client.read(reply));
+  server.shutdown();
+}
+
+TEST(EventTCPServerTests, TestLayeredSocketIsRejected)
+{
+  // Stands in for (e.g.) an SSL socket
+  class LayeredSocket: public Net::TCPSocket
+  {
+  public:
+    LayeredSocket(int fd): Net::TCPSocket(fd) {}
+    bool is_plain() const override { return false; }
+  };
+
+  class LayeredServer: public EchoServer
+  {
+  public:
+    atomic<int> connections{0};
+    LayeredServer(): EchoServer(1) {}
+    Net::TCPSocket *create_client_socket(int client_fd) override
+    { return new LayeredSocket(client_fd); }
+    Net::EventConnection *create_connection(Net::TCPSocket *s,
+                                            Net::EndPoint client) override
+    { connections++; return EchoServer::create_connection(s, client); }
+  };
+
+  LayeredServer server;
+  Net::EventTCPServerThread server_thread(server);
+
+  Net::TCPClient client(Net::EndPoint(Net::IPAddress("127.0.0.1"),
+                                      server.local().port), 5);
+  ASSERT_FALSE(!client);
+  string reply;
+  client.set_timeout(5);
+  EXPECT_FALSE(client.read(reply));
+  EXPECT_EQ(0, server.connections);
+  server.shutdown();
+}
+
+TEST(EventTCPServerTests, TestTakeOver)
+{
+  EchoServer server(1);
+  Net::EventTCPServerThread server_thread(server);
+
+  int fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  server.take_over(fds[0], Net::EndPoint());
+
+  Net::TCPSocket local(fds[1]);
+  local.write("ping");
+  string reply;
+  ASSERT_TRUE(local.read(reply, 4));
+  EXPECT_EQ("ping", reply);
+  server.shutdown();
+}
+
+TEST(EventTCPServerTests, TestSlowReaderDoesntBlockOthers)
+{
+  EchoServer server(1);
+  Net::EventTCPServerThread server_thread(server);
+  Net::EndPoint ep(Net::IPAddress("127.0.0.1"), server.local().port);
+
+  // Ask for far more than the socket buffers hold, and don't read it
+  Net::TCPClient slow(ep, 5);
+  ASSERT_FALSE(!slow);
+  slow.write("big");
+  this_thread::sleep_for(chrono::milliseconds{50});
+
+  // Same reactor still serves someone else
+  Net::TCPClient fast(ep, 5);
+  ASSERT_FALSE(!fast);
+  fast.write("hello");
+  string reply;
+  ASSERT_TRUE(fast.read(reply, 5));
+  EXPECT_EQ("hello", reply);
+
+  // And the slow one gets all of it eventually
+  reply.clear();
+  ASSERT_TRUE(slow.read(reply, EchoServer::big_reply));
+  EXPECT_EQ(EchoServer::big_reply, reply.size());
+  server.shutdown();
+}
+
+TEST(EventTCPServerTests, TestOutputWrittenBeforeClose)
+{
+  EchoServer server(1);
+  Net::EventTCPServerThread server_thread(server);
+
+  Net::TCPClient client(Net::EndPoint(Net::IPAddress("127.0.0.1"),
+                                      server.local().port), 5);
+  ASSERT_FALSE(!client);
+  client.write("bye");
+  string reply;
+  ASSERT_TRUE(client.read(reply, 3));
+  EXPECT_EQ("bye", reply);
+  EXPECT_FALSE(client.read(reply));
+  server.shutdown();
+}
+
+TEST(EventTCPServerTests, TestOutOfFdsDropsConnection)
+{
+  EchoServer server(1);
+  Net::EventTCPServerThread server_thread(server);
+  Net::EndPoint ep(Net::IPAddress("127.0.0.1"), server.local().port);
+
+  // Use up all the fds but one, for the client
+  struct rlimit old_limit, limit;
+  ASSERT_EQ(0, getrlimit(RLIMIT_NOFILE, &old_limit));
+  limit = old_limit;
+  limit.rlim_cur = 256;
+  ASSERT_EQ(0, setrlimit(RLIMIT_NOFILE, &limit));
+  vector<int> fds;
+  for(;;)
+  {
+    auto fd = open("/dev/null", O_RDONLY);
+    if (fd < 0) break;
+    fds.push_back(fd);
+  }
+  ASSERT_FALSE(fds.empty());
+  close(fds.back());
+  fds.pop_back();
+
+  // Server can't keep it, so closes it rather than spinning on it
+  auto connected = false, closed = false;
+  {
+    Net::TCPClient client(ep, 5);
+    connected = !!client;
+    client.set_timeout(5);
+    string reply;
+    closed = connected && !client.read(reply);
+  }
+
+  for(auto fd: fds) close(fd);
+  setrlimit(RLIMIT_NOFILE, &old_limit);
+  EXPECT_TRUE(connected);
+  EXPECT_TRUE(closed);
+
+  // And serves normally again
+  Net::TCPClient client(ep, 5);
+  ASSERT_FALSE(!client);
+  client.write("hello");
+  string reply;
+  ASSERT_TRUE(client.read(reply, 5));
+  EXPECT_EQ("hello", reply);
+  server.shutdown();
+}
+
+//--------------------------------------------------------------------------
+// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
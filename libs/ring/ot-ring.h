@@ -17,6 +17,7 @@
 
 #include <atomic>
 #include <vector>
+#include <utility>
 
 namespace ObTools { namespace Ring {
 
@@ -32,18 +33,62 @@ using namespace std;
 template<class ITEM_T> class Buffer
 {
 private:
+  static const size_t cache_line = 64;
+
   vector<ITEM_T> items;           // Fixed array of items
-  atomic<unsigned> in_index{0};   // Index of next item to be written
-  atomic<unsigned> out_index{0};  // Index of next item to be read
+
+  // Writer's side, on its own cache line
+  alignas(cache_line) atomic<unsigned> in_index{0};
+                                  // Index of next item to be written
+  unsigned cached_out_index{0};   // Writer's last view of out_index
+
+  // Reader's side, on its own cache line
+  alignas(cache_line) atomic<unsigned> out_index{0};
+                                  // Index of next item to be read
 
   // Note: in_index == out_index => queue empty
   //       in_index == out_index-1 (mod length) => queue full
   // Therefore queue is full at (length-1) items, and we allocate one
   // more than asked for
+  //
+  // The writer only re-reads out_index when its cached copy says the
+  // queue is full, which saves pulling in the reader's cache line on every
+  // put.  The reader doesn't do the same with in_index, because
+  // flush_from_put() can move in_index backwards under it
 
   //------------------------------------------------------------------------
   // Modular increment - increments the value given, mod length
-  unsigned inc(unsigned n) { return (++n>=items.size())?0:n; }
+  unsigned inc(unsigned n) const { return (++n>=items.size())?0:n; }
+
+  //------------------------------------------------------------------------
+  // Number of items between out and in
+  unsigned count(unsigned in, unsigned out) const
+  { return out<=in ? in-out : in+items.size()-out; }
+
+  //------------------------------------------------------------------------
+  // Free space for the writer, given in_index - only checks the reader's
+  // real position if there aren't enough spaces wanted
+  unsigned free_space(unsigned in, unsigned wanted = 1)
+  {
+    auto space = size() - count(in, cached_out_index);
+    if (space < wanted)
+    {
+      cached_out_index = out_index.load(memory_order_acquire);
+      space = size() - count(in, cached_out_index);
+    }
+    return space;
+  }
+
+  //------------------------------------------------------------------------
+  // Write an item, copied or moved
+  template<class T> bool put_item(T&& item)
+  {
+    const auto in = in_index.load(memory_order_relaxed);
+    if (!free_space(in)) return false;
+    items[in] = std::forward<T>(item);
+    in_index.store(inc(in), memory_order_release);
+    return true;
+  }
 
 public:
   //------------------------------------------------------------------------
@@ -52,37 +97,80 @@ public:
 
   //------------------------------------------------------------------------
   // Write an item - returns whether successfully written (buffer wasn't full)
-  bool put(const ITEM_T& item)
+  bool put(const ITEM_T& item) { return put_item(item); }
+
+  //------------------------------------------------------------------------
+  // Write an item by moving it - returns whether successfully written
+  // (buffer wasn't full), item is unchanged if not
+  bool put(ITEM_T&& item) { return put_item(std::move(item)); }
+
+  //------------------------------------------------------------------------
+  // Write up to n items from the given iterator (use make_move_iterator()
+  // to move them) - returns the number written, which is less than n only
+  // if the buffer filled up
+  // The reader sees them all at once
+  template<class InputIterator> unsigned put_n(InputIterator first,
+                                               unsigned n)
   {
-    unsigned next_in_index = inc(in_index);
-    if (next_in_index == out_index) return false;
-    items[in_index] = item;
-    in_index = next_in_index;
-    return true;
+    auto in = in_index.load(memory_order_relaxed);
+    auto space = free_space(in, n);
+    if (n > space) n = space;
+    for(auto i=0u; i<n; i++, ++first)
+    {
+      items[in] = *first;
+      in = inc(in);
+    }
+    in_index.store(in, memory_order_release);
+    return n;
   }
 
   //------------------------------------------------------------------------
   // Read an item - returns whether successfully fetched (buffer wasn't
-  // empty) and sets item_p if so
+  // empty) and moves it into item_p if so
   bool get(ITEM_T& item_p)
   {
-    if (out_index == in_index) return false;
-    item_p = items[out_index];
-    out_index = inc(out_index);
+    const auto out = out_index.load(memory_order_relaxed);
+    if (out == in_index.load(memory_order_acquire)) return false;
+    item_p = std::move(items[out]);
+    out_index.store(inc(out), memory_order_release);
     return true;
   }
 
+  //------------------------------------------------------------------------
+  // Read up to n items into the given output iterator, moving them -
+  // returns the number read
+  template<class OutputIterator> unsigned get_n(OutputIterator result,
+                                                unsigned n)
+  {
+    auto out = out_index.load(memory_order_relaxed);
+    const auto available = count(in_index.load(memory_order_acquire), out);
+    if (n > available) n = available;
+    for(auto i=0u; i<n; i++, ++result)
+    {
+      *result = std::move(items[out]);
+      out = inc(out);
+    }
+    out_index.store(out, memory_order_release);
+    return n;
+  }
+
   // Ways to flush the queue:  Both end up with in_index=out_index, but
   // you must call the right one depending whether you are the putter or
   // getter, otherwise there is a race condition
 
   //------------------------------------------------------------------------
   // Flush the queue, called from putter side
-  void flush_from_put() { in_index = out_index.load(); }
+  void flush_from_put()
+  {
+    cached_out_index = out_index.load(memory_order_acquire);
+    in_index.store(cached_out_index, memory_order_release);
+  }
 
   //------------------------------------------------------------------------
   // Flush the queue, called from getter side
-  void flush_from_get() { out_index = in_index.load(); }
+  void flush_from_get()
+  { out_index.store(in_index.load(memory_order_acquire),
+                    memory_order_release); }
 
   //------------------------------------------------------------------------
   // Get array size
@@ -90,9 +178,9 @@ public:
 
   //------------------------------------------------------------------------
   // Get number of items used
-  unsigned used() const { return out_index<=in_index?
-                                    in_index-out_index:
-                                    in_index+items.size()-out_index; }
+  unsigned used() const
+  { return count(in_index.load(memory_order_acquire),
+                 out_index.load(memory_order_acquire)); }
 };
 
 //==========================================================================
@@ -9,6 +9,8 @@
 
 #include <gtest/gtest.h>
 #include "ot-ring.h"
+#include <memory>
+#include <thread>
 
 using namespace std;
 using namespace ObTools;
@@ -73,6 +75,94 @@ TEST(RingBuffer, TestRingBufferUsedWorksAfterWrap)
   ASSERT_EQ(7, buffer.used());
 }
 
+TEST(RingBuffer, TestPutNGetNWrapAndFill)
+{
+  Ring::Buffer<int> buffer(10);
+  vector<int> in{1, 2, 3, 4, 5, 6, 7};
+  ASSERT_EQ(7, buffer.put_n(in.begin(), 7));
+
+  int out[10];
+  ASSERT_EQ(5, buffer.get_n(out, 5));
+  EXPECT_EQ(1, out[0]);
+  EXPECT_EQ(5, out[4]);
+
+  // Only 8 spaces left, across the wrap
+  ASSERT_EQ(8, buffer.put_n(in.begin(), 7) + buffer.put_n(in.begin(), 7));
+  ASSERT_EQ(10, buffer.used());
+  EXPECT_FALSE(buffer.put(99));
+
+  ASSERT_EQ(10, buffer.get_n(out, 20));
+  EXPECT_EQ(6, out[0]);
+  EXPECT_EQ(7, out[1]);
+  EXPECT_EQ(1, out[2]);
+  EXPECT_EQ(1, out[9]);
+  EXPECT_EQ(0, buffer.get_n(out, 10));
+}
+
+TEST(RingBuffer, TestMoveOnlyItems)
+{
+  Ring::Buffer<unique_ptr<int>> buffer(2);
+  ASSERT_TRUE(buffer.put(unique_ptr<int>(new int(42))));
+
+  vector<unique_ptr<int>> more;
+  more.emplace_back(new int(43));
+  more.emplace_back(new int(44));
+  ASSERT_EQ(1, buffer.put_n(make_move_iterator(more.begin()), 2));
+  EXPECT_EQ(nullptr, more[0]);
+  EXPECT_NE(nullptr, more[1]);
+
+  unique_ptr<int> p;
+  ASSERT_TRUE(buffer.get(p));
+  EXPECT_EQ(42, *p);
+  ASSERT_TRUE(buffer.get(p));
+  EXPECT_EQ(43, *p);
+  EXPECT_FALSE(buffer.get(p));
+}
+
+TEST(RingBuffer, TestFlush)
+{
+  Ring::Buffer<int> buffer(4);
+  for(int i=0; i<4; i++) buffer.put(i);
+  buffer.flush_from_put();
+  EXPECT_EQ(0, buffer.used());
+  for(int i=0; i<4; i++) EXPECT_TRUE(buffer.put(i));
+  buffer.flush_from_get();
+  EXPECT_EQ(0, buffer.used());
+  EXPECT_TRUE(buffer.put(1));
+}
+
+TEST(RingBuffer, TestThreadedTransferKeepsOrder)
+{
+  const auto n = 100000u;
+  Ring::Buffer<unsigned> buffer(1024);
+  thread writer([&buffer, n]()
+  {
+    unsigned batch[64];
+    for(auto i=0u; i<n;)
+    {
+      auto k = 0u;
+      for(; k<64 && i+k<n; k++) batch[k] = i+k;
+      auto put = buffer.put_n(batch, k);
+      if (!put) this_thread::yield();
+      i += put;
+    }
+  });
+
+  auto expected = 0u;
+  auto ok = true;
+  unsigned batch[64];
+  while (expected < n)
+  {
+    auto got = buffer.get_n(batch, 64);
+    if (!got) this_thread::yield();
+    for(auto k=0u; k<got; k++)
+      if (batch[k] != expected++) ok = false;
+  }
+  writer.join();
+  EXPECT_TRUE(ok);
+  EXPECT_EQ(0, buffer.used());
+}
+
 int main(int argc, char **argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
@@ -210,6 +210,12 @@ public:
   // Get list of headers, parsed out into Header structures
   list<Header> get_headers() const;
 
+  //------------------------------------------------------------------------
+  // Get the envelope element, including its namespace attributes
+  // Returns Element::none if invalid
+  const XML::Element& get_envelope() const
+  { return doc ? *doc : XML::Element::none; }
+
   //------------------------------------------------------------------------
   // Get a single header of a particular name
   // Returns whether successful;  fills in h if so
@@ -103,6 +103,10 @@ public:
   // Raw stream write wrapper override
   ssize_t cwrite(const void *buf, size_t count);
 
+  //------------------------------------------------------------------------
+  // Plain only if SSL is not attached
+  bool is_plain() const { return !ssl; }
+
   //------------------------------------------------------------------------
   // Get peer's X509 common name
   string get_peer_cn();
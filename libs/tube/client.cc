@@ -238,13 +238,8 @@ bool Client::send_messages(Log::Streams& log)
     // might jump in here and kill it under us, otherwise
     MT::Lock lock(mutex);
 
-    // Write chunk header
-    socket->write_nbo_int(msg.tag);
-    socket->write_nbo_int(msg.data.size());
-    socket->write_nbo_int(msg.flags); // Flags
-
-    // Write data
-    socket->write(msg.data);
+    // Write chunk header and data
+    msg.write_to(*socket);
   }
   catch (const Net::SocketError& se)
   {
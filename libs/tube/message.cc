@@ -13,6 +13,29 @@
 
 namespace ObTools { namespace Tube {
 
+//--------------------------------------------------------------------------
+// Write the whole frame to a socket
+// Header and data are written separately, without copying the data, but
+// corked so the header doesn't go out alone and leave the data waiting for
+// its ACK.  On failure the socket is left corked, but is no use anyway
+void Message::write_to(Net::TCPSocket& socket) const
+{
+  unsigned char header[12];
+  auto p = header;
+  for(const auto i: {tag, static_cast<uint32_t>(data.size()), flags})
+  {
+    *p++ = static_cast<unsigned char>(i >> 24);
+    *p++ = static_cast<unsigned char>(i >> 16);
+    *p++ = static_cast<unsigned char>(i >> 8);
+    *p++ = static_cast<unsigned char>(i);
+  }
+
+  socket.set_cork(true);
+  socket.write(header, sizeof(header));
+  socket.write(data);
+  socket.set_cork(false);
+}
+
 }} // namespaces
 
 
@@ -125,6 +125,11 @@ struct Message
   //------------------------------------------------------------------------
   // Get a friendly string version of the tag
   string stag() const { return "'"+tag_to_string(tag)+"'"; }
+
+  //------------------------------------------------------------------------
+  // Write the whole frame (tag, length, flags, data) to a socket
+  // Throws Net::SocketError on failure
+  void write_to(Net::TCPSocket& socket) const;
 };
 
 //==========================================================================
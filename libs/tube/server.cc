@@ -47,13 +47,8 @@ class ServerSendThread: public MT::Thread
 
       try // Handle SocketErrors
       {
-        // Write chunk header
-        session.socket.write_nbo_int(msg.tag);
-        session.socket.write_nbo_int(msg.data.size());
-        session.socket.write_nbo_int(msg.flags); // Flags
-
-        // Write data
-        session.socket.write(msg.data);
+        // Write chunk header and data
+        msg.write_to(session.socket);
       }
       catch (const Net::SocketError& se)
       {
@@ -0,0 +1,68 @@
+//==========================================================================
+// ObTools::Web: async-http-server.cc
+//
+// Event-driven HTTP server - subclassed to implement handlers
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "ot-web.h"
+#include <sstream>
+
+#if defined(PLATFORM_LINUX)
+namespace ObTools { namespace Web {
+
+namespace
+{
+  const auto read_size = 16384;
+}
+
+//--------------------------------------------------------------------------
+// Readable connection handler
+// Reads what is available, and answers every complete request buffered
+bool AsyncHTTPServer::handle(Net::EventConnection& econn)
+{
+  auto& conn = static_cast<Connection&>(econn);
+
+  char buf[read_size];
+  auto size = conn.socket->read(buf, read_size);
+  if (!size) return false;  // Closed
+  conn.parser.feed(buf, size);
+
+  // Collect responses to pipelined requests into a single send
+  ostringstream out;
+  auto persistent = true;
+  while (persistent)
+  {
+    HTTPMessage request;
+    auto result = conn.parser.parse(request);
+    if (result == HTTPParser::Result::incomplete) break;
+
+    HTTPMessage response;
+    if (result == HTTPParser::Result::error)
+    {
+      Log::Error log;
+      log << "Bad HTTP request from " << conn.client << endl;
+      response = HTTPMessage(400, "Bad Request", "HTTP/1.1");
+      response.write(out);
+      persistent = false;
+      break;
+    }
+
+    persistent = build_response(request, response, conn.client_details,
+                                conn.persistent, [&]()
+      { return handle_request(request, response, conn.client_details); });
+    conn.persistent = persistent;
+
+    // Suppress body if a HEAD request
+    response.write(out, request.method == "HEAD");
+  }
+
+  // Queued, so a slow reader doesn't hold up the reactor
+  conn.send(out.str());
+  return persistent;
+}
+
+}} // namespaces
+#endif // PLATFORM_LINUX
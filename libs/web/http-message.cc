@@ -58,6 +58,56 @@ bool HTTPMessage::get_first_line(istream& in, string& s)
 }
 
 
+//--------------------------------------------------------------------------
+// Parse a request/response first line into method/url/version or
+// version/code/reason
+// Returns whether successful
+bool HTTPMessage::parse_first_line(const string& line)
+{
+  // Split line into method, URI and version, and set in root
+  string::size_type sp1 = line.find(' ');
+  if (sp1 == string::npos) return false;
+  string first(line, 0, sp1);
+
+  // Check for '/' in first word, indicating response
+  if (first.find('/') != string::npos)
+  {
+    // It's a response - get first word as version
+    version = first;
+
+    // Next word is code
+    string::size_type sp2 = line.find(' ', sp1+1);
+    if (sp2 == string::npos) return false;
+    code = atoi(string(line, sp1+1, sp2-sp1-1).c_str());
+
+    // Rest is reason
+    reason = string(line, sp2+1);
+
+    // Method, URL are empty
+    method.clear();
+    url.clear();
+  }
+  else
+  {
+    // It's a request
+    method = first;
+
+    // URI is next
+    string::size_type sp2 = line.find(' ', sp1+1);
+    if (sp2 == string::npos) return false;
+    url.text = string(line, sp1+1, sp2-sp1-1);
+
+    // Version is the rest
+    version = string(line, sp2+1);
+
+    // Code, reason are empty
+    code = 0;
+    reason.clear();
+  }
+
+  return true;
+}
+
 //--------------------------------------------------------------------------
 // Read request/response and headers from a stream
 // Leave stream ready to read body (if any)
@@ -108,46 +158,7 @@ bool HTTPMessage::read_headers(istream &in)
     return true;
   }
 
-  // Split line into method, URI and version, and set in root
-  string::size_type sp1 = line.find(' ');
-  if (sp1 == string::npos) return false;
-  string first(line, 0, sp1);
-
-  // Check for '/' in first word, indicating response
-  if (first.find('/') != string::npos)
-  {
-    // It's a response - get first word as version
-    version = first;
-
-    // Next word is code
-    string::size_type sp2 = line.find(' ', sp1+1);
-    if (sp2 == string::npos) return false;
-    code = atoi(string(line, sp1+1, sp2-sp1-1).c_str());
-
-    // Rest is reason
-    reason = string(line, sp2+1);
-
-    // Method, URL are empty
-    method.clear();
-    url.clear();
-  }
-  else
-  {
-    // It's a request
-    method = first;
-
-    // URI is next
-    string::size_type sp2 = line.find(' ', sp1+1);
-    if (sp2 == string::npos) return false;
-    url.text = string(line, sp1+1, sp2-sp1-1);
-
-    // Version is the rest
-    version = string(line, sp2+1);
-
-    // Code, reason are empty
-    code = 0;
-    reason.clear();
-  }
+  if (!parse_first_line(line)) return false;
 
   // Now read headers
   return headers.read(in);
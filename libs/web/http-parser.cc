@@ -0,0 +1,271 @@
+//==========================================================================
+// ObTools::Web: http-parser.cc
+//
+// Incremental buffer-based parser for HTTP messages
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "ot-web.h"
+#include "ot-text.h"
+#include <string.h>
+
+namespace ObTools { namespace Web {
+
+//--------------------------------------------------------------------------
+// Add data received
+void HTTPParser::feed(const char *data, size_t length)
+{
+  // Drop anything already consumed before we grow the buffer
+  if (start)
+  {
+    buffer.erase(0, start);
+    scanned -= start;
+    pos = pos > start ? pos - start : 0;
+    start = 0;
+  }
+
+  buffer.append(data, length);
+}
+
+//--------------------------------------------------------------------------
+// Discard all state and data
+void HTTPParser::reset()
+{
+  buffer.clear();
+  start = scanned = pos = remaining = 0;
+  state = State::headers;
+  current = HTTPMessage();
+}
+
+//--------------------------------------------------------------------------
+// Find the end of a line starting at pos, in body states
+// Sets line_end to the position of the '\n'
+// Returns whether one was found
+bool HTTPParser::find_line(string::size_type& line_end)
+{
+  line_end = buffer.find('\n', pos);
+  return line_end != string::npos;
+}
+
+//--------------------------------------------------------------------------
+// Parse a single 'name: value' header line into the current message
+// Returns whether successful
+bool HTTPParser::parse_header_line(const char *data, size_t length)
+{
+  // Lines without colons or values are ignored, as MIMEHeaders::read()
+  current.headers.parse_line(string_view(data, length));
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Parse the first line and headers from a complete header block
+// Returns whether successful
+bool HTTPParser::parse_headers(const char *data, size_t length)
+{
+  auto end = data + length;
+  auto p = data;
+  bool first = true;
+  string folded;   // Current header, accumulated over continuation lines
+
+  while (p < end)
+  {
+    auto nl = static_cast<const char *>(memchr(p, '\n', end-p));
+    if (!nl) nl = end;
+    auto line_end = (nl > p && nl[-1] == '\r') ? nl-1 : nl;
+
+    if (first)
+    {
+      if (!current.parse_first_line(string(p, line_end))) return false;
+      first = false;
+    }
+    else if (line_end > p && (*p == ' ' || *p == '\t') && !folded.empty())
+    {
+      // Continuation of the previous header
+      folded += ' ';
+      folded.append(p, line_end);
+    }
+    else
+    {
+      if (!folded.empty()
+          && !parse_header_line(folded.data(), folded.size()))
+        return false;
+      folded.assign(p, line_end);
+    }
+
+    p = nl+1;
+  }
+
+  if (first) return false;  // No first line at all
+  return folded.empty() || parse_header_line(folded.data(), folded.size());
+}
+
+//--------------------------------------------------------------------------
+// Try to extract a complete message from the buffered data
+HTTPParser::Result HTTPParser::parse(HTTPMessage& msg)
+{
+  bool done = false;
+  while (!done)
+  {
+    switch (state)
+    {
+      case State::headers:
+      {
+        // Be lenient about blank lines before the first line, as per RFC
+        while (start < buffer.size()
+               && (buffer[start] == '\r' || buffer[start] == '\n'))
+          start++;
+        if (scanned < start) scanned = start;
+
+        // Look for the blank line ending the headers, resuming where we
+        // left off last time
+        string::size_type end = string::npos;
+        while (end == string::npos)
+        {
+          auto nl = buffer.find('\n', scanned);
+          if (nl == string::npos)
+          {
+            scanned = buffer.size();
+            break;
+          }
+
+          // Need to see what follows before we can decide
+          if (nl+1 >= buffer.size()) { scanned = nl; break; }
+          if (buffer[nl+1] == '\n')
+            end = nl+2;
+          else if (buffer[nl+1] == '\r')
+          {
+            if (nl+2 >= buffer.size()) { scanned = nl; break; }
+            if (buffer[nl+2] == '\n') end = nl+3;
+            else scanned = nl+1;
+          }
+          else scanned = nl+1;
+        }
+
+        if (end == string::npos)
+        {
+          if (buffer.size() - start > MAX_HEADERS) return Result::error;
+          return Result::incomplete;
+        }
+
+        if (end - start > MAX_HEADERS) return Result::error;
+
+        current = HTTPMessage();
+        if (!parse_headers(buffer.data()+start, end-start))
+          return Result::error;
+        pos = end;
+
+        // Decide how the body is delimited
+        if (Text::tolower(current.headers.get("transfer-encoding"))
+            == "chunked")
+        {
+          state = State::chunk_size;
+        }
+        else
+        {
+          auto length = Text::stoi64(current.headers.get("content-length"));
+          if (length > max_body) return Result::error;
+          remaining = length;
+          state = State::body;
+        }
+        break;
+      }
+
+      case State::body:
+      case State::chunk_data:
+      {
+        if (buffer.size() - pos < remaining) return Result::incomplete;
+        current.body.append(buffer, pos, remaining);
+        pos += remaining;
+        remaining = 0;
+
+        if (state == State::body)
+          done = true;
+        else
+          state = State::chunk_size;
+        break;
+      }
+
+      case State::chunk_size:
+      {
+        string::size_type nl;
+        if (!find_line(nl))
+        {
+          if (buffer.size() - pos > MAX_HEADERS) return Result::error;
+          return Result::incomplete;
+        }
+
+        auto line_end = (nl > pos && buffer[nl-1] == '\r') ? nl-1 : nl;
+        string line(buffer, pos, line_end-pos);
+        pos = nl+1;
+
+        // Blank line is the end of the previous chunk
+        if (line.empty()) break;
+
+        // Ignore any chunk extensions
+        auto semi = line.find(';');
+        if (semi != string::npos) line.resize(semi);
+        line = Text::canonicalise_space(line);
+        if (line.empty()) return Result::error;
+
+        // Must be valid hex - anything else would read as the last chunk
+        if (line.size() > 16
+            || line.find_first_not_of("0123456789abcdefABCDEF")
+               != string::npos)
+          return Result::error;
+
+        auto length = Text::xtoi64(line);
+        if (!length)
+        {
+          state = State::trailers;
+        }
+        else
+        {
+          if (length > max_body - current.body.size()) return Result::error;
+          remaining = length;
+          state = State::chunk_data;
+        }
+        break;
+      }
+
+      case State::trailers:
+      {
+        string::size_type nl;
+        if (!find_line(nl))
+        {
+          if (buffer.size() - pos > MAX_HEADERS) return Result::error;
+          return Result::incomplete;
+        }
+
+        auto line_end = (nl > pos && buffer[nl-1] == '\r') ? nl-1 : nl;
+        auto length = line_end - pos;
+        auto line_start = pos;
+        pos = nl+1;
+
+        // Blank line ends trailers and message
+        if (!length)
+          done = true;
+        else if (!parse_header_line(buffer.data()+line_start, length))
+          return Result::error;
+        break;
+      }
+    }
+  }
+
+  msg = move(current);
+  current = HTTPMessage();
+  state = State::headers;
+  start = scanned = pos;
+
+  // Tidy up fully consumed buffer cheaply
+  if (start == buffer.size())
+  {
+    buffer.clear();
+    start = scanned = pos = 0;
+  }
+
+  return Result::complete;
+}
+
+}} // namespaces
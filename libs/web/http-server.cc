@@ -20,6 +20,175 @@ namespace
   const auto websocket_key_guid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
 }
 
+//==========================================================================
+// Common HTTP protocol handling
+
+//--------------------------------------------------------------------------
+// Build the response to a request
+// Returns whether the connection should persist
+bool HTTPServerBase::build_response(HTTPMessage& request,
+                                    HTTPMessage& response,
+                                    const SSL::ClientDetails& client,
+                                    bool was_persistent,
+                                    const function<bool()>& handle)
+{
+  Log::Streams log;
+  auto persistent = false;
+
+  // Log request
+  log.detail << request.version << " request: " << request.method
+             << " from " << client << " for "
+             << request.url << endl;
+  OBTOOLS_LOG_IF_DEBUG(
+    log.debug << request.headers.get_xml();
+    if (request.body.size())
+      log.debug << "Body:\n" << request.body << endl;
+  )
+
+  // Set version to reflect client
+  response.version = request.version;
+
+  // Add our own advert
+  if (!version.empty()) response.headers.put("server", version);
+
+  // Add CORS origin header if set and they supply an Origin
+  if (!cors_origin.empty() && request.headers.has("origin"))
+    response.headers.put("Access-Control-Allow-Origin", cors_origin);
+
+  // Add date
+  response.headers.put_date();
+
+  // Check version
+  if (request.version == "HTTP/1.0" || request.version == "HTTP/1.1")
+  {
+    string conn_hdr = Text::tolower(request.headers.get("connection"));
+    const auto conn_opts = Text::split(conn_hdr);
+
+    // Check for HTTP/1.1
+    if (request.version == "HTTP/1.1")
+    {
+      // Check for Connection: close - otherwise, assume persistent
+      // WebSocket upgrades are also non-persistent
+      if (find(conn_opts.begin(), conn_opts.end(), "close")
+          != conn_opts.end() ||
+          find(conn_opts.begin(), conn_opts.end(), "upgrade")
+          != conn_opts.end())
+      {
+        if (was_persistent)
+          log.detail << "HTTP/1.1 persistent connection from "
+                     << client << " closed\n";
+        else
+          log.detail << "HTTP/1.1 non-persistent connection\n";
+      }
+      else
+      {
+        if (was_persistent)
+          log.detail << "HTTP/1.1 persistent connection from "
+                     << client << " continues\n";
+        else
+          log.detail << "HTTP/1.1 persistent connection started\n";
+        persistent = true;
+      }
+    }
+    else
+    {
+      // Check for old-style HTTP/1.0 Keep-Alive
+      if (find(conn_opts.begin(), conn_opts.end(), "keep-alive")
+          != conn_opts.end())
+      {
+        if (was_persistent)
+          log.detail << "HTTP/1.0 persistent connection from "
+                     << client << " continues\n";
+        else
+          log.detail << "HTTP/1.0 persistent connection started\n";
+
+        // Reflect it back in response
+        response.headers.put("connection", "Keep-Alive");
+
+        persistent = true;
+      }
+      else
+      {
+        // We stop
+        if (was_persistent)
+          log.detail << "HTTP/1.0 persistent connection from "
+                     << client << " closed\n";
+        else
+          log.detail << "HTTP/1.0 non-persistent connection\n";
+      }
+    }
+
+    // Be optimistic - saves handler doing it for simple cases
+    response.code = 200;
+    response.reason = "OK";
+
+    // Check authentication / authorisation
+    if (!check_auth(request, response, client))
+    {
+      // If they set it, leave response code alone
+      if (response.code == 200)
+      {
+        // Otherwise generic 401, hope they have set WWW-Authenticate
+        response.code = 401;
+        response.reason = "Unauthorized";
+      }
+    }
+    // Check for OPTIONS request - mainly for CORS
+    // (we have already set access-control header above)
+    else if (request.method == "OPTIONS")
+    {
+      response.headers.put("Allow",
+                           "GET, POST, PUT, DELETE, HEAD, OPTIONS");
+      response.headers.put("Access-Control-Allow-Methods",
+                           "GET, POST, PUT, DELETE, HEAD, OPTIONS");
+      response.headers.put("Access-Control-Allow-Headers",
+                           "user-agent, content-type, authorization");
+    }
+    // In all other cases call down to the server
+    else
+    {
+      try
+      {
+        if (!handle())
+        {
+          log.error << "Handler failed - sending 500\n";
+          error(response, 500, "Server Failure");
+        }
+      }
+      catch (URLHandler::Exception& e)
+      {
+        error(response, e.code, e.what());
+      }
+      catch (exception& e)
+      {
+        log.error << "URL handler raised exception: " << e.what() << endl;
+        error(response, 500, "Internal error");
+      }
+    }
+  }
+  else
+  {
+    response.version = "HTTP/1.1";
+    error(response, 505, "HTTP Version not supported");
+  }
+
+  // Add any other custom headers - note after all the above so
+  // we can override them
+  for(const auto& p: response_headers)
+    response.headers.put(p.first, p.second);
+
+  // Log response
+  log.detail << "Response: " << response.code << " "
+             << response.reason << endl;
+  OBTOOLS_LOG_IF_DEBUG(
+    log.debug << response.headers.get_xml();
+    if (response.body.size())
+      log.debug << "Body:\n" << response.body << endl;
+    )
+
+  return persistent;
+}
+
 //==========================================================================
 // Generic HTTP server
 
@@ -64,171 +233,29 @@ void HTTPServer::process(SSL::TCPSocket& s, const SSL::ClientDetails& client)
         return;
       }
 
-      // Log request
-      log.detail << request.version << " request: " << request.method
-                 << " from " << client << " for "
-                 << request.url << endl;
-      OBTOOLS_LOG_IF_DEBUG(
-        log.debug << request.headers.xml;
-        if (request.body.size())
-          log.debug << "Body:\n" << request.body << endl;
-      )
-
-      // Set version to reflect client
-      response.version = request.version;
-
-      // Add our own advert
-      if (!version.empty()) response.headers.put("server", version);
-
-      // Add CORS origin header if set and they supply an Origin
-      if (!cors_origin.empty() && request.headers.has("origin"))
-        response.headers.put("Access-Control-Allow-Origin", cors_origin);
-
-      // Add date
-      response.headers.put_date();
-
-      // Check version
-      if (request.version == "HTTP/1.0" || request.version == "HTTP/1.1")
-      {
-        string conn_hdr = Text::tolower(request.headers.get("connection"));
-        const auto conn_opts = Text::split(conn_hdr);
-
-        // Check for HTTP/1.1
-        if (request.version == "HTTP/1.1")
-        {
-          // Check for Connection: close - otherwise, assume persistent
-          // WebSocket upgrades are also non-persistent
-          if (find(conn_opts.begin(), conn_opts.end(), "close")
-              != conn_opts.end() ||
-              find(conn_opts.begin(), conn_opts.end(), "upgrade")
-              != conn_opts.end())
-          {
-            if (persistent)
-              log.detail << "HTTP/1.1 persistent connection from "
-                         << client << " closed\n";
-            else
-              log.detail << "HTTP/1.1 non-persistent connection\n";
-            persistent = false;
-          }
-          else
-          {
-            if (persistent)
-              log.detail << "HTTP/1.1 persistent connection from "
-                         << client << " continues\n";
-            else
-              log.detail << "HTTP/1.1 persistent connection started\n";
-            persistent = true;
-          }
-        }
-        else
+      persistent = build_response(request, response, client, persistent,
+        [&]()
         {
-          // Check for old-style HTTP/1.0 Keep-Alive
-          if (find(conn_opts.begin(), conn_opts.end(), "keep-alive")
-              != conn_opts.end())
-          {
-            if (persistent)
-              log.detail << "HTTP/1.0 persistent connection from "
-                         << client << " continues\n";
-            else
-              log.detail << "HTTP/1.0 persistent connection started\n";
-
-            // Reflect it back in response
-            response.headers.put("connection", "Keep-Alive");
-
-            persistent = true;
-          }
-          else
-          {
-            // We stop
-            if (persistent)
-              log.detail << "HTTP/1.0 persistent connection from "
-                         << client << " closed\n";
-            else
-              log.detail << "HTTP/1.0 non-persistent connection\n";
-            persistent = false;
-          }
-        }
-
-        // Be optimistic - saves handler doing it for simple cases
-        response.code = 200;
-        response.reason = "OK";
-
-        // Check authentication / authorisation
-        if (!check_auth(request, response, client))
-        {
-          // If they set it, leave response code alone
-          if (response.code == 200)
-          {
-            // Otherwise generic 401, hope they have set WWW-Authenticate
-            response.code = 401;
-            response.reason = "Unauthorized";
-          }
-        }
-        // Check for OPTIONS request - mainly for CORS
-        // (we have already set access-control header above)
-        else if (request.method == "OPTIONS")
-        {
-          response.headers.put("Allow",
-                               "GET, POST, PUT, DELETE, HEAD, OPTIONS");
-          response.headers.put("Access-Control-Allow-Methods",
-                               "GET, POST, PUT, DELETE, HEAD, OPTIONS");
-          response.headers.put("Access-Control-Allow-Headers",
-                               "user-agent, content-type, authorization");
-        }
-        // Check for WebSocket upgrade
-        else if (websocket_enabled
+          // Check for WebSocket upgrade
+          const auto conn_opts =
+            Text::split(Text::tolower(request.headers.get("connection")));
+          if (websocket_enabled
               && request.method == "GET"
               && find(conn_opts.begin(), conn_opts.end(), "upgrade")
               != conn_opts.end()
               && Text::tolower(request.headers.get("upgrade")) == "websocket")
-        {
-          log.detail << "Upgrade to WebSocket requested\n";
-          if (do_websocket_handshake(request, response))
-            do_websocket = true;
-          else
-            error(response, 400, "Bad WebSocket request");
-        }
-        // In all other cases call down to subclass implementation
-        else
-        {
-          try
           {
-            if (!handle_request(request, response, client, s, ss))
-            {
-              log.error << "Handler failed - sending 500\n";
-              error(response, 500, "Server Failure");
-            }
-          }
-          catch (URLHandler::Exception& e)
-          {
-            error(response, e.code, e.what());
-          }
-          catch (exception& e)
-          {
-            log.error << "URL handler raised exception: " << e.what() << endl;
-            error(response, 500, "Internal error");
+            log.detail << "Upgrade to WebSocket requested\n";
+            if (do_websocket_handshake(request, response))
+              do_websocket = true;
+            else
+              error(response, 400, "Bad WebSocket request");
+            return true;
           }
-        }
-      }
-      else
-      {
-        response.version = "HTTP/1.1";
-        error(response, 505, "HTTP Version not supported");
-      }
 
-      // Add any other custom headers - note after all the above so
-      // we can override them
-      for(const auto& p: response_headers)
-        response.headers.put(p.first, p.second);
-
-      // Log response
-      log.detail << "Response: " << response.code << " "
-                 << response.reason << endl;
-      OBTOOLS_LOG_IF_DEBUG(
-        log.debug << response.headers.xml;
-        if (response.body.size())
-          log.debug << "Body:\n" << response.body << endl;
-        )
+          // Otherwise call down to subclass implementation
+          return handle_request(request, response, client, s, ss);
+        });
 
       // Send out response
       // Suppress body if a HEAD request - saves simple handlers having to
@@ -310,14 +337,14 @@ bool SimpleHTTPServer::handle_request(const HTTPMessage& request,
 {
   MT::RWReadLock lock(mutex);
 
-  // Check all handlers for a URL match
-  for(list<URLHandler *>::iterator p = handlers.begin();
-      p!=handlers.end(); ++p)
-  {
-    URLHandler& h = **p;
-    if (Text::pattern_match(h.url, request.url.get_text()))
-      return h.handle_request(request, response, client);
-  }
+  // Find first handler matching URL and method
+  auto match = router.find(request.method, request.url.get_text());
+  if (match.handler)
+    return match.handler->handle_request_with_params(request, response,
+                                                     client, match.params);
+
+  if (match.wrong_method)
+    return error(response, 405, "Method not allowed");
 
   // Not found - 404
   return error(response, 404, "Not found");
@@ -34,7 +34,7 @@ int main()
          << msg.reason << endl;
   }
 
-  cout << msg.headers.xml;
+  cout << msg.headers.get_xml();
   if (msg.body.size()) cout << "Body:\n" << msg.body << endl;
 
   cout << "\n--- Regenerated\n";
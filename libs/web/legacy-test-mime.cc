@@ -24,7 +24,7 @@ int main()
   }
 
   cout << "\n--- XML form\n";
-  cout << headers.xml;
+  cout << headers.get_xml();
 
   cout << "\n--- Foo headers, split at commas:\n";
   list<string> foos = headers.get_all_splitting("foo");
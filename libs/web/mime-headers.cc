@@ -10,9 +10,250 @@
 #include "ot-web.h"
 #include "ot-text.h"
 #include <time.h>
+#include <string.h>
 
 namespace ObTools { namespace Web {
 
+namespace
+{
+  // Common header names, interned by index (0 = not interned)
+  // Must be lower-case
+  const char *const common_headers[] =
+  {
+    "",
+    "accept",
+    "accept-encoding",
+    "accept-language",
+    "access-control-allow-origin",
+    "authorization",
+    "cache-control",
+    "connection",
+    "content-encoding",
+    "content-length",
+    "content-type",
+    "cookie",
+    "date",
+    "etag",
+    "expires",
+    "host",
+    "if-modified-since",
+    "if-none-match",
+    "keep-alive",
+    "last-modified",
+    "location",
+    "origin",
+    "range",
+    "referer",
+    "sec-websocket-key",
+    "sec-websocket-version",
+    "server",
+    "set-cookie",
+    "transfer-encoding",
+    "upgrade",
+    "user-agent",
+    "x-forwarded-for"
+  };
+  const size_t num_common_headers =
+    sizeof(common_headers)/sizeof(common_headers[0]);
+
+  // Lengths of the above, calculated once
+  struct CommonLengths
+  {
+    size_t lengths[num_common_headers];
+    CommonLengths()
+    {
+      for(auto i=0u; i<num_common_headers; i++)
+        lengths[i] = strlen(common_headers[i]);
+    }
+  };
+
+  inline char lower(char c)
+  {
+    return (c >= 'A' && c <= 'Z') ? c + ('a'-'A') : c;
+  }
+
+  inline bool is_space(char c)
+  {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+  }
+
+  // Case-insensitive compare of equal length names
+  bool equal_nocase(const char *a, const char *b, size_t length)
+  {
+    for(auto i=0u; i<length; i++)
+      if (lower(a[i]) != lower(b[i])) return false;
+    return true;
+  }
+}
+
+//--------------------------------------------------------------------------
+// Get interned id of a header name, or 0 if not common
+uint8_t MIMEHeaders::intern(string_view name)
+{
+  static const CommonLengths common;
+  for(auto i=1u; i<num_common_headers; i++)
+    if (common.lengths[i] == name.size()
+        && equal_nocase(common_headers[i], name.data(), name.size()))
+      return i;
+  return 0;
+}
+
+//--------------------------------------------------------------------------
+// Find index of first header of the given name at or after 'from'
+// Returns -1 if not found
+int MIMEHeaders::find(string_view name, size_t from) const
+{
+  auto id = intern(name);
+  for(auto i=from; i<entries.size(); i++)
+  {
+    const auto& e = entries[i];
+    if (id)
+    {
+      if (e.id == id) return i;
+    }
+    else if (!e.id && e.name_length == name.size()
+             && equal_nocase(buffer.data()+e.name_offset, name.data(),
+                             name.size()))
+      return i;
+  }
+  return -1;
+}
+
+//--------------------------------------------------------------------------
+// Insert a header
+void MIMEHeaders::put(string_view name, string_view value)
+{
+  xml_view.reset();
+  if (entries.empty())
+  {
+    entries.reserve(16);
+    buffer.reserve(512);
+  }
+
+  Entry e;
+  e.name_offset = buffer.size();
+  e.name_length = name.size();
+  e.id = intern(name);
+  buffer.append(name.data(), name.size());
+  e.value_offset = buffer.size();
+  e.value_length = value.size();
+  buffer.append(value.data(), value.size());
+  entries.push_back(e);
+}
+
+//--------------------------------------------------------------------------
+// Remove all headers of the given name
+void MIMEHeaders::remove(string_view name)
+{
+  auto i = find(name);
+  if (i < 0) return;
+
+  xml_view.reset();
+  auto id = entries[i].id;
+  auto length = name.size();
+  auto out = entries.begin()+i;
+  for(auto p = out; p != entries.end(); ++p)
+  {
+    auto match = id ? p->id == id
+      : (!p->id && p->name_length == length
+         && equal_nocase(buffer.data()+p->name_offset, name.data(), length));
+    if (match)
+      garbage += p->name_length + p->value_length;
+    else
+      *out++ = *p;
+  }
+  entries.erase(out, entries.end());
+
+  if (garbage > buffer.size()/2) compact();
+}
+
+//--------------------------------------------------------------------------
+// Rebuild the buffer without removed headers
+void MIMEHeaders::compact()
+{
+  string fresh;
+  fresh.reserve(buffer.size() - garbage);
+  for(auto& e: entries)
+  {
+    auto offset = fresh.size();
+    fresh.append(buffer, e.name_offset, e.name_length);
+    fresh.append(buffer, e.value_offset, e.value_length);
+    e.name_offset = offset;
+    e.value_offset = offset + e.name_length;
+  }
+  buffer.swap(fresh);
+  garbage = 0;
+}
+
+//--------------------------------------------------------------------------
+// Remove all headers
+void MIMEHeaders::clear()
+{
+  xml_view.reset();
+  entries.clear();
+  buffer.clear();
+  garbage = 0;
+}
+
+//--------------------------------------------------------------------------
+// Get XML view
+const XML::Element& MIMEHeaders::get_xml() const
+{
+  if (!xml_view)
+  {
+    auto xml = make_shared<XML::Element>("headers");
+    for(const auto& e: entries)
+      xml->add(string(name_of(e)), string(value_of(e)));
+    xml_view = xml;
+  }
+  return *xml_view;
+}
+
+//--------------------------------------------------------------------------
+// Parse a single unfolded header line and add it
+void MIMEHeaders::parse_line(string_view line)
+{
+  auto colon = line.find(':');
+  if (colon == string_view::npos || !colon) return;
+
+  // Trim and squash value whitespace first so we can drop empty ones
+  auto value = line.substr(colon+1);
+  while (!value.empty() && is_space(value.front())) value.remove_prefix(1);
+  while (!value.empty() && is_space(value.back())) value.remove_suffix(1);
+  if (value.empty()) return;
+
+  xml_view.reset();
+  if (entries.empty())
+  {
+    entries.reserve(16);
+    buffer.reserve(512);
+  }
+
+  // Lower-case name directly into the buffer
+  Entry e;
+  e.name_offset = buffer.size();
+  e.name_length = colon;
+  for(auto i=0u; i<colon; i++) buffer += lower(line[i]);
+  e.id = intern(string_view(buffer.data()+e.name_offset, colon));
+
+  // Flatten internal whitespace
+  e.value_offset = buffer.size();
+  auto in_space = false;
+  for(auto c: value)
+  {
+    if (is_space(c))
+      in_space = true;
+    else
+    {
+      if (in_space) buffer += ' ';
+      in_space = false;
+      buffer += c;
+    }
+  }
+  e.value_length = buffer.size() - e.value_offset;
+  entries.push_back(e);
+}
+
 //--------------------------------------------------------------------------
 // Add a current date header to RFC 822 standard
 void MIMEHeaders::put_date(const string& header)
@@ -61,14 +302,13 @@ bool MIMEHeaders::getline(istream& in, string& s)
 
 //--------------------------------------------------------------------------
 // Get all headers of name 'name'
-list<string> MIMEHeaders::get_all(const string& name) const
+list<string> MIMEHeaders::get_all(string_view name) const
 {
   list<string> l;
-  for(ObTools::XML::ConstElementIterator p(xml.get_children(name)); p; ++p)
+  for(auto i = find(name); i >= 0; i = find(name, i+1))
   {
-    const ObTools::XML::Element& e=*p;
-    string value = e.content;
-    if (!value.empty()) l.push_back(value);
+    auto value = value_of(entries[i]);
+    if (!value.empty()) l.push_back(string(value));
   }
 
   return l;
@@ -78,14 +318,13 @@ list<string> MIMEHeaders::get_all(const string& name) const
 // Split multi-value headers at commas
 // Reads all headers of name 'name', and splits at delimiter to give a
 // flattened list of values
-list<string> MIMEHeaders::get_all_splitting(const string& name,
+list<string> MIMEHeaders::get_all_splitting(string_view name,
                                             char delimiter) const
 {
   list<string> l;
-  for(ObTools::XML::ConstElementIterator p(xml.get_children(name)); p; ++p)
+  for(auto i = find(name); i >= 0; i = find(name, i+1))
   {
-    const ObTools::XML::Element& e=*p;
-    string value = e.content;
+    string value(value_of(entries[i]));
 
     // Loop over all values in each header
     for(;;)
@@ -186,7 +425,7 @@ Misc::PropertyList MIMEHeaders::split_parameters(string& value)
 bool MIMEHeaders::read(istream& in, bool append)
 {
   // Clear existing
-  if (!append) xml.clear_children();
+  if (!append) clear();
 
   // Read lines
   while (!in.fail())
@@ -198,13 +437,8 @@ bool MIMEHeaders::read(istream& in, bool append)
       return true;
 
     // Check for :
-    string::size_type colon = line.find(':');
-
-    if (colon != string::npos)
+    if (line.find(':') != string::npos)
     {
-      string name(line, 0, colon);
-      string value(line, colon+1);
-
       // Check for following LWS - indicates continuation header
       for(;;)
       {
@@ -217,10 +451,10 @@ bool MIMEHeaders::read(istream& in, bool append)
           // DoS protection - just in case someone is 'clever' enough
           // to send folded headers, each of which is within the length,
           // we need to check the total length
-          if (value.size() + extra.size() > MAX_HEADER) return false;
+          if (line.size() + extra.size() > MAX_HEADER) return false;
 
-          value += ' ';
-          value += extra;
+          line += ' ';
+          line += extra;
         }
         else
         {
@@ -229,15 +463,8 @@ bool MIMEHeaders::read(istream& in, bool append)
         }
       }
 
-      // Lower-case name for comparison
-      name = Text::tolower(name);
-
-      // Strip leading and trailing whitespace and flatten internal space
-      value = Text::canonicalise_space(value);
-
-      // If anything sensible left, add it to the XML structure
-      if (!name.empty() && !value.empty())
-        xml.add(name, value);
+      // Lower-case name, flatten value, and add if anything sensible left
+      parse_line(line);
     }
   }
 
@@ -251,10 +478,10 @@ bool MIMEHeaders::read(istream& in, bool append)
 // body (if any)
 bool MIMEHeaders::write(ostream& out) const
 {
-  // Iterate over each child of root xml
-  OBTOOLS_XML_FOREACH_CHILD(e, xml)
-    string name = e.name;
-    string value = e.content;
+  for(const auto& e: entries)
+  {
+    string name(name_of(e));
+    string value(value_of(e));
 
     // Uppercase first letter and any letters after - to be conformant
     bool first = true;
@@ -309,7 +536,7 @@ bool MIMEHeaders::write(ostream& out) const
 
     // Output remainder and CRLF
     out << value << "\r\n";
-  OBTOOLS_XML_ENDFOR
+  }
 
   // Output final blank line
   if (out.fail()) return false;
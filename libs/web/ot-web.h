@@ -13,6 +13,12 @@
 #include <stdint.h>
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <functional>
 #include "ot-xml.h"
 #include "ot-misc.h"
 #include "ot-net.h"
@@ -164,11 +170,14 @@ ostream& operator<<(ostream& s, const URL& u);
 // Represents a block of MIME headers - e.g. from a mail message, or an HTTP
 // request.
 //
-// Stores in XML, since we have convenient access & iteration methods for this.
+// Stored flat: all names and values are held in a single owned buffer with
+// a small vector of offsets into it, so a typical HTTP header block costs a
+// couple of allocations.  Name lookup is case-insensitive, and names of
+// common headers are interned so they compare as a single byte.
 //
-// On input, headers are unfolded and each header is added as a sub-element of
-// the root 'xml', with name (tag) equal to the header tag **lowercased**,
-// and content equal to the text of the header
+// On input, headers are unfolded and names are **lowercased**.  An XML view
+// (root 'headers', a sub-element per header with name = tag and content =
+// value) is available through get_xml(), built only when asked for.
 //
 // On output, header names are generated with first letter capitalised,
 // following convention.  Values longer than 64 characters are folded at
@@ -180,12 +189,58 @@ private:
   static const unsigned int MAX_HEADER = 8000;  // Input DoS protection
   unsigned int max_line = 0;  // Set to 60 for MIME
 
+  // Offsets of a header in the buffer
+  struct Entry
+  {
+    uint32_t name_offset;
+    uint32_t value_offset;
+    uint32_t name_length;
+    uint32_t value_length;
+    uint8_t id;              // Interned name, or 0 if uncommon
+  };
+
+  string buffer;
+  vector<Entry> entries;
+  size_t garbage{0};         // Bytes in buffer no longer referenced
+
+  // Lazily built XML view - shared between copies since immutable once built
+  // Note: building it is not thread-safe against other const callers
+  mutable shared_ptr<XML::Element> xml_view;
+
+  static uint8_t intern(string_view name);
+  int find(string_view name, size_t from = 0) const;
+  string_view name_of(const Entry& e) const
+  { return string_view(buffer.data()+e.name_offset, e.name_length); }
+  string_view value_of(const Entry& e) const
+  { return string_view(buffer.data()+e.value_offset, e.value_length); }
+  void compact();
+
 public:
-  XML::Element xml;
+  // Single header as seen through iteration
+  struct Field
+  {
+    string_view name;
+    string_view value;
+  };
+
+  // Const iterator over headers in order
+  class const_iterator
+  {
+    const MIMEHeaders *headers;
+    size_t index;
+
+  public:
+    const_iterator(const MIMEHeaders *_headers, size_t _index):
+      headers(_headers), index(_index) {}
+    Field operator*() const { return (*headers)[index]; }
+    const_iterator& operator++() { index++; return *this; }
+    bool operator!=(const const_iterator& o) const
+    { return index != o.index; }
+  };
 
   //------------------------------------------------------------------------
   // Constructor
-  MIMEHeaders(): xml("headers") {}
+  MIMEHeaders() {}
 
   //------------------------------------------------------------------------
   // Enable folding at the given width
@@ -193,28 +248,51 @@ public:
 
   //------------------------------------------------------------------------
   // Check for presence of a header
-  bool has(const string& name) const
-  { return !!xml.get_child(name); }
+  bool has(string_view name) const { return find(name) >= 0; }
 
   //------------------------------------------------------------------------
-  // Get a specific header (first of that name)
-  string get(const string& name) const
-  { return xml.get_child(name).content; }
+  // Get a specific header (first of that name), or empty if not present
+  string get(string_view name) const
+  { return string(get_view(name)); }
+
+  //------------------------------------------------------------------------
+  // Get a specific header without copying - valid until next modification
+  string_view get_view(string_view name) const
+  {
+    auto i = find(name);
+    return i < 0 ? string_view() : value_of(entries[i]);
+  }
 
   //------------------------------------------------------------------------
   // Insert a header
-  void put(const string& name, const string& value)
-  { xml.add(name, value); }
+  void put(string_view name, string_view value);
 
   //------------------------------------------------------------------------
   // Remove all headers of the given name
-  void remove(const string& name)
-  { xml.remove_children(name); }
+  void remove(string_view name);
 
   //------------------------------------------------------------------------
   // Replace a header
-  void replace(const string& name, const string& value)
-  { remove(name); xml.add(name, value); }
+  void replace(string_view name, string_view value)
+  { remove(name); put(name, value); }
+
+  //------------------------------------------------------------------------
+  // Remove all headers
+  void clear();
+
+  //------------------------------------------------------------------------
+  // Iterate over all headers, in order
+  size_t size() const { return entries.size(); }
+  Field operator[](size_t i) const
+  { return Field{name_of(entries[i]), value_of(entries[i])}; }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, entries.size()); }
+
+  //------------------------------------------------------------------------
+  // Get XML view - built on first use after any modification
+  // Not thread-safe even though const: building it changes the object, so
+  // lock around it if other threads may be reading the same headers
+  const XML::Element& get_xml() const;
 
   //------------------------------------------------------------------------
   // Add a current date header to RFC 822 standard
@@ -222,13 +300,13 @@ public:
 
   //------------------------------------------------------------------------
   // Get all headers of name 'name'
-  list<string> get_all(const string& name) const;
+  list<string> get_all(string_view name) const;
 
   //------------------------------------------------------------------------
   // Split multi-value headers at commas
   // Reads all headers of name 'name', and splits at delimiter to give a
   // flattened list of values
-  list<string> get_all_splitting(const string& name, char delimiter=',') const;
+  list<string> get_all_splitting(string_view name, char delimiter=',') const;
 
   //------------------------------------------------------------------------
   // Split a header value (e.g. from get or get_all) into a prime value
@@ -245,6 +323,12 @@ public:
   //   pure        1
   static Misc::PropertyList split_parameters(string& value);
 
+  //------------------------------------------------------------------------
+  // Parse a single unfolded 'name: value' header line and add it, with
+  // name lowercased and value space-canonicalised
+  // Lines without a colon, or with empty name or value, are ignored
+  void parse_line(string_view line);
+
   //------------------------------------------------------------------------
   // Parse headers from a stream
   // Returns whether successful
@@ -339,6 +423,11 @@ public:
   // Check for request (not response)
   bool is_request() { return !method.empty(); }
 
+  //------------------------------------------------------------------------
+  // Parse a request/response first line (without line ending)
+  // Returns whether successful
+  bool parse_first_line(const string& line);
+
   //------------------------------------------------------------------------
   // Read request/response and headers from a stream
   // Leave stream ready to read body (if any)
@@ -401,6 +490,75 @@ istream& operator>>(istream& s, HTTPMessage& msg);
 // e.g. cout << url;
 ostream& operator<<(ostream& s, const HTTPMessage& msg);
 
+//==========================================================================
+// Incremental HTTP message parser (http-parser.cc)
+// Buffer-based alternative to HTTPMessage::read() for non-blocking servers:
+// data is fed in as it arrives and complete messages are extracted,
+// resuming across partial reads without rescanning.  The buffer may hold
+// several (pipelined) messages at once - call parse() until it stops
+// returning complete.
+// Bodies are delimited by Content-Length or chunked encoding only - there
+// is no read to EOF, and no RTSP interleave
+class HTTPParser
+{
+public:
+  enum class Result
+  {
+    incomplete,  // Need more data
+    complete,    // Message extracted
+    error        // Bad or oversized message - connection should be dropped
+  };
+
+private:
+  static const size_t MAX_HEADERS = 65536;  // Input DoS protection
+
+  enum class State
+  {
+    headers,
+    body,
+    chunk_size,
+    chunk_data,
+    trailers
+  };
+
+  size_t max_body;
+  string buffer;
+  size_t start{0};       // Start of current message in buffer
+  size_t scanned{0};     // Where to resume search for end of headers
+  size_t pos{0};         // Parse position in body states
+  size_t remaining{0};   // Body or chunk bytes still to come
+  State state{State::headers};
+  HTTPMessage current;
+
+  bool find_line(string::size_type& line_end);
+  bool parse_headers(const char *data, size_t length);
+  bool parse_header_line(const char *data, size_t length);
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor
+  // max_body limits Content-Length and total chunked size
+  HTTPParser(size_t _max_body = 64*1024*1024): max_body(_max_body) {}
+
+  //------------------------------------------------------------------------
+  // Add data received
+  void feed(const char *data, size_t length);
+  void feed(const string& data) { feed(data.data(), data.size()); }
+
+  //------------------------------------------------------------------------
+  // Try to extract a complete message from the buffered data
+  // msg is only modified if complete is returned
+  Result parse(HTTPMessage& msg);
+
+  //------------------------------------------------------------------------
+  // Get amount of unparsed data held
+  size_t buffered() const { return buffer.size() - start; }
+
+  //------------------------------------------------------------------------
+  // Discard all state and data
+  void reset();
+};
+
 //==========================================================================
 // Representation of a cookie (cookies.cc)
 struct Cookie
@@ -793,27 +951,27 @@ class WebSocketServer
 };
 
 //==========================================================================
-// HTTP Server abstract class (http-server.cc)
-// Multi-threaded server for HTTP - manages HTTP protocol state, and
-// passes request messages to subclasses
-class HTTPServer: public SSL::TCPServer
+// HTTP Server common base (http-server.cc)
+// HTTP protocol handling shared by HTTPServer and AsyncHTTPServer, which
+// only add the transport
+class HTTPServerBase
 {
-private:
-  int timeout;    // Socket inactivity timeout
-  string version; // Version reported in Server: header
+  string version;      // Version reported in Server: header
   string cors_origin;  // Pattern for Access-Control-Allow-Origin header
   map<string, string> response_headers;  // Headers to add on responses
-  bool websocket_enabled{false};
 
+protected:
   //------------------------------------------------------------------------
-  // Implementation of worker process method
-  void process(SSL::TCPSocket &s, const SSL::ClientDetails& client);
+  // Build the response to a request - checks the version and persistence,
+  // adds our standard headers, checks authentication and answers OPTIONS,
+  // then calls handle() to fill in the response, and adds custom headers
+  // handle() returns false to send 500, and may throw URLHandler::Exception
+  // was_persistent is whether the connection had persisted until now
+  // Returns whether the connection should persist after this response
+  bool build_response(HTTPMessage& request, HTTPMessage& response,
+                      const SSL::ClientDetails& client, bool was_persistent,
+                      const function<bool()>& handle);
 
-  // Internals
-  bool do_websocket_handshake(const HTTPMessage& request,
-                              HTTPMessage& response);
-
-protected:
   //------------------------------------------------------------------------
   // Helper to generate error in response, and log it
   bool error(Web::HTTPMessage& response, int code, const string& reason)
@@ -834,6 +992,50 @@ protected:
                           const SSL::ClientDetails& /*client*/)
   { return true; }
 
+public:
+  //------------------------------------------------------------------------
+  // Constructor
+  HTTPServerBase(const string& _version): version(_version) {}
+
+  //------------------------------------------------------------------------
+  // Set origin pattern for CORS (Access-Control-Allow-Origin header)
+  // pattern defaults to '*' = any origin
+  void set_cors_origin(const string& pattern = "*")
+  {
+    cors_origin = pattern;
+  }
+
+  //------------------------------------------------------------------------
+  // Add a header on responses
+  void add_response_header(const string& name, const string& value)
+  {
+    response_headers[name] = value;
+  }
+
+  //------------------------------------------------------------------------
+  // Virtual destructor
+  virtual ~HTTPServerBase() {}
+};
+
+//==========================================================================
+// HTTP Server abstract class (http-server.cc)
+// Multi-threaded server for HTTP - manages HTTP protocol state, and
+// passes request messages to subclasses
+class HTTPServer: public SSL::TCPServer, public HTTPServerBase
+{
+private:
+  int timeout;    // Socket inactivity timeout
+  bool websocket_enabled{false};
+
+  //------------------------------------------------------------------------
+  // Implementation of worker process method
+  void process(SSL::TCPSocket &s, const SSL::ClientDetails& client);
+
+  // Internals
+  bool do_websocket_handshake(const HTTPMessage& request,
+                              HTTPMessage& response);
+
+protected:
   //------------------------------------------------------------------------
   // Abstract interface to handle requests
   // Return whether handled - fill in response for normal errors, only
@@ -880,7 +1082,7 @@ public:
   HTTPServer(int port=80, const string& _version="", int backlog=5,
              int min_spare=1, int max_threads=10, int _timeout=90):
     SSL::TCPServer(0, port, backlog, min_spare, max_threads),
-    timeout(_timeout), version(_version) {}
+    HTTPServerBase(_version), timeout(_timeout) {}
 
   //------------------------------------------------------------------------
   // Constructor to bind to specific address (basic TCP)
@@ -888,7 +1090,7 @@ public:
   HTTPServer(Net::EndPoint address, const string& _version="", int backlog=5,
              int min_spare=1, int max_threads=10, int _timeout=90):
     SSL::TCPServer(0, address, backlog, min_spare, max_threads),
-    timeout(_timeout), version(_version) {}
+    HTTPServerBase(_version), timeout(_timeout) {}
 
   //------------------------------------------------------------------------
   // Constructor to bind to any interface, with SSL
@@ -897,7 +1099,7 @@ public:
              int port=80, const string& _version="", int backlog=5,
              int min_spare=1, int max_threads=10, int _timeout=90):
     SSL::TCPServer(ctx, port, backlog, min_spare, max_threads),
-    timeout(_timeout), version(_version) {}
+    HTTPServerBase(_version), timeout(_timeout) {}
 
   //------------------------------------------------------------------------
   // Constructor to bind to specific address, with SSL
@@ -906,22 +1108,7 @@ public:
              Net::EndPoint address, const string& _version="", int backlog=5,
              int min_spare=1, int max_threads=10, int _timeout=90):
     SSL::TCPServer(ctx, address, backlog, min_spare, max_threads),
-    timeout(_timeout), version(_version) {}
-
-  //------------------------------------------------------------------------
-  // Set origin pattern for CORS (Access-Control-Allow-Origin header)
-  // pattern defaults to '*' = any origin
-  void set_cors_origin(const string& pattern = "*")
-  {
-    cors_origin = pattern;
-  }
-
-  //------------------------------------------------------------------------
-  // Add a header on responses
-  void add_response_header(const string& name, const string& value)
-  {
-    response_headers[name] = value;
-  }
+    HTTPServerBase(_version), timeout(_timeout) {}
 
   //------------------------------------------------------------------------
   // Enable WebSocket upgrade
@@ -938,7 +1125,8 @@ public:
 class URLHandler
 {
 public:
-  string url;   // URL (patterns allowed)
+  string url;     // URL (patterns allowed)
+  string method;  // Method to handle (HEAD implied by GET), or empty for all
 
   //------------------------------------------------------------------------
   // Exception - handlers can throw this and server will log and return
@@ -951,8 +1139,10 @@ public:
   };
 
   //------------------------------------------------------------------------
-  // Constructor
+  // Constructors
   URLHandler(const string& _url): url(_url) {}
+  URLHandler(const string& _method, const string& _url):
+    url(_url), method(_method) {}
 
   //------------------------------------------------------------------------
   // Abstract interface to handle requests
@@ -963,11 +1153,98 @@ public:
                               HTTPMessage& response,
                               const SSL::ClientDetails& client) = 0;
 
+  //------------------------------------------------------------------------
+  // Interface to handle requests with path parameters captured by {name}
+  // segments in the URL pattern - defaults to ignoring them
+  virtual bool handle_request_with_params(const HTTPMessage& request,
+                                          HTTPMessage& response,
+                                          const SSL::ClientDetails& client,
+                                          const Misc::PropertyList&)
+  { return handle_request(request, response, client); }
+
   //------------------------------------------------------------------------
   // Virtual destructor
   virtual ~URLHandler() {}
 };
 
+//==========================================================================
+// URL router - finds the first registered handler matching a request
+// (url-router.cc)
+// Patterns are split at '/' into segments, each of which can be:
+//   literal     Matches exactly
+//   *           Matches one or more segments, as a glob '*' would
+//   {name}      Matches a single non-empty segment, captured as 'name'
+// The last segment can also be 'prefix*' which matches anything after it,
+// including any query.  Patterns with no wildcards at all are found by
+// hash; ones using other glob features fall back to Text::pattern_match().
+// Patterns match the whole URL text, as before, so those without a
+// trailing '*' do not match a URL with a query
+// Not thread-safe - lock around modification if required
+class URLRouter
+{
+  struct Route
+  {
+    URLHandler *handler;
+    size_t order;                 // Registration order - lowest wins
+    vector<string> param_names;   // Names of {name} segments in order
+  };
+
+  struct Node
+  {
+    map<string, unique_ptr<Node>, less<>> literals;
+    unique_ptr<Node> param;       // {name}
+    unique_ptr<Node> star;        // Non-final '*'
+    vector<pair<string, Route *>> tails;  // Final 'prefix*', with prefix
+    vector<Route *> routes;       // Patterns ending here
+    size_t min_order{SIZE_MAX};   // Lowest order in this subtree
+  };
+
+  // Best match so far in a search
+  struct Best
+  {
+    const Route *route{nullptr};
+    size_t order{SIZE_MAX};
+    vector<string_view> captures;
+    bool wrong_method{false};
+  };
+
+  list<Route> all_routes;
+  size_t next_order{0};
+  unordered_map<string, vector<Route *>> exact;
+  Node root;
+  vector<Route *> globs;
+
+  void insert(Route& route);
+  void search(const Node& node, const vector<string_view>& segments,
+              size_t index, bool has_query, const string& method,
+              vector<string_view>& captures, Best& best) const;
+  static bool method_matches(const Route& route, const string& method);
+  static void offer(const Route& route, const string& method,
+                    const vector<string_view>& captures, Best& best);
+
+public:
+  //------------------------------------------------------------------------
+  // Result of a find
+  struct Match
+  {
+    URLHandler *handler{nullptr};
+    Misc::PropertyList params;    // Captured {name} segments
+    bool wrong_method{false};     // Path matched, but not the method
+  };
+
+  //------------------------------------------------------------------------
+  // Add a handler, using its url and method
+  void add(URLHandler *h);
+
+  //------------------------------------------------------------------------
+  // Remove a handler
+  void remove(URLHandler *h);
+
+  //------------------------------------------------------------------------
+  // Find the first added handler matching the method and URL text
+  Match find(const string& method, const string& url) const;
+};
+
 //==========================================================================
 // Simple HTTP server which just fields GET and/or POST requests to a list
 // of registered URLs (http-server.cc)
@@ -976,6 +1253,7 @@ class SimpleHTTPServer: public HTTPServer
 {
   MT::RWMutex mutex;               // Around global state
   list<URLHandler *> handlers;
+  URLRouter router;
 
 protected:
   // Implementation of general request handler
@@ -1019,18 +1297,78 @@ public:
   //------------------------------------------------------------------------
   // Add a handler - will be deleted on destruction of server
   void add(URLHandler *h)
-  { MT::RWWriteLock lock(mutex); handlers.push_back(h); }
+  { MT::RWWriteLock lock(mutex); handlers.push_back(h); router.add(h); }
 
   //------------------------------------------------------------------------
   // Remove a handler
   void remove(URLHandler *h)
-  { MT::RWWriteLock lock(mutex); handlers.remove(h); }
+  { MT::RWWriteLock lock(mutex); handlers.remove(h); router.remove(h); }
 
   //------------------------------------------------------------------------
   // Destructor
   ~SimpleHTTPServer();
 };
 
+#if defined(PLATFORM_LINUX)
+//==========================================================================
+// Asynchronous HTTP server abstract class (async-http-server.cc)
+// Event-driven alternative to HTTPServer built on Net::EventTCPServer:
+// requests are parsed incrementally with HTTPParser as data arrives on
+// each connection, so persistent connections hold no thread while idle
+// and pipelined requests are answered in order.  The number of threads is
+// fixed (one reactor per core by default) whatever the connection count.
+// Handlers are called in the reactor thread and should not block for long.
+// Plain TCP only - no SSL, WebSocket or progressive responses
+class AsyncHTTPServer: public Net::EventTCPServer, public HTTPServerBase
+{
+  // Per-connection state
+  struct Connection: public Net::EventConnection
+  {
+    HTTPParser parser;
+    SSL::ClientDetails client_details;
+    bool persistent{false};
+
+    Connection(Net::TCPSocket *s, Net::EndPoint client):
+      Net::EventConnection(s, client), client_details(client) {}
+  };
+
+protected:
+  //------------------------------------------------------------------------
+  // Abstract interface to handle requests
+  // Return whether handled - fill in response for normal errors, only
+  // return false if things are really bad, and we'll return 500
+  // response is pre-initialised with 200 OK, no body
+  virtual bool handle_request(const HTTPMessage& request,
+                              HTTPMessage& response,
+                              const SSL::ClientDetails& client) = 0;
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor to bind to any interface
+  // threads is the number of reactors - 0 means one per core
+  AsyncHTTPServer(int port=80, const string& _version="", int backlog=128,
+                  int threads=0):
+    Net::EventTCPServer(port, backlog, threads), HTTPServerBase(_version) {}
+
+  //------------------------------------------------------------------------
+  // Constructor to bind to specific address
+  AsyncHTTPServer(Net::EndPoint address, const string& _version="",
+                  int backlog=128, int threads=0):
+    Net::EventTCPServer(address, backlog, threads),
+    HTTPServerBase(_version) {}
+
+  //------------------------------------------------------------------------
+  // Connection state factory - see Net::EventTCPServer
+  Net::EventConnection *create_connection(Net::TCPSocket *s,
+                                          Net::EndPoint client) override
+  { return new Connection(s, client); }
+
+  //------------------------------------------------------------------------
+  // Readable connection handler - see Net::EventTCPServer
+  bool handle(Net::EventConnection& conn) override;
+};
+#endif
+
 //==========================================================================
 // HTTP cache
 // Maintains a directory with a subdirectory for each domain, then MD5-ed
@@ -0,0 +1,194 @@
+//==========================================================================
+// ObTools::Web: test-async-http-server.cc
+//
+// Test harness for event-driven HTTP server, including a keepalive
+// throughput comparison with the threaded HTTPServer
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "ot-web.h"
+#include <gtest/gtest.h>
+
+namespace {
+
+using namespace std;
+using namespace ObTools;
+using Result = Web::HTTPParser::Result;
+
+//--------------------------------------------------------------------------
+// Async server which returns the URL path
+class TestAsyncServer: public Web::AsyncHTTPServer
+{
+protected:
+  bool handle_request(const Web::HTTPMessage& request,
+                      Web::HTTPMessage& response,
+                      const SSL::ClientDetails&) override
+  {
+    if (request.url.get_path() == "/fail")
+      throw Web::URLHandler::Exception(418, "I'm a teapot");
+    response.body = request.url.get_path() + request.body;
+    return true;
+  }
+
+public:
+  TestAsyncServer(): Web::AsyncHTTPServer(0, "Test", 128, 2) {}
+  ~TestAsyncServer() { shutdown(); }
+};
+
+//--------------------------------------------------------------------------
+// Threaded server which does the same
+class TestThreadedServer: public Web::HTTPServer
+{
+protected:
+  bool handle_request(const Web::HTTPMessage& request,
+                      Web::HTTPMessage& response,
+                      const SSL::ClientDetails&,
+                      SSL::TCPSocket&, Net::TCPStream&) override
+  {
+    response.body = request.url.get_path() + request.body;
+    return true;
+  }
+
+public:
+  TestThreadedServer(): Web::HTTPServer(0, "Test") {}
+};
+
+//--------------------------------------------------------------------------
+// Simple keepalive client - sends requests and parses responses
+class KeepaliveClient
+{
+  Net::TCPClient socket;
+  Web::HTTPParser parser;
+
+public:
+  KeepaliveClient(int port):
+    socket(Net::EndPoint(Net::IPAddress("127.0.0.1"), port), 5) {}
+
+  bool operator!() const { return !socket; }
+
+  void send(const string& text) { socket.write(text); }
+
+  bool receive(Web::HTTPMessage& response)
+  {
+    for(;;)
+    {
+      auto result = parser.parse(response);
+      if (result == Result::complete) return true;
+      if (result == Result::error) return false;
+      string data;
+      if (!socket.read(data)) return false;
+      parser.feed(data);
+    }
+  }
+};
+
+TEST(AsyncHTTPServerTest, TestPersistentAndPipelinedRequests)
+{
+  TestAsyncServer server;
+  ASSERT_FALSE(!server);
+  Net::EventTCPServerThread server_thread(server);
+
+  KeepaliveClient client(server.local().port);
+  ASSERT_FALSE(!client);
+
+  // Two pipelined in one write, then another on same connection
+  client.send("GET /one HTTP/1.1\r\n\r\n"
+              "POST /two HTTP/1.1\r\nContent-Length: 3\r\n\r\nabc");
+  Web::HTTPMessage response;
+  ASSERT_TRUE(client.receive(response));
+  EXPECT_EQ(200, response.code);
+  EXPECT_EQ("/one", response.body);
+  EXPECT_EQ("Test", response.headers.get("server"));
+  ASSERT_TRUE(client.receive(response));
+  EXPECT_EQ("/twoabc", response.body);
+
+  client.send("GET /fail HTTP/1.1\r\n\r\n");
+  ASSERT_TRUE(client.receive(response));
+  EXPECT_EQ(418, response.code);
+
+  // Close ends it
+  client.send("GET /last HTTP/1.1\r\nConnection: close\r\n\r\n");
+  ASSERT_TRUE(client.receive(response));
+  EXPECT_EQ("/last", response.body);
+  EXPECT_FALSE(client.receive(response));
+  server.shutdown();
+}
+
+TEST(AsyncHTTPServerTest, TestBadRequestGets400)
+{
+  TestAsyncServer server;
+  Net::EventTCPServerThread server_thread(server);
+
+  KeepaliveClient client(server.local().port);
+  client.send("RUBBISH\r\n\r\n");
+  Web::HTTPMessage response;
+  ASSERT_TRUE(client.receive(response));
+  EXPECT_EQ(400, response.code);
+  server.shutdown();
+}
+
+//--------------------------------------------------------------------------
+// Run a keepalive load against a server, return requests/sec
+double run_keepalive_load(int port, int clients, int requests)
+{
+  auto start = chrono::steady_clock::now();
+  vector<thread> threads;
+  atomic<int> ok{0};
+  for (auto i=0; i<clients; i++)
+  {
+    threads.emplace_back([port, requests, &ok]()
+    {
+      KeepaliveClient client(port);
+      if (!client) return;
+      Web::HTTPMessage response;
+      for (auto j=0; j<requests; j++)
+      {
+        client.send("GET /bench HTTP/1.1\r\nHost: localhost\r\n\r\n");
+        if (!client.receive(response) || response.body != "/bench") return;
+        ok++;
+      }
+    });
+  }
+  for (auto& t: threads) t.join();
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  EXPECT_EQ(clients * requests, ok);
+  return ok / elapsed.count();
+}
+
+TEST(AsyncHTTPServerTest, BenchmarkKeepaliveAgainstThreadedServer)
+{
+  if (!getenv("OBTOOLS_BENCHMARK"))
+    GTEST_SKIP() << "OBTOOLS_BENCHMARK not set";
+
+  const auto clients = 8;
+  const auto requests = 500;
+
+  double threaded_rate, async_rate;
+  {
+    TestThreadedServer server;
+    Net::TCPServerThread server_thread(server);
+    threaded_rate = run_keepalive_load(server.local().port,
+                                       clients, requests);
+    server.shutdown();
+  }
+  {
+    TestAsyncServer server;
+    Net::EventTCPServerThread server_thread(server);
+    async_rate = run_keepalive_load(server.local().port, clients, requests);
+    server.shutdown();
+  }
+
+  cout << "Keepalive requests/sec: threaded "
+       << static_cast<int>(threaded_rate) << ", async " << static_cast<int>(async_rate)
+       << " (x" << async_rate / threaded_rate << ")\n";
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
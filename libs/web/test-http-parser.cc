@@ -0,0 +1,158 @@
+//==========================================================================
+// ObTools::Web: test-http-parser.cc
+//
+// Test harness for incremental HTTP parser
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "ot-web.h"
+#include <gtest/gtest.h>
+
+namespace {
+
+using namespace std;
+using namespace ObTools;
+using Result = Web::HTTPParser::Result;
+
+TEST(HTTPParserTest, TestSimpleRequest)
+{
+  Web::HTTPParser parser;
+  parser.feed("GET /foo?x=1 HTTP/1.1\r\nHost: example.com\r\n"
+              "X-Thing:   lots   of space  \r\n\r\n");
+  Web::HTTPMessage msg;
+  ASSERT_EQ(Result::complete, parser.parse(msg));
+  EXPECT_EQ("GET", msg.method);
+  EXPECT_EQ("/foo?x=1", msg.url.get_text());
+  EXPECT_EQ("HTTP/1.1", msg.version);
+  EXPECT_EQ("example.com", msg.headers.get("host"));
+  EXPECT_EQ("lots of space", msg.headers.get("x-thing"));
+  EXPECT_EQ("", msg.body);
+  EXPECT_EQ(0u, parser.buffered());
+  EXPECT_EQ(Result::incomplete, parser.parse(msg));
+}
+
+TEST(HTTPParserTest, TestResponse)
+{
+  Web::HTTPParser parser;
+  parser.feed("HTTP/1.0 404 Not Found\r\nContent-Length: 3\r\n\r\nnah");
+  Web::HTTPMessage msg;
+  ASSERT_EQ(Result::complete, parser.parse(msg));
+  EXPECT_TRUE(msg.method.empty());
+  EXPECT_EQ(404, msg.code);
+  EXPECT_EQ("Not Found", msg.reason);
+  EXPECT_EQ("nah", msg.body);
+}
+
+TEST(HTTPParserTest, TestByteAtATimeWithBody)
+{
+  const string text = "POST /x HTTP/1.1\r\nContent-Length: 11\r\n\r\n"
+                      "hello world";
+  Web::HTTPParser parser;
+  Web::HTTPMessage msg;
+  for (auto i=0u; i<text.size()-1; i++)
+  {
+    parser.feed(&text[i], 1);
+    ASSERT_EQ(Result::incomplete, parser.parse(msg)) << "at " << i;
+  }
+  parser.feed(&text[text.size()-1], 1);
+  ASSERT_EQ(Result::complete, parser.parse(msg));
+  EXPECT_EQ("POST", msg.method);
+  EXPECT_EQ("hello world", msg.body);
+}
+
+TEST(HTTPParserTest, TestPipelinedRequests)
+{
+  Web::HTTPParser parser;
+  parser.feed("GET /1 HTTP/1.1\r\n\r\n"
+              "POST /2 HTTP/1.1\r\nContent-Length: 2\r\n\r\nhi"
+              "GET /3 HTTP/1.1\r\n");
+  Web::HTTPMessage msg;
+  ASSERT_EQ(Result::complete, parser.parse(msg));
+  EXPECT_EQ("/1", msg.url.get_text());
+  ASSERT_EQ(Result::complete, parser.parse(msg));
+  EXPECT_EQ("/2", msg.url.get_text());
+  EXPECT_EQ("hi", msg.body);
+  ASSERT_EQ(Result::incomplete, parser.parse(msg));
+  parser.feed("\r\n");
+  ASSERT_EQ(Result::complete, parser.parse(msg));
+  EXPECT_EQ("/3", msg.url.get_text());
+}
+
+TEST(HTTPParserTest, TestChunkedBodyWithTrailers)
+{
+  const string text = "POST /c HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+                      "5;ext=1\r\nhello\r\n6\r\n world\r\n0\r\n"
+                      "X-Trailer: yes\r\n\r\n";
+  // Try every split point
+  for (auto split=1u; split<text.size(); split++)
+  {
+    Web::HTTPParser parser;
+    Web::HTTPMessage msg;
+    parser.feed(text.substr(0, split));
+    ASSERT_EQ(Result::incomplete, parser.parse(msg)) << "at " << split;
+    parser.feed(text.substr(split));
+    ASSERT_EQ(Result::complete, parser.parse(msg)) << "at " << split;
+    EXPECT_EQ("hello world", msg.body);
+    EXPECT_EQ("yes", msg.headers.get("x-trailer"));
+  }
+}
+
+TEST(HTTPParserTest, TestFoldedHeadersAndLFOnly)
+{
+  Web::HTTPParser parser;
+  parser.feed("\r\nGET / HTTP/1.0\nX-Long: one,\n  two\nHost: h\n\n");
+  Web::HTTPMessage msg;
+  ASSERT_EQ(Result::complete, parser.parse(msg));
+  EXPECT_EQ("one, two", msg.headers.get("x-long"));
+  EXPECT_EQ("h", msg.headers.get("host"));
+}
+
+TEST(HTTPParserTest, TestBadRequestsAreErrors)
+{
+  Web::HTTPMessage msg;
+  {
+    Web::HTTPParser parser;
+    parser.feed("NONSENSE\r\n\r\n");
+    EXPECT_EQ(Result::error, parser.parse(msg));
+  }
+  {
+    Web::HTTPParser parser(10);
+    parser.feed("POST / HTTP/1.1\r\nContent-Length: 11\r\n\r\n");
+    EXPECT_EQ(Result::error, parser.parse(msg));
+  }
+  {
+    Web::HTTPParser parser;
+    parser.feed("GET / HTTP/1.1\r\nX: " + string(70000, 'x'));
+    EXPECT_EQ(Result::error, parser.parse(msg));
+  }
+}
+
+TEST(HTTPParserTest, TestBadChunkSizesAreErrors)
+{
+  const string start = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+                       "2\r\nhi\r\n";
+  for (const auto size: {"ffffffffffffffff", "10000000000000000", "zz",
+                         "5x", "-1"})
+  {
+    Web::HTTPParser parser(100);
+    Web::HTTPMessage msg;
+    parser.feed(start + size + "\r\n");
+    EXPECT_EQ(Result::error, parser.parse(msg)) << size;
+  }
+
+  // Total over the limit
+  Web::HTTPParser parser(10);
+  Web::HTTPMessage msg;
+  parser.feed(start + "9\r\n");
+  EXPECT_EQ(Result::error, parser.parse(msg));
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,199 @@
+//==========================================================================
+// ObTools::Web: test-mime-headers.cc
+//
+// Test harness for MIME headers, including a parse and lookup benchmark
+// against the equivalent XML element representation
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "ot-web.h"
+#include "ot-text.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+namespace {
+
+using namespace std;
+using namespace ObTools;
+
+const string request_headers =
+  "Host: www.example.com\r\n"
+  "User-Agent: Mozilla/5.0 (X11; Linux x86_64) Gecko/20100101\r\n"
+  "Accept: text/html,application/xhtml+xml\r\n"
+  "Accept-Language: en-GB,en;q=0.5\r\n"
+  "Accept-Encoding: gzip, deflate, br\r\n"
+  "Connection: keep-alive\r\n"
+  "Cookie: session=abcdef0123456789; theme=dark\r\n"
+  "X-Request-Id: 0f8e2c4a\r\n"
+  "\r\n";
+
+TEST(MIMEHeadersTest, TestReadAndCaseInsensitiveLookup)
+{
+  istringstream in(request_headers);
+  Web::MIMEHeaders headers;
+  ASSERT_TRUE(headers.read(in));
+  EXPECT_EQ(8u, headers.size());
+  EXPECT_EQ("www.example.com", headers.get("host"));
+  EXPECT_EQ("www.example.com", headers.get("HOST"));
+  EXPECT_EQ("0f8e2c4a", headers.get("x-request-id"));
+  EXPECT_EQ("0f8e2c4a", headers.get("X-Request-ID"));
+  EXPECT_TRUE(headers.has("Connection"));
+  EXPECT_FALSE(headers.has("content-length"));
+  EXPECT_EQ("", headers.get("content-length"));
+
+  // Names are stored lower-case
+  EXPECT_EQ("host", headers[0].name);
+  EXPECT_EQ("user-agent", headers[1].name);
+}
+
+TEST(MIMEHeadersTest, TestReadFoldedAndSpacedValues)
+{
+  istringstream in("X-Long:  one,\r\n   two \r\n\tthree\r\n"
+                   "Empty:   \r\nNoColon\r\n\r\n");
+  Web::MIMEHeaders headers;
+  ASSERT_TRUE(headers.read(in));
+  EXPECT_EQ(1u, headers.size());
+  EXPECT_EQ("one, two three", headers.get("x-long"));
+}
+
+TEST(MIMEHeadersTest, TestPutRemoveReplace)
+{
+  Web::MIMEHeaders headers;
+  headers.put("Via", "a");
+  headers.put("Content-Type", "text/plain");
+  headers.put("via", "b");
+  headers.put("X-Other", "c");
+  EXPECT_EQ((list<string>{"a", "b"}), headers.get_all("VIA"));
+
+  headers.remove("via");
+  EXPECT_EQ(2u, headers.size());
+  EXPECT_FALSE(headers.has("via"));
+  EXPECT_EQ("text/plain", headers.get("content-type"));
+  EXPECT_EQ("c", headers.get("x-other"));
+
+  headers.replace("content-type", "text/html");
+  EXPECT_EQ(2u, headers.size());
+  EXPECT_EQ("text/html", headers.get("Content-Type"));
+
+  // Lots of churn doesn't grow without bound
+  for (auto i=0; i<1000; i++) headers.replace("x-other", to_string(i));
+  EXPECT_EQ("999", headers.get("x-other"));
+  EXPECT_EQ(2u, headers.size());
+
+  headers.clear();
+  EXPECT_EQ(0u, headers.size());
+  EXPECT_FALSE(headers.has("content-type"));
+}
+
+TEST(MIMEHeadersTest, TestLongNamesNotTruncated)
+{
+  Web::MIMEHeaders headers;
+  const auto name = "x-" + string(70000, 'n');
+  headers.put(name, "long");
+  headers.put("x-" + string(70000-65536, 'n'), "short");
+  EXPECT_EQ("long", headers.get(name));
+  EXPECT_EQ(name.size(), headers[0].name.size());
+}
+
+TEST(MIMEHeadersTest, TestGetAllSplitting)
+{
+  Web::MIMEHeaders headers;
+  headers.put("accept", "text/html, text/plain");
+  headers.put("accept", "image/png");
+  EXPECT_EQ((list<string>{"text/html", "text/plain", "image/png"}),
+            headers.get_all_splitting("accept"));
+}
+
+TEST(MIMEHeadersTest, TestWriteCapitalisesAndFolds)
+{
+  Web::MIMEHeaders headers;
+  headers.put("content-type", "text/plain");
+  headers.put("x-long", "aaaaaaaaaa, bbbbbbbbbb, cccccccccc");
+  headers.enable_folding(20);
+  ostringstream out;
+  ASSERT_TRUE(headers.write(out));
+  EXPECT_EQ("Content-Type: text/plain\r\n"
+            "X-Long: aaaaaaaaaa,\r\n bbbbbbbbbb,\r\n cccccccccc\r\n\r\n",
+            out.str());
+}
+
+TEST(MIMEHeadersTest, TestXMLViewAndCopy)
+{
+  Web::MIMEHeaders headers;
+  headers.put("host", "example.com");
+  const auto& xml = headers.get_xml();
+  EXPECT_EQ("headers", xml.name);
+  EXPECT_EQ("example.com", xml.get_child("host").content);
+
+  // Copy is independent
+  auto copy = headers;
+  copy.put("origin", "foo");
+  EXPECT_FALSE(headers.has("origin"));
+  EXPECT_EQ("foo", copy.get_xml().get_child("origin").content);
+  EXPECT_FALSE(headers.get_xml().get_child("origin").valid());
+}
+
+//--------------------------------------------------------------------------
+// Old-style XML element parse, for comparison
+void parse_into_xml(const string& text, XML::Element& xml)
+{
+  istringstream in(text);
+  for(;;)
+  {
+    string line;
+    if (!Web::MIMEHeaders::getline(in, line) || line.empty()) break;
+    auto colon = line.find(':');
+    if (colon == string::npos) continue;
+    auto name = Text::tolower(line.substr(0, colon));
+    auto value = Text::canonicalise_space(line.substr(colon+1));
+    if (!name.empty() && !value.empty()) xml.add(name, value);
+  }
+}
+
+TEST(MIMEHeadersTest, BenchmarkParseAndLookupAgainstXML)
+{
+  if (!getenv("OBTOOLS_BENCHMARK"))
+    GTEST_SKIP() << "OBTOOLS_BENCHMARK not set";
+
+  const auto iterations = 50000;
+  const char *lookups[] = { "host", "user-agent", "cookie", "x-request-id",
+                            "content-length" };
+
+  auto start = chrono::steady_clock::now();
+  size_t total = 0;
+  for (auto i=0; i<iterations; i++)
+  {
+    XML::Element xml("headers");
+    parse_into_xml(request_headers, xml);
+    for (auto name: lookups) total += xml.get_child(name).content.size();
+  }
+  chrono::duration<double> xml_time = chrono::steady_clock::now() - start;
+
+  start = chrono::steady_clock::now();
+  size_t flat_total = 0;
+  for (auto i=0; i<iterations; i++)
+  {
+    istringstream in(request_headers);
+    Web::MIMEHeaders headers;
+    headers.read(in);
+    for (auto name: lookups) flat_total += headers.get_view(name).size();
+  }
+  chrono::duration<double> flat_time = chrono::steady_clock::now() - start;
+
+  EXPECT_EQ(total, flat_total);
+  cout << "Parse+lookup per block: XML "
+       << static_cast<int>(xml_time.count() * 1e9 / iterations)
+       << "ns, flat "
+       << static_cast<int>(flat_time.count() * 1e9 / iterations)
+       << "ns (x" << xml_time.count() / flat_time.count() << ")\n";
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,271 @@
+//==========================================================================
+// ObTools::Web: test-url-router.cc
+//
+// Test harness for URL router, including a lookup benchmark against a
+// linear scan of glob patterns
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "ot-web.h"
+#include "ot-text.h"
+#include <gtest/gtest.h>
+
+namespace {
+
+using namespace std;
+using namespace ObTools;
+
+class TestHandler: public Web::URLHandler
+{
+public:
+  TestHandler(const string& _url): URLHandler(_url) {}
+  TestHandler(const string& _method, const string& _url):
+    URLHandler(_method, _url) {}
+
+  bool handle_request(const Web::HTTPMessage&, Web::HTTPMessage&,
+                      const SSL::ClientDetails&) override
+  { return true; }
+};
+
+// Router plus handlers it refers to
+class RouterTest: public ::testing::Test
+{
+protected:
+  list<TestHandler> handlers;
+  Web::URLRouter router;
+
+  TestHandler *add(const string& url)
+  {
+    handlers.emplace_back(url);
+    router.add(&handlers.back());
+    return &handlers.back();
+  }
+
+  TestHandler *add(const string& method, const string& url)
+  {
+    handlers.emplace_back(method, url);
+    router.add(&handlers.back());
+    return &handlers.back();
+  }
+
+  Web::URLHandler *find(const string& url, const string& method = "GET")
+  {
+    return router.find(method, url).handler;
+  }
+};
+
+TEST_F(RouterTest, TestLiteralMatchesWholeURL)
+{
+  auto h = add("/api/status");
+  EXPECT_EQ(h, find("/api/status"));
+  EXPECT_EQ(nullptr, find("/api/status/"));
+  EXPECT_EQ(nullptr, find("/api/status?full=1"));
+  EXPECT_EQ(nullptr, find("/api"));
+}
+
+TEST_F(RouterTest, TestStarsMatchAsGlobs)
+{
+  auto test = add("/test*");
+  auto files = add("/files/*/raw");
+  auto all = add("*");
+  EXPECT_EQ(test, find("/test"));
+  EXPECT_EQ(test, find("/testing/more?x=1"));
+  EXPECT_EQ(files, find("/files/a/raw"));
+  EXPECT_EQ(files, find("/files/a/b/c/raw"));
+  EXPECT_EQ(all, find("/files/raw"));
+  EXPECT_EQ(all, find(""));
+
+  // Same as the glob would have done
+  for (auto url: {"/test", "/testing/more?x=1", "/files/a/raw",
+                  "/files/a/b/c/raw", "/files/raw", "/files//raw"})
+    EXPECT_EQ(Text::pattern_match("/files/*/raw", url),
+              find(url) == files) << url;
+}
+
+TEST_F(RouterTest, TestParamsAreCaptured)
+{
+  auto user = add("/users/{id}");
+  auto post = add("/users/{user}/posts/{post}");
+  auto match = router.find("GET", "/users/42");
+  EXPECT_EQ(user, match.handler);
+  EXPECT_EQ("42", match.params.get("id"));
+
+  match = router.find("GET", "/users/fred/posts/7");
+  EXPECT_EQ(post, match.handler);
+  EXPECT_EQ("fred", match.params.get("user"));
+  EXPECT_EQ("7", match.params.get("post"));
+
+  EXPECT_EQ(nullptr, find("/users/"));
+  EXPECT_EQ(nullptr, find("/users/42/posts"));
+}
+
+TEST_F(RouterTest, TestFirstRegisteredWins)
+{
+  auto any = add("/a/*");
+  add("/a/b");
+  add("/a/{x}");
+  EXPECT_EQ(any, find("/a/b"));
+  EXPECT_EQ(any, find("/a/c"));
+
+  // Remove keeps the order of the rest
+  router.remove(any);
+  EXPECT_EQ(&*next(handlers.begin()), find("/a/b"));
+  EXPECT_EQ(&handlers.back(), find("/a/c"));
+  EXPECT_EQ(nullptr, find("/a/b/c"));
+}
+
+TEST_F(RouterTest, TestPerMethodDispatch)
+{
+  auto get = add("GET", "/items/{id}");
+  auto del = add("DELETE", "/items/{id}");
+  auto any = add("/items/special");
+  EXPECT_EQ(get, find("/items/1"));
+  EXPECT_EQ(get, find("/items/1", "HEAD"));
+  EXPECT_EQ(del, find("/items/1", "DELETE"));
+  EXPECT_EQ(any, find("/items/special", "PUT"));
+
+  auto match = router.find("PUT", "/items/1");
+  EXPECT_EQ(nullptr, match.handler);
+  EXPECT_TRUE(match.wrong_method);
+  EXPECT_FALSE(router.find("PUT", "/other").wrong_method);
+}
+
+TEST_F(RouterTest, TestOtherGlobsFallBack)
+{
+  auto single = add("/v?/info");
+  auto set = add("/[ab]x*");
+  auto mid = add("/img*.png");
+  EXPECT_EQ(single, find("/v1/info"));
+  EXPECT_EQ(set, find("/bx/y"));
+  EXPECT_EQ(mid, find("/img/logo.png"));
+  EXPECT_EQ(nullptr, find("/cx"));
+}
+
+//--------------------------------------------------------------------------
+// Handler which returns a path parameter
+class ParamHandler: public Web::URLHandler
+{
+public:
+  ParamHandler(): URLHandler("GET", "/hello/{name}") {}
+
+  bool handle_request(const Web::HTTPMessage&, Web::HTTPMessage&,
+                      const SSL::ClientDetails&) override
+  { return false; }
+
+  bool handle_request_with_params(const Web::HTTPMessage&,
+                                  Web::HTTPMessage& response,
+                                  const SSL::ClientDetails&,
+                                  const Misc::PropertyList& params) override
+  {
+    response.body = "Hello " + params.get("name");
+    return true;
+  }
+};
+
+TEST(SimpleHTTPServerTest, TestRoutedRequests)
+{
+  Web::SimpleHTTPServer server(0, "Test");
+  server.add(new ParamHandler);
+  Net::TCPServerThread server_thread(server);
+
+  auto request = [&server](const string& text)
+  {
+    Net::TCPClient client(Net::EndPoint(Net::IPAddress("127.0.0.1"),
+                                        server.local().port), 5);
+    client.write(text);
+    Web::HTTPParser parser;
+    Web::HTTPMessage response;
+    string data;
+    while (parser.parse(response) == Web::HTTPParser::Result::incomplete
+           && client.read(data))
+      parser.feed(data);
+    return response;
+  };
+
+  auto response = request("GET /hello/world HTTP/1.0\r\n\r\n");
+  EXPECT_EQ(200, response.code);
+  EXPECT_EQ("Hello world", response.body);
+  EXPECT_EQ(405, request("PUT /hello/world HTTP/1.0\r\n\r\n").code);
+  EXPECT_EQ(404, request("GET /bye HTTP/1.0\r\n\r\n").code);
+  server.shutdown();
+}
+
+TEST_F(RouterTest, BenchmarkAgainstLinearGlobScan)
+{
+  if (!getenv("OBTOOLS_BENCHMARK"))
+    GTEST_SKIP() << "OBTOOLS_BENCHMARK not set";
+
+  // ~200 REST-like endpoints, with a default at the end
+  const vector<string> resources = { "users", "groups", "orders", "items",
+                                     "invoices", "accounts", "reports",
+                                     "sessions", "tokens", "devices" };
+  for (const auto& r: resources)
+  {
+    for (auto i=0; i<5; i++)
+    {
+      auto base = "/api/v" + to_string(i) + "/" + r;
+      add(base);
+      add(base + "/search*");
+      add(base + "/{id}/history");
+      add(base + "/{id}");
+    }
+  }
+  add("*");
+  ASSERT_EQ(201u, handlers.size());
+
+  vector<string> urls;
+  for (const auto& r: resources)
+  {
+    urls.push_back("/api/v4/" + r);
+    urls.push_back("/api/v3/" + r + "/1234/history");
+    urls.push_back("/api/v2/" + r + "/search?q=x");
+    urls.push_back("/static/" + r + ".css");
+  }
+
+  // Results must be the same, with {id} as a glob '*'
+  auto glob_find = [this](const string& url) -> Web::URLHandler *
+  {
+    for (auto& h: handlers)
+    {
+      auto pattern = Text::subst(h.url, "{id}", "*");
+      if (Text::pattern_match(pattern, url)) return &h;
+    }
+    return nullptr;
+  };
+  for (const auto& url: urls)
+    ASSERT_EQ(glob_find(url), find(url)) << url;
+
+  const auto iterations = 2000;
+  auto start = chrono::steady_clock::now();
+  size_t found = 0;
+  for (auto i=0; i<iterations; i++)
+    for (const auto& url: urls)
+      for (auto& h: handlers)
+        if (Text::pattern_match(h.url, url)) { found++; break; }
+  chrono::duration<double> glob_time = chrono::steady_clock::now() - start;
+
+  start = chrono::steady_clock::now();
+  size_t routed = 0;
+  for (auto i=0; i<iterations; i++)
+    for (const auto& url: urls)
+      if (router.find("GET", url).handler) routed++;
+  chrono::duration<double> router_time = chrono::steady_clock::now() - start;
+
+  EXPECT_EQ(found, routed);
+  const auto lookups = iterations * urls.size();
+  cout << "Lookup: glob scan "
+       << static_cast<int>(glob_time.count() * 1e9 / lookups)
+       << "ns, router "
+       << static_cast<int>(router_time.count() * 1e9 / lookups)
+       << "ns (x" << glob_time.count() / router_time.count() << ")\n";
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
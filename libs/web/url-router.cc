@@ -0,0 +1,235 @@
+//==========================================================================
+// ObTools::Web: url-router.cc
+//
+// Segment trie router for URL handlers
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "ot-web.h"
+#include "ot-text.h"
+
+namespace ObTools { namespace Web {
+
+namespace
+{
+  // Split a path at '/' - note leading '/' gives an empty first segment
+  vector<string_view> split_segments(string_view path)
+  {
+    vector<string_view> segments;
+    for(;;)
+    {
+      auto slash = path.find('/');
+      segments.push_back(path.substr(0, slash));
+      if (slash == string_view::npos) break;
+      path.remove_prefix(slash+1);
+    }
+    return segments;
+  }
+
+  // Is a segment a {name} parameter?
+  bool is_param(string_view segment)
+  {
+    return segment.size() > 2 && segment.front() == '{'
+      && segment.back() == '}';
+  }
+}
+
+//--------------------------------------------------------------------------
+// Insert a route into the hash, trie or glob list
+void URLRouter::insert(Route& route)
+{
+  const auto& url = route.handler->url;
+  route.param_names.clear();
+
+  // Other glob features, or no wildcards at all?
+  if (url.find_first_of("?[\\") != string::npos)
+  {
+    globs.push_back(&route);
+    return;
+  }
+  if (url.find_first_of("*{") == string::npos)
+  {
+    exact[url].push_back(&route);
+    return;
+  }
+
+  // Check every segment can be expressed in the trie
+  auto segments = split_segments(url);
+  for(auto i=0u; i<segments.size(); i++)
+  {
+    auto star = segments[i].find('*');
+    if (star == string_view::npos || segments[i] == "*") continue;
+    if (i+1 < segments.size() || star+1 != segments[i].size())
+    {
+      // '*' in the middle of a segment
+      globs.push_back(&route);
+      return;
+    }
+  }
+
+  auto node = &root;
+  node->min_order = min(node->min_order, route.order);
+  for(auto i=0u; i<segments.size(); i++)
+  {
+    auto segment = segments[i];
+    auto last = (i+1 == segments.size());
+
+    if (last && !segment.empty() && segment.back() == '*')
+    {
+      segment.remove_suffix(1);
+      node->tails.emplace_back(string(segment), &route);
+      return;
+    }
+
+    unique_ptr<Node> *next;
+    if (segment == "*")
+    {
+      next = &node->star;
+    }
+    else if (is_param(segment))
+    {
+      route.param_names.emplace_back(segment.substr(1, segment.size()-2));
+      next = &node->param;
+    }
+    else
+    {
+      auto p = node->literals.find(segment);
+      if (p == node->literals.end())
+        p = node->literals.emplace(string(segment), nullptr).first;
+      next = &p->second;
+    }
+
+    if (!*next) next->reset(new Node);
+    node = next->get();
+    node->min_order = min(node->min_order, route.order);
+  }
+
+  node->routes.push_back(&route);
+}
+
+//--------------------------------------------------------------------------
+// Add a handler
+void URLRouter::add(URLHandler *h)
+{
+  all_routes.push_back(Route{h, next_order++, {}});
+  insert(all_routes.back());
+}
+
+//--------------------------------------------------------------------------
+// Remove a handler - rebuilds everything, preserving order
+void URLRouter::remove(URLHandler *h)
+{
+  all_routes.remove_if([h](const Route& r) { return r.handler == h; });
+  exact.clear();
+  root = Node();
+  globs.clear();
+  for(auto& route: all_routes)
+    insert(route);
+}
+
+//--------------------------------------------------------------------------
+// Check whether a route handles the given method
+bool URLRouter::method_matches(const Route& route, const string& method)
+{
+  const auto& m = route.handler->method;
+  return m.empty() || m == method || (m == "GET" && method == "HEAD");
+}
+
+//--------------------------------------------------------------------------
+// Offer a route whose pattern matches as a possible best match
+void URLRouter::offer(const Route& route, const string& method,
+                      const vector<string_view>& captures, Best& best)
+{
+  if (route.order >= best.order) return;
+  if (!method_matches(route, method))
+  {
+    best.wrong_method = true;
+    return;
+  }
+
+  best.route = &route;
+  best.order = route.order;
+  best.captures = captures;
+}
+
+//--------------------------------------------------------------------------
+// Search a trie node for matches of segments from index onwards
+void URLRouter::search(const Node& node, const vector<string_view>& segments,
+                       size_t index, bool has_query, const string& method,
+                       vector<string_view>& captures, Best& best) const
+{
+  // Nothing in here could beat what we have
+  if (node.min_order >= best.order) return;
+
+  if (index == segments.size())
+  {
+    // Patterns without a trailing '*' can't match a query
+    if (!has_query)
+      for(const auto r: node.routes)
+        offer(*r, method, captures, best);
+    return;
+  }
+
+  const auto segment = segments[index];
+  for(const auto& t: node.tails)
+    if (segment.substr(0, t.first.size()) == t.first)
+      offer(*t.second, method, captures, best);
+
+  const auto p = node.literals.find(segment);
+  if (p != node.literals.end())
+    search(*p->second, segments, index+1, has_query, method, captures, best);
+
+  if (node.param && !segment.empty())
+  {
+    captures.push_back(segment);
+    search(*node.param, segments, index+1, has_query, method, captures,
+           best);
+    captures.pop_back();
+  }
+
+  if (node.star)
+    for(auto i=index+1; i<=segments.size(); i++)
+      search(*node.star, segments, i, has_query, method, captures, best);
+}
+
+//--------------------------------------------------------------------------
+// Find the first added handler matching the method and URL
+URLRouter::Match URLRouter::find(const string& method,
+                                 const string& url) const
+{
+  Best best;
+  vector<string_view> captures;
+
+  const auto p = exact.find(url);
+  if (p != exact.end())
+    for(const auto r: p->second)
+      offer(*r, method, captures, best);
+
+  const auto query = url.find('?');
+  const auto segments =
+    split_segments(string_view(url).substr(0, query));
+  search(root, segments, 0, query != string::npos, method, captures, best);
+
+  for(const auto r: globs)
+  {
+    if (r->order >= best.order) break;
+    if (Text::pattern_match(r->handler->url, url))
+      offer(*r, method, captures, best);
+  }
+
+  Match match;
+  if (best.route)
+  {
+    match.handler = best.route->handler;
+    for(auto i=0u; i<best.captures.size(); i++)
+      match.params.add(best.route->param_names[i],
+                       string(best.captures[i]));
+  }
+  else match.wrong_method = best.wrong_method;
+
+  return match;
+}
+
+}} // namespaces
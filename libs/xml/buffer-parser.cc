@@ -0,0 +1,636 @@
+//==========================================================================
+// ObTools::XML: buffer-parser.cc
+//
+// Fast path for the XML parser on a contiguous buffer
+//
+// Mirrors the stream parser in parser.cc step for step, so errors, line
+// numbers and the resulting tree are the same, but scans runs of name,
+// content and attribute characters in one go and builds strings straight
+// from the buffer, only decoding references where there is a '&'.
+// Content for the innermost open element is held back until we know
+// whether it will be optimised into the element itself, saving the
+// sub-element
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "ot-xml.h"
+#include <sstream>
+#include <cstring>
+#include <climits>
+#include <memory>
+using namespace ObTools::XML;
+
+namespace
+{
+  // Character classes by byte, as Parser's is_ascii_space, is_name_start
+  // and is_name_char
+  enum
+  {
+    CHAR_SPACE         = 1,
+    CHAR_NAME_START    = 2,
+    CHAR_NAME          = 4,
+    CHAR_CONTENT_STOP  = 8   // '<', '&' or NUL - ends a run of content
+  };
+
+  struct CharClasses
+  {
+    unsigned char classes[256];
+
+    CharClasses(): classes()
+    {
+      for(const auto c: " \t\n\v\f\r")
+        if (c) classes[static_cast<unsigned char>(c)] = CHAR_SPACE;
+      for(auto c=0; c<128; c++)
+        if (isalnum(c) || c==':' || c=='_')
+          classes[c] = CHAR_NAME_START | CHAR_NAME;
+      classes[static_cast<unsigned char>('-')] = CHAR_NAME;
+      classes[static_cast<unsigned char>('.')] = CHAR_NAME;
+      for(const auto c: {'<', '&', '\0'})
+        classes[static_cast<unsigned char>(c)] = CHAR_CONTENT_STOP;
+    }
+  };
+
+  const CharClasses char_classes;
+
+  inline bool char_is(xmlchar c, int cls)
+  { return char_classes.classes[static_cast<unsigned char>(c)] & cls; }
+}
+
+//==========================================================================
+// Buffer scanner - holds the position in the buffer and the content
+// pending for the innermost open element
+class Parser::BufferScanner
+{
+  Parser& parser;
+  const xmlchar *p;
+  const xmlchar *end;
+  bool failed;       // Tried to read past the end, like a failed stream
+  string pending;    // Content not yet added to elements.back()
+  bool has_pending;
+
+  //------------------------------------------------------------------------
+  // Read a character - like istream::get(), leaves c alone at the end
+  void get(xmlchar& c)
+  {
+    if (p < end)
+      c = *p++;
+    else
+      failed = true;
+  }
+
+  //------------------------------------------------------------------------
+  // Put back the last character - like istream::unget(), not after failure
+  void unget()
+  {
+    if (!failed) p--;
+  }
+
+  //------------------------------------------------------------------------
+  // Read a character, skipping initial whitespace, and counting lines
+  xmlchar skip_ws(xmlchar c=0)
+  {
+    if (c=='\n') parser.line++;
+    while (p < end && char_is(*p, CHAR_SPACE))
+      if (*p++ == '\n') parser.line++;
+    c = 0;
+    get(c);
+    return c;
+  }
+
+  void skip_bom();
+  bool read_tag(xmlchar c);
+  void read_end_tag(xmlchar c);
+  void read_content(xmlchar c);
+  void read_ref(string& text);
+  bool read_int(int& n, int base);
+  string_view read_rest_of_name(xmlchar& c);
+  void skip_comment();
+  void skip_to_gt();
+  void skip_pi();
+  void add_pending(Element *e);
+
+public:
+  //------------------------------------------------------------------------
+  // Constructor
+  BufferScanner(Parser& _parser, const xmlchar *data, size_t length):
+    parser(_parser), p(data), end(data+length), failed(false),
+    has_pending(false)
+  {}
+
+  //------------------------------------------------------------------------
+  // Parse the buffer - as Parser::parse_stream()
+  void parse();
+
+  //------------------------------------------------------------------------
+  // Leave the partial tree as the stream parser would after a failure
+  void abandon()
+  { if (!parser.elements.empty()) add_pending(parser.elements.back()); }
+};
+
+//--------------------------------------------------------------------------
+// Parse the buffer
+// Throws XML::ParseFailed if unsuccessful
+void Parser::BufferScanner::parse()
+{
+  skip_bom();
+
+  bool done=false;
+  while (!done)
+  {
+    xmlchar c=0;
+
+    // Read first character, stripping leading whitespace unless preserving
+    // it within the document - see Parser::parse_stream
+    if (parser.root && (parser.flags & PARSER_PRESERVE_WHITESPACE))
+      get(c);
+    else
+      c = skip_ws();
+
+    if (!c)
+    {
+      if (parser.root)
+        parser.fatal("Input stream failed unexpectedly");
+      else
+        parser.fatal("Empty or unreadable document");
+    }
+
+    if (c == '<')
+    {
+      get(c);
+      switch (c)
+      {
+        case '!':  // Comment or DOCTYPE
+          get(c);
+          switch (c)
+          {
+            case '-':  // Comment
+              get(c);
+              if (c=='-')
+                skip_comment();
+              else
+              {
+                parser.error("Weird comment");
+                skip_to_gt();
+              }
+              break;
+
+            default:
+              skip_to_gt();
+              break;
+          }
+          break;
+
+        case '?':  // Prolog or other PI - just ignore
+          skip_pi();
+          break;
+
+        case '/': // End tag
+          get(c);
+          if (char_is(c, CHAR_NAME_START))
+            read_end_tag(c);
+          else
+            parser.fatal("Illegal end tag");
+
+          if (parser.elements.empty()) done=true;
+          break;
+
+        default:  // Something else - could be tag
+          if (char_is(c, CHAR_NAME_START))
+          {
+            if (read_tag(c) && parser.elements.empty()) done=true;
+          }
+          else
+          {
+            if (parser.flags & PARSER_BE_LENIENT)
+            {
+              unget();
+              read_content('<');
+            }
+            else parser.fatal("Illegal tag");
+          }
+      }
+    }
+    else if (parser.root)
+    {
+      read_content(c);
+    }
+    else
+    {
+      parser.fatal("Non-tag data at start of document");
+    }
+  }
+}
+
+//--------------------------------------------------------------------------
+// Check for and skip a BOM
+void Parser::BufferScanner::skip_bom()
+{
+  xmlchar c=0;
+  get(c);
+  if (c != '\xEF') { unget(); return; }
+  get(c);
+  if (c != '\xBB') { unget(); return; }
+  get(c);
+  if (c != '\xBF') { unget(); }
+}
+
+//--------------------------------------------------------------------------
+// Read a tag and attributes
+// c is first character already read
+// Returns whether element read is empty
+bool Parser::BufferScanner::read_tag(xmlchar c)
+{
+  unique_ptr<Element> e(new Element());
+  e->name = string(read_rest_of_name(c));
+  e->line = parser.line;
+
+  // Now loop looking for attributes or >
+  bool empty=false;
+  for(;;)
+  {
+    if (!char_is(c, CHAR_SPACE) && c!='/' && c!='>')
+      parser.fatal("Illegal start tag");
+
+    if (c!='/' && c!='>') c = skip_ws(c);
+
+    // Empty close />
+    if (c=='/')
+    {
+      empty=true;
+      get(c);
+      if (c!='>') parser.fatal("Illegal empty close");
+      break;
+    }
+
+    // Normal close
+    if (c=='>') break;
+
+    if (!char_is(c, CHAR_NAME_START)) parser.fatal("Illegal attribute name");
+
+    // Get attribute name, which must be unique - keep the place to insert it
+    string aname(read_rest_of_name(c));
+    const auto pos = e->attrs.lower_bound(aname);
+    if (pos != e->attrs.end() && pos->first == aname)
+      parser.fatal("Duplicate attribute name");
+
+    if (char_is(c, CHAR_SPACE)) c = skip_ws(c);
+    if (c!='=') parser.fatal("No = given for attribute");
+
+    c = skip_ws();
+    if (c!='"' && c!='\'') parser.fatal("Attribute value not quoted");
+    const xmlchar quote = c;
+
+    // Read attribute value to matching quote, a run at a time up to any
+    // reference or NUL
+    string aval;
+    for(;;)
+    {
+      auto stop = static_cast<const xmlchar *>(memchr(p, quote, end-p));
+      if (!stop) stop = end;
+      auto q = p;
+      while (q < stop && *q != '&' && *q) q++;
+      aval.append(p, q);
+      p = q;
+
+      c=0;
+      get(c);
+      if (!c) parser.fatal("Document ended in attribute value");
+      if (c==quote) break;
+      read_ref(aval);  // Must be '&'
+    }
+
+    e->attrs.emplace_hint(pos, move(aname), move(aval));
+
+    c=0;
+    get(c);
+  }
+
+  // Add this as a child of the last open element, if any, after any
+  // content before it
+  Element *ep = e.release();
+  if (!parser.elements.empty())
+  {
+    add_pending(parser.elements.back());
+    parser.elements.back()->add(ep);
+  }
+
+  parser.initial_processing(ep);
+
+  if (empty)
+    parser.final_processing(ep);
+  else
+    parser.elements.push_back(ep);
+
+  if (!parser.root) parser.root = ep;
+
+  return empty;
+}
+
+//--------------------------------------------------------------------------
+// Read an end tag
+// c is first character already read
+void Parser::BufferScanner::read_end_tag(xmlchar c)
+{
+  const auto name = read_rest_of_name(c);
+
+  if (char_is(c, CHAR_SPACE)) c = skip_ws(c);
+  if (c!='>') throw ParseFailed();
+
+  if (parser.elements.empty())
+  {
+    parser.error("End-tag found but no elements open");  // GCOV_EXCL_LINE
+    return;                                              // GCOV_EXCL_LINE
+  }
+
+  Element *e = parser.elements.back();
+  if (name==e->name)
+  {
+    parser.elements.pop_back();
+
+    // Content can go straight into the element if it would be optimised
+    if (has_pending && (parser.flags & PARSER_OPTIMISE_CONTENT)
+        && e->children.empty())
+    {
+      e->content = move(pending);
+      has_pending = false;
+    }
+    else add_pending(e);
+
+    parser.final_processing(e);
+  }
+  else
+  {
+    ostringstream oss;
+    oss << "Mis-nested tags - expected </" << e->name
+        << ">, opened at line " << e->line << ", but got </"
+        << name << ">";
+    parser.fatal(oss.str());
+  }
+}
+
+//--------------------------------------------------------------------------
+// Add any pending content to the given element as a sub-element
+void Parser::BufferScanner::add_pending(Element *e)
+{
+  if (!has_pending) return;
+  auto text = new Element();
+  text->content = move(pending);
+  e->add(text);
+  has_pending = false;
+}
+
+//--------------------------------------------------------------------------
+// Read data content
+// Handles whitespace compression and tail stripping
+// c is first character already read
+void Parser::BufferScanner::read_content(xmlchar c)
+{
+  const auto preserve = parser.flags & PARSER_PRESERVE_WHITESPACE;
+
+  // Continue any content we already have for this element - we got broken
+  // by a comment or PI, which we treat like whitespace
+  const auto was_pending = has_pending;
+  const auto kept = pending.size();
+  string discard;
+  string& content = parser.elements.empty() ? discard : pending;
+  if (has_pending)
+  {
+    if (!preserve) content += ' ';
+  }
+  else if (!parser.elements.empty())
+  {
+    content.clear();
+    has_pending = true;
+  }
+
+  try
+  {
+    bool first = true;
+    for(;;)
+    {
+      if (!preserve && char_is(c, CHAR_SPACE))
+      {
+        c = skip_ws(c);
+        if (c!='<') content+=' ';
+        first = false;
+      }
+
+      // First (passed in) character '<' is allowed if lenient
+      if (c=='<' && !first)
+      {
+        unget();
+        break;
+      }
+
+      if (c=='&')
+        read_ref(content);
+      else if (!c)
+        parser.fatal("Unexpected end of stream");
+      else
+      {
+        if (c=='\n') parser.line++;
+        content+=c;
+      }
+
+      // Take the run of ordinary characters which follows
+      auto q = p;
+      if (preserve)
+      {
+        for(; q < end && !char_is(*q, CHAR_CONTENT_STOP); q++)
+          if (*q == '\n') parser.line++;
+      }
+      else
+      {
+        while (q < end && !char_is(*q, CHAR_CONTENT_STOP | CHAR_SPACE)) q++;
+      }
+      content.append(p, q);
+      p = q;
+
+      c=0;
+      get(c);
+      first = false;
+    }
+  }
+  catch (const ParseFailed&)
+  {
+    // Drop what we read of this content, as the stream parser would
+    if (was_pending)
+      pending.resize(kept);
+    else
+      has_pending = false;
+    throw;
+  }
+}
+
+//--------------------------------------------------------------------------
+// Read a number, as istream >> int without skipping whitespace
+// Returns whether a valid number was read
+bool Parser::BufferScanner::read_int(int& n, int base)
+{
+  const auto negative = p < end && *p == '-';
+  if (p < end && (*p == '-' || *p == '+')) p++;
+  if (base == 16 && end-p >= 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+    p += 2;
+
+  long long value = 0;
+  auto digits = 0;
+  for(; p < end; p++, digits++)
+  {
+    int d;
+    if (*p >= '0' && *p <= '9')
+      d = *p - '0';
+    else if (base == 16 && *p >= 'a' && *p <= 'f')
+      d = *p - 'a' + 10;
+    else if (base == 16 && *p >= 'A' && *p <= 'F')
+      d = *p - 'A' + 10;
+    else
+      break;
+
+    value = value * base + d;
+    if (value > static_cast<long long>(INT_MAX)+1) return false;
+  }
+
+  if (negative) value = -value;
+  if (!digits || value > INT_MAX || value < INT_MIN) return false;
+  n = static_cast<int>(value);
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Read a reference (CharRef or EntityRef)
+// Assumes & has been read.  Allows &#nn; &#xXX; and &ent;
+// text is string to add to (note can be multiple chars if UTF8)
+void Parser::BufferScanner::read_ref(string& text)
+{
+  xmlchar c=0;
+  get(c);
+  if (c=='#') //CharRef
+  {
+    int n = 0;
+    get(c);
+    auto ok = false;
+    if (c=='x')
+      ok = read_int(n, 16);
+    else
+    {
+      unget();
+      ok = read_int(n, 10);
+    }
+
+    c=0;
+    if (ok) get(c);
+    if (c!=';') parser.fatal("Malformed character reference");
+
+    parser.add_char_ref(text, n);
+  }
+  else if (isalpha(c)) //Entity name - alphabetic only
+  {
+    const auto ent = read_rest_of_name(c);
+    if (c!=';') parser.fatal("Malformed entity reference");
+
+    if (!parser.add_entity_ref(text, ent))
+      parser.fatal("Unrecognised entity name");
+  }
+  else
+  {
+    if (parser.flags & PARSER_BE_LENIENT)
+    {
+      text += '&';
+      unget();
+    }
+    else parser.fatal("Weird reference - unescaped '&'?");
+  }
+}
+
+//--------------------------------------------------------------------------
+// Read the rest of a name (while name chars)
+// c is initially first character read, which is still in the buffer
+// Returns name in the buffer, modifies 'c' to first non-name character read
+string_view Parser::BufferScanner::read_rest_of_name(xmlchar& c)
+{
+  const auto start = p-1;
+  while (p < end && char_is(*p, CHAR_NAME)) p++;
+  const string_view name(start, p-start);
+  c = 0;
+  get(c);
+  return name;
+}
+
+//--------------------------------------------------------------------------
+// Read to end of !DOCTYPE etc - just look for '>'
+void Parser::BufferScanner::skip_to_gt()
+{
+  for(;;)
+  {
+    xmlchar c=0;
+    get(c);
+    if (c == '>') break;
+    else if (c == '\n') parser.line++;
+    else if (!c) parser.fatal("Unexpected end-of-file");
+  }
+}
+
+//--------------------------------------------------------------------------
+// Read to end of comment - look for -->
+void Parser::BufferScanner::skip_comment()
+{
+  for(;;)
+  {
+    xmlchar c=0;
+    get(c);
+    if (c=='-')
+    {
+      c=0;
+      get(c);
+      if (c=='-')
+      {
+        c=0;
+        get(c);
+        if (c=='>') break;
+        else if (c == '\n') parser.line++;
+      }
+      else if (c == '\n') parser.line++;
+    }
+    else if (c == '\n') parser.line++;
+    else if (!c) parser.fatal("Unexpected end-of-file in comment");
+  }
+}
+
+//--------------------------------------------------------------------------
+// Read to end of PI - look for ?>
+void Parser::BufferScanner::skip_pi()
+{
+  for(;;)
+  {
+    xmlchar c=0;
+    get(c);
+    if (c=='?')
+    {
+      c=0;
+      get(c);
+      if (c == '\n') parser.line++;
+      if (c=='>') break;
+    }
+
+    if (!c) parser.fatal("Unexpected end-of-file in PI");
+  }
+}
+
+//--------------------------------------------------------------------------
+// Parse from a contiguous buffer
+void Parser::read_from(const char *data, size_t length)
+{
+  reset();
+  BufferScanner scanner(*this, data, length);
+  try
+  {
+    scanner.parse();
+  }
+  catch (const ParseFailed&)
+  {
+    scanner.abandon();
+    throw;
+  }
+}
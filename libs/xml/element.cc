@@ -289,7 +289,7 @@ void Element::optimise()
   if (!children.empty() && ++children.begin() == children.end()
     && children.back()->name.empty())
   {
-    content = children.back()->content;
+    content = move(children.back()->content);
     delete children.back();
     children.pop_back();
   }
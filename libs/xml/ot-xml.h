@@ -10,11 +10,15 @@
 #define __OBTOOLS_XML_H
 
 #include <string>
+#include <string_view>
 #include <deque>
 #include <list>
 #include <map>
+#include <vector>
 #include <iostream>
+#include <functional>
 #include <stdint.h>
+#include "ot-chan.h"
 
 namespace ObTools {
 
@@ -622,7 +626,9 @@ private:
   // Transient per-document state
   deque<Element *> elements;  //Could be a <stack>, but no clear()
   Element *root;       //0 if not valid
-  deque<map<string, string> > ns_maps; //Stack of maps of prefix->full name
+  // Stack of maps of prefix->full name, each with the element which
+  // declared it - pushed only by elements with xmlns attributes
+  vector<pair<Element *, map<string, string> > > ns_maps;
 
   //------------------------------------------------------------------------
   // Inline character classification functions
@@ -652,14 +658,21 @@ private:
     }
   }
 
+  //------------------------------------------------------------------------
+  // Fast path for contiguous buffers - see buffer-parser.cc
+  class BufferScanner;
+
   //------------------------------------------------------------------------
   // Other private functions
+  void reset();
   void parse_stream(istream &s);
   void skip_bom(istream& s);
   bool read_tag(xmlchar c, istream &s);
   void read_end_tag(xmlchar c, istream &s);
   void read_content(xmlchar c, istream &s);
   void read_ref(string& text, istream &s);
+  static bool add_entity_ref(string& text, string_view ent);
+  static void add_char_ref(string& text, int n);
   void read_rest_of_name(xmlchar& c, istream& s, string& name);
   string read_rest_of_name(xmlchar& c, istream& s);
   void skip_comment(istream &s);
@@ -669,8 +682,12 @@ private:
   void fatal(const string& s);
   void initial_processing(Element *e);
   void final_processing(Element *e);
+  void fix_names(Element *e);
   void substitute_name(string& name, bool usedef=false);
 
+  // Reader shares our namespace handling and error reporting
+  friend class Reader;
+
 protected:
   ostream& serr;       //error output stream
   int flags;
@@ -719,6 +736,12 @@ public:
   // Throws ParseFailed if parse fails for any fatal reason
   void read_from(const string& s);
 
+  //------------------------------------------------------------------------
+  // Parse from a contiguous buffer, e.g. a received message or mapped file
+  // Same results as the stream parser, but much faster
+  // Throws ParseFailed if parse fails for any fatal reason
+  void read_from(const char *data, size_t length);
+
   //------------------------------------------------------------------------
   // Get root element
   // Returns Element::none if not valid
@@ -757,6 +780,119 @@ istream& operator>>(istream& s, Parser& p);
 // Note - read into Parser, write from Element
 ostream& operator<<(ostream& s, const Element& e);
 
+//==========================================================================
+// XML pull reader
+// Reads a document a piece at a time as a sequence of events, without
+// building the tree, so memory is proportional to nesting depth rather than
+// document size.  Subtrees at given paths can be read whole as Elements.
+// Flags and fix_namespace() are as Parser, with names fixed as each start
+// tag is read
+//
+// e.g.
+//   XML::Reader reader(in);
+//   while (reader.next() != XML::Reader::END_OF_DOCUMENT) ...
+//
+// Throws ParseFailed on any fatal error, as Parser
+class Reader
+{
+public:
+  enum Event
+  {
+    NONE,             // Nothing read yet
+    END_OF_DOCUMENT,
+    START,            // Start tag - name and attributes
+    TEXT,             // Text content
+    END,              // End tag, also given for empty tags
+    ELEMENT           // Whole subtree at a path given to add_path()
+  };
+
+private:
+  static const size_t buffer_size = 65536;
+
+  Parser parser;               // Flags, namespaces and error reporting
+  istream *stream;             // Source - either stream or channel
+  Channel::Reader *channel;
+  vector<char> buffer;
+  size_t pos;
+  size_t length;
+  bool eof;
+
+  vector<Element *> open;      // Start tags open, name and attributes only
+  vector<string> raw_names;    // As read, to check end tags
+  vector<vector<string> > paths;
+  Event event;
+  Element *current;            // Element for this event, if any
+  Element *closed;             // Ended element or subtree, ours to delete
+  string text;
+  bool started;                // Read the root start tag
+  bool closing;                // Empty tag just given START, END to come
+
+  bool fill(size_t n);
+  xmlchar peek(size_t offset=0)
+  { return (pos+offset < length || fill(offset+1)) ? buffer[pos+offset] : 0; }
+  xmlchar get();
+  void skip_ws();
+  void read_name(string& name);
+  void read_ref(string& text);
+  void read_piece(string& piece, bool lenient_lt);
+  bool read_text();
+  void skip_markup();
+  Element *read_start_tag(bool& empty);
+  void read_end_tag();
+  void start_element(Element *e);
+  Element *end_element();
+  bool matches_path() const;
+  void read_subtree(bool empty);
+
+public:
+  //------------------------------------------------------------------------
+  // Constructors - s is output stream for parsing errors, f flags as Parser
+  Reader(istream& in, ostream& s=cerr, int f=PARSER_OPTIMISE_CONTENT);
+  Reader(Channel::Reader& in, ostream& s=cerr, int f=PARSER_OPTIMISE_CONTENT);
+
+  ~Reader();
+
+  //------------------------------------------------------------------------
+  // Add namespace to prefix mapping - as Parser
+  void fix_namespace(const string& name, const string& prefix)
+  { parser.fix_namespace(name, prefix); }
+
+  //------------------------------------------------------------------------
+  // Add an element path to read whole, given as an ELEMENT event instead of
+  // its START, contents and END - e.g. "/XMI/XMI.content/*" - with '*'
+  // matching any one name
+  void add_path(const string& path);
+
+  //------------------------------------------------------------------------
+  // Read the next event
+  // Throws ParseFailed if parse fails for any fatal reason
+  Event next();
+
+  //------------------------------------------------------------------------
+  // Details of the current event
+  Event get_event() const { return event; }
+  // START, END and ELEMENT
+  const string& get_name() const;
+  // START and ELEMENT
+  const map<string, string>& get_attrs() const;
+  string get_attr(const string& name, const string& def="") const;
+  // TEXT
+  const string& get_text() const { return text; }
+  // ELEMENT: whole subtree, only valid until next(); START: just the
+  // name and attributes
+  Element& get_element() const;
+  // Number of elements open, including one just started
+  size_t get_depth() const { return open.size(); }
+  int get_line() const { return parser.line; }
+  int get_errors() const { return parser.errors; }
+
+  //------------------------------------------------------------------------
+  // Read the rest of the document, calling the callback with each subtree
+  // at the given path, which is deleted afterwards
+  void for_each_element(const string& path,
+                        const function<void(Element&)>& callback);
+};
+
 //==========================================================================
 // XPath processor
 // Only handles child and attribute axis steps in abbreviated form, no
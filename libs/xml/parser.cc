@@ -12,6 +12,16 @@
 using namespace ObTools::XML;
 
 
+//--------------------------------------------------------------------------
+// Clear stacks and root before a new document
+void Parser::reset()
+{
+  elements.clear();
+  ns_maps.clear();
+  if (root) delete root;
+  root = 0;
+}
+
 //--------------------------------------------------------------------------
 // Parse a stream
 // This is the main document-level parser
@@ -19,11 +29,7 @@ using namespace ObTools::XML;
 // Throws XML::ParseFailed if unsuccessful
 void Parser::parse_stream(istream& s)
 {
-  // Clear stacks and root
-  elements.clear();
-  ns_maps.clear();
-  if (root) delete root;
-  root = 0;
+  reset();
 
   // Skip optional Byte Order Mark
   skip_bom(s);
@@ -396,7 +402,7 @@ void Parser::read_ref(string& text, istream &s)
     {
       s.unget();
       c=0;
-      s >> n >> c;
+      s >> dec >> n >> c;
     }
     s.setf(ios::skipws);
 
@@ -404,32 +410,7 @@ void Parser::read_ref(string& text, istream &s)
     // or didn't end with ;
     if (c!=';') fatal("Malformed character reference");
 
-    // Some subtleties here...  This parser ignores the encoding
-    // specified in the prolog, and hence is only really conformant for
-    // documents with the default encoding, UTF8.  That's enough for me!
-
-    // However, it causes some work here: character references are in
-    // the document character set (Unicode), NOT the encoding - hence
-    // to make this consistent, we have to expand the Unicode value to
-    // UTF8 here
-
-    // 7-bit is simple
-    if (n < 0x80)
-      text += static_cast<xmlchar>(n);
-    else
-    {
-      // 8-bit and above depends on the length
-      // NB we only handle UCS2 here, so can only go to 3 bytes
-      if (n < 0x800)
-        text += static_cast<xmlchar>(0xC0 | (n >> 6));
-      else
-      {
-        text += static_cast<xmlchar>(0xE0 | (n >> 12));
-        text += static_cast<xmlchar>(0x80 | ((n >> 6) & 0x3f));
-      }
-
-      text += static_cast<xmlchar>(0x80 | (n & 0x3f));
-    }
+    add_char_ref(text, n);
   }
   else if (isalpha(c)) //Entity name - alphabetic only
   {
@@ -437,20 +418,7 @@ void Parser::read_ref(string& text, istream &s)
     // Must have ; terminator
     if (c!=';') fatal("Malformed entity reference");
 
-    // Not many options, simple tests will do
-    //(Always thought that switch(ent) should be allowed here!)
-    if (ent=="lt")
-      text+='<';
-    else if (ent=="gt")
-      text+='>';
-    else if (ent=="amp")
-      text+='&';
-    else if (ent=="apos")
-      text+='\'';
-    else if (ent=="quot")
-      text+='"';
-    else
-      fatal("Unrecognised entity name");
+    if (!add_entity_ref(text, ent)) fatal("Unrecognised entity name");
   }
   else
   {
@@ -465,6 +433,60 @@ void Parser::read_ref(string& text, istream &s)
   }
 }
 
+//--------------------------------------------------------------------------
+// Add an entity reference's character to text
+// Returns false if not recognised
+bool Parser::add_entity_ref(string& text, string_view ent)
+{
+  // Not many options, simple tests will do
+  //(Always thought that switch(ent) should be allowed here!)
+  if (ent=="lt")
+    text+='<';
+  else if (ent=="gt")
+    text+='>';
+  else if (ent=="amp")
+    text+='&';
+  else if (ent=="apos")
+    text+='\'';
+  else if (ent=="quot")
+    text+='"';
+  else
+    return false;
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Add a character reference's character to text
+void Parser::add_char_ref(string& text, int n)
+{
+  // Some subtleties here...  This parser ignores the encoding
+  // specified in the prolog, and hence is only really conformant for
+  // documents with the default encoding, UTF8.  That's enough for me!
+
+  // However, it causes some work here: character references are in
+  // the document character set (Unicode), NOT the encoding - hence
+  // to make this consistent, we have to expand the Unicode value to
+  // UTF8 here
+
+  // 7-bit is simple
+  if (n < 0x80)
+    text += static_cast<xmlchar>(n);
+  else
+  {
+    // 8-bit and above depends on the length
+    // NB we only handle UCS2 here, so can only go to 3 bytes
+    if (n < 0x800)
+      text += static_cast<xmlchar>(0xC0 | (n >> 6));
+    else
+    {
+      text += static_cast<xmlchar>(0xE0 | (n >> 12));
+      text += static_cast<xmlchar>(0x80 | ((n >> 6) & 0x3f));
+    }
+
+    text += static_cast<xmlchar>(0x80 | (n & 0x3f));
+  }
+}
+
 //--------------------------------------------------------------------------
 // Read the rest of a name (while name chars) into the given string
 // c is initially first character read
@@ -621,40 +643,30 @@ void Parser::initial_processing(Element *e)
 {
   if (flags & PARSER_FIX_NAMESPACES)
   {
-    // Open a new nsmap level - copy current and push to back of ns_maps
-    if (!ns_maps.empty())
-      ns_maps.push_back(ns_maps.back());
-    else
-      ns_maps.resize(1);
-
-    // Look for xmlns:* attributes and add to current map
+    // Look for xmlns:* attributes and add to a new map level, copied from
+    // the current one
+    map<string, string> *nsmap = 0;
     for(map<string,string>::const_iterator p=e->attrs.begin();
         p!=e->attrs.end();
         p++)
     {
       const string& aname=p->first;
 
-      // Begins with xmlns?
-      // GCC2.95 bug - string::compare parameters are nonstandard - use probably
-      // inefficient substring compare
-      if (string(aname, 0, 5)=="xmlns")
+      // Begins with xmlns?  Either alone (default namespace, stored as
+      // empty prefix) or xmlns:prefix - otherwise, ignore it
+      if (aname.compare(0, 5, "xmlns")) continue;
+      if (aname.size() > 5 && aname[5] != ':') continue;
+
+      if (!nsmap)
       {
-        // Only xmlns alone?  Default namespace
-        if (aname.size()==5)
-        {
-          // Store as empty prefix (default)
-          ns_maps.back()[""]=p->second;
-        }
-        // xmlns:prefix?
-        else if (aname[5]==':')
-        {
-          string prefix(aname,6);
-
-          // Store with prefix
-          ns_maps.back()[prefix]=p->second;
-        }
-        // Otherwise, ignore it
+        if (ns_maps.empty())
+          ns_maps.emplace_back(e, map<string, string>());
+        else
+          ns_maps.emplace_back(e, ns_maps.back().second);
+        nsmap = &ns_maps.back().second;
       }
+
+      (*nsmap)[aname.size() > 5 ? aname.substr(6) : ""] = p->second;
     }
   }
 }
@@ -667,36 +679,46 @@ void Parser::final_processing(Element *e)
   if (flags & PARSER_OPTIMISE_CONTENT)
     e->optimise();
 
-  if ((flags & PARSER_FIX_NAMESPACES)
-    && !ns_maps.empty())  // Should always be OK, but be safe
+  // Nothing to do if no namespaces declared in scope
+  if ((flags & PARSER_FIX_NAMESPACES) && !ns_maps.empty())
   {
-    // Check current element name in latest ns_map and see if we need to
-    // translate it - including default namespace
-    substitute_name(e->name, true);
-
-    // Substitute attributes as well - non-obvious because we can't just
-    // replace key names, and it's a hassle to manipulate maps in place.
-    // For simplicity, but not speed, we take a copy of the map and copy
-    // them all across
-    map<string,string> old_attrs(e->attrs);
-    e->attrs.clear();
-
-    // Run through all the old ones and copy them back, optionally
-    // modified
-    for(map<string,string>::iterator p=old_attrs.begin();
-        p!=old_attrs.end();
-        p++)
-    {
-      string name=p->first;
+    fix_names(e);
 
-      // Subsitute without defaulting
-      substitute_name(name);
+    // Chop this element's level off ns_map stack, if it made one
+    if (ns_maps.back().first == e) ns_maps.pop_back();
+  }
+}
+
+//--------------------------------------------------------------------------
+// Substitute an element's name and attribute names according to the
+// current namespace map (assumed non empty)
+void Parser::fix_names(Element *e)
+{
+  // Check current element name in latest ns_map and see if we need to
+  // translate it - including default namespace
+  substitute_name(e->name, true);
+
+  // Substitute attributes as well - we can't just replace key names, so
+  // if any change we rebuild the map
+  for(map<string,string>::iterator p=e->attrs.begin();
+      p!=e->attrs.end();
+      p++)
+  {
+    string name=p->first;
 
+    // Subsitute without defaulting
+    substitute_name(name);
+    if (name == p->first) continue;
+
+    map<string,string> old_attrs;
+    old_attrs.swap(e->attrs);
+    for(p=old_attrs.begin(); p!=old_attrs.end(); p++)
+    {
+      name=p->first;
+      substitute_name(name);
       e->attrs[name]=p->second;
     }
-
-    // Chop current level off ns_map stack
-    ns_maps.pop_back();
+    break;
   }
 }
 
@@ -706,10 +728,9 @@ void Parser::final_processing(Element *e)
 // Replaces the name in place if necessary
 // Only substitutes default namespaces if usedef is true - set for elements
 // not for attributes
-// Returns whether any subsititution done
 void Parser::substitute_name(string& name, bool usedef)
 {
-  map<string,string>& topmap = ns_maps.back();
+  const map<string,string>& topmap = ns_maps.back().second;
   string prefix;
 
   // Look for a prefix
@@ -726,25 +747,22 @@ void Parser::substitute_name(string& name, bool usedef)
   }
 
   // Lookup this prefix in latest map
-  if (topmap.find(prefix)!=topmap.end())
+  map<string,string>::const_iterator p = topmap.find(prefix);
+  if (p!=topmap.end())
   {
-    string rest(name,pos);
-    const string& nsname=topmap[prefix];
-
     // Look up nsname in user_ns_map and substitute prefix
-    if (user_ns_map.find(nsname)!=user_ns_map.end())
+    map<string,string>::const_iterator q = user_ns_map.find(p->second);
+    if (q!=user_ns_map.end())
     {
-      const string& newprefix=user_ns_map[nsname];
+      const string& newprefix=q->second;
 
       // Rebuild name in place
       if (newprefix.empty())
-        name = rest;
+        name.erase(0, pos);
+      else if (pos)
+        name.replace(0, pos-1, newprefix);
       else
-      {
-        name=newprefix;
-        name += ':';
-        name += rest;
-      }
+        name.insert(0, newprefix + ':');
     }
   }
 }
@@ -782,8 +800,7 @@ void Parser::read_from(istream &s)
 // Parse from given string
 void Parser::read_from(const string &s)
 {
-  istringstream iss(s);
-  parse_stream(iss);
+  read_from(s.data(), s.size());
 }
 
 //--------------------------------------------------------------------------
@@ -0,0 +1,602 @@
+//==========================================================================
+// ObTools::XML: reader.cc
+//
+// Pull reader for XML documents too large to hold in memory
+//
+// Text follows the same rules as Parser - whitespace compression, and
+// joining text broken by comments - so subtrees read whole are the same as
+// Parser would make
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "ot-xml.h"
+#include <sstream>
+#include <cstring>
+#include <memory>
+
+namespace ObTools { namespace XML {
+
+//--------------------------------------------------------------------------
+// Constructors
+Reader::Reader(istream& in, ostream& s, int f):
+  parser(s, f), stream(&in), channel(0), buffer(buffer_size), pos(0),
+  length(0), eof(false), event(NONE), current(0), closed(0), started(false),
+  closing(false)
+{}
+
+Reader::Reader(Channel::Reader& in, ostream& s, int f):
+  parser(s, f), stream(0), channel(&in), buffer(buffer_size), pos(0),
+  length(0), eof(false), event(NONE), current(0), closed(0), started(false),
+  closing(false)
+{}
+
+//--------------------------------------------------------------------------
+// Destructor
+Reader::~Reader()
+{
+  if (closed) delete closed;
+
+  // Elements within a subtree are owned by their parents
+  for(const auto e: open)
+    if (!e->parent) delete e;
+}
+
+//--------------------------------------------------------------------------
+// Make sure there are at least n characters from pos in the buffer
+// Returns whether there are
+bool Reader::fill(size_t n)
+{
+  if (pos)
+  {
+    memmove(buffer.data(), buffer.data()+pos, length-pos);
+    length -= pos;
+    pos = 0;
+  }
+
+  while (length < n && !eof)
+  {
+    size_t got = 0;
+    if (stream)
+    {
+      stream->read(buffer.data()+length, buffer.size()-length);
+      got = stream->gcount();
+    }
+    else
+    {
+      try
+      {
+        got = channel->basic_read(buffer.data()+length, buffer.size()-length);
+      }
+      catch (const Channel::Error& e)
+      {
+        parser.fatal("Read failed: " + e.text);
+      }
+    }
+
+    if (!got) eof = true;
+    length += got;
+  }
+
+  return length >= n;
+}
+
+//--------------------------------------------------------------------------
+// Read a character, counting lines - 0 at end
+xmlchar Reader::get()
+{
+  const auto c = peek();
+  if (pos < length)
+  {
+    pos++;
+    if (c == '\n') parser.line++;
+  }
+  return c;
+}
+
+//--------------------------------------------------------------------------
+// Skip whitespace
+void Reader::skip_ws()
+{
+  while (parser.is_ascii_space(peek())) get();
+}
+
+//--------------------------------------------------------------------------
+// Read a name, which must start with a name start character
+void Reader::read_name(string& name)
+{
+  name.clear();
+  do
+  {
+    auto q = pos;
+    while (q < length && parser.is_name_char(buffer[q])) q++;
+    name.append(&buffer[pos], q-pos);
+    pos = q;
+  } while (pos == length && fill(1));
+}
+
+//--------------------------------------------------------------------------
+// Read a reference (CharRef or EntityRef), after the '&' - as Parser
+void Reader::read_ref(string& text)
+{
+  xmlchar c = peek();
+  if (c=='#') //CharRef
+  {
+    get();
+    auto base = 10;
+    if (peek()=='x')
+    {
+      get();
+      base = 16;
+    }
+
+    auto n = 0;
+    auto digits = 0;
+    for(;; digits++)
+    {
+      c = peek();
+      int d;
+      if (c >= '0' && c <= '9')
+        d = c - '0';
+      else if (base == 16 && c >= 'a' && c <= 'f')
+        d = c - 'a' + 10;
+      else if (base == 16 && c >= 'A' && c <= 'F')
+        d = c - 'A' + 10;
+      else
+        break;
+
+      get();
+      n = n * base + d;
+      if (n > 0x10FFFF) parser.fatal("Malformed character reference");
+    }
+
+    if (!digits || get()!=';') parser.fatal("Malformed character reference");
+    parser.add_char_ref(text, n);
+  }
+  else if (isalpha(c)) //Entity name - alphabetic only
+  {
+    string ent;
+    read_name(ent);
+    if (get()!=';') parser.fatal("Malformed entity reference");
+    if (!parser.add_entity_ref(text, ent))
+      parser.fatal("Unrecognised entity name");
+  }
+  else
+  {
+    if (parser.flags & PARSER_BE_LENIENT)
+      text += '&';
+    else
+      parser.fatal("Weird reference - unescaped '&'?");
+  }
+}
+
+//--------------------------------------------------------------------------
+// Read a piece of text up to the next '<' or end, compressing whitespace
+// unless preserving it.  Starts with '<' as text if lenient_lt
+void Reader::read_piece(string& piece, bool lenient_lt)
+{
+  const auto preserve = parser.flags & PARSER_PRESERVE_WHITESPACE;
+  if (lenient_lt) piece += get();
+
+  for(;;)
+  {
+    // Take the run of ordinary characters
+    do
+    {
+      auto q = pos;
+      for(; q < length; q++)
+      {
+        const auto c = buffer[q];
+        if (c=='<' || c=='&' || !c) break;
+        if (preserve)
+        {
+          if (c=='\n') parser.line++;
+        }
+        else if (parser.is_ascii_space(c)) break;
+      }
+      piece.append(&buffer[pos], q-pos);
+      pos = q;
+    } while (pos == length && fill(1));
+
+    const auto c = peek();
+    if (c=='<' || !c) return;
+
+    if (c=='&')
+    {
+      get();
+      read_ref(piece);
+    }
+    else
+    {
+      // Compress whitespace to a single space, suppressed at end
+      skip_ws();
+      if (peek()!='<') piece += ' ';
+    }
+  }
+}
+
+//--------------------------------------------------------------------------
+// Read text up to the next start or end tag, skipping comments and the
+// like, which join the text either side with a space unless preserving
+// whitespace
+// Returns whether there was any
+bool Reader::read_text()
+{
+  const auto preserve = parser.flags & PARSER_PRESERVE_WHITESPACE;
+  text.clear();
+  auto any = false;
+  string piece;
+  for(;;)
+  {
+    if (!preserve) skip_ws();
+
+    auto lenient_lt = false;
+    auto c = peek();
+    if (!c) parser.fatal("Unexpected end of stream");
+    if (c=='<')
+    {
+      c = peek(1);
+      if (c=='/' || parser.is_name_start(c)) return any;
+
+      if (c=='!' || c=='?')
+      {
+        skip_markup();
+        continue;
+      }
+
+      // Check for leniency here - if so, keep it as character data, like
+      // SGML would
+      if (!(parser.flags & PARSER_BE_LENIENT)) parser.fatal("Illegal tag");
+      lenient_lt = true;
+    }
+
+    piece.clear();
+    read_piece(piece, lenient_lt);
+    if (any && !preserve) text += ' ';
+    text += piece;
+    any = true;
+  }
+}
+
+//--------------------------------------------------------------------------
+// Skip a comment, PI, DOCTYPE or similar, starting at the '<'
+void Reader::skip_markup()
+{
+  get();
+  const char *end = ">";
+  if (get()=='?')
+    end = "?>";
+  else if (peek()=='-')
+  {
+    get();
+    if (peek()=='-')
+    {
+      get();
+      end = "-->";
+    }
+    else parser.error("Weird comment");
+  }
+
+  const auto n = strlen(end);
+  for(;;)
+  {
+    const auto c = get();
+    if (!c) parser.fatal("Unexpected end-of-file");
+    if (c==end[0])
+    {
+      auto i = 1u;
+      while (i < n && peek(i-1)==end[i]) i++;
+      if (i == n)
+      {
+        for(i=1; i<n; i++) get();
+        return;
+      }
+    }
+  }
+}
+
+//--------------------------------------------------------------------------
+// Read a start tag and attributes, starting at the '<'
+// Sets empty if an empty tag
+Element *Reader::read_start_tag(bool& empty)
+{
+  get();
+  unique_ptr<Element> e(new Element());
+  read_name(e->name);
+  e->line = parser.line;
+  raw_names.push_back(e->name);
+
+  // Now loop looking for attributes or >
+  empty = false;
+  for(;;)
+  {
+    // Next must be / > or whitespace, or it's an error
+    auto c = peek();
+    if (!parser.is_ascii_space(c) && c!='/' && c!='>')
+      parser.fatal("Illegal start tag");
+    skip_ws();
+
+    // Empty close />
+    c = get();
+    if (c=='/')
+    {
+      if (get()!='>') parser.fatal("Illegal empty close");
+      empty = true;
+      break;
+    }
+
+    // Normal close
+    if (c=='>') break;
+
+    if (!parser.is_name_start(c)) parser.fatal("Illegal attribute name");
+    pos--;  // We know it's still there
+
+    // Get attribute name, which must be unique
+    string aname;
+    read_name(aname);
+    const auto p = e->attrs.lower_bound(aname);
+    if (p != e->attrs.end() && p->first == aname)
+      parser.fatal("Duplicate attribute name");
+
+    skip_ws();
+    if (get()!='=') parser.fatal("No = given for attribute");
+
+    skip_ws();
+    const auto quote = get();
+    if (quote!='"' && quote!='\'') parser.fatal("Attribute value not quoted");
+
+    // Read attribute value to matching quote
+    string aval;
+    for(;;)
+    {
+      do
+      {
+        auto q = pos;
+        for(; q < length; q++)
+        {
+          const auto c = buffer[q];
+          if (c==quote || c=='&' || !c) break;
+          if (c=='\n') parser.line++;
+        }
+        aval.append(&buffer[pos], q-pos);
+        pos = q;
+      } while (pos == length && fill(1));
+
+      c = get();
+      if (!c) parser.fatal("Document ended in attribute value");
+      if (c==quote) break;
+      read_ref(aval);
+    }
+
+    e->attrs.emplace_hint(p, move(aname), move(aval));
+  }
+
+  return e.release();
+}
+
+//--------------------------------------------------------------------------
+// Read an end tag, starting at the '<', and check it matches the last
+// start tag
+void Reader::read_end_tag()
+{
+  get();
+  get();
+  if (!parser.is_name_start(peek())) parser.fatal("Illegal end tag");
+  string name;
+  read_name(name);
+  skip_ws();
+  if (get()!='>') parser.fatal("Illegal end tag");
+
+  if (name != raw_names.back())
+  {
+    ostringstream oss;
+    oss << "Mis-nested tags - expected </" << raw_names.back()
+        << ">, opened at line " << open.back()->line << ", but got </"
+        << name << ">";
+    parser.fatal(oss.str());
+  }
+}
+
+//--------------------------------------------------------------------------
+// Start an element - open its namespace level and fix its names now
+void Reader::start_element(Element *e)
+{
+  parser.initial_processing(e);
+  if ((parser.flags & PARSER_FIX_NAMESPACES) && !parser.ns_maps.empty())
+    parser.fix_names(e);
+}
+
+//--------------------------------------------------------------------------
+// End the last open element, returning it
+Element *Reader::end_element()
+{
+  const auto e = open.back();
+  open.pop_back();
+  raw_names.pop_back();
+
+  if (parser.flags & PARSER_OPTIMISE_CONTENT)
+    e->optimise();
+
+  if (!parser.ns_maps.empty() && parser.ns_maps.back().first == e)
+    parser.ns_maps.pop_back();
+  return e;
+}
+
+//--------------------------------------------------------------------------
+// Check whether the open elements match a path
+bool Reader::matches_path() const
+{
+  for(const auto& path: paths)
+  {
+    if (path.size() != open.size()) continue;
+    auto i = 0u;
+    while (i < path.size() && (path[i] == "*" || path[i] == open[i]->name))
+      i++;
+    if (i == path.size()) return true;
+  }
+  return false;
+}
+
+//--------------------------------------------------------------------------
+// Read the whole of the last open element into a subtree
+void Reader::read_subtree(bool empty)
+{
+  const auto depth = open.size();
+  if (!empty)
+  {
+    for(;;)
+    {
+      const auto e = open.back();
+      if (read_text())
+      {
+        auto t = new Element();
+        t->content = move(text);
+        e->add(t);
+      }
+
+      if (peek(1)=='/')
+      {
+        read_end_tag();
+        if (open.size() == depth) break;
+        end_element();
+        continue;
+      }
+
+      bool child_empty;
+      const auto child = read_start_tag(child_empty);
+      e->add(child);
+      open.push_back(child);
+      start_element(child);
+      if (child_empty) end_element();
+    }
+  }
+
+  closed = current = end_element();
+}
+
+//--------------------------------------------------------------------------
+// Add an element path to read whole
+void Reader::add_path(const string& path)
+{
+  vector<string> segments;
+  string::size_type p = 0;
+  while (p != string::npos)
+  {
+    const auto slash = path.find('/', p);
+    const auto segment = path.substr(p, slash == string::npos
+                                        ? string::npos : slash-p);
+    if (!segment.empty()) segments.push_back(segment);
+    p = (slash == string::npos) ? slash : slash+1;
+  }
+  paths.push_back(segments);
+}
+
+//--------------------------------------------------------------------------
+// Read the next event
+Reader::Event Reader::next()
+{
+  // Finished with the last ended element
+  if (closed) delete closed;
+  closed = current = 0;
+
+  if (closing)
+  {
+    closing = false;
+    closed = current = end_element();
+    return event = END;
+  }
+
+  if (open.empty())
+  {
+    if (started) return event = END_OF_DOCUMENT;
+
+    // Skip optional Byte Order Mark
+    if (peek()=='\xEF' && peek(1)=='\xBB' && peek(2)=='\xBF') pos += 3;
+
+    // Skip prolog, comments and DOCTYPE to the root
+    for(;;)
+    {
+      skip_ws();
+      const auto c = peek();
+      if (!c) parser.fatal("Empty or unreadable document");
+      if (c!='<') parser.fatal("Non-tag data at start of document");
+
+      const auto c1 = peek(1);
+      if (c1=='!' || c1=='?')
+        skip_markup();
+      else if (parser.is_name_start(c1))
+        break;
+      else
+        parser.fatal("Illegal tag");
+    }
+    started = true;
+  }
+  else
+  {
+    if (read_text()) return event = TEXT;
+
+    if (peek(1)=='/')
+    {
+      read_end_tag();
+      closed = current = end_element();
+      return event = END;
+    }
+  }
+
+  bool empty;
+  const auto e = read_start_tag(empty);
+  open.push_back(e);
+  start_element(e);
+  current = e;
+
+  if (matches_path())
+  {
+    read_subtree(empty);
+    return event = ELEMENT;
+  }
+
+  closing = empty;
+  return event = START;
+}
+
+//--------------------------------------------------------------------------
+// Get the name of the current element
+const string& Reader::get_name() const
+{
+  static const string none;
+  return current ? current->name : none;
+}
+
+//--------------------------------------------------------------------------
+// Get the attributes of the current element
+const map<string, string>& Reader::get_attrs() const
+{
+  return get_element().attrs;
+}
+
+//--------------------------------------------------------------------------
+// Get an attribute of the current element
+string Reader::get_attr(const string& name, const string& def) const
+{
+  return get_element().get_attr(name, def);
+}
+
+//--------------------------------------------------------------------------
+// Get the current element
+Element& Reader::get_element() const
+{
+  return current ? *current : Element::none;
+}
+
+//--------------------------------------------------------------------------
+// Read the rest of the document, calling the callback with each subtree
+void Reader::for_each_element(const string& path,
+                              const function<void(Element&)>& callback)
+{
+  add_path(path);
+  while (next() != END_OF_DOCUMENT)
+    if (event == ELEMENT) callback(*current);
+}
+
+}} // namespaces
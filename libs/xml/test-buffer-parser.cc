@@ -0,0 +1,371 @@
+//==========================================================================
+// ObTools::XML: test-buffer-parser.cc
+//
+// Test harness for the buffer fast path of the XML parser, checking it
+// against the stream parser, and a benchmark on the XMI and SOAP test
+// documents
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "ot-xml.h"
+#include <gtest/gtest.h>
+#include <sstream>
+#include <fstream>
+#include <random>
+#include <chrono>
+#include <functional>
+
+// Count heap allocations
+namespace {
+size_t heap_allocations = 0;
+}
+
+// Neither is inlined, where the compiler sees free() of a new'd pointer
+__attribute__((noinline)) void *operator new(size_t size)
+{
+  heap_allocations++;
+  auto p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+  operator delete(p);
+}
+
+namespace {
+
+using namespace std;
+using namespace ObTools;
+
+const int all_flags = XML::PARSER_OPTIMISE_CONTENT
+  | XML::PARSER_PRESERVE_WHITESPACE | XML::PARSER_FIX_NAMESPACES
+  | XML::PARSER_BE_LENIENT;
+
+// Dump an element with everything the parser sets
+void dump(const XML::Element& e, ostream& out)
+{
+  out << '[' << e.name << '@' << e.line << '|' << e.content;
+  for(const auto& p: e.attrs) out << ' ' << p.first << '=' << p.second;
+  for(const auto c: e.children)
+  {
+    if (c->parent != &e) out << "(bad parent)";
+    dump(*c, out);
+  }
+  out << ']';
+}
+
+// Everything observable about a parse
+struct Result
+{
+  bool failed = false;
+  int errors = 0;
+  int line = 0;
+  string messages;
+  string tree;
+};
+
+Result parse(const string& doc, int flags, bool buffer)
+{
+  Result result;
+  ostringstream err;
+  XML::Parser parser(err, flags & ~XML::PARSER_FIX_NAMESPACES);
+  if (flags & XML::PARSER_FIX_NAMESPACES)
+  {
+    parser.fix_namespace("u", "n");
+    parser.fix_namespace("v", "");
+  }
+
+  try
+  {
+    if (buffer)
+      parser.read_from(doc.data(), doc.size());
+    else
+    {
+      istringstream iss(doc);
+      parser.read_from(iss);
+    }
+  }
+  catch (const XML::ParseFailed&)
+  {
+    result.failed = true;
+  }
+
+  result.errors = parser.errors;
+  result.line = parser.line;
+  result.messages = err.str();
+  ostringstream tree;
+  dump(parser.get_root(), tree);
+  result.tree = tree.str();
+  return result;
+}
+
+void expect_same(const string& doc, int flags)
+{
+  const auto s = parse(doc, flags, false);
+  const auto b = parse(doc, flags, true);
+  EXPECT_EQ(s.failed, b.failed) << flags << ": " << doc;
+  EXPECT_EQ(s.errors, b.errors) << flags << ": " << doc;
+  EXPECT_EQ(s.line, b.line) << flags << ": " << doc;
+  EXPECT_EQ(s.messages, b.messages) << flags << ": " << doc;
+  EXPECT_EQ(s.tree, b.tree) << flags << ": " << doc;
+}
+
+string read_file(const string& path)
+{
+  ifstream in(path, ios::binary);
+  ostringstream oss;
+  oss << in.rdbuf();
+  return oss.str();
+}
+
+const vector<string> xmi_files{
+  "../xmi/tests/enum.xmi", "../xmi/tests/jeckle.de.1-0-rose.xmi",
+  "../xmi/tests/jeckle.de.1-0.xmi", "../xmi/tests/jeckle.de.1-1.xmi",
+  "../xmi/tests/omg.1-4.xmi", "../xmi/tests/prim.xmi",
+  "../xmi/tests/test1-2.xmi", "../xmi/tests/touchline.xmi"
+};
+
+const vector<string> soap_files{
+  "../soap/tests/place.soap.xml", "../soap/tests/soap1-2.xml"
+};
+
+const vector<string> xml_files{
+  "tests/books.xml", "tests/config.xml", "tests/expand.xml",
+  "tests/simple.xml"
+};
+
+//--------------------------------------------------------------------------
+// Tests
+TEST(BufferParserTest, TestBasicParse)
+{
+  const string xml = "<?xml version='1.0'?>\n<root a='1' b=\"&lt;2&gt;\">"
+    "\n  Some &amp; text<!-- comment -->\n  more\n  <child/>\n</root>";
+  XML::Parser parser;
+  ASSERT_NO_THROW(parser.read_from(xml.data(), xml.size()));
+  const auto& root = parser.get_root();
+  EXPECT_EQ("root", root.name);
+  EXPECT_EQ(2, root.line);
+  EXPECT_EQ("1", root["a"]);
+  EXPECT_EQ("<2>", root["b"]);
+  ASSERT_EQ(2u, root.children.size());
+  EXPECT_EQ("Some & text more", root.children.front()->content);
+  EXPECT_EQ("child", root.children.back()->name);
+  EXPECT_EQ(6, parser.line);
+}
+
+TEST(BufferParserTest, TestContentOptimisedWithoutSubElement)
+{
+  const string xml = "<root><a>Hello<!-- x --> world</a><b>&#65;</b></root>";
+  XML::Parser parser;
+  parser.read_from(xml.data(), xml.size());
+  const auto& root = parser.get_root();
+  EXPECT_EQ("Hello world", root.get_child("a").content);
+  EXPECT_TRUE(root.get_child("a").children.empty());
+  EXPECT_EQ("A", root.get_child("b").content);
+}
+
+TEST(BufferParserTest, TestDecimalCharRefAfterHex)
+{
+  // Used to be read as hex by the stream parser
+  const string xml = "<root>&#x41;&#66;</root>";
+  for(const auto buffer: {false, true})
+  {
+    const auto r = parse(xml, XML::PARSER_OPTIMISE_CONTENT, buffer);
+    EXPECT_EQ("[root@1|AB]", r.tree);
+  }
+}
+
+TEST(BufferParserTest, TestNamespacesFixedOnlyInScope)
+{
+  const string xml = "<a:root xmlns:a='u' a:x='1'><b xmlns='v' a:y='2'>"
+    "<a:c xmlns:a='w' a:z='3'/></b><a:d/></a:root>";
+  XML::Parser parser;
+  parser.fix_namespace("u", "n");
+  parser.fix_namespace("v", "");
+  parser.read_from(xml);
+  ostringstream tree;
+  dump(parser.get_root(), tree);
+  EXPECT_EQ("[n:root@1| n:x=1 xmlns:a=u[b@1| n:y=2 xmlns=v"
+            "[a:c@1| a:z=3 xmlns:a=w]][n:d@1|]]", tree.str());
+}
+
+TEST(BufferParserTest, TestErrorsSameAsStream)
+{
+  const vector<string> docs{
+    "", "   ", "\xef\xbb\xbf<a/>", "\xef\xbf\xbb<a/>", "\xef\xbb", "\xef",
+    "text", "<a>", "<a>text", "<a></b>", "<a></a >", "<a></a x>", "</a>",
+    "<a b='1' b='2'/>", "<a b/>", "<a b=1/>", "<a b='1/>", "<a/ >",
+    "<a><!- x --></a>", "<a><!-- x ---></a>", "<a><!-- x", "<a><!-",
+    "<a><!DOCTYPE x>", "<a><? x ?></a>", "<a><? x", "<a>&#;</a>",
+    "<a>&#x;</a>", "<a>&#65</a>", "<a>&#99999999999;</a>", "<a>&#-65;</a>",
+    "<a>&#x0x41;</a>", "<a>&bogus;</a>", "<a>& b</a>", "<a>&</a>",
+    "<a>&amp</a>", "<a>a < b</a>", "<a>a <</a>", "<", "<a", "<a ",
+    "<a>\n<b>\n</c>", "<a>x\0y</a>"s, "<a b='x\0'/>"s, "<a\0/>"s,
+    "<a>x</a>trailing", "<!-- c --><a/>", "<?pi\n?>\n<a/>",
+    "<a>\r\n\t x \n</a>", "<a>&#xe9;&#x20ac;&#169;</a>", "<a> </a>",
+    "<a>x<!-- c --> <?p?> y</a>", "<a><!-- c -->x</a>", "<a>x<b/>y</a>"
+  };
+  for(const auto& doc: docs)
+    for(auto flags=0; flags<=all_flags; flags++)
+      expect_same(doc, flags);
+}
+
+TEST(BufferParserTest, TestRealDocumentsSameAsStream)
+{
+  for(const auto files: {&xmi_files, &soap_files, &xml_files})
+  {
+    for(const auto& file: *files)
+    {
+      const auto doc = read_file(file);
+      ASSERT_FALSE(doc.empty()) << file;
+      for(auto flags=0; flags<=all_flags; flags++)
+        expect_same(doc, flags);
+    }
+  }
+}
+
+TEST(BufferParserTest, TestRandomDocumentsSameAsStream)
+{
+  mt19937 rng(42);
+  const vector<string> names{"a", "b:c", "n:x", "d-e.f", "_g"};
+  const vector<string> attrs{
+    " x='1'", " a:y=\"&amp;2\"", " xmlns:a='u'", " xmlns='v'",
+    " xmlns:b='w'", " z = 'a\nb'", " q=\"it's\""
+  };
+  const vector<string> texts{
+    "text", " ", "\n", "\t\r\n", "&lt;", "&#65;", "&#x41;", "&#233;",
+    "<!-- c\n-->", "<?pi?>", "<![CDATA[x]]>", "two words", "&apos;"
+  };
+  const vector<string> junk{
+    "<", ">", "&", "'", "\"", "=", "/", "\n", "-->", "<!--", "?>", "&#",
+    "</", string(1, '\0'), "\xef\xbb\xbf", ";", " ", "x"
+  };
+
+  // Well-formed documents, then broken ones
+  function<string(int)> element = [&](int depth)
+  {
+    const auto& name = names[rng() % names.size()];
+    string s = "<" + name;
+    for(auto n = rng() % 3; n; n--) s += attrs[rng() % attrs.size()];
+    if (!depth || !(rng() % 4)) return s + (rng() % 2 ? "/>" : " />");
+    s += ">";
+    for(auto n = rng() % 4; n; n--)
+      s += (rng() % 2) ? element(depth-1) : texts[rng() % texts.size()];
+    return s + "</" + name + (rng() % 4 ? ">" : "\n>");
+  };
+
+  for(auto i=0; i<3000; i++)
+  {
+    auto doc = (rng() % 2 ? "<?xml version='1.0'?>\n" : "") + element(4);
+    const auto good = doc;
+    if (i % 2)
+    {
+      for(auto n = 1 + rng() % 3; n; n--)
+      {
+        const auto pos = rng() % (doc.size() + 1);
+        switch (rng() % 3)
+        {
+          case 0: doc.insert(pos, junk[rng() % junk.size()]); break;
+          case 1: doc.erase(pos, 1 + rng() % 3); break;
+          case 2: doc.resize(pos); break;
+        }
+      }
+    }
+    const auto flags = static_cast<int>(rng() % (all_flags+1));
+    expect_same(doc, flags);
+    if (::testing::Test::HasFailure())
+    {
+      cout << "Failed on: " << doc << " (from " << good << ")\n";
+      return;
+    }
+  }
+}
+
+TEST(BufferParserTest, BenchmarkXMIAndSOAP)
+{
+  if (!getenv("OBTOOLS_BENCHMARK"))
+    GTEST_SKIP() << "OBTOOLS_BENCHMARK not set";
+
+  const struct
+  {
+    string title;
+    const vector<string> *files;
+    vector<pair<string, string>> namespaces;
+    int iterations;
+  } sets[] =
+  {
+    { "XMI", &xmi_files, {{"org.omg.xmi.namespace.UML", "UML"}}, 200 },
+    { "SOAP", &soap_files,
+      {{"http://www.w3.org/2003/05/soap-envelope", "env"}}, 20000 }
+  };
+
+  for(const auto& set: sets)
+  {
+    vector<string> docs;
+    auto bytes = 0.0;
+    for(const auto& file: *set.files)
+    {
+      docs.push_back(read_file(file));
+      bytes += docs.back().size();
+    }
+
+    auto run = [&](bool buffer, size_t& allocations)
+    {
+      const auto base = heap_allocations;
+      const auto start = chrono::steady_clock::now();
+      for(auto i=0; i<set.iterations; i++)
+      {
+        for(const auto& doc: docs)
+        {
+          XML::Parser parser;
+          for(const auto& ns: set.namespaces)
+            parser.fix_namespace(ns.first, ns.second);
+          if (buffer)
+            parser.read_from(doc.data(), doc.size());
+          else
+          {
+            istringstream iss(doc);
+            parser.read_from(iss);
+          }
+          EXPECT_EQ(0, parser.errors);
+        }
+      }
+      const chrono::duration<double> time =
+        chrono::steady_clock::now() - start;
+      allocations = (heap_allocations - base) / set.iterations;
+      return bytes * set.iterations / time.count() / 1e6;
+    };
+
+    size_t stream_allocations, buffer_allocations;
+    const auto stream_rate = run(false, stream_allocations);
+    const auto buffer_rate = run(true, buffer_allocations);
+    EXPECT_LT(buffer_allocations, stream_allocations);
+
+    cout << set.title << " (" << docs.size() << " documents, "
+         << static_cast<int>(bytes) << " bytes): stream "
+         << static_cast<int>(stream_rate) << "MB/s, "
+         << stream_allocations << " allocations; buffer "
+         << static_cast<int>(buffer_rate) << "MB/s, "
+         << buffer_allocations << " allocations (x"
+         << buffer_rate / stream_rate << " faster)\n";
+  }
+}
+
+} // anonymous namespace
+
+//--------------------------------------------------------------------------
+// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
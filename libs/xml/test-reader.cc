@@ -0,0 +1,445 @@
+//==========================================================================
+// ObTools::XML: test-reader.cc
+//
+// Test harness for the XML pull reader, checking subtrees read whole
+// against the parser, and a benchmark streaming a large document
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "ot-xml.h"
+#include <gtest/gtest.h>
+#include <sstream>
+#include <fstream>
+#include <random>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+using namespace std;
+using namespace ObTools;
+
+const int all_flags = XML::PARSER_OPTIMISE_CONTENT
+  | XML::PARSER_PRESERVE_WHITESPACE | XML::PARSER_FIX_NAMESPACES
+  | XML::PARSER_BE_LENIENT;
+
+// Channel reader giving at most one byte at a time, to test refills
+class TrickleReader: public Channel::Reader
+{
+  const string& data;
+
+public:
+  TrickleReader(const string& _data): data(_data) {}
+
+  size_t basic_read(void *buf, size_t count) override
+  {
+    if (offset >= data.size() || !count) return 0;
+    if (buf) memcpy(buf, data.data()+offset, 1);
+    offset++;
+    return 1;
+  }
+};
+
+// Channel reader which fails
+class FailingReader: public Channel::Reader
+{
+public:
+  size_t basic_read(void *, size_t) override
+  { throw Channel::Error(1, "broken"); }
+};
+
+// Dump an element without line numbers, which the reader counts in a few
+// places the parser doesn't
+void dump(const XML::Element& e, ostream& out)
+{
+  out << '[' << e.name << '|' << e.content;
+  for(const auto& p: e.attrs) out << ' ' << p.first << '=' << p.second;
+  for(const auto c: e.children)
+  {
+    if (c->parent != &e) out << "(bad parent)";
+    dump(*c, out);
+  }
+  out << ']';
+}
+
+void set_namespaces(int flags, function<void(const string&,
+                                             const string&)> fix)
+{
+  if (flags & XML::PARSER_FIX_NAMESPACES)
+  {
+    fix("u", "n");
+    fix("v", "");
+  }
+}
+
+// Parse with the parser - returns tree, or empty if failed
+string parse(const string& doc, int flags)
+{
+  ostringstream err;
+  XML::Parser parser(err, flags & ~XML::PARSER_FIX_NAMESPACES);
+  set_namespaces(flags, [&](const string& n, const string& p)
+                 { parser.fix_namespace(n, p); });
+  try
+  {
+    parser.read_from(doc);
+  }
+  catch (const XML::ParseFailed&)
+  {
+    return "";
+  }
+  ostringstream tree;
+  dump(parser.get_root(), tree);
+  return tree.str();
+}
+
+// Read the root whole with the reader, trickled or all at once
+string read_whole(const string& doc, int flags, bool trickle)
+{
+  ostringstream err;
+  istringstream iss(doc);
+  TrickleReader tr(doc);
+  unique_ptr<XML::Reader> reader(
+    trickle ? new XML::Reader(tr, err, flags & ~XML::PARSER_FIX_NAMESPACES)
+            : new XML::Reader(iss, err, flags & ~XML::PARSER_FIX_NAMESPACES));
+  set_namespaces(flags, [&](const string& n, const string& p)
+                 { reader->fix_namespace(n, p); });
+  ostringstream tree;
+  try
+  {
+    reader->for_each_element("/*", [&](XML::Element& e) { dump(e, tree); });
+  }
+  catch (const XML::ParseFailed&)
+  {
+    return "";
+  }
+  return tree.str();
+}
+
+// Read as events, rebuilding the tree from them
+string read_events(const string& doc, int flags)
+{
+  ostringstream err;
+  istringstream iss(doc);
+  XML::Reader reader(iss, err, flags & ~XML::PARSER_FIX_NAMESPACES);
+  set_namespaces(flags, [&](const string& n, const string& p)
+                 { reader.fix_namespace(n, p); });
+  ostringstream tree;
+  try
+  {
+    for(;;)
+    {
+      switch (reader.next())
+      {
+        case XML::Reader::START:
+          tree << '[' << reader.get_name() << '|';
+          for(const auto& p: reader.get_attrs())
+            tree << ' ' << p.first << '=' << p.second;
+          break;
+
+        case XML::Reader::TEXT:
+          tree << "[|" << reader.get_text() << ']';
+          break;
+
+        case XML::Reader::END:
+          tree << ']';
+          break;
+
+        case XML::Reader::END_OF_DOCUMENT:
+          return tree.str();
+
+        default:
+          ADD_FAILURE() << "Unexpected event";
+          return "";
+      }
+    }
+  }
+  catch (const XML::ParseFailed&)
+  {
+    return "";
+  }
+}
+
+void expect_same(const string& doc, int flags)
+{
+  const auto p = parse(doc, flags);
+  EXPECT_EQ(p, read_whole(doc, flags, false)) << flags << ": " << doc;
+  EXPECT_EQ(p, read_whole(doc, flags, true)) << flags << ": " << doc;
+
+  // Events don't see optimisation or merged text, so compare only with
+  // the parser's unoptimised tree
+  if (!(flags & XML::PARSER_OPTIMISE_CONTENT))
+  {
+    EXPECT_EQ(p, read_events(doc, flags)) << flags << ": " << doc;
+  }
+}
+
+string read_file(const string& path)
+{
+  ifstream in(path, ios::binary);
+  ostringstream oss;
+  oss << in.rdbuf();
+  return oss.str();
+}
+
+const vector<string> test_files{
+  "../xmi/tests/enum.xmi", "../xmi/tests/jeckle.de.1-0-rose.xmi",
+  "../xmi/tests/jeckle.de.1-0.xmi", "../xmi/tests/jeckle.de.1-1.xmi",
+  "../xmi/tests/omg.1-4.xmi", "../xmi/tests/prim.xmi",
+  "../xmi/tests/test1-2.xmi", "../xmi/tests/touchline.xmi",
+  "../soap/tests/place.soap.xml", "../soap/tests/soap1-2.xml",
+  "tests/books.xml", "tests/config.xml", "tests/expand.xml",
+  "tests/simple.xml"
+};
+
+//--------------------------------------------------------------------------
+// Tests
+TEST(ReaderTest, TestEvents)
+{
+  istringstream iss("<?xml version='1.0'?>\n<!-- c -->\n<root a='1'>\n"
+                    "  Some &amp; text<!-- c -->\n  more\n"
+                    "  <child b=\"&lt;2&gt;\"/>\n</root>\n");
+  XML::Reader reader(iss);
+  EXPECT_EQ(XML::Reader::NONE, reader.get_event());
+
+  ASSERT_EQ(XML::Reader::START, reader.next());
+  EXPECT_EQ("root", reader.get_name());
+  EXPECT_EQ("1", reader.get_attr("a"));
+  EXPECT_EQ(3, reader.get_element().line);
+  EXPECT_EQ(1u, reader.get_depth());
+
+  ASSERT_EQ(XML::Reader::TEXT, reader.next());
+  EXPECT_EQ("Some & text more", reader.get_text());
+  EXPECT_EQ("", reader.get_name());
+
+  ASSERT_EQ(XML::Reader::START, reader.next());
+  EXPECT_EQ("child", reader.get_name());
+  EXPECT_EQ("<2>", reader.get_attr("b"));
+  EXPECT_EQ(2u, reader.get_depth());
+
+  ASSERT_EQ(XML::Reader::END, reader.next());
+  EXPECT_EQ("child", reader.get_name());
+  EXPECT_EQ(1u, reader.get_depth());
+
+  ASSERT_EQ(XML::Reader::END, reader.next());
+  EXPECT_EQ("root", reader.get_name());
+  EXPECT_EQ(0u, reader.get_depth());
+
+  EXPECT_EQ(XML::Reader::END_OF_DOCUMENT, reader.next());
+  EXPECT_EQ(XML::Reader::END_OF_DOCUMENT, reader.next());
+  EXPECT_EQ(7, reader.get_line());
+  EXPECT_EQ(0, reader.get_errors());
+}
+
+TEST(ReaderTest, TestNamespacesFixedOnStart)
+{
+  istringstream iss("<a:root xmlns:a='u' a:x='1'><b xmlns='v' a:y='2'>"
+                    "<a:c xmlns:a='w' a:z='3'/></b><a:d/></a:root>");
+  XML::Reader reader(iss);
+  reader.fix_namespace("u", "n");
+  reader.fix_namespace("v", "");
+  vector<string> names;
+  while (reader.next() != XML::Reader::END_OF_DOCUMENT)
+    if (reader.get_event() == XML::Reader::START)
+      names.push_back(reader.get_name());
+  EXPECT_EQ(vector<string>({"n:root", "b", "a:c", "n:d"}), names);
+}
+
+TEST(ReaderTest, TestSubtreesAtPath)
+{
+  const string xml = "<XMI><XMI.header><x/></XMI.header><XMI.content>"
+    "<Class name='a'><f>1</f></Class><!-- c --><Package name='b'/>"
+    "<Class name='c'/></XMI.content></XMI>";
+  istringstream iss(xml);
+  XML::Reader reader(iss);
+  reader.add_path("/XMI/XMI.content/*");
+  reader.add_path("/XMI/XMI.header");
+
+  vector<string> events;
+  while (reader.next() != XML::Reader::END_OF_DOCUMENT)
+  {
+    ostringstream oss;
+    oss << reader.get_event() << ':' << reader.get_name();
+    if (reader.get_event() == XML::Reader::ELEMENT)
+    {
+      oss << '=';
+      dump(reader.get_element(), oss);
+    }
+    events.push_back(oss.str());
+  }
+
+  EXPECT_EQ(vector<string>({"2:XMI", "5:XMI.header=[XMI.header|[x|]]",
+                            "2:XMI.content", "5:Class=[Class| name=a[f|1]]",
+                            "5:Package=[Package| name=b]",
+                            "5:Class=[Class| name=c]", "4:XMI.content",
+                            "4:XMI"}), events);
+}
+
+TEST(ReaderTest, TestForEachElementFromChannel)
+{
+  const string xml = "<feed><item id='1'>one</item><other><item id='x'/>"
+    "</other><item id='2'>two</item></feed>";
+  TrickleReader tr(xml);
+  XML::Reader reader(tr);
+  vector<string> items;
+  reader.for_each_element("feed/item", [&](XML::Element& e)
+                          { items.push_back(e["id"] + "=" + e.content); });
+  EXPECT_EQ(vector<string>({"1=one", "2=two"}), items);
+}
+
+TEST(ReaderTest, TestErrorsThrow)
+{
+  const vector<string> docs{
+    "", "   ", "text", "<a>", "<a>text", "<a></b>", "</a>", "<a b/>",
+    "<a b='1' b='2'/>", "<a b=1/>", "<a b='1/>", "<a/ >", "<a>&#;</a>",
+    "<a>&bogus;</a>", "<a>& b</a>", "<a>a < b</a>", "<", "<a", "<a><!-- x"
+  };
+  for(const auto& doc: docs)
+  {
+    istringstream iss(doc);
+    ostringstream err;
+    XML::Reader reader(iss, err);
+    EXPECT_THROW(while (reader.next() != XML::Reader::END_OF_DOCUMENT);,
+                 XML::ParseFailed) << doc;
+    EXPECT_FALSE(err.str().empty()) << doc;
+  }
+
+  FailingReader fr;
+  ostringstream err;
+  XML::Reader reader(fr, err);
+  EXPECT_THROW(reader.next(), XML::ParseFailed);
+  EXPECT_NE(string::npos, err.str().find("Read failed: broken"));
+}
+
+TEST(ReaderTest, TestDocumentsSameAsParser)
+{
+  const vector<string> docs{
+    "\xef\xbb\xbf<a/>", "<a></a >", "<a><!DOCTYPE x></a>", "<a><? x ?></a>",
+    "<a>&#65;&#x41;&#xe9;&#x20ac;&#169;</a>", "<a>x</a>trailing",
+    "<!-- c --><a/>", "<?pi\n?>\n<a/>", "<a>\r\n\t x \n</a>", "<a> </a>",
+    "<a>x<!-- c --> <?p?> y</a>", "<a><!-- c -->x</a>", "<a>x<b/>y</a>",
+    "<a>x <![CDATA[y]]> z</a>", "<a:r xmlns:a='u' a:x='1'><b xmlns='v'>"
+    "<a:c xmlns:a='w' a:z='3'/>t</b><a:d/></a:r>"
+  };
+  for(const auto& doc: docs)
+    for(auto flags=0; flags<=all_flags; flags++)
+      expect_same(doc, flags);
+
+  // Lenient '<' kept as text
+  expect_same("<a>a < b</a>", XML::PARSER_BE_LENIENT);
+
+  for(const auto& file: test_files)
+  {
+    const auto doc = read_file(file);
+    ASSERT_FALSE(doc.empty()) << file;
+    for(auto flags=0; flags<=all_flags; flags++)
+      expect_same(doc, flags);
+  }
+}
+
+TEST(ReaderTest, TestRandomDocumentsSameAsParser)
+{
+  mt19937 rng(42);
+  const vector<string> names{"a", "b:c", "n:x", "d-e.f", "_g"};
+  const vector<string> attrs{
+    " x='1'", " a:y=\"&amp;2\"", " xmlns:a='u'", " xmlns='v'",
+    " xmlns:b='w'", " z = 'a\nb'", " q=\"it's\""
+  };
+  const vector<string> texts{
+    "text", " ", "\n", "\t\r\n", "&lt;", "&#65;", "&#x41;", "&#233;",
+    "<!-- c\n-->", "<?pi?>", "<![CDATA[x]]>", "two words", "&apos;"
+  };
+
+  function<string(int)> element = [&](int depth)
+  {
+    const auto& name = names[rng() % names.size()];
+    string s = "<" + name;
+    for(auto n = rng() % 3; n; n--) s += attrs[rng() % attrs.size()];
+    if (!depth || !(rng() % 4)) return s + (rng() % 2 ? "/>" : " />");
+    s += ">";
+    for(auto n = rng() % 4; n; n--)
+      s += (rng() % 2) ? element(depth-1) : texts[rng() % texts.size()];
+    return s + "</" + name + (rng() % 4 ? ">" : "\n>");
+  };
+
+  for(auto i=0; i<1000; i++)
+  {
+    const auto doc = (rng() % 2 ? "<?xml version='1.0'?>\n" : "")
+      + element(4);
+    const auto flags = static_cast<int>(rng() % (all_flags+1));
+    expect_same(doc, flags);
+    if (::testing::Test::HasFailure())
+    {
+      cout << "Failed on: " << doc << endl;
+      return;
+    }
+  }
+}
+
+// Stream generating a large document on the fly
+class FeedBuf: public streambuf
+{
+  int items;
+  int next_item = 0;
+  string chunk;
+
+  int_type underflow() override
+  {
+    if (next_item > items) return traits_type::eof();
+    chunk.clear();
+    if (!next_item) chunk = "<?xml version='1.0'?>\n<feed>\n";
+    for(auto i=0; i<100 && next_item<items; i++, next_item++)
+      chunk += "  <item id='" + to_string(next_item) + "'><name>Item "
+        + to_string(next_item) + "</name><value>&#65;" + string(40, 'x')
+        + "</value></item>\n";
+    if (next_item == items)
+    {
+      chunk += "</feed>\n";
+      next_item++;
+    }
+    setg(&chunk[0], &chunk[0], &chunk[0]+chunk.size());
+    return traits_type::to_int_type(chunk[0]);
+  }
+
+public:
+  FeedBuf(int _items): items(_items) {}
+};
+
+TEST(ReaderTest, BenchmarkLargeFeed)
+{
+  if (!getenv("OBTOOLS_BENCHMARK"))
+    GTEST_SKIP() << "OBTOOLS_BENCHMARK not set";
+
+  const auto items = 500000;
+  FeedBuf buf(items);
+  istream in(&buf);
+  XML::Reader reader(in);
+
+  auto count = 0;
+  size_t bytes = 0;
+  const auto start = chrono::steady_clock::now();
+  reader.for_each_element("/feed/item", [&](XML::Element& e)
+  {
+    ASSERT_EQ(to_string(count), e["id"]);
+    ASSERT_EQ("A" + string(40, 'x'), e.get_child("value").content);
+    bytes += e.to_string().size();
+    count++;
+  });
+  const chrono::duration<double> time = chrono::steady_clock::now() - start;
+
+  EXPECT_EQ(items, count);
+  EXPECT_EQ(0u, reader.get_depth());
+  cout << "Streamed " << count << " items (" << bytes / 1000000
+       << "MB as text) in " << time.count() << "s, holding one at a time\n";
+}
+
+} // anonymous namespace
+
+//--------------------------------------------------------------------------
+// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
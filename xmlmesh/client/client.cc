@@ -20,8 +20,7 @@ namespace ObTools { namespace XMLMesh {
 // Whether message queued
 bool Client::send(const Message& msg)
 {
-  string data = msg.get_text();  // Convert to <message> string
-  return transport.send(data);
+  return transport.send_message(msg);
 }
 
 //--------------------------------------------------------------------------
@@ -59,15 +58,13 @@ bool Client::wait(Message& msg)
     return true;
   }
 
-  string data;
-  if (!transport.wait(data))
+  if (!transport.wait_message(msg))
   {
     log.summary << "Transport restarted - resubscribing\n";
     resubscribe();
     return false;
   }
 
-  msg = Message(data);  // Construct message from XML <message> data
   return true;
 }
 
@@ -109,11 +106,8 @@ bool Client::request(const Message& req, Message& response)
   {
     // Block waiting for a message (note, don't use wait(), otherwise
     // we end up going in circles!)
-    string data;
-    if (transport.wait(data))
+    if (transport.wait_message(response))
     {
-      response = Message(data);
-
       // Make sure the ref's match
       // Note:  This is the simplest synchronous send/receive;  assumes
       // no interleaving of responses
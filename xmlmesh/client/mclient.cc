@@ -40,12 +40,9 @@ class DispatchThread: public MT::Thread
   {
     for(;;)
     {
-      string data;
-      if (transport.wait(data))
-      {
-        Message msg(data);  // Construct message from XML <message> data
+      Message msg;
+      if (transport.wait_message(msg))
         client.handle(msg, log);
-      }
       else
       {
         // Stop on shutdown
@@ -224,11 +221,9 @@ retry:
     // Loop dispatching message until we get a response to this
     for(;;)
     {
-      string data;
-      if (transport.wait(data))
+      Message msg;
+      if (transport.wait_message(msg))
       {
-        Message msg(data);  // Construct message from XML <message> data
-
         // Check ref (if any) to see if it's ours
         string ref = msg.get_ref();
         if (ref == id)
@@ -236,7 +231,7 @@ retry:
           // Check it for OK
           if (msg.get_subject() == "xmlmesh.ok") break;
 
-          log.error << "Error response to resubscribe:\n" << data << endl;
+          log.error << "Error response to resubscribe:\n" << msg << endl;
         }
         else
         {
@@ -289,8 +284,7 @@ void MultiClient::start()
 // Whether message queued
 bool MultiClient::send(const Message& msg)
 {
-  string data = msg.get_text();  // Convert to <message> string
-  return transport.send(data);
+  return transport.send_message(msg);
 }
 
 //--------------------------------------------------------------------------
@@ -20,25 +20,38 @@ using namespace std;
 
 //==========================================================================
 // OTMP Client Transport
+// Messages are sent as <message> text offering the binary form, if
+// requested, until the server replies in binary
 class OTMPClientTransport: public ClientTransport
 {
 private:
   OTMP::Client otmp;
+  const OTMP::Encoding encoding;  // Requested
+  atomic<bool> binary{false};     // Whether the server has agreed
+
+  Tube::flags_t get_flags() const;
 
 public:
   //------------------------------------------------------------------------
   // Constructor - take server address
-  OTMPClientTransport(Net::EndPoint server, bool fail_on_no_conn):
-    otmp(server, fail_on_no_conn)
+  OTMPClientTransport(Net::EndPoint server, bool fail_on_no_conn,
+                      OTMP::Encoding _encoding = OTMP::Encoding::xml):
+    otmp(server, fail_on_no_conn), encoding(_encoding)
   {
     otmp.start();
   }
 
+  //------------------------------------------------------------------------
+  // Check whether the binary form is in use
+  bool is_binary() const { return binary; }
+
   // Implementations of ClientTransport virtuals (q.v. ot-xmlmesh.h)
   bool is_connected() { return otmp.is_connected(); }
   bool send(const string& data);
+  bool send_message(const Message& msg);
   bool poll();
   bool wait(string& data);
+  bool wait_message(Message& msg);
   void shutdown();
 };
 
@@ -52,8 +65,9 @@ private:
 public:
   //------------------------------------------------------------------------
   // Constructor - take server address
-  OTMPClient(Net::EndPoint server):
-    Client(transport), transport(server, false) {}
+  OTMPClient(Net::EndPoint server,
+             OTMP::Encoding encoding = OTMP::Encoding::xml):
+    Client(transport), transport(server, false, encoding) {}
 };
 
 //==========================================================================
@@ -69,15 +83,22 @@ public:
   // port=0 means use default port for protocol
   // NB: MultiClient is constructed before transport whatever we say
   // - therefore leave starting it to constructor body
-  OTMPMultiClient(Net::EndPoint server, bool fail_on_no_conn = false):
-    MultiClient(transport), transport(server, fail_on_no_conn) { start(); }
+  OTMPMultiClient(Net::EndPoint server, bool fail_on_no_conn = false,
+                  OTMP::Encoding encoding = OTMP::Encoding::xml):
+    MultiClient(transport), transport(server, fail_on_no_conn, encoding)
+  { start(); }
 
   // Constructor specifying workers
   OTMPMultiClient(Net::EndPoint server,
                   int min_spare_workers, int max_workers,
-                  bool fail_on_no_conn = false):
+                  bool fail_on_no_conn = false,
+                  OTMP::Encoding encoding = OTMP::Encoding::xml):
     MultiClient(transport, min_spare_workers, max_workers),
-    transport(server, fail_on_no_conn) { start(); }
+    transport(server, fail_on_no_conn, encoding) { start(); }
+
+  //------------------------------------------------------------------------
+  // Check whether the binary form is in use
+  bool is_binary() const { return transport.is_binary(); }
 
   //------------------------------------------------------------------------
   // Destructor - force shutdown early so we can shutdown MultiClient dispatch
@@ -110,6 +131,11 @@ public:
 
     int port = xpath.get_value_int("server/@port", OTMP::DEFAULT_PORT);
 
+    // Optional binary encoding - 'binary' or 'cbor'
+    const auto enc = xpath.get_value("server/@encoding", "xml");
+    const auto encoding = (enc == "binary") ? OTMP::Encoding::binary
+      : ((enc == "cbor") ? OTMP::Encoding::binary_cbor : OTMP::Encoding::xml);
+
     Net::IPAddress addr(host);
     if (!addr)
     {
@@ -121,7 +147,7 @@ public:
     log.summary << "Connecting to XMLMesh at " << ep << endl;
 
     // Start mesh client
-    client = new OTMPMultiClient(ep, fail_on_no_conn);
+    client = new OTMPMultiClient(ep, fail_on_no_conn, encoding);
 
     // Register our transport into server message broker
     broker.add_transport(new MessageTransport<CONTEXT>(context, *client));
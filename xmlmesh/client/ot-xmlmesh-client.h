@@ -47,6 +47,23 @@ public:
   // (and messages) may have been lost
   virtual bool wait(string& data) = 0;
 
+  //------------------------------------------------------------------------
+  // Send a whole message - by default as <message> text
+  // Override to use another form
+  virtual bool send_message(const Message& msg)
+  { return send(msg.get_text()); }
+
+  //------------------------------------------------------------------------
+  // Wait for a whole message - by default from <message> text
+  // Returns false as wait()
+  virtual bool wait_message(Message& msg)
+  {
+    string data;
+    if (!wait(data)) return false;
+    msg = Message(data);
+    return true;
+  }
+
   //------------------------------------------------------------------------
   // Clean shutdown (optional)
   virtual void shutdown() {};
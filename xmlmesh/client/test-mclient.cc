@@ -1,7 +1,8 @@
 //==========================================================================
 // ObTools::XMLMesh: test-mclient.cc
 //
-// Test harness for XMLMesh multi-threaded client
+// Test harness for XMLMesh multi-threaded client, including a benchmark
+// of message throughput over OTMP in each encoding
 //
 // Copyright (c) 2016 Paul Clark.  All rights reserved
 // This code comes with NO WARRANTY and is subject to licence agreement
@@ -9,11 +10,147 @@
 
 #include <gtest/gtest.h>
 #include "ot-xmlmesh-client-otmp.h"
+#include "ot-text.h"
 #include <unistd.h>
+#include <thread>
 
 using namespace std;
 using namespace ObTools;
 
+namespace {
+const auto test_port = 29177;
+
+//--------------------------------------------------------------------------
+// OTMP server thread
+class ServerThread: public MT::Thread
+{
+  XMLMesh::OTMP::Server& server;
+  void run() { server.run(); }
+
+public:
+  ServerThread(XMLMesh::OTMP::Server& s): server(s) { start(); }
+};
+
+//--------------------------------------------------------------------------
+// Echo thread - decodes messages as the XMLMesh server does, and sends
+// them back in the form the client offered
+class EchoThread: public MT::Thread
+{
+  XMLMesh::OTMP::Server& server;
+  XMLMesh::OTMP::ClientMessageQueue& receive_q;
+
+  void run()
+  {
+    for(;;)
+    {
+      const auto otmp_msg = receive_q.wait();
+      if (otmp_msg.action == Tube::ClientMessage::SHUTDOWN) return;
+      if (otmp_msg.action != Tube::ClientMessage::MESSAGE_DATA) continue;
+
+      XMLMesh::Message msg;
+      if (otmp_msg.msg.tag == XMLMesh::OTMP::TAG_BINARY)
+        msg.read_binary(otmp_msg.msg.data);
+      else
+        msg = XMLMesh::Message(otmp_msg.msg.data);
+      if (msg.get_subject().empty()) continue;
+
+      auto reply = (otmp_msg.msg.flags & XMLMesh::OTMP::FLAG_ACCEPT_BINARY)
+        ? XMLMesh::OTMP::ClientMessage(otmp_msg.client,
+                                       XMLMesh::OTMP::TAG_BINARY,
+                                       msg.to_binary(
+            (otmp_msg.msg.flags & XMLMesh::OTMP::FLAG_PREFER_CBOR)
+            ? XMLMesh::BinaryBody::cbor : XMLMesh::BinaryBody::xml))
+        : XMLMesh::OTMP::ClientMessage(otmp_msg.client, msg.get_text());
+      server.send(reply);
+    }
+  }
+
+public:
+  EchoThread(XMLMesh::OTMP::Server& s,
+             XMLMesh::OTMP::ClientMessageQueue& q):
+    server(s), receive_q(q) { start(); }
+};
+
+//--------------------------------------------------------------------------
+// Fixture running an echo server, shut down even if the test fails
+class EchoServerTest: public ::testing::Test
+{
+protected:
+  XMLMesh::OTMP::ClientMessageQueue receive_q;
+  XMLMesh::OTMP::Server server{receive_q, test_port};
+  ServerThread server_thread{server};
+  EchoThread echo_thread{server, receive_q};
+
+  void SetUp() override { server.allow(Net::MaskedAddress("localhost")); }
+
+  void TearDown() override { server.shutdown(); }
+};
+
+//--------------------------------------------------------------------------
+// Create a typical structured message
+XMLMesh::Message create_message(int n)
+{
+  auto body = new XML::Element("x:update");
+  body->set_attr_int("n", n);
+  for(auto i=0; i<10; i++)
+  {
+    auto& item = body->add("x:item", "value " + Text::itos(i));
+    item.set_attr("key", "k" + Text::itos(i));
+    item.set_attr_int("size", i*100);
+  }
+  return XMLMesh::Message("test.update", body);
+}
+}
+
+TEST_F(EchoServerTest, BenchmarkThroughputByEncoding)
+{
+  if (!getenv("OBTOOLS_BENCHMARK"))
+    GTEST_SKIP() << "OBTOOLS_BENCHMARK not set";
+
+  const Net::EndPoint address(Net::IPAddress("localhost"), test_port);
+  const auto n = 10000;
+  const auto window = 1000;
+  for(const auto encoding: {XMLMesh::OTMP::Encoding::xml,
+                            XMLMesh::OTMP::Encoding::binary,
+                            XMLMesh::OTMP::Encoding::binary_cbor})
+  {
+    XMLMesh::OTMPClientTransport transport(address, true, encoding);
+    for(auto i=0; i<100 && !transport.is_connected(); i++)
+      this_thread::sleep_for(chrono::milliseconds(10));
+    ASSERT_TRUE(transport.is_connected());
+
+    // First round trip negotiates - skipping the connection notification
+    ASSERT_TRUE(transport.send_message(create_message(-1)));
+    XMLMesh::Message reply;
+    while (!transport.wait_message(reply))
+      ;
+    EXPECT_EQ(-1, reply.get_body().get_attr_int("n"));
+    EXPECT_EQ(encoding != XMLMesh::OTMP::Encoding::xml,
+              transport.is_binary());
+
+    const auto start = chrono::steady_clock::now();
+    for(auto i=0; i<n; i+=window)
+    {
+      for(auto j=0; j<window; j++)
+        ASSERT_TRUE(transport.send_message(create_message(i+j)));
+      for(auto j=0; j<window; j++)
+      {
+        ASSERT_TRUE(transport.wait_message(reply));
+        ASSERT_EQ("test.update", reply.get_subject());
+        ASSERT_EQ(i+j, reply.get_body().get_attr_int("n"));
+      }
+    }
+    chrono::duration<double> time = chrono::steady_clock::now() - start;
+
+    ASSERT_EQ("value 9", reply.get_body().get_child("x:item", 9).content);
+    cout << (encoding == XMLMesh::OTMP::Encoding::xml ? "XML"
+             : encoding == XMLMesh::OTMP::Encoding::binary ? "Binary"
+             : "Binary+CBOR")
+         << ": " << static_cast<int>(n / time.count()) << " messages/sec\n";
+    transport.shutdown();
+  }
+}
+
 TEST(XMLMeshMultiClientTests, TestMultiClientExitsReasonablyQuickly)
 {
   const auto host = "localhost";
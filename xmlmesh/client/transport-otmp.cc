@@ -15,15 +15,45 @@
 
 namespace ObTools { namespace XMLMesh {
 
+//--------------------------------------------------------------------------
+// Get flags for messages, offering binary if we want it
+Tube::flags_t OTMPClientTransport::get_flags() const
+{
+  switch (encoding)
+  {
+    case OTMP::Encoding::xml:         return 0;
+    case OTMP::Encoding::binary:      return OTMP::FLAG_ACCEPT_BINARY;
+    case OTMP::Encoding::binary_cbor:
+      return OTMP::FLAG_ACCEPT_BINARY | OTMP::FLAG_PREFER_CBOR;
+  }
+  return 0;
+}
+
 //--------------------------------------------------------------------------
 // Send a message - can block if the queue is full
 // Whether message queued
 bool OTMPClientTransport::send(const string& data)
 {
-  OTMP::Message otmp_msg(data);
+  OTMP::Message otmp_msg(data, get_flags());
   return otmp.send(otmp_msg);
 }
 
+//--------------------------------------------------------------------------
+// Send a whole message, in binary if agreed
+bool OTMPClientTransport::send_message(const Message& msg)
+{
+  if (binary)
+  {
+    OTMP::BinaryMessage otmp_msg(msg.to_binary(
+                                 encoding == OTMP::Encoding::binary_cbor
+                                 ? BinaryBody::cbor : BinaryBody::xml),
+                               get_flags());
+    return otmp.send(otmp_msg);
+  }
+
+  return send(msg.get_text());
+}
+
 //--------------------------------------------------------------------------
 // Check for message available
 bool OTMPClientTransport::poll()
@@ -42,9 +72,38 @@ bool OTMPClientTransport::poll()
 // (and messages) may have been lost
 bool OTMPClientTransport::wait(string &data)
 {
-  OTMP::Message otmp_msg;
-  if (!otmp.wait(otmp_msg)) return false;
-  data = otmp_msg.data;
+  Message msg;
+  if (!wait_message(msg)) return false;
+  data = msg.get_text();
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Receive a whole message, in either form
+// Returns false as wait()
+bool OTMPClientTransport::wait_message(Message& msg)
+{
+  Tube::Message otmp_msg;
+  if (!otmp.wait(otmp_msg))
+  {
+    // May be a different server now
+    binary = false;
+    return false;
+  }
+
+  if (otmp_msg.tag == OTMP::TAG_BINARY)
+  {
+    // Server has accepted our offer
+    binary = (encoding != OTMP::Encoding::xml);
+    if (!msg.read_binary(otmp_msg.data))
+    {
+      Log::Error log;
+      log << "OTMP: Bad binary message received\n";
+      msg = Message();
+    }
+  }
+  else msg = Message(otmp_msg.data);
+
   return true;
 }
 
@@ -0,0 +1,218 @@
+//==========================================================================
+// ObTools::XMLMesh:Core: binary.cc
+//
+// Binary form of XMLMesh messages:
+//   version (1 byte, = 1)
+//   flags (1 byte):  1 = rsvp, 2 = CBOR body
+//   id, subject, ref (each 4-byte length then bytes, network order)
+//   body - the rest: <message> text, or the body element as CBOR
+//
+// CBOR bodies map elements to { "n": name, "a": { attributes },
+// "t": content, "c": [ children ] }, omitting empty parts, with text
+// children as plain strings.  They only carry a single body element and the
+// routing header, so are only used for messages with nothing else
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "ot-xmlmesh.h"
+#include "ot-json.h"
+#include "ot-log.h"
+#include <set>
+
+namespace ObTools { namespace XMLMesh {
+
+namespace
+{
+  const unsigned char binary_version = 1;
+  const unsigned char flag_rsvp = 1;
+  const unsigned char flag_cbor = 2;
+
+  // Check whether a message is no more than a single body element and the
+  // routing header, as create_soap() makes - so CBOR loses nothing
+  bool fits_cbor(const SOAP::Message& soap)
+  {
+    const auto& env = soap.get_envelope();
+    for(const auto& p: env.attrs)
+      if (!(p.first == "xmlns:env" && p.second == SOAP::NS_ENVELOPE_1_2)
+          && !(p.first == "xmlns:x" && p.second == xmlmesh_namespace))
+        return false;
+
+    if (env.children.size() != 2) return false;
+    const auto header = env.children.front();
+    const auto body = env.children.back();
+    if (header->name != "env:Header" || !header->attrs.empty()
+        || body->name != "env:Body" || !body->attrs.empty()
+        || header->children.size() != 1 || body->children.size() != 1
+        || body->children.front()->name.empty())
+      return false;
+
+    // Routing header with only the attributes we carry, and the standard
+    // role and flags
+    static const set<string> routing_attrs{"x:id", "x:subject", "x:rsvp",
+      "x:ref", "env:role", "env:mustUnderstand", "env:relay"};
+    const auto routing = header->children.front();
+    if (routing->name != "x:routing" || !routing->content.empty()
+        || !routing->children.empty())
+      return false;
+    for(const auto& p: routing->attrs)
+      if (!routing_attrs.count(p.first)) return false;
+    SOAP::Header h;
+    return soap.get_header("x:routing", h) && h.role == SOAP::Header::ROLE_NEXT
+      && h.must_understand && h.relay;
+  }
+
+  // Convert an element to a JSON value for CBOR
+  JSON::Value element_to_value(const XML::Element& e)
+  {
+    if (e.name.empty()) return JSON::Value(e.content);
+
+    JSON::Value v(JSON::Value::OBJECT);
+    v.set("n", e.name);
+    if (!e.attrs.empty())
+    {
+      auto& attrs = v.put("a", JSON::Value(JSON::Value::OBJECT));
+      for(const auto& p: e.attrs) attrs.set(p.first, p.second);
+    }
+    if (!e.content.empty()) v.set("t", e.content);
+    if (!e.children.empty())
+    {
+      auto& children = v.put("c", JSON::Value(JSON::Value::ARRAY));
+      for(const auto child: e.children)
+        children.add(element_to_value(*child));
+    }
+    return v;
+  }
+
+  // Convert a JSON value back to an element - returns 0 if invalid
+  XML::Element *value_to_element(const JSON::Value& v)
+  {
+    if (v.type == JSON::Value::STRING) return new XML::Element("", v.s);
+    if (v.type != JSON::Value::OBJECT) return 0;
+
+    const auto& name = v["n"];
+    if (name.type != JSON::Value::STRING || name.s.empty()) return 0;
+
+    auto e = new XML::Element(name.s, v["t"].as_str());
+    for(const auto& p: v["a"].o) e->set_attr(p.first, p.second.as_str());
+    for(const auto& c: v["c"].a)
+    {
+      auto child = value_to_element(c);
+      if (!child)
+      {
+        delete e;
+        return 0;
+      }
+      e->add(child);
+    }
+    return e;
+  }
+}
+
+//--------------------------------------------------------------------------
+// Get binary form
+string Message::to_binary(BinaryBody body) const
+{
+  MT::Lock lock(cached_bits_mutex);
+  const auto& rh = cache_routing();
+
+  // Only make CBOR from a SOAP message which isn't already text, and only
+  // if it can carry everything
+  if (body == BinaryBody::cbor && !cbor_body && soap_message
+      && (!textual_message || textual_message->empty())
+      && fits_cbor(*soap_message))
+  {
+    string cbor;
+    Channel::StringWriter sw(cbor);
+    JSON::CBORWriter cw(sw);
+    cw.encode(element_to_value(soap_message->get_body()));
+    cbor_body = make_shared<const string>(move(cbor));
+  }
+
+  static const string empty;
+  const auto use_cbor = body == BinaryBody::cbor && cbor_body;
+  if (!use_cbor) cache_text();
+  const auto& content = use_cbor ? *cbor_body
+    : (textual_message ? *textual_message : empty);
+
+  string data;
+  data.reserve(14 + rh.id.size() + rh.subject.size() + rh.ref.size()
+               + content.size());
+  Channel::StringWriter sw(data);
+  sw.write_byte(binary_version);
+  sw.write_byte((rh.rsvp ? flag_rsvp : 0) | (use_cbor ? flag_cbor : 0));
+  for(const auto s: {&rh.id, &rh.subject, &rh.ref})
+  {
+    sw.write_nbo_32(s->size());
+    sw.write(*s);
+  }
+  sw.write(content);
+  return data;
+}
+
+//--------------------------------------------------------------------------
+// Read binary form
+bool Message::read_binary(const string& data)
+{
+  auto rh = make_shared<RoutingHeader>();
+  unsigned char flags;
+  size_t header_size;
+  try
+  {
+    Channel::StringReader sr(data);
+    if (sr.read_byte() != binary_version) return false;
+    flags = sr.read_byte();
+    for(const auto s: {&rh->id, &rh->subject, &rh->ref})
+      sr.read(*s, sr.read_nbo_32());
+    header_size = sr.get_offset();
+  }
+  catch (const Channel::Error&)
+  {
+    return false;
+  }
+  rh->rsvp = flags & flag_rsvp;
+  auto content = make_shared<const string>(data, header_size);
+
+  MT::Lock lock(cached_bits_mutex);
+  if (soap_message) delete soap_message;
+  soap_message = 0;
+  routing = rh;
+  if (flags & flag_cbor)
+  {
+    textual_message.reset();
+    cbor_body = content;
+  }
+  else
+  {
+    textual_message = content;
+    cbor_body.reset();
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Build SOAP message from CBOR body and routing header - lock must be held
+void Message::parse_cbor_body() const
+{
+  soap_message = create_soap(*routing);
+
+  try
+  {
+    Channel::StringReader sr(*cbor_body);
+    JSON::CBORReader cr(sr);
+    auto body = value_to_element(cr.decode());
+    if (body)
+    {
+      soap_message->add_body(body);
+      return;
+    }
+  }
+  catch (const Channel::Error&) {}
+
+  Log::Error log;
+  log << "XMLMesh:: Can't decode CBOR message body\n";
+  // Leave the header-only message, otherwise we'll keep decoding it again
+}
+
+}} // namespaces
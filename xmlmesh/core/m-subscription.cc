@@ -30,7 +30,7 @@ SubscriptionMessage::SubscriptionMessage(Operation _operation,
 //--------------------------------------------------------------------------
 // Down-cast constructor from general message on receipt
 SubscriptionMessage::SubscriptionMessage(Message& msg):
-  Message(msg.get_text())  // Copy text
+  Message(msg)  // Share text
 {
   // Get the body
   const XML::Element& body = get_body();
@@ -11,15 +11,13 @@
 #include "ot-log.h"
 #include "ot-misc.h"
 #include <sstream>
+#include <map>
+#include <string.h>
 
 namespace ObTools { namespace XMLMesh {
 
 #define XMLMESH_ID_SIZE 16
 
-//--------------------------------------------------------------------------
-// Standard namespace
-static const char *xmlmesh_namespace = "http://obtools.com/ns/xmlmesh";
-
 //--------------------------------------------------------------------------
 // Allocate an ID
 // Actually, we just generate a very long random one - this should make it
@@ -35,7 +33,8 @@ static string _allocate_id()
 static void _add_routing_header(SOAP::Message *soap,
                                 const string& subject,
                                 bool rsvp,
-                                const string& ref)
+                                const string& ref,
+                                const string& id = _allocate_id())
 {
   // Add routing header - role 'Next', must_understand, relay
   XML::Element& rh = soap->add_header("x:routing",
@@ -43,12 +42,22 @@ static void _add_routing_header(SOAP::Message *soap,
                                       true, true);
 
   // Add our routing parameters
-  rh.set_attr("x:id", _allocate_id());
+  rh.set_attr("x:id", id);
   rh.set_attr("x:subject", subject);
   if (rsvp) rh.set_attr_bool("x:rsvp", true);
   if (ref.size()) rh.set_attr("x:ref", ref);
 }
 
+//--------------------------------------------------------------------------
+// Create an empty SOAP message with the given routing header
+SOAP::Message *Message::create_soap(const RoutingHeader& rh)
+{
+  SOAP::Message *soap = new SOAP::Message();
+  soap->add_namespace("xmlns:x", xmlmesh_namespace);
+  _add_routing_header(soap, rh.subject, rh.rsvp, rh.ref, rh.id);
+  return soap;
+}
+
 //--------------------------------------------------------------------------
 // Constructor from existing SOAP::Message for outgoing messages
 // ID is manufactured here, and routing header added
@@ -151,43 +160,111 @@ Message::Message(const string& subject, const string& body_text,
 
 //--------------------------------------------------------------------------
 // Constructor from XML <message> text for incoming messages
-Message::Message(const string& message_text)
+Message::Message(const string& message_text):
+  soap_message(0),  // For now - will be created in get_soap if required
+  textual_message(make_shared<const string>(message_text))
 {
-  textual_message = message_text;
-  soap_message = 0;  // For now - will be created in get_xml if required
+}
+
+//--------------------------------------------------------------------------
+// Copy constructor
+Message::Message(const Message& m):
+  soap_message(0)
+{
+  MT::Lock lock(m.cached_bits_mutex);
+  if (!m.cbor_body) m.cache_text();
+  m.cache_routing();
+  textual_message = m.textual_message;
+  cbor_body = m.cbor_body;
+  routing = m.routing;
+}
+
+//--------------------------------------------------------------------------
+// Assignment operator
+Message& Message::operator=(const Message& m)
+{
+  if (&m == this) return *this;
+
+  shared_ptr<const string> text, cbor;
+  shared_ptr<const RoutingHeader> rh;
+  {
+    MT::Lock lock(m.cached_bits_mutex);
+    if (!m.cbor_body) m.cache_text();
+    m.cache_routing();
+    text = m.textual_message;
+    cbor = m.cbor_body;
+    rh = m.routing;
+  }
+
+  MT::Lock lock(cached_bits_mutex);
+  if (soap_message) delete soap_message;
+  soap_message = 0;
+  textual_message = text;
+  cbor_body = cbor;
+  routing = rh;
+  return *this;
 }
 
 //--------------------------------------------------------------------------
 // Get <message> text, but don't cache it
 string Message::to_text() const
 {
-  if (textual_message.size()) return textual_message;
+  if (textual_message && textual_message->size()) return *textual_message;
 
   // If XML exists, get the textual form
   if (soap_message) return soap_message->to_string();
 
+  // Or build it from CBOR
+  if (cbor_body)
+  {
+    MT::Lock lock(cached_bits_mutex);
+    return parse_soap().to_string();
+  }
+
   return "";
 }
 
+//--------------------------------------------------------------------------
+// Make sure the textual form exists if possible - lock must be held
+void Message::cache_text() const
+{
+  if ((!textual_message || textual_message->empty())
+      && (soap_message || cbor_body))
+    textual_message = make_shared<const string>(parse_soap().to_string());
+}
+
 //--------------------------------------------------------------------------
 // Get <message> text and cache it
 string Message::get_text() const
 {
   MT::Lock lock(cached_bits_mutex);
-  if (!textual_message.size()) textual_message = to_text();
+  cache_text();
+  return textual_message ? *textual_message : "";
+}
 
-  return textual_message;
+//--------------------------------------------------------------------------
+// Get <message> text as a shared buffer, and cache it
+shared_ptr<const string> Message::get_shared_text() const
+{
+  MT::Lock lock(cached_bits_mutex);
+  cache_text();
+  return textual_message ? textual_message : make_shared<const string>();
 }
 
 //--------------------------------------------------------------------------
-// Get SOAP Message, still owned by Message, will be destroyed with it
-// Check for validity with !
-const SOAP::Message& Message::get_soap() const
+// Get SOAP Message, parsing it if necessary - lock must be held
+const SOAP::Message& Message::parse_soap() const
 {
   // If we've already got it, return immediately
-  MT::Lock lock(cached_bits_mutex);
   if (soap_message) return *soap_message;
 
+  // Build it from CBOR if we don't have text
+  if ((!textual_message || textual_message->empty()) && cbor_body)
+  {
+    parse_cbor_body();
+    return *soap_message;
+  }
+
   // Create parser with fixed namespace in case someone's being clever
   // and using another prefix
   Log::Error error_log;
@@ -195,7 +272,8 @@ const SOAP::Message& Message::get_soap() const
   parser.fix_namespace(xmlmesh_namespace, "x");
 
   // Read SOAP message from parser
-  soap_message = new SOAP::Message(textual_message, parser);
+  soap_message = new SOAP::Message(textual_message ? *textual_message : "",
+                                   parser);
   if (!*soap_message)
   {
     error_log << "XMLMesh:: Can't parse incoming SOAP message\n";
@@ -205,16 +283,29 @@ const SOAP::Message& Message::get_soap() const
   return *soap_message;
 }
 
+//--------------------------------------------------------------------------
+// Get SOAP Message, still owned by Message, will be destroyed with it
+// Check for validity with !
+const SOAP::Message& Message::get_soap() const
+{
+  MT::Lock lock(cached_bits_mutex);
+  return parse_soap();
+}
+
 //--------------------------------------------------------------------------
 // Get SOAP message for modification - clears textual copy if any
 // SOAP is still owned by Message, will be destroyed with it
 SOAP::Message& Message::get_modifiable_soap()
 {
+  MT::Lock lock(cached_bits_mutex);
+
   // Make sure we have XML form available
-  get_soap();
+  parse_soap();
 
-  // Delete the textual form
-  textual_message = "";
+  // Drop our reference to the other forms and routing, which may change
+  textual_message.reset();
+  cbor_body.reset();
+  routing.reset();
 
   // Return message
   return *soap_message;
@@ -239,10 +330,10 @@ XML::Element& Message::get_body(const string& name) const
 }
 
 //--------------------------------------------------------------------------
-// Get routing header of the message
+// Get routing header of the message - lock must be held
 const XML::Element& Message::get_routing_header() const
 {
-  const SOAP::Message& soap = get_soap();
+  const SOAP::Message& soap = parse_soap();
   SOAP::Header h;
   if (soap.get_header("x:routing", h))
     return *h.content;
@@ -250,36 +341,162 @@ const XML::Element& Message::get_routing_header() const
     return XML::Element::none;
 }
 
+//--------------------------------------------------------------------------
+// Read the attributes of a start tag, from just after its name
+// Returns the position after the tag, or npos if it isn't simple enough to
+// read this way (e.g. entities in values)
+static string::size_type _scan_attrs(const string& text, string::size_type p,
+                                     map<string, string>& attrs)
+{
+  static const auto ws = " \t\r\n";
+  for(;;)
+  {
+    p = text.find_first_not_of(ws, p);
+    if (p == string::npos) return p;
+    if (text[p] == '>') return p+1;
+    if (text[p] == '/')
+      return text.compare(p, 2, "/>") ? string::npos : p+2;
+
+    const auto name_end = text.find_first_of(" \t\r\n=/>", p);
+    if (name_end == string::npos || name_end == p) return string::npos;
+    const auto eq = text.find_first_not_of(ws, name_end);
+    if (eq == string::npos || text[eq] != '=') return string::npos;
+    const auto q = text.find_first_not_of(ws, eq+1);
+    if (q == string::npos || (text[q] != '"' && text[q] != '\''))
+      return string::npos;
+    const auto end = text.find(text[q], q+1);
+    if (end == string::npos) return end;
+
+    auto value = text.substr(q+1, end-q-1);
+    if (value.find_first_of("&<") != string::npos) return string::npos;
+    attrs[text.substr(p, name_end-p)] = move(value);
+    p = end+1;
+  }
+}
+
+//--------------------------------------------------------------------------
+// Scan routing header attributes directly from message text
+// Only handles our namespace declared on the SOAP envelope and the routing
+// header in the SOAP header - returns false on anything else, or anything
+// it doesn't recognise, so a full parse is used instead
+bool Message::scan_routing(const string& text, RoutingHeader& rh)
+{
+  // Find the root element, after any XML declaration
+  auto p = text.find('<');
+  if (p != string::npos && !text.compare(p, 5, "<?xml"))
+  {
+    p = text.find("?>", p);
+    if (p == string::npos) return false;
+    p = text.find('<', p+2);
+  }
+  if (p == string::npos || p+1 >= text.size() || strchr("!?/", text[p+1]))
+    return false;
+
+  const auto name_end = text.find_first_of(" \t\r\n/>", p+1);
+  if (name_end == string::npos) return false;
+  const auto root = text.substr(p+1, name_end-p-1);
+  const auto colon = root.find(':');
+  const auto soap_prefix = colon == string::npos ? string()
+                                                 : root.substr(0, colon+1);
+  if (root != soap_prefix + "Envelope") return false;
+
+  // Find the prefix bound to our namespace
+  map<string, string> attrs;
+  p = _scan_attrs(text, name_end, attrs);
+  if (p == string::npos) return false;
+  string prefix;
+  for(const auto& it: attrs)
+    if (!it.first.compare(0, 6, "xmlns:") && it.second == xmlmesh_namespace)
+      prefix = it.first.substr(6);
+  if (prefix.empty()) return false;
+
+  // Find the routing element, before the end of the SOAP header
+  const auto header_end = text.find("</" + soap_prefix + "Header", p);
+  if (header_end == string::npos) return false;
+  const auto tag = "<" + prefix + ":routing";
+  for(p = text.find(tag, p); p < header_end; p = text.find(tag, p+1))
+  {
+    const auto next = p + tag.size();
+    if (next < text.size() && strchr(" \t\r\n/>", text[next])) break;
+  }
+  if (p >= header_end) return false;
+
+  // Read its attributes - must at least have an id and subject
+  attrs.clear();
+  if (_scan_attrs(text, p + tag.size(), attrs) == string::npos) return false;
+  const auto attr_prefix = prefix + ":";
+  const auto id = attrs.find(attr_prefix + "id");
+  const auto subject = attrs.find(attr_prefix + "subject");
+  if (id == attrs.end() || id->second.empty()
+      || subject == attrs.end() || subject->second.empty())
+    return false;
+
+  rh.id = id->second;
+  rh.subject = subject->second;
+  const auto ref = attrs.find(attr_prefix + "ref");
+  if (ref != attrs.end()) rh.ref = ref->second;
+  const auto rsvp = attrs.find(attr_prefix + "rsvp");
+  if (rsvp != attrs.end())
+    rh.rsvp = !rsvp->second.empty() && strchr("TtYy1", rsvp->second[0]);
+
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Extract routing header fields if we haven't already - lock must be held
+const Message::RoutingHeader& Message::cache_routing() const
+{
+  if (routing) return *routing;
+
+  auto rh = make_shared<RoutingHeader>();
+  if (!textual_message || textual_message->empty()
+      || !scan_routing(*textual_message, *rh))
+  {
+    const XML::Element& header = get_routing_header();
+    rh->id = header["x:id"];
+    rh->subject = header["x:subject"];
+    rh->ref = header["x:ref"];
+    rh->rsvp = header.get_attr_bool("x:rsvp");
+  }
+
+  routing = rh;
+  return *routing;
+}
+
+//--------------------------------------------------------------------------
+// Get routing header fields
+const Message::RoutingHeader& Message::get_routing() const
+{
+  MT::Lock lock(cached_bits_mutex);
+  return cache_routing();
+}
+
 //--------------------------------------------------------------------------
 // Get subject of a message
 string Message::get_subject() const
 {
-  const XML::Element& routing = get_routing_header();
-  return routing["x:subject"];
+  return get_routing().subject;
 }
 
 //--------------------------------------------------------------------------
 // Get id of a message
 string Message::get_id() const
 {
-  const XML::Element& routing = get_routing_header();
-  return routing["x:id"];
+  return get_routing().id;
 }
 
 //--------------------------------------------------------------------------
 // Get whether the message requires a response
 bool Message::get_rsvp() const
 {
-  const XML::Element& routing = get_routing_header();
-  return routing.get_attr_bool("x:rsvp");
+  return get_routing().rsvp;
 }
 
 //--------------------------------------------------------------------------
 // Get reference of a message
 string Message::get_ref() const
 {
-  const XML::Element& routing = get_routing_header();
-  return routing["x:ref"];
+  return get_routing().ref;
 }
 
 //--------------------------------------------------------------------------
@@ -11,6 +11,7 @@
 #define __OBTOOLS_XMLMESH_H
 
 #include <string>
+#include <memory>
 #include "ot-net.h"
 #if !defined(_SINGLE)
 #include "ot-mt.h"
@@ -23,19 +24,52 @@ namespace ObTools { namespace XMLMesh {
 // Make our lives easier without polluting anyone else
 using namespace std;
 
+// Standard namespace
+const char xmlmesh_namespace[] = "http://obtools.com/ns/xmlmesh";
+
+//==========================================================================
+// Body encoding for the binary form of messages
+enum class BinaryBody
+{
+  xml,   // Complete <message> text
+  cbor   // Body element as CBOR
+};
+
 //==========================================================================
 // XMLMesh message
 class Message
 {
 protected:
+  // Routing header fields, extracted once
+  struct RoutingHeader
+  {
+    string id;
+    string subject;
+    string ref;
+    bool rsvp{false};
+  };
+
   // Two forms of message - either XML, or text, or both.  get_xml and
   // get_text will convert if necessary, but holding both saves work
   // when just passing things through
+  // The text is immutable and shared between copies, as is the routing
+  // header, so copying a message (e.g. for fan-out) doesn't reparse or
+  // reserialise it
   mutable MT::Mutex cached_bits_mutex;  // Mutex on...
   mutable SOAP::Message *soap_message;  // SOAP message
-  mutable string textual_message;       // Textual message (<message ...>)
+  mutable shared_ptr<const string> textual_message;  // <message> text
+  mutable shared_ptr<const string> cbor_body;        // Body as CBOR, only
+                                                     // ever with routing
+  mutable shared_ptr<const RoutingHeader> routing;
 
   const XML::Element& get_routing_header() const;
+  const SOAP::Message& parse_soap() const;
+  void cache_text() const;
+  const RoutingHeader& cache_routing() const;
+  const RoutingHeader& get_routing() const;
+  static bool scan_routing(const string& text, RoutingHeader& rh);
+  static SOAP::Message *create_soap(const RoutingHeader& rh);
+  void parse_cbor_body() const;
 
 public:
   //------------------------------------------------------------------------
@@ -77,22 +111,13 @@ public:
 
   //------------------------------------------------------------------------
   // Copy constructor - don't transfer ownership of XML form
-  // Note, uses to_text to ensure there is a textual form, since we aren't
-  // taking the XML
-  Message(const Message& m):
-    soap_message(0), textual_message(m.to_text()) {}
+  // Shares the textual form, creating it in the original if necessary, so
+  // it is only serialised once however many copies there are
+  Message(const Message& m);
 
   //------------------------------------------------------------------------
   // Assignment operator, likewise
-  Message& operator=(const Message &m)
-  {
-    // Check for old XML
-    if (soap_message) delete soap_message;
-
-    soap_message = 0;
-    textual_message = m.to_text();
-    return *this;
-  }
+  Message& operator=(const Message &m);
 
   //------------------------------------------------------------------------
   // Get <message> text, but don't cache it
@@ -102,6 +127,22 @@ public:
   // Get <message> text and cache it
   string get_text() const;
 
+  //------------------------------------------------------------------------
+  // Get <message> text and cache it, without copying - the buffer is shared
+  // with copies of the message, and stays valid if it is modified
+  shared_ptr<const string> get_shared_text() const;
+
+  //------------------------------------------------------------------------
+  // Get binary form (binary.cc) - routing header in fixed fields, then the
+  // body.  A CBOR body is only used if asked for and available without
+  // parsing text - otherwise it falls back to XML
+  string to_binary(BinaryBody body = BinaryBody::xml) const;
+
+  //------------------------------------------------------------------------
+  // Read binary form, replacing any existing content
+  // Returns whether it was valid
+  bool read_binary(const string& data);
+
   //------------------------------------------------------------------------
   // Get SOAP Message, still owned by Message, will be destroyed with it
   // Check for validity with !
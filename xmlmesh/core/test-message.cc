@@ -0,0 +1,203 @@
+//==========================================================================
+// ObTools::XMLMesh:Core: test-message.cc
+//
+// Test harness for XMLMesh messages, including a benchmark of fan-out
+// copies
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include <gtest/gtest.h>
+#include "ot-xmlmesh.h"
+
+using namespace std;
+using namespace ObTools;
+
+//--------------------------------------------------------------------------
+// Tests
+TEST(MessageTest, TestRoutingHeaderFromOutgoingMessage)
+{
+  XMLMesh::Message msg("foo.bar", "<x:thing n='1'/>", true, "ref&1");
+  EXPECT_EQ("foo.bar", msg.get_subject());
+  EXPECT_EQ(32u, msg.get_id().size());
+  EXPECT_TRUE(msg.get_rsvp());
+  EXPECT_EQ("ref&1", msg.get_ref());
+
+  // Same from its text, whether scanned or (with the entity) parsed
+  XMLMesh::Message in(msg.get_text());
+  EXPECT_EQ("foo.bar", in.get_subject());
+  EXPECT_EQ(msg.get_id(), in.get_id());
+  EXPECT_TRUE(in.get_rsvp());
+  EXPECT_EQ("ref&1", in.get_ref());
+  EXPECT_EQ("1", in.get_body()["n"]);
+}
+
+TEST(MessageTest, TestRoutingHeaderScannedWithOtherPrefix)
+{
+  XMLMesh::Message in(
+    "<env:Envelope xmlns:env=\"http://www.w3.org/2003/05/soap-envelope\""
+    " xmlns:m='http://obtools.com/ns/xmlmesh'>"
+    "<env:Header><m:routing env:mustUnderstand='true'"
+    " env:role='http://www.w3.org/2003/05/soap-envelope/role/next'"
+    " env:relay='true' m:id='1234' m:subject='a.b' m:rsvp='yes'/>"
+    "</env:Header><env:Body><m:ok/></env:Body></env:Envelope>");
+  EXPECT_EQ("a.b", in.get_subject());
+  EXPECT_EQ("1234", in.get_id());
+  EXPECT_TRUE(in.get_rsvp());
+  EXPECT_EQ("", in.get_ref());
+
+  // Full parse agrees
+  EXPECT_EQ("x:ok", in.get_body().name);
+}
+
+TEST(MessageTest, TestRoutingHeaderWithSpacesOrNamespaceInHeader)
+{
+  XMLMesh::Message spaced(
+    "<env:Envelope xmlns:env=\"http://www.w3.org/2003/05/soap-envelope\""
+    " xmlns:x = 'http://obtools.com/ns/xmlmesh'>"
+    "<env:Header><x:routing x:id =\"1\" x:subject= 'a.b'/></env:Header>"
+    "<env:Body><x:ok/></env:Body></env:Envelope>");
+  EXPECT_EQ("1", spaced.get_id());
+  EXPECT_EQ("a.b", spaced.get_subject());
+
+  // Not declared on the envelope, so parsed - ignoring the one in the body
+  XMLMesh::Message nested(
+    "<env:Envelope xmlns:env=\"http://www.w3.org/2003/05/soap-envelope\">"
+    "<env:Header><m:routing xmlns:m='http://obtools.com/ns/xmlmesh'"
+    " m:id='2' m:subject='c.d'/></env:Header>"
+    "<env:Body><n:routing xmlns:n='http://obtools.com/ns/xmlmesh'"
+    " n:id='3' n:subject='e.f'/></env:Body></env:Envelope>");
+  EXPECT_EQ("2", nested.get_id());
+  EXPECT_EQ("c.d", nested.get_subject());
+}
+
+TEST(MessageTest, TestCopiesShareTextUntilModified)
+{
+  XMLMesh::Message msg("foo.bar", new XML::Element("x:thing"));
+  XMLMesh::Message copy(msg);
+  XMLMesh::Message assigned;
+  assigned = copy;
+  EXPECT_EQ(msg.get_shared_text(), copy.get_shared_text());
+  EXPECT_EQ(msg.get_shared_text(), assigned.get_shared_text());
+  EXPECT_EQ("foo.bar", assigned.get_subject());
+
+  const auto original = msg.get_text();
+  copy.get_modifiable_soap().get_body().set_attr("changed", "yes");
+  EXPECT_NE(original, copy.get_text());
+  EXPECT_EQ(original, msg.get_text());
+  EXPECT_EQ("foo.bar", copy.get_subject());
+}
+
+TEST(MessageTest, TestBinaryRoundTripWithXMLAndCBORBodies)
+{
+  auto body = new XML::Element("x:thing");
+  body->set_attr("n", "1");
+  body->add("x:child", "text & <more>").set_attr("a", "b");
+  const XMLMesh::Message msg("foo.bar", body, true, "r1");
+
+  for(const auto form: {XMLMesh::BinaryBody::xml, XMLMesh::BinaryBody::cbor})
+  {
+    XMLMesh::Message in;
+    ASSERT_TRUE(in.read_binary(msg.to_binary(form)));
+    EXPECT_EQ("foo.bar", in.get_subject());
+    EXPECT_EQ(msg.get_id(), in.get_id());
+    EXPECT_TRUE(in.get_rsvp());
+    EXPECT_EQ("r1", in.get_ref());
+    const auto& b = in.get_body();
+    EXPECT_EQ("x:thing", b.name);
+    EXPECT_EQ("1", b["n"]);
+    EXPECT_EQ("text & <more>", b.get_child("x:child").content);
+    EXPECT_EQ("b", b.get_child("x:child")["a"]);
+
+    // Converts back to text for XML clients
+    XMLMesh::Message text(in.get_text());
+    EXPECT_EQ("foo.bar", text.get_subject());
+    EXPECT_EQ("b", text.get_body().get_child("x:child")["a"]);
+  }
+}
+
+TEST(MessageTest, TestCBOROnlyUsedIfItCarriesEverything)
+{
+  const auto cbor_flag = 2;
+  XMLMesh::Message plain("foo.bar", new XML::Element("x:thing"));
+  EXPECT_TRUE(plain.to_binary(XMLMesh::BinaryBody::cbor)[1] & cbor_flag);
+
+  XMLMesh::Message headed("foo.bar", new XML::Element("x:thing"));
+  headed.get_modifiable_soap().add_header("x:extra");
+  const auto headed_binary = headed.to_binary(XMLMesh::BinaryBody::cbor);
+  EXPECT_FALSE(headed_binary[1] & cbor_flag);
+  XMLMesh::Message headed_in;
+  ASSERT_TRUE(headed_in.read_binary(headed_binary));
+  SOAP::Header h;
+  EXPECT_TRUE(headed_in.get_soap().get_header("x:extra", h));
+
+  XMLMesh::Message bodies("foo.bar", new XML::Element("x:one"));
+  bodies.get_modifiable_soap().add_body(new XML::Element("x:two"));
+  const auto bodies_binary = bodies.to_binary(XMLMesh::BinaryBody::cbor);
+  EXPECT_FALSE(bodies_binary[1] & cbor_flag);
+  XMLMesh::Message bodies_in;
+  ASSERT_TRUE(bodies_in.read_binary(bodies_binary));
+  EXPECT_EQ(2u, bodies_in.get_soap().get_bodies().size());
+}
+
+TEST(MessageTest, TestBinaryCarriesLongRoutingFields)
+{
+  const auto subject = string(70000, 's');
+  XMLMesh::Message msg(subject, new XML::Element("x:thing"), false,
+                       string(100000, 'r'));
+  XMLMesh::Message in;
+  ASSERT_TRUE(in.read_binary(msg.to_binary()));
+  EXPECT_EQ(subject, in.get_subject());
+  EXPECT_EQ(100000u, in.get_ref().size());
+}
+
+TEST(MessageTest, TestBadBinaryRejected)
+{
+  XMLMesh::Message in;
+  EXPECT_FALSE(in.read_binary(""));
+  EXPECT_FALSE(in.read_binary(string("\x02\0", 2)));
+  EXPECT_FALSE(in.read_binary(string("\x01\0\0\0\0\x05" "ab", 8)));
+}
+
+TEST(MessageTest, BenchmarkFanOutCopies)
+{
+  if (!getenv("OBTOOLS_BENCHMARK"))
+    GTEST_SKIP() << "OBTOOLS_BENCHMARK not set";
+
+  const auto n = 100000;
+  XMLMesh::Message msg("foo.bar", "<x:thing>" + string(1000, 'x')
+                       + "</x:thing>");
+  const XMLMesh::Message in(msg.get_text());
+
+  // As before: copy the text, and parse it to read the routing header
+  auto start = chrono::steady_clock::now();
+  for(auto i=0; i<n/100; i++)
+  {
+    XMLMesh::Message copy(in.to_text());
+    ASSERT_EQ("x:thing", copy.get_body().name);
+  }
+  chrono::duration<double> parse_time = chrono::steady_clock::now() - start;
+
+  start = chrono::steady_clock::now();
+  for(auto i=0; i<n; i++)
+  {
+    XMLMesh::Message copy(in);
+    ASSERT_EQ("foo.bar", copy.get_subject());
+  }
+  chrono::duration<double> copy_time = chrono::steady_clock::now() - start;
+
+  const auto parse_ns = parse_time.count() * 1e9 / (n/100);
+  const auto copy_ns = copy_time.count() * 1e9 / n;
+  cout << "Per fan-out copy: reparsed " << static_cast<int>(parse_ns)
+       << "ns, shared " << static_cast<int>(copy_ns) << "ns (x"
+       << parse_ns / copy_ns << ")\n";
+}
+
+//--------------------------------------------------------------------------
+// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
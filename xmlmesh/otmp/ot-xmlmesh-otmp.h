@@ -26,7 +26,25 @@ const int DEFAULT_PORT = 29167;
 // Standard OTMP tags
 enum Tag
 {
-  TAG_MESSAGE = 0x4f544d53   // OTMS - Message carrying
+  TAG_MESSAGE = 0x4f544d53,  // OTMS - Message carrying, as <message> text
+  TAG_BINARY  = 0x4f544d42   // OTMB - Message carrying, in binary form
+};
+
+// Flags on TAG_MESSAGE and TAG_BINARY, offering the binary form
+// Servers which don't understand it ignore the flags, and those which do
+// reply with TAG_BINARY, which then lets the client send it too
+enum Flag
+{
+  FLAG_ACCEPT_BINARY = 1,    // Sender can receive TAG_BINARY
+  FLAG_PREFER_CBOR   = 2     // ... and would like CBOR bodies
+};
+
+// Encoding selectable per client connection
+enum class Encoding
+{
+  xml,          // <message> text only
+  binary,       // Binary routing header, body as <message> text
+  binary_cbor   // Binary routing header, body as CBOR where possible
 };
 
 //==========================================================================
@@ -37,6 +55,14 @@ struct Message: public Tube::Message
     Tube::Message(TAG_MESSAGE, _data, _flags) {}
 };
 
+//==========================================================================
+// OTMP message in binary form
+struct BinaryMessage: public Tube::Message
+{
+  BinaryMessage(const string& _data="", Tube::flags_t _flags=0):
+    Tube::Message(TAG_BINARY, _data, _flags) {}
+};
+
 //==========================================================================
 // Client message with fixed tag
 struct ClientMessage: public Tube::ClientMessage
@@ -46,6 +72,11 @@ struct ClientMessage: public Tube::ClientMessage
                 const string& _data="", Tube::flags_t _flags=0):
     Tube::ClientMessage(_client, TAG_MESSAGE, _data, _flags) {}
 
+  // Constructor for message with other tag
+  ClientMessage(const SSL::ClientDetails& _client, Tube::tag_t _tag,
+                const string& _data, Tube::flags_t _flags=0):
+    Tube::ClientMessage(_client, _tag, _data, _flags) {}
+
   // Constructor for shutdown
   ClientMessage(Tube::ClientMessage::Action action):
     Tube::ClientMessage(action) {}
@@ -58,8 +89,9 @@ class Client: public Tube::Client
 private:
   //------------------------------------------------------------------------
   // Overridable function to filter message tags - return true if tag
-  // is recognised.  Only allows 'OTMS'
-  virtual bool tag_recognised(Tube::tag_t tag) { return tag == TAG_MESSAGE; }
+  // is recognised.  Only allows 'OTMS' and 'OTMB'
+  virtual bool tag_recognised(Tube::tag_t tag)
+  { return tag == TAG_MESSAGE || tag == TAG_BINARY; }
 
 public:
   //------------------------------------------------------------------------
@@ -84,9 +116,9 @@ private:
 
   //------------------------------------------------------------------------
   // Overridable function to filter message tags - return true if tag
-  // is recognised.  Only allows 'OTMS'
+  // is recognised.  Only allows 'OTMS' and 'OTMB'
   virtual bool tag_recognised(Tube::tag_t tag) const
-  { return tag == TAG_MESSAGE; }
+  { return tag == TAG_MESSAGE || tag == TAG_BINARY; }
 
   //------------------------------------------------------------------------
   // Abstract function to handle an incoming client message
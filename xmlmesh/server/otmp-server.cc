@@ -68,6 +68,13 @@ private:
   OTMPMessageThread message_thread;
   OTMP::ClientMessageQueue receive_q;
 
+  // Clients which have offered the binary form
+  MT::RWMutex encodings_mutex;
+  map<Net::EndPoint, OTMP::Encoding> encodings;
+
+  void set_encoding(const Net::EndPoint& client, const Tube::Message& msg);
+  OTMP::Encoding get_encoding(const Net::EndPoint& client);
+
 public:
   //------------------------------------------------------------------------
   // Constructor - default to standard OTMP port
@@ -144,6 +151,40 @@ bool OTMPServer::started() const
   return (!!otmp && !!server_thread);
 }
 
+//--------------------------------------------------------------------------
+// Record the encoding a client wants, from a message it sent
+void OTMPServer::set_encoding(const Net::EndPoint& client,
+                              const Tube::Message& msg)
+{
+  auto encoding = OTMP::Encoding::xml;
+  if (msg.flags & OTMP::FLAG_ACCEPT_BINARY)
+    encoding = (msg.flags & OTMP::FLAG_PREFER_CBOR)
+      ? OTMP::Encoding::binary_cbor : OTMP::Encoding::binary;
+
+  {
+    MT::RWReadLock lock(encodings_mutex);
+    const auto p = encodings.find(client);
+    if (p == encodings.end() ? encoding == OTMP::Encoding::xml
+                             : p->second == encoding)
+      return;
+  }
+
+  MT::RWWriteLock lock(encodings_mutex);
+  if (encoding == OTMP::Encoding::xml)
+    encodings.erase(client);
+  else
+    encodings[client] = encoding;
+}
+
+//--------------------------------------------------------------------------
+// Get the encoding for a client
+OTMP::Encoding OTMPServer::get_encoding(const Net::EndPoint& client)
+{
+  MT::RWReadLock lock(encodings_mutex);
+  const auto p = encodings.find(client);
+  return p == encodings.end() ? OTMP::Encoding::xml : p->second;
+}
+
 //--------------------------------------------------------------------------
 // OTMP Message dispatcher
 // Fetch OTMP messages and send into the system
@@ -169,8 +210,22 @@ bool OTMPServer::dispatch()
 
     case OTMP::ClientMessage::MESSAGE_DATA:
     {
+      set_encoding(otmp_msg.client.address, otmp_msg.msg);
+
       // Convert to routing message
-      Message msg(otmp_msg.msg.data);
+      Message msg;
+      if (otmp_msg.msg.tag == OTMP::TAG_BINARY)
+      {
+        if (!msg.read_binary(otmp_msg.msg.data))
+        {
+          Log::Error log;
+          log << "OTMP Server received bad binary message from "
+              << otmp_msg.client << endl;
+          break;
+        }
+      }
+      else msg = Message(otmp_msg.msg.data);
+
       RoutingMessage rmsg(msg);
       rmsg.path = path; // Note not with constructor because this is forward
 
@@ -181,6 +236,11 @@ bool OTMPServer::dispatch()
 
     case OTMP::ClientMessage::FINISHED:
     {
+      {
+        MT::RWWriteLock lock(encodings_mutex);
+        encodings.erase(otmp_msg.client.address);
+      }
+
       // Send DISCONNECTION routing message with this path
       RoutingMessage rmsg(RoutingMessage::DISCONNECTION, path);
       originate(rmsg);
@@ -235,7 +295,14 @@ bool OTMPServer::handle(RoutingMessage& msg)
       OBTOOLS_LOG_IF_DEBUG(log.debug << "OTMP Server: responding to "
                            << client << endl;)
 
-      OTMP::ClientMessage otmp_msg(client, msg.message.get_text());
+      // Send in the form the client wants - converted if necessary
+      const auto encoding = get_encoding(address);
+      auto otmp_msg = (encoding == OTMP::Encoding::xml)
+        ? OTMP::ClientMessage(client, msg.message.get_text())
+        : OTMP::ClientMessage(client, OTMP::TAG_BINARY,
+                              msg.message.to_binary(
+                                encoding == OTMP::Encoding::binary_cbor
+                                ? BinaryBody::cbor : BinaryBody::xml));
       if (otmp.send(otmp_msg))
       {
         // Tell tracker it was forwarded
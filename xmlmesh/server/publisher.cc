@@ -18,28 +18,14 @@ namespace ObTools { namespace XMLMesh {
 
 class PublishService;  // forward
 
-//==========================================================================
-// Subscription record
-struct Subscription
-{
-  const string subject;          // Subject pattern
-  const string path;             // Client return path
-  const string subscriber_id;    // Subscriber ID (optional)
-
-  Subscription(const string& _subject, const string& _path,
-               const string& _subscriber_id):
-    subject(_subject), path(_path), subscriber_id(_subscriber_id)
-  {}
-};
-
 //==========================================================================
 // Publisher Service
 class Publisher: public Service
 {
 private:
   const string subject_pattern;            // Pattern of allowed subjects
-  MT::RWMutex mutex;                       // On subscriptions list
-  list<Subscription> subscriptions;
+  MT::RWMutex mutex;                       // On subscriptions
+  SubscriptionIndex subscriptions;
 
   bool handle_subscription(RoutingMessage& msg);
   bool subscribe(const string& subject, const string& path,
@@ -47,6 +33,8 @@ private:
   void unsubscribe(const string& subject, const string& path,
                    const string& subscriber_id);
   void unsubscribe_all(const string& path, const string& subscriber_id);
+  void log_unsubscribed(const string& path, const string& subscriber_id,
+                        const vector<string>& subjects);
 
 public:
   //------------------------------------------------------------------------
@@ -92,29 +80,25 @@ bool Publisher::handle(RoutingMessage& msg)
           && !handle_subscription(msg))
         return false;
 
-      // Try each subscription in turn to see if it wants it
+      // Send to each subscriber which wants it, once only
       MT::RWReadLock lock(mutex);
-      for(list<Subscription>::const_iterator p = subscriptions.begin();
-          p!=subscriptions.end();
-          p++)
+      vector<const SubscriptionIndex::Subscriber *> subscribers;
+      subscriptions.match(subject, subscribers);
+      for(const auto sub: subscribers)
       {
-        const Subscription& sub = *p;
-        if (Text::pattern_match(sub.subject, subject))
-        {
-          // Create new RoutingMessage from the inbound one, with us
-          // as originator, and with the same path, but set as response
-          // Note however that the message isn't modified - no ref set
-          const MessagePath path(sub.path);
-          RoutingMessage submsg(msg.message, path);
-
-          // Reflect the subscription ID
-          submsg.subscriber_id = sub.subscriber_id;
-
-          // If old message was being tracked, attach new one as well
-          if (msg.tracker) submsg.track(msg.tracker);
-
-          originate(submsg);
-        }
+        // Create new RoutingMessage from the inbound one, with us
+        // as originator, and with the same path, but set as response
+        // Note however that the message isn't modified - no ref set
+        const MessagePath path(sub->path);
+        RoutingMessage submsg(msg.message, path);
+
+        // Reflect the subscription ID
+        submsg.subscriber_id = sub->subscriber_id;
+
+        // If old message was being tracked, attach new one as well
+        if (msg.tracker) submsg.track(msg.tracker);
+
+        originate(submsg);
       }
     }
     break;
@@ -188,20 +172,33 @@ bool Publisher::subscribe(const string& subject,
     unsubscribe(subject, path, subscriber_id);
 
     // (Re)subscribe
-    const Subscription sub(subject, path, subscriber_id);
-
     Log::Detail log;
     log << "Client " << path << " subscribed to " << subject;
     if (!subscriber_id.empty()) log  << " with ID " << subscriber_id;
     log << endl;
 
     MT::RWWriteLock lock(mutex);
-    subscriptions.push_back(sub);
+    subscriptions.add(subject, path, subscriber_id);
     return true;
   }
   else return false;
 }
 
+//--------------------------------------------------------------------------
+// Log subjects a client was unsubscribed from
+void Publisher::log_unsubscribed(const string& path,
+                                 const string& subscriber_id,
+                                 const vector<string>& subjects)
+{
+  for(const auto& subject: subjects)
+  {
+    Log::Detail log;
+    log << "Client " << path << " unsubscribed from " << subject;
+    if (!subscriber_id.empty()) log  << " with ID " << subscriber_id;
+    log << endl;
+  }
+}
+
 //--------------------------------------------------------------------------
 // Unsubscribe a client from a particular (set of) subject(s)
 // Uses pattern match to allow general unsubscribe
@@ -210,26 +207,12 @@ void Publisher::unsubscribe(const string& subject,
                             const string& path,
                             const string& subscriber_id)
 {
-  MT::RWWriteLock lock(mutex);  // Require write now because may need it later
-  for(list<Subscription>::iterator p = subscriptions.begin();
-      p!=subscriptions.end();
-     )
+  vector<string> removed;
   {
-    list<Subscription>::iterator q = p++;  // Move safely before deletion
-    const Subscription& sub = *q;
-
-    if ((subscriber_id.empty()?(sub.path == path)
-                                :(sub.subscriber_id == subscriber_id))
-        && Text::pattern_match(subject, sub.subject))
-    {
-      Log::Detail log;
-      log << "Client " << path << " unsubscribed from " << sub.subject;
-      if (!subscriber_id.empty()) log  << " with ID " << subscriber_id;
-      log << endl;
-
-      subscriptions.erase(q);
-    }
+    MT::RWWriteLock lock(mutex);
+    subscriptions.remove(subject, path, subscriber_id, removed);
   }
+  log_unsubscribed(path, subscriber_id, removed);
 }
 
 //--------------------------------------------------------------------------
@@ -237,24 +220,12 @@ void Publisher::unsubscribe(const string& subject,
 void Publisher::unsubscribe_all(const string& path,
                                 const string& subscriber_id)
 {
-  MT::RWWriteLock lock(mutex);  // Require write now because may need it later
-  for(list<Subscription>::iterator p = subscriptions.begin();
-      p!=subscriptions.end();
-      )
+  vector<string> removed;
   {
-    list<Subscription>::iterator q = p++;  // Move safely before deletion
-    const Subscription& sub = *q;
-    if (subscriber_id.empty()?(sub.path == path)
-                               :(sub.subscriber_id == subscriber_id))
-    {
-      Log::Detail log;
-      log << "Client " << path << " unsubscribed from " << sub.subject;
-      if (!subscriber_id.empty()) log  << " with ID " << subscriber_id;
-      log << endl;
-
-      subscriptions.erase(q);
-    }
+    MT::RWWriteLock lock(mutex);
+    subscriptions.remove_all(path, subscriber_id, removed);
   }
+  log_unsubscribed(path, subscriber_id, removed);
 }
 
 //==========================================================================
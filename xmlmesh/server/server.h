@@ -11,6 +11,9 @@
 #define __OBTOOLS_XMLMESH_SERVER_H
 
 #include <string>
+#include <string_view>
+#include <map>
+#include <memory>
 #include "ot-net.h"
 #include "ot-log.h"
 #include "ot-mt.h"
@@ -209,6 +212,106 @@ struct MessageRoute
     subject_pattern(_pattern), service(_service) {}
 };
 
+//==========================================================================
+// Index of subscriptions by subject pattern, for fan-out
+// Patterns are stored in a trie of dot-separated segments - a literal
+// segment, or a '*' segment which (as in Text::pattern_match) matches one or
+// more whole segments.  Matching therefore costs roughly the depth of the
+// subject, not the number of subscriptions.  Patterns with other wildcards
+// inside a segment (foo*, ?, [...]) are matched individually
+// Not thread-safe - lock around it
+class SubscriptionIndex
+{
+public:
+  // A subscriber - the client path and subscriber ID (optional)
+  struct Subscriber;
+
+private:
+  struct Node;
+
+  // A single subscription, owned by its subscriber
+  struct Entry
+  {
+    string subject;                           // Pattern
+    Subscriber *subscriber;
+    Node *node;                               // 0 if unindexed
+    list<Entry>::iterator self;               // Position in subscriber
+    list<Entry *>::iterator in_node;          // Position in node/unindexed
+  };
+
+  // Trie node - patterns which end here, and onward segments
+  struct Node
+  {
+    Node *parent;
+    string segment;                           // Our edge from parent
+    list<Entry *> entries;
+    map<string, unique_ptr<Node>, less<>> children;
+    unique_ptr<Node> star;                    // '*' segment
+
+    Node(Node *_parent, const string& _segment):
+      parent(_parent), segment(_segment) {}
+  };
+
+public:
+  struct Subscriber
+  {
+    string path;
+    string subscriber_id;
+    list<Entry> entries;
+
+    Subscriber(const string& _path, const string& _subscriber_id):
+      path(_path), subscriber_id(_subscriber_id) {}
+  };
+
+private:
+  Node root{nullptr, ""};
+  list<Entry *> unindexed;
+  size_t count{0};
+
+  // Subscribers by (path, ID), and those with IDs by (ID, path)
+  map<pair<string, string>, unique_ptr<Subscriber>> subscribers;
+  map<pair<string, string>, Subscriber *> subscribers_by_id;
+
+  void remove_entry(Entry& entry);
+  void remove_subscriber(Subscriber *subscriber);
+  template<typename F> void for_subscribers(const string& path,
+                                            const string& subscriber_id,
+                                            F f);
+  void match_node(const Node& node, const vector<string_view>& segments,
+                  size_t i, vector<const Subscriber *>& result) const;
+
+public:
+  //------------------------------------------------------------------------
+  // Add a subscription
+  // Returns false if the subscriber already has exactly this subject
+  bool add(const string& subject, const string& path,
+           const string& subscriber_id);
+
+  //------------------------------------------------------------------------
+  // Remove a client's subscriptions whose subjects match the given pattern
+  // (so foo.* removes foo.bar and foo.*.splat as well as foo.*)
+  // The client is identified by subscriber ID if given, otherwise by path
+  // Adds the subjects removed to 'removed'
+  void remove(const string& pattern, const string& path,
+              const string& subscriber_id, vector<string>& removed);
+
+  //------------------------------------------------------------------------
+  // Remove all of a client's subscriptions, identified as above
+  // Adds the subjects removed to 'removed'
+  void remove_all(const string& path, const string& subscriber_id,
+                  vector<string>& removed);
+
+  //------------------------------------------------------------------------
+  // Find the subscribers with a pattern which matches the subject
+  // Each subscriber is returned once, however many of its patterns match
+  void match(const string& subject,
+             vector<const Subscriber *>& result) const;
+
+  //------------------------------------------------------------------------
+  // Get the number of subscriptions
+  size_t size() const { return count; }
+};
+
 //==========================================================================
 // Service thread for multi-threaded services
 class ServiceThread: public MT::PoolThread
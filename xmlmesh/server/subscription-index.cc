@@ -0,0 +1,239 @@
+//==========================================================================
+// ObTools::XMLMesh:Server: subscription-index.cc
+//
+// Trie index of subscriptions by subject pattern
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include "server.h"
+#include "ot-text.h"
+#include <unordered_set>
+
+namespace ObTools { namespace XMLMesh {
+
+namespace
+{
+  // Split a subject or pattern into dot-separated segments
+  vector<string_view> split_segments(const string& subject)
+  {
+    vector<string_view> segments;
+    string_view s(subject);
+    for(;;)
+    {
+      const auto dot = s.find('.');
+      segments.push_back(s.substr(0, dot));
+      if (dot == string_view::npos) break;
+      s.remove_prefix(dot+1);
+    }
+    return segments;
+  }
+
+  // Check whether a pattern segment can go in the trie
+  bool is_indexable(string_view segment)
+  {
+    return segment == "*"
+      || segment.find_first_of("*?[\\") == string_view::npos;
+  }
+}
+
+//--------------------------------------------------------------------------
+// Add a subscription
+bool SubscriptionIndex::add(const string& subject, const string& path,
+                            const string& subscriber_id)
+{
+  auto& sp = subscribers[make_pair(path, subscriber_id)];
+  if (!sp)
+  {
+    sp.reset(new Subscriber(path, subscriber_id));
+    if (!subscriber_id.empty())
+      subscribers_by_id[make_pair(subscriber_id, path)] = sp.get();
+  }
+  auto subscriber = sp.get();
+
+  for(const auto& e: subscriber->entries)
+    if (e.subject == subject) return false;
+
+  auto it = subscriber->entries.emplace(subscriber->entries.end());
+  auto& entry = *it;
+  entry.subject = subject;
+  entry.subscriber = subscriber;
+  entry.self = it;
+
+  const auto segments = split_segments(subject);
+  auto indexable = true;
+  for(const auto& seg: segments)
+    if (!is_indexable(seg)) indexable = false;
+
+  if (indexable)
+  {
+    auto node = &root;
+    for(const auto& seg: segments)
+    {
+      auto& next = (seg == "*") ? node->star : node->children[string(seg)];
+      if (!next) next.reset(new Node(node, string(seg)));
+      node = next.get();
+    }
+    entry.node = node;
+    entry.in_node = node->entries.insert(node->entries.end(), &entry);
+  }
+  else
+  {
+    entry.node = nullptr;
+    entry.in_node = unindexed.insert(unindexed.end(), &entry);
+  }
+
+  count++;
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// Remove a single entry, and any trie nodes left empty
+// Leaves the subscriber, even if empty
+void SubscriptionIndex::remove_entry(Entry& entry)
+{
+  auto node = entry.node;
+  if (node)
+  {
+    node->entries.erase(entry.in_node);
+    while (node->parent && node->entries.empty()
+           && node->children.empty() && !node->star)
+    {
+      auto parent = node->parent;
+      if (parent->star.get() == node)
+        parent->star.reset();
+      else
+        parent->children.erase(string(node->segment));  // Copy before death
+      node = parent;
+    }
+  }
+  else unindexed.erase(entry.in_node);
+
+  entry.subscriber->entries.erase(entry.self);
+  count--;
+}
+
+//--------------------------------------------------------------------------
+// Remove an (empty) subscriber
+void SubscriptionIndex::remove_subscriber(Subscriber *subscriber)
+{
+  if (!subscriber->subscriber_id.empty())
+    subscribers_by_id.erase(make_pair(subscriber->subscriber_id,
+                                      subscriber->path));
+  subscribers.erase(make_pair(subscriber->path, subscriber->subscriber_id));
+}
+
+//--------------------------------------------------------------------------
+// Call f for each subscriber identified by ID if given, otherwise by path
+// f may remove the subscriber
+template<typename F>
+void SubscriptionIndex::for_subscribers(const string& path,
+                                        const string& subscriber_id, F f)
+{
+  vector<Subscriber *> found;
+  if (subscriber_id.empty())
+  {
+    for(auto p = subscribers.lower_bound(make_pair(path, string()));
+        p != subscribers.end() && p->first.first == path; ++p)
+      found.push_back(p->second.get());
+  }
+  else
+  {
+    for(auto p = subscribers_by_id.lower_bound(make_pair(subscriber_id,
+                                                         string()));
+        p != subscribers_by_id.end() && p->first.first == subscriber_id; ++p)
+      found.push_back(p->second);
+  }
+
+  for(auto subscriber: found) f(subscriber);
+}
+
+//--------------------------------------------------------------------------
+// Remove a client's subscriptions which match a pattern
+void SubscriptionIndex::remove(const string& pattern, const string& path,
+                               const string& subscriber_id,
+                               vector<string>& removed)
+{
+  for_subscribers(path, subscriber_id,
+                  [this, &pattern, &removed](Subscriber *subscriber)
+  {
+    for(auto p = subscriber->entries.begin();
+        p != subscriber->entries.end();)
+    {
+      auto& entry = *p++;  // Move safely before deletion
+      if (Text::pattern_match(pattern, entry.subject))
+      {
+        removed.push_back(entry.subject);
+        remove_entry(entry);
+      }
+    }
+    if (subscriber->entries.empty()) remove_subscriber(subscriber);
+  });
+}
+
+//--------------------------------------------------------------------------
+// Remove all of a client's subscriptions
+void SubscriptionIndex::remove_all(const string& path,
+                                   const string& subscriber_id,
+                                   vector<string>& removed)
+{
+  for_subscribers(path, subscriber_id,
+                  [this, &removed](Subscriber *subscriber)
+  {
+    while (!subscriber->entries.empty())
+    {
+      auto& entry = subscriber->entries.front();
+      removed.push_back(entry.subject);
+      remove_entry(entry);
+    }
+    remove_subscriber(subscriber);
+  });
+}
+
+//--------------------------------------------------------------------------
+// Collect entries under a node for segments from i on
+void SubscriptionIndex::match_node(const Node& node,
+                                   const vector<string_view>& segments,
+                                   size_t i,
+                                   vector<const Subscriber *>& result) const
+{
+  if (i == segments.size())
+  {
+    for(const auto entry: node.entries)
+      result.push_back(entry->subscriber);
+    return;
+  }
+
+  const auto p = node.children.find(segments[i]);
+  if (p != node.children.end())
+    match_node(*p->second, segments, i+1, result);
+
+  // '*' takes one or more segments
+  if (node.star)
+    for(auto j = i+1; j <= segments.size(); j++)
+      match_node(*node.star, segments, j, result);
+}
+
+//--------------------------------------------------------------------------
+// Find subscribers matching a subject
+void SubscriptionIndex::match(const string& subject,
+                              vector<const Subscriber *>& result) const
+{
+  const auto start = result.size();
+  match_node(root, split_segments(subject), 0, result);
+  for(const auto entry: unindexed)
+    if (Text::pattern_match(entry->subject, subject))
+      result.push_back(entry->subscriber);
+
+  // A subscriber can match through more than one pattern, or a pattern
+  // with more than one '*' can match more than one way
+  unordered_set<const Subscriber *> seen;
+  seen.reserve(result.size() - start);
+  auto out = result.begin() + start;
+  for(auto p = out; p != result.end(); ++p)
+    if (seen.insert(*p).second) *out++ = *p;
+  result.erase(out, result.end());
+}
+
+}} // namespaces
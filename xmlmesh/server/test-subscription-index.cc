@@ -0,0 +1,240 @@
+//==========================================================================
+// ObTools::XMLMesh:Server: test-subscription-index.cc
+//
+// Test harness for subscription index, including a benchmark of publishing
+// to a million subscriptions against a linear pattern match
+//
+// Copyright (c) 2026 Paul Clark.  All rights reserved
+// This code comes with NO WARRANTY and is subject to licence agreement
+//==========================================================================
+
+#include <gtest/gtest.h>
+#include "server.h"
+#include "ot-text.h"
+#include <random>
+#include <set>
+
+using namespace std;
+using namespace ObTools;
+using namespace ObTools::XMLMesh;
+
+namespace {
+// Get matching subscribers as sorted "path/id" strings
+vector<string> match(const SubscriptionIndex& index, const string& subject)
+{
+  vector<const SubscriptionIndex::Subscriber *> subscribers;
+  index.match(subject, subscribers);
+  vector<string> result;
+  for(const auto s: subscribers)
+    result.push_back(s->path + "/" + s->subscriber_id);
+  sort(result.begin(), result.end());
+  return result;
+}
+}
+
+//--------------------------------------------------------------------------
+// Tests
+TEST(SubscriptionIndexTest, TestLiteralAndWildcardMatches)
+{
+  SubscriptionIndex index;
+  EXPECT_TRUE(index.add("foo.bar", "1", ""));
+  EXPECT_TRUE(index.add("foo.*", "2", ""));
+  EXPECT_TRUE(index.add("*.bar", "3", ""));
+  EXPECT_TRUE(index.add("foo.*.splat", "4", ""));
+  EXPECT_TRUE(index.add("*", "5", ""));
+  EXPECT_TRUE(index.add("foo.b?r", "6", ""));
+  EXPECT_TRUE(index.add("fo*", "7", ""));
+  EXPECT_EQ(7u, index.size());
+
+  EXPECT_EQ((vector<string>{"1/", "2/", "3/", "5/", "6/", "7/"}),
+            match(index, "foo.bar"));
+  EXPECT_EQ((vector<string>{"2/", "4/", "5/", "7/"}),
+            match(index, "foo.a.b.splat"));
+  EXPECT_EQ((vector<string>{"5/", "7/"}), match(index, "foo"));
+  EXPECT_EQ((vector<string>{"2/", "5/", "7/"}), match(index, "foo."));
+  EXPECT_EQ((vector<string>{"5/"}), match(index, ""));
+}
+
+TEST(SubscriptionIndexTest, TestSubscriberReturnedOnce)
+{
+  SubscriptionIndex index;
+  EXPECT_TRUE(index.add("foo.bar", "1", ""));
+  EXPECT_TRUE(index.add("foo.*", "1", ""));
+  EXPECT_TRUE(index.add("f*", "1", ""));
+  EXPECT_TRUE(index.add("*.*", "1", ""));
+  EXPECT_FALSE(index.add("foo.*", "1", ""));
+  EXPECT_TRUE(index.add("foo.*", "1", "a"));
+  EXPECT_EQ((vector<string>{"1/", "1/a"}), match(index, "foo.bar"));
+  EXPECT_EQ((vector<string>{"1/"}), match(index, "a.b.c.d"));
+}
+
+TEST(SubscriptionIndexTest, TestRemoveByPatternPathAndID)
+{
+  SubscriptionIndex index;
+  index.add("foo.bar", "1", "");
+  index.add("foo.*.splat", "1", "");
+  index.add("wibble", "1", "");
+  index.add("foo.bar", "2", "");
+  index.add("foo.bar", "3", "a");
+  index.add("foo.bar", "4", "a");
+
+  // Pattern removes matching subjects for this path only
+  vector<string> removed;
+  index.remove("foo.*", "1", "", removed);
+  EXPECT_EQ((vector<string>{"foo.bar", "foo.*.splat"}), removed);
+  EXPECT_EQ((vector<string>{"2/", "3/a", "4/a"}), match(index, "foo.bar"));
+  EXPECT_EQ(4u, index.size());
+
+  // ID takes precedence over path
+  removed.clear();
+  index.remove_all("x", "a", removed);
+  EXPECT_EQ(2u, removed.size());
+  EXPECT_EQ((vector<string>{"2/"}), match(index, "foo.bar"));
+
+  removed.clear();
+  index.remove_all("1", "", removed);
+  EXPECT_EQ((vector<string>{"wibble"}), removed);
+  EXPECT_TRUE(match(index, "wibble").empty());
+  EXPECT_EQ(1u, index.size());
+
+  // Trie is pruned and reusable
+  removed.clear();
+  index.remove_all("2", "", removed);
+  EXPECT_EQ(0u, index.size());
+  EXPECT_TRUE(match(index, "foo.bar").empty());
+  index.add("foo.bar", "2", "");
+  EXPECT_EQ((vector<string>{"2/"}), match(index, "foo.bar"));
+}
+
+TEST(SubscriptionIndexTest, TestAgreesWithPatternMatch)
+{
+  const vector<string> segments{"a", "b", "c", "*", "a?", "[ab]", "", "b*"};
+  const vector<string> subject_segments{"a", "b", "c", "ab", ""};
+  mt19937 rng(42);
+  auto make = [&rng](const vector<string>& from)
+  {
+    string s;
+    const auto n = 1 + rng() % 4;
+    for(auto i=0u; i<n; i++)
+    {
+      if (i) s += '.';
+      s += from[rng() % from.size()];
+    }
+    return s;
+  };
+
+  SubscriptionIndex index;
+  vector<string> patterns;
+  for(auto i=0; i<200; i++)
+  {
+    patterns.push_back(make(segments));
+    index.add(patterns.back(), to_string(i), "");
+  }
+
+  for(auto i=0; i<2000; i++)
+  {
+    const auto subject = make(subject_segments);
+    vector<string> expected;
+    for(auto j=0u; j<patterns.size(); j++)
+      if (Text::pattern_match(patterns[j], subject))
+        expected.push_back(to_string(j) + "/");
+    sort(expected.begin(), expected.end());
+    ASSERT_EQ(expected, match(index, subject)) << subject;
+  }
+}
+
+TEST(SubscriptionIndexTest, BenchmarkMillionSubscriptions)
+{
+  if (!getenv("OBTOOLS_BENCHMARK"))
+    GTEST_SKIP() << "OBTOOLS_BENCHMARK not set";
+
+  // 10000 clients, each with 100 subscriptions in a 3-level space of
+  // 100 * 100 * 100 subjects, some wildcarded
+  const auto clients = 10000;
+  const auto per_client = 100;
+  const auto publishes = 10000;
+  mt19937 rng(1);
+  auto seg = [&rng]() { return "s" + to_string(rng() % 100); };
+
+  vector<pair<string, string>> linear;  // pattern, path
+  SubscriptionIndex index;
+  auto start = chrono::steady_clock::now();
+  for(auto c=0; c<clients; c++)
+  {
+    const auto path = to_string(c);
+    for(auto i=0; i<per_client; i++)
+    {
+      auto subject = seg() + "." + seg() + ".";
+      subject += (i % 10) ? seg() : "*";
+      if (index.add(subject, path, "")) linear.emplace_back(subject, path);
+    }
+  }
+  chrono::duration<double> add_time = chrono::steady_clock::now() - start;
+  ASSERT_EQ(linear.size(), index.size());
+
+  vector<string> subjects;
+  for(auto i=0; i<publishes; i++)
+    subjects.push_back(seg() + "." + seg() + "." + seg());
+
+  // Linear: pattern match every subscription, for a few subjects
+  const auto linear_publishes = 10;
+  vector<vector<size_t>> linear_matches(linear_publishes);
+  start = chrono::steady_clock::now();
+  for(auto i=0; i<linear_publishes; i++)
+    for(auto j=0u; j<linear.size(); j++)
+      if (Text::pattern_match(linear[j].first, subjects[i]))
+        linear_matches[i].push_back(j);
+  chrono::duration<double> linear_time = chrono::steady_clock::now() - start;
+
+  // Index
+  auto index_matches = 0u;
+  vector<const SubscriptionIndex::Subscriber *> result;
+  start = chrono::steady_clock::now();
+  for(auto i=0; i<publishes; i++)
+  {
+    result.clear();
+    index.match(subjects[i], result);
+    index_matches += result.size();
+  }
+  chrono::duration<double> index_time = chrono::steady_clock::now() - start;
+
+  // Same subscribers, allowing for clients matching more than once in the
+  // linear scan
+  auto checked = 0u;
+  for(auto i=0; i<linear_publishes; i++)
+  {
+    set<string> expected;
+    for(const auto j: linear_matches[i])
+      expected.insert(linear[j].second + "/");
+    EXPECT_EQ(vector<string>(expected.begin(), expected.end()),
+              match(index, subjects[i])) << subjects[i];
+    checked += expected.size();
+  }
+  EXPECT_GT(checked, 0u);
+
+  // Remove all clients
+  start = chrono::steady_clock::now();
+  vector<string> removed;
+  for(auto c=0; c<clients; c++)
+    index.remove_all(to_string(c), "", removed);
+  chrono::duration<double> remove_time = chrono::steady_clock::now() - start;
+  EXPECT_EQ(linear.size(), removed.size());
+  EXPECT_EQ(0u, index.size());
+
+  const auto linear_us = linear_time.count() * 1e6 / linear_publishes;
+  const auto index_us = index_time.count() * 1e6 / publishes;
+  cout << linear.size() << " subscriptions added in " << add_time.count()
+       << "s, removed in " << remove_time.count() << "s\n"
+       << "Per publish: linear " << static_cast<int>(linear_us)
+       << "us, index " << index_us << "us (x" << linear_us / index_us
+       << "), " << static_cast<double>(index_matches) / publishes
+       << " subscribers each\n";
+}
+
+//--------------------------------------------------------------------------
+// Main
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}